@@ -0,0 +1,71 @@
+/**
+ * @file aabb.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_AABB_H_
+#define RAY_TRACING_INCLUDE_AABB_H_
+
+#include <algorithm>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+
+namespace rt {
+
+// axis-aligned bounding box
+class Aabb {
+ public:
+  Aabb() = default;
+  Aabb(const glm::vec3& minimum, const glm::vec3& maximum);
+  ~Aabb() = default;
+
+  glm::vec3 GetMin() const;
+  glm::vec3 GetMax() const;
+  glm::vec3 GetCentroid() const;
+  glm::vec3 GetExtent() const;
+
+  float SurfaceArea() const;
+  bool IsEmpty() const;
+
+  void Expand(const Aabb& box);
+  void Expand(const glm::vec3& point);
+
+  static Aabb Union(const Aabb& a, const Aabb& b);
+
+  // slab test, inverse direction is precomputed once per ray by the caller
+  inline bool Hit(const glm::vec3& origin, const glm::vec3& inv_direction,
+                  float t_min, float t_max) const {
+    for (int axis = 0; axis < 3; ++axis) {
+      float t0 = (min_[axis] - origin[axis]) * inv_direction[axis];
+      float t1 = (max_[axis] - origin[axis]) * inv_direction[axis];
+      if (inv_direction[axis] < 0.f) {
+        std::swap(t0, t1);
+      }
+
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+
+      if (t_max < t_min) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  glm::vec3 min_{INFINITY_F};
+  glm::vec3 max_{-INFINITY_F};
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_AABB_H_
@@ -0,0 +1,61 @@
+/**
+ * @file aligned_allocator.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_ALIGNED_ALLOCATOR_H_
+#define RAY_TRACING_INCLUDE_ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace rt {
+
+// allocator for containers whose storage is read by aligned SIMD loads
+template <typename T, std::size_t Alignment>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+    return false;
+  }
+};
+
+// vector aligned to the widest SIMD register in use
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 32> >;
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_ALIGNED_ALLOCATOR_H_
@@ -0,0 +1,89 @@
+/**
+ * @file arena.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_ARENA_H_
+#define RAY_TRACING_INCLUDE_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+// bytes of a block, large requests get a block of their own
+const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+// monotonic allocator, objects are placed one after the other in large
+// blocks and released all at once, so a scene costs a few allocations
+// instead of one per object and neighbouring objects share cache lines
+class Arena {
+ public:
+  Arena(size_t block_size = ARENA_BLOCK_SIZE);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&& other) noexcept;
+  Arena& operator=(Arena&& other) noexcept;
+
+  void* Allocate(size_t size, size_t alignment);
+
+  // destructors run on Reset or when the arena goes away, in reverse order
+  template <typename T, typename... Args>
+  T* Create(Args&&... args) {
+    T* object = new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      destructors_.push_back({object, &Destroy<T>});
+    }
+
+    return object;
+  }
+
+  // destroy every object, the blocks are kept for whatever comes next
+  void Reset();
+
+  size_t GetUsedBytes() const;
+  size_t GetCapacity() const;
+
+ private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> memory;
+    size_t size = 0;
+  };
+
+  struct Destructor {
+    void* object = nullptr;
+    void (*destroy)(void*) = nullptr;
+  };
+
+  template <typename T>
+  static void Destroy(void* object) {
+    static_cast<T*>(object)->~T();
+  }
+
+  void Release();
+
+  size_t block_size_ = ARENA_BLOCK_SIZE;
+  std::vector<Block> blocks_;
+  // block being filled and the bytes of it already handed out
+  size_t block_ = 0;
+  size_t offset_ = 0;
+  // bytes handed out by the blocks before block_
+  size_t used_ = 0;
+  std::vector<Destructor> destructors_;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_ARENA_H_
@@ -0,0 +1,128 @@
+/**
+ * @file bvh.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_BVH_H_
+#define RAY_TRACING_INCLUDE_BVH_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "sphere_set.h"
+
+namespace rt {
+
+// flattened bvh node, nodes are stored in depth-first order so the first
+// child of an interior node always directly follows its parent
+struct BvhNode {
+  Aabb box;
+  // leaf: index of first primitive, interior: index of second child
+  uint32_t offset;
+  // number of primitives in leaf, zero for interior nodes
+  uint16_t count;
+  // split axis of interior nodes
+  uint8_t axis;
+  // set by the owner of the nodes, the builder leaves it zero
+  uint8_t flags;
+
+  // leaf whose primitives are all spheres
+  static const uint8_t SPHERE_LEAF = 1u;
+
+  inline bool IsLeaf() const { return count > 0; }
+  inline bool IsSphereLeaf() const { return flags & SPHERE_LEAF; }
+};
+
+class BvhBuilder {
+ public:
+  // build nodes with binned surface area heuristic, indices are reordered so
+  // that every leaf references a contiguous range of primitives
+  static std::vector<BvhNode> Build(const std::vector<Aabb>& boxes,
+                                    std::vector<uint32_t>& indices);
+
+  // surface area cost of a node before dividing by the root area
+  static float GetNodeCost(const BvhNode& node);
+
+  // entries of the traversal stacks, no tree gets deeper than this
+  static const uint32_t MAX_DEPTH = 64;
+
+ private:
+  static uint32_t BuildRecursive(const std::vector<Aabb>& boxes,
+                                 const std::vector<glm::vec3>& centroids,
+                                 std::vector<uint32_t>& indices, uint32_t begin,
+                                 uint32_t end, uint32_t depth,
+                                 std::vector<BvhNode>& nodes);
+
+  static const int BIN_COUNT = 16;
+  static const uint32_t MAX_LEAF_SIZE = 4;
+  // deeper nodes take median splits, which halve any of the at most 2^32
+  // primitives down to a leaf within the remaining 32 levels
+  static const uint32_t MAX_BINNED_DEPTH = MAX_DEPTH - 32;
+  static constexpr float TRAVERSAL_COST = 0.125f;
+};
+
+class Bvh : public Hittable {
+ public:
+  Bvh() = default;
+  Bvh(const HittableList& list);
+  // spheres only, every leaf is a sphere leaf
+  Bvh(const SphereSet& spheres);
+  ~Bvh() = default;
+
+  // replace object index of the list the bvh was built from, boxes are only
+  // brought up to date by the next Refit, only bvhs built from a
+  // HittableList have objects and index has to be below the size of the list
+  void SetObject(uint32_t index, std::shared_ptr<Hittable> object);
+  // bottom-up box update of the leaves touched since the last refit, costs
+  // the changed objects times the tree depth, never the whole tree
+  void Refit();
+  // surface area cost relative to the freshly built tree, refits only ever
+  // loosen the tree so this grows until it gets rebuilt
+  float GetCostRatio() const;
+
+  virtual bool Hit(const Ray& ray, float t_min, float t_max,
+                   HitRecord& record) const override;
+
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
+ private:
+  void InitRefit();
+  // flag the leaf as sphere leaf when all of its slots hold spheres
+  void UpdateSphereLeaf(uint32_t leaf);
+
+  std::vector<BvhNode> nodes_;
+  std::vector<std::shared_ptr<Hittable> > objects_;
+  // spheres of objects_ in the same order, other primitives are empty slots,
+  // sphere leaves are tested through it without any virtual call
+  SphereSet spheres_{};
+
+  // refit state: parent of every node, leaf of every slot of objects_ and
+  // slot of every object of the original list
+  std::vector<uint32_t> parents_;
+  std::vector<uint32_t> leaves_;
+  std::vector<uint32_t> slots_;
+  std::vector<uint32_t> dirty_leaves_;
+  double cost_ = 0.0;
+  double build_cost_ = 0.0;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_BVH_H_
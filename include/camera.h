@@ -11,9 +11,13 @@
 #ifndef RAY_TRACING_INCLUDE_CAMERA_H_
 #define RAY_TRACING_INCLUDE_CAMERA_H_
 
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
 #include "ray.h"
+#include "ray_packet.h"
+#include "sampler.h"
 
 namespace rt {
 
@@ -24,7 +28,22 @@ class Camera {
          float aspect_ratio, float aperture, float focus_dist);
   ~Camera() = default;
 
-  Ray GetRay(float u, float v) const;
+  Ray GetRay(float u, float v, Sampler& sampler) const;
+  // rays of the lanes in mask, lane i consumes samplers[i] exactly like
+  // GetRay does, u and v must be set for every lane
+  void GetRayPacket(const float* u, const float* v, Sampler* samplers,
+                    uint32_t mask, RayPacket& packet) const;
+  // screen coordinates of a point as passed to GetRay, seen through the lens
+  // center, false behind the camera
+  bool Project(const glm::vec3& point, float& u, float& v) const;
+
+  glm::vec3 GetOrigin() const;
+  glm::vec3 GetLowerLeft() const;
+  glm::vec3 GetHorizontal() const;
+  glm::vec3 GetVertical() const;
+  glm::vec3 GetRight() const;
+  glm::vec3 GetUp() const;
+  float GetLensRadius() const;
 
  private:
   glm::vec3 origin_;
@@ -37,6 +56,7 @@ class Camera {
   glm::vec3 up_;
 
   float lens_radius_;
+  float focus_dist_;
 };
 
 }  // namespace rt
@@ -0,0 +1,88 @@
+/**
+ * @file checkpoint.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_CHECKPOINT_H_
+#define RAY_TRACING_INCLUDE_CHECKPOINT_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "renderer.h"
+
+namespace rt {
+
+// accumulation of a whole image on disk, in host byte order: a header with
+// the settings and the SceneFile::Hash of the scene it was traced with, then
+// the columns of Accumulation, so
+// a render that got killed goes on from its last checkpoint, samplers only
+// depend on the seed, the pixel and its sample count, so the counts are all
+// there is to the random state
+class Checkpoint {
+ public:
+  // false if the current settings are not compatible with the ones the
+  // checkpoint was traced with, throws if path is no checkpoint or was
+  // traced from another scene
+  static bool Read(const std::string& path, const RenderSettings& settings,
+                   uint64_t scene_hash, Accumulation& accumulation);
+
+  // written next to path through a mapping and moved over it once it is
+  // complete, so path always holds a whole checkpoint
+  static void Write(const std::string& path, const RenderSettings& settings,
+                    uint64_t scene_hash, const Accumulation& accumulation);
+};
+
+// writes checkpoints on a thread of its own, the caller copies the next one
+// into the buffer and goes on while it is written
+class CheckpointWriter {
+ public:
+  CheckpointWriter();
+  ~CheckpointWriter();
+
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  // whether a checkpoint is still being written
+  bool IsBusy() const;
+  // filled by the caller, only while not busy
+  Accumulation& GetBuffer();
+  // write the buffer to path in the background
+  void Submit(const std::string& path, const RenderSettings& settings,
+              uint64_t scene_hash);
+
+  // block until nothing is being written
+  void Wait();
+  // error of the last checkpoint that failed since the previous call,
+  // empty if none did
+  std::string TakeError();
+
+ private:
+  void WriteLoop();
+
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  // signaled whenever a checkpoint was written
+  std::condition_variable written_;
+  bool is_busy_ = false;
+  bool stop_ = false;
+
+  std::string path_{};
+  RenderSettings settings_{};
+  uint64_t scene_hash_ = 0;
+  Accumulation buffer_{};
+  std::string error_{};
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_CHECKPOINT_H_
@@ -0,0 +1,75 @@
+/**
+ * @file color_resolve.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_COLOR_RESOLVE_H_
+#define RAY_TRACING_INCLUDE_COLOR_RESOLVE_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+namespace rt {
+
+enum class Tonemap { NONE = 0, REINHARD = 1, ACES = 2 };
+
+// the display lut is indexed by the float bits of a value in
+// [2^COLOR_LUT_MIN_EXPONENT, 1), every octave split into buckets of the top
+// COLOR_LUT_MANTISSA_BITS mantissa bits, so it is finest where gamma is
+// steepest, values below resolve to 0 and always would at 8 bits
+const int COLOR_LUT_MIN_EXPONENT = -20;
+const int COLOR_LUT_MANTISSA_BITS = 8;
+const uint32_t COLOR_LUT_SIZE = static_cast<uint32_t>(-COLOR_LUT_MIN_EXPONENT)
+                                << COLOR_LUT_MANTISSA_BITS;
+const int COLOR_LUT_SHIFT = 23 - COLOR_LUT_MANTISSA_BITS;
+// float bits of 2^COLOR_LUT_MIN_EXPONENT and of the largest float below 1
+const uint32_t COLOR_LUT_MIN_BITS =
+    static_cast<uint32_t>(127 + COLOR_LUT_MIN_EXPONENT) << 23;
+const uint32_t COLOR_LUT_MAX_BITS = 0x3f7fffffu;
+
+// constants of Krzysztof Narkowicz's fit of the ACES filmic curve
+const float ACES_A = 2.51f;
+const float ACES_B = 0.03f;
+const float ACES_C = 2.43f;
+const float ACES_D = 0.59f;
+const float ACES_E = 0.14f;
+
+struct ResolveParams {
+  // 2^exposure
+  float exposure_scale;
+  Tonemap tonemap;
+  // COLOR_LUT_SIZE display values of ColorLut
+  const uint8_t* lut;
+};
+
+// 8 bit display values of one gamma, rebuilt only when the gamma changes
+class ColorLut {
+ public:
+  void Build(float gamma);
+
+  float GetGamma() const;
+  const uint8_t* GetData() const;
+
+ private:
+  float gamma_ = 0.f;
+  std::vector<uint8_t> values_;
+};
+
+// running sums of linear RGB and their sample counts to RGBA8: exposure,
+// tonemap and the display lut, this is the scalar kernel of
+// PacketKernels::resolve_colors and resolves the tails of the others
+void ResolveColors(const glm::vec3* sums, const int* sample_counts,
+                   uint32_t count, const ResolveParams& params,
+                   uint32_t* pixels);
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_COLOR_RESOLVE_H_
@@ -11,6 +11,8 @@
 #ifndef RAY_TRACING_INCLUDE_CONFIG_H_
 #define RAY_TRACING_INCLUDE_CONFIG_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 
 namespace rt {
@@ -29,8 +31,67 @@ const char* const FONTS_FILEPATH{"../../fonts/Roboto-Medium.ttf"};
 const char* const FONTS_FILEPATH{"../fonts/Roboto-Medium.ttf"};
 #endif
 
+#ifdef _WIN32
+const char* const PATH_TRACER_SHADER_FILEPATH{
+    "../shaders/path_tracer.comp.spv"};
+#else
+const char* const PATH_TRACER_SHADER_FILEPATH{"shaders/path_tracer.comp.spv"};
+#endif
+
+// ray tracing pipeline stages, next to the compute shader
+#ifdef _WIN32
+const char* const RAY_TRACING_SHADER_DIRECTORY{"../shaders/"};
+#else
+const char* const RAY_TRACING_SHADER_DIRECTORY{"shaders/"};
+#endif
+
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+// samples per pixel of one compute dispatch, longer passes are split so a
+// single dispatch never runs into the driver timeout
+const int GPU_SAMPLES_PER_DISPATCH = 16;
+
+// edge length in pixels of the square tiles scheduled by the renderer
+const uint32_t TILE_SIZE = 32;
+
+// rows a render farm worker traces at a time, a whole row of tiles
+const uint32_t FARM_BAND_ROWS = TILE_SIZE;
+// bands a worker holds at once, so it never waits for the next one
+const size_t FARM_QUEUE_DEPTH = 2;
+// largest frame and binary scene a worker accepts from a coordinator
+const uint64_t FARM_MAX_PIXEL_COUNT = uint64_t(1) << 26;
+const uint64_t FARM_MAX_SCENE_SIZE = uint64_t(1) << 30;
+// seconds a worker waits for its coordinator before serving the next one,
+// well above the default --worker-timeout a coordinator may spend waiting
+// on the bands of slower workers
+const float FARM_WORKER_TIMEOUT = 900.f;
+
+// seconds between the checkpoints of a render, unless asked otherwise
+const float CHECKPOINT_INTERVAL = 60.f;
+// checkpointed batch renders trace in passes of this many samples, as
+// checkpoints are only ever taken between passes
+const int CHECKPOINT_PASS_SAMPLES = 4;
+
+// bounces traced before russian roulette may end a path
+const int ROULETTE_MIN_DEPTH = 3;
+
+// keeps the adaptive sampling error of black pixels finite
+const float ADAPTIVE_ERROR_EPSILON = 1e-4f;
+
+// reprojected history stands in for at most this many samples of a pixel
+const int REPROJECTION_MAX_SAMPLES = 32;
+// history is reused where the first hits agree, closer than this share of
+// their distance to the camera and with normals at most ~25 degrees apart
+const float REPROJECTION_DEPTH_TOLERANCE = 0.03f;
+const float REPROJECTION_MIN_COS = 0.9f;
+// shorter mean normals come from pixels whose samples missed the world or
+// straddle an edge, they are never reused
+const float REPROJECTION_MIN_NORMAL_LENGTH = 0.9f;
+
+// refit bvhs whose surface area cost grew past this factor of the freshly
+// built tree are rebuilt
+const float BVH_REBUILD_COST_RATIO = 1.5f;
+
 const float INFINITY_F = std::numeric_limits<float>::infinity();
 const float PI = 3.1415926f;
 
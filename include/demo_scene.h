@@ -0,0 +1,32 @@
+/**
+ * @file demo_scene.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_DEMO_SCENE_H_
+#define RAY_TRACING_INCLUDE_DEMO_SCENE_H_
+
+#include <cstdint>
+
+#include "scene_file.h"
+
+namespace rt {
+
+// built-in world shared by the viewport and the headless renderer
+class DemoScene {
+ public:
+  // fixed seed keeps the generated scene identical across renders
+  static const uint64_t SEED = 2023u;
+
+  // plain description, built through SceneFile::Build like any loaded scene
+  static SceneDescription Build();
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_DEMO_SCENE_H_
@@ -0,0 +1,91 @@
+/**
+ * @file denoiser.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_DENOISER_H_
+#define RAY_TRACING_INCLUDE_DENOISER_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#ifdef RAY_TRACING_ENABLE_OIDN
+#include <OpenImageDenoise/oidn.hpp>
+#endif
+
+#include "thread_pool.h"
+
+namespace rt {
+
+// OIDN falls back to ATROUS in builds without RAY_TRACING_ENABLE_OIDN
+enum class DenoiseMode { NONE = 0, ATROUS = 1, OIDN = 2 };
+
+// passes of the a-trous filter, pass i samples every 2^i-th pixel of a 5x5
+// footprint, so five passes cover 61x61 pixels
+const int ATROUS_ITERATION_COUNT = 5;
+// edge stopping widths of the first pass, the color width is that of a
+// single sample and shrinks with the noise, by the square root of a pixel's
+// sample count, and halves with every pass since the image gets smoother
+const float ATROUS_SIGMA_COLOR = 2.f;
+const float ATROUS_SIGMA_NORMAL = 0.3f;
+const float ATROUS_SIGMA_ALBEDO = 0.1f;
+
+// filters the running sums of a progressive render, guided by the sums of the
+// samples' albedo and normal, state is kept between calls so repeated passes
+// at the same size do not allocate
+class Denoiser {
+ public:
+  static constexpr bool HasOidn() {
+#ifdef RAY_TRACING_ENABLE_OIDN
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // sums of width * height pixels in, denoised sums over the same sample
+  // counts out, false when the pool got cancelled
+  bool Denoise(DenoiseMode mode, uint32_t width, uint32_t height,
+               const glm::vec3* color_sums, const glm::vec3* albedo_sums,
+               const glm::vec3* normal_sums, const int* sample_counts,
+               glm::vec3* output_sums, ThreadPool& thread_pool);
+
+ private:
+  // edge avoiding a-trous wavelet filter of Dammertz et al. on the
+  // demodulated irradiance color_ / albedo_, result in color_
+  bool FilterAtrous(uint32_t width, uint32_t height, const int* sample_counts,
+                    ThreadPool& thread_pool);
+#ifdef RAY_TRACING_ENABLE_OIDN
+  // result in filtered_
+  bool FilterOidn(uint32_t width, uint32_t height);
+#endif
+
+  // per pixel means of the inputs
+  std::vector<glm::vec3> color_;
+  std::vector<glm::vec3> albedo_;
+  std::vector<glm::vec3> normal_;
+  // oidn output
+  std::vector<glm::vec3> filtered_;
+  // planar a-trous buffers, ping pong target and the per pixel color weight
+  std::vector<float> planes_;
+  std::vector<float> filtered_planes_;
+  std::vector<float> guide_planes_;
+  std::vector<float> sample_weights_;
+
+#ifdef RAY_TRACING_ENABLE_OIDN
+  oidn::DeviceRef device_;
+  oidn::FilterRef filter_;
+#endif
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_DENOISER_H_
@@ -16,23 +16,18 @@
 #include "hittable.h"
 #include "material.h"
 #include "ray.h"
+#include "sampler.h"
 
 namespace rt {
 
-class Dielectric : public Material {
+class Dielectric final : public Material {
  public:
   Dielectric(float refraction_index);
   ~Dielectric() = default;
 
   virtual bool Scatter(const Ray& ray, const HitRecord& record,
-                       glm::vec3& attenuation, Ray& scattered) const override;
-
- private:
-  float refraction_index_;
-
- private:
-  // User Schlick's approximation for reflectance
-  static float Reflectance(float cosine, float refraction_ratio);
+                       glm::vec3& attenuation, Ray& scattered,
+                       Sampler& sampler) const override;
 };
 
 }  // namespace rt
@@ -0,0 +1,39 @@
+/**
+ * @file diffuse_light.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_DIFFUSE_LIGHT_H_
+#define RAY_TRACING_INCLUDE_DIFFUSE_LIGHT_H_
+
+#include <glm/glm.hpp>
+
+#include "hittable.h"
+#include "material.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+// emits the same radiance in every direction off its front faces and
+// absorbs whatever hits it
+class DiffuseLight final : public Material {
+ public:
+  DiffuseLight(const glm::vec3& radiance);
+  ~DiffuseLight() = default;
+
+  virtual bool Scatter(const Ray& ray, const HitRecord& record,
+                       glm::vec3& attenuation, Ray& scattered,
+                       Sampler& sampler) const override;
+
+  virtual glm::vec3 Emitted(const HitRecord& record) const override;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_DIFFUSE_LIGHT_H_
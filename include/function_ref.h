@@ -0,0 +1,51 @@
+/**
+ * @file function_ref.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_FUNCTION_REF_H_
+#define RAY_TRACING_INCLUDE_FUNCTION_REF_H_
+
+#include <type_traits>
+#include <utility>
+
+namespace rt {
+
+template <typename Signature>
+class FunctionRef;
+
+// non owning reference to a callable, unlike std::function it never
+// allocates, so the callable has to outlive the reference, which holds for
+// arguments of a call taking the lambda right where it is written
+template <typename Result, typename... Args>
+class FunctionRef<Result(Args...)> {
+ public:
+  template <typename Callable,
+            typename = std::enable_if_t<!std::is_same<
+                std::decay_t<Callable>, FunctionRef>::value> >
+  FunctionRef(const Callable& callable)
+      : callable_{&callable}, invoke_{&Invoke<Callable>} {}
+
+  inline Result operator()(Args... args) const {
+    return invoke_(callable_, std::forward<Args>(args)...);
+  }
+
+ private:
+  template <typename Callable>
+  static Result Invoke(const void* callable, Args... args) {
+    return (*static_cast<const Callable*>(callable))(
+        std::forward<Args>(args)...);
+  }
+
+  const void* callable_ = nullptr;
+  Result (*invoke_)(const void*, Args...) = nullptr;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_FUNCTION_REF_H_
@@ -0,0 +1,191 @@
+/**
+ * @file gpu_renderer.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_GPU_RENDERER_H_
+#define RAY_TRACING_INCLUDE_GPU_RENDERER_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "image.h"
+#include "ray_tracing_scene.h"
+#include "renderer.h"
+#include "scene_file.h"
+
+namespace rt {
+
+// storage buffer layouts of path_tracer.comp
+struct GpuBvhNode {
+  // w: bits of BvhNode::offset
+  glm::vec4 min_offset;
+  // w: bits of BvhNode::count | BvhNode::axis << 16
+  glm::vec4 max_count;
+};
+
+struct GpuSphere {
+  glm::vec4 center_radius;
+  uint32_t material;
+  uint32_t padding[3];
+};
+
+struct GpuMaterial {
+  glm::vec4 albedo_fuzz;
+  uint32_t type;
+  float refraction_index;
+  uint32_t padding[2];
+};
+
+// tracer a device runs, hardware ray tracing wherever it is available
+enum class GpuBackend { COMPUTE, RAY_TRACING };
+
+// push constants of one dispatch, exactly the 128 bytes every device has
+struct GpuPass {
+  glm::vec4 origin;
+  glm::vec4 lower_left;
+  glm::vec4 horizontal;
+  glm::vec4 vertical;
+  glm::vec4 right;
+  glm::vec4 up;
+  glm::ivec4 extent;
+  glm::ivec4 trace;
+};
+
+// traces a scene straight into the storage image the viewer samples, with
+// the samplers, camera and materials of the cpu Renderer so both backends
+// converge to the same image, passes are recorded into the frame's command
+// buffer so nothing is read back, devices with the ray tracing extensions
+// trace spheres and meshes through hardware acceleration structures, others
+// trace the spheres alone in a compute shader
+class GpuRenderer {
+ public:
+  GpuRenderer() = delete;
+  GpuRenderer(VkPhysicalDevice& physical_device, VkDevice& device,
+              VkQueue& queue, VkCommandPool& command_pool,
+              uint32_t queue_family);
+  ~GpuRenderer();
+
+  // the samplers need 64 bit integers and the queue compute
+  static bool IsSupported(const VkPhysicalDevice& physical_device,
+                          uint32_t queue_family);
+
+  // upload the world, geometry holds the meshes built from the scene and is
+  // left out by the compute tracer along with the instances
+  void SetWorld(const SceneDescription& scene, const SceneGeometry& geometry);
+  // move the instances, a top level rebuild when ray tracing
+  void SetInstances(const std::vector<InstanceDescription>& instances);
+  // same semantics as the cpu Renderer
+  void SetSettings(const RenderSettings& settings);
+  void SetPlaying(bool playing);
+  void RequestRender();
+
+  // record the next pass into image if there is one, the caller must have
+  // waited on the fence of frame_index
+  void RecordRender(VkCommandBuffer command_buffer, uint32_t frame_index,
+                    Image& image);
+
+  GpuBackend GetBackend() const;
+  int GetAccumulatedSamples() const;
+  // milliseconds the last finished pass took on the device
+  float GetPassTime() const;
+  // whether the world has geometry the backend does not trace
+  bool HasSkippedGeometry() const;
+
+ private:
+  // bindings of the backend's shaders, see path_tracer.comp and
+  // ray_tracing.rgen
+  std::vector<VkDescriptorSetLayoutBinding> GetBindings() const;
+
+  void CreateDescriptorSetLayout();
+  void CreatePipeline();
+  void CreateComputePipeline();
+  void CreateRayTracingPipeline();
+  void CreateShaderBindingTable();
+  void CreateDescriptorSet();
+  void CreateQueryPool(uint32_t queue_family);
+
+  // device local buffer filled through a one time staging copy
+  void CreateStorageBuffer(const void* data, VkDeviceSize size,
+                           VkBuffer& buffer, VkDeviceMemory& buffer_memory);
+  void DestroyWorldBuffers();
+  void ResizeAccumulation(uint32_t width, uint32_t height);
+  void UpdateDescriptorSet();
+
+  bool HasWork() const;
+  void ReadPassTime(uint32_t frame_index);
+
+  VkPhysicalDevice& physical_device_;
+  VkDevice& device_;
+  VkQueue& queue_;
+  VkCommandPool& command_pool_;
+
+  GpuBackend backend_ = GpuBackend::COMPUTE;
+  VkPipelineBindPoint bind_point_ = VK_PIPELINE_BIND_POINT_COMPUTE;
+  // stages writing the image and reading the push constants
+  VkPipelineStageFlags shader_stage_ = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkShaderStageFlags push_constant_stages_ = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  // hardware ray tracing only
+  RayTracingFunctions functions_{};
+  std::unique_ptr<RayTracingScene> ray_tracing_scene_{};
+  VkBuffer shader_binding_table_ = VK_NULL_HANDLE;
+  VkDeviceMemory shader_binding_table_memory_ = VK_NULL_HANDLE;
+  VkStridedDeviceAddressRegionKHR raygen_region_{};
+  VkStridedDeviceAddressRegionKHR miss_region_{};
+  VkStridedDeviceAddressRegionKHR hit_region_{};
+  VkStridedDeviceAddressRegionKHR callable_region_{};
+
+  VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+
+  VkBuffer node_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory node_buffer_memory_ = VK_NULL_HANDLE;
+  VkBuffer sphere_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory sphere_buffer_memory_ = VK_NULL_HANDLE;
+  VkBuffer material_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory material_buffer_memory_ = VK_NULL_HANDLE;
+  uint32_t node_count_ = 0;
+  bool has_skipped_geometry_ = false;
+
+  VkBuffer accumulation_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory accumulation_buffer_memory_ = VK_NULL_HANDLE;
+  uint32_t accumulation_width_ = 0;
+  uint32_t accumulation_height_ = 0;
+
+  // image view the descriptor set currently points at
+  VkImageView image_view_ = VK_NULL_HANDLE;
+  bool is_descriptor_set_dirty_ = true;
+
+  // a begin and end timestamp per frame in flight
+  VkQueryPool query_pool_ = VK_NULL_HANDLE;
+  float timestamp_period_ = 0.f;
+  bool has_timestamps_[MAX_FRAMES_IN_FLIGHT]{};
+
+  RenderSettings settings_{};
+  int accumulated_samples_ = 0;
+  bool playing_ = false;
+  bool render_requested_ = false;
+  bool reset_requested_ = true;
+  bool resolve_requested_ = false;
+  float pass_time_ = 0.f;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_GPU_RENDERER_H_
@@ -11,23 +11,25 @@
 #ifndef RAY_TRACING_INCLUDE_HITTABLE_H_
 #define RAY_TRACING_INCLUDE_HITTABLE_H_
 
-#include <memory>
+#include <cstdint>
 
 #define RAY_TRACING_INCLUDE_GLM
 #include <glm/glm.hpp>
 
+#include "aabb.h"
 #include "ray.h"
+#include "ray_packet.h"
 
 namespace rt {
 
-class Material;
-
+// plain data, copying a record is a handful of stores
 struct HitRecord {
-  bool front_face;
-  float t;
   glm::vec3 point;
   glm::vec3 normal;
-  std::shared_ptr<Material> material;
+  float t;
+  // index into the scene material table
+  uint32_t material_index;
+  bool front_face;
 
   inline void SetFaceNormal(const Ray& ray, const glm::vec3& outward_normal) {
     front_face = glm::dot(ray.GetDirection(), outward_normal) < 0.f;
@@ -41,6 +43,18 @@ class Hittable {
 
   virtual bool Hit(const Ray& ray, float t_min, float t_max,
                    HitRecord& record) const = 0;
+
+  // whether anything lies along the ray in [t_min, t_max], for shadow rays,
+  // may stop at the first hit and never builds a record, default asks Hit
+  virtual bool Occluded(const Ray& ray, float t_min, float t_max) const;
+
+  // closest hit of every lane in mask, a lane is only updated when its hit is
+  // nearer than hit.t, object is set to the hittable whose Hit rebuilds the
+  // record, default traces the lanes one by one
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const;
+
+  virtual Aabb BoundingBox() const = 0;
 };
 
 }  // namespace rt
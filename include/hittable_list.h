@@ -11,11 +11,14 @@
 #ifndef RAY_TRACING_INCLUDE_HITTABLE_LIST_H_
 #define RAY_TRACING_INCLUDE_HITTABLE_LIST_H_
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "aabb.h"
 #include "hittable.h"
 #include "ray.h"
+#include "ray_packet.h"
 
 namespace rt {
 
@@ -25,7 +28,7 @@ class HittableList : public Hittable {
   HittableList(std::shared_ptr<Hittable> object);
   ~HittableList() = default;
 
-  inline std::vector<std::shared_ptr<Hittable> > GetObjects();
+  const std::vector<std::shared_ptr<Hittable> >& GetObjects() const;
 
   void Add(std::shared_ptr<Hittable> ojbect);
   void Clear();
@@ -33,6 +36,14 @@ class HittableList : public Hittable {
   virtual bool Hit(const Ray& ray, float t_min, float t_max,
                    HitRecord& record) const override;
 
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
  private:
   std::vector<std::shared_ptr<Hittable> > objects_;
 };
@@ -11,9 +11,13 @@
 #ifndef RAY_TRACING_INCLUDE_IMAGE_H_
 #define RAY_TRACING_INCLUDE_IMAGE_H_
 
+#include <vector>
+
 #define RAY_TRACING_INCLUDE_VULKAN
 #include <vulkan/vulkan.h>
 
+#include "config.h"
+
 namespace rt {
 
 class Image {
@@ -28,12 +32,30 @@ class Image {
   void CreateTextureImageView();
   void CreateTextureSampler();
   void CreateDescriptorSet();
+  void CreateStagingBuffers();
+  void DestroyStagingBuffers();
 
+  // queue whole image for upload, data must stay valid until the upload has
+  // been recorded
   void SetData(const void* data);
+  // queue only a dirty region of the image, data still covers the whole image
+  void SetData(const void* data, const VkRect2D& region);
+  // copy pending data into the staging buffer of the given frame in flight
+  // and record the copy, the caller must have waited on that frame's fence
+  void RecordUpload(VkCommandBuffer command_buffer, uint32_t frame_index);
+  // hand the image to shader writes in shader_stage and back to sampling,
+  // the commands in between must write every texel
+  void RecordStorageBegin(
+      VkCommandBuffer command_buffer,
+      VkPipelineStageFlags shader_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  void RecordStorageEnd(
+      VkCommandBuffer command_buffer,
+      VkPipelineStageFlags shader_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
   void Resize(uint32_t width, uint32_t height);
 
   uint32_t GetWidth() const;
   uint32_t GetHeight() const;
+  VkImageView GetImageView() const;
   VkDescriptorSet GetDescritorSet() const;
 
  private:
@@ -51,6 +73,16 @@ class Image {
   VkSampler texture_sampler_ = VK_NULL_HANDLE;
 
   VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+
+  // persistently mapped staging buffers, one per frame in flight, only
+  // created by the first upload so gpu written images never get them
+  VkBuffer staging_buffers_[MAX_FRAMES_IN_FLIGHT]{};
+  VkDeviceMemory staging_buffer_memories_[MAX_FRAMES_IN_FLIGHT]{};
+  void* staging_maps_[MAX_FRAMES_IN_FLIGHT]{};
+
+  const void* pending_data_ = nullptr;
+  std::vector<VkRect2D> dirty_regions_;
+  bool is_initialized_ = false;
 };
 
 }  // namespace rt
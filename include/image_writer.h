@@ -0,0 +1,59 @@
+/**
+ * @file image_writer.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_IMAGE_WRITER_H_
+#define RAY_TRACING_INCLUDE_IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+
+namespace rt {
+
+enum class ImageFormat { PNG, PFM, EXR };
+
+// writes rendered images to disk without any third-party codec
+class ImageWriter {
+ public:
+  // format picked from the file extension, PNG if unknown
+  static ImageFormat GetFormat(const std::string& path);
+  // whether the format stores linear radiance instead of display colors
+  static bool IsHdr(ImageFormat format);
+
+  static void Write(const std::string& path, const Framebuffer& framebuffer);
+
+  // 8-bit RGBA, zlib stored blocks so no compressor is needed
+  static void WritePng(const std::string& path, uint32_t width,
+                       uint32_t height, const std::vector<uint32_t>& pixels);
+
+  // 32-bit float RGB, rows bottom to top as the format expects
+  static void WritePfm(const std::string& path, uint32_t width,
+                       uint32_t height,
+                       const std::vector<glm::vec3>& radiance);
+
+  // 32-bit float RGB scanlines, uncompressed
+  static void WriteExr(const std::string& path, uint32_t width,
+                       uint32_t height,
+                       const std::vector<glm::vec3>& radiance);
+
+ private:
+  static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0u);
+  static void WriteFile(const std::string& path,
+                        const std::vector<uint8_t>& bytes);
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_IMAGE_WRITER_H_
@@ -0,0 +1,67 @@
+/**
+ * @file instance.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_INSTANCE_H_
+#define RAY_TRACING_INCLUDE_INSTANCE_H_
+
+#include <cstdint>
+#include <memory>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+// shared geometry placed by an invertible affine transform, rays are taken
+// into object space on entry so the geometry and its bvh are never copied or
+// touched, SceneFile rejects the transforms without an inverse
+class Instance : public Hittable {
+ public:
+  Instance() = default;
+  Instance(std::shared_ptr<const Hittable> geometry,
+           const glm::mat4& object_to_world);
+  ~Instance() = default;
+
+  virtual bool Hit(const Ray& ray, float t_min, float t_max,
+                   HitRecord& record) const override;
+
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
+  const std::shared_ptr<const Hittable>& GetGeometry() const;
+  glm::mat4 GetTransform() const;
+  // move the instance in place, the bvh holding it needs a refit afterwards
+  void SetTransform(const glm::mat4& object_to_world);
+
+ private:
+  // directions are not renormalized, t is the same in both spaces
+  Ray ToObject(const Ray& ray) const;
+
+  std::shared_ptr<const Hittable> geometry_;
+  glm::mat4 object_to_world_{1.f};
+  glm::mat4 world_to_object_{1.f};
+  // inverse transpose, keeps normals perpendicular under non-uniform scale
+  glm::mat3 normal_to_world_{1.f};
+  Aabb box_{};
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_INSTANCE_H_
@@ -16,19 +16,23 @@
 #include "hittable.h"
 #include "material.h"
 #include "ray.h"
+#include "sampler.h"
 
 namespace rt {
 
-class Lambertian : public Material {
+// ideal diffuse surface, scatters in a cosine lobe about the normal
+class Lambertian final : public Material {
  public:
   Lambertian(const glm::vec3& color);
   ~Lambertian() = default;
 
   virtual bool Scatter(const Ray& ray, const HitRecord& record,
-                       glm::vec3& attenuation, Ray& scattered) const override;
+                       glm::vec3& attenuation, Ray& scattered,
+                       Sampler& sampler) const override;
 
- private:
-  glm::vec3 albedo_;
+  virtual glm::vec3 Evaluate(const Ray& ray, const HitRecord& record,
+                             const glm::vec3& direction,
+                             float& pdf) const override;
 };
 
 }  // namespace rt
@@ -11,12 +11,24 @@
 #ifndef RAY_TRACING_INCLUDE_LAYER_H_
 #define RAY_TRACING_INCLUDE_LAYER_H_
 
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+
 namespace rt {
 class Layer {
  public:
   virtual ~Layer() = default;
 
   virtual void OnUIRender() = 0;
+
+  // record work into the frame's command buffer ahead of the UI render pass
+  virtual void OnRecordCommands(VkCommandBuffer command_buffer,
+                                uint32_t frame_index) {
+    (void)command_buffer;
+    (void)frame_index;
+  }
 };
 
 }  // namespace rt
@@ -0,0 +1,100 @@
+/**
+ * @file light_list.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_LIGHT_LIST_H_
+#define RAY_TRACING_INCLUDE_LIGHT_LIST_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "sampler.h"
+#include "triangle_mesh.h"
+
+namespace rt {
+
+// point on a light picked for next event estimation
+struct LightSample {
+  glm::vec3 point;
+  // shading normal of the light
+  glm::vec3 normal;
+  glm::vec3 radiance;
+  // per solid angle at the shaded point
+  float pdf;
+};
+
+// emissive spheres and triangles in world space, picked by power and then
+// sampled uniformly over the area facing the shaded point, so the density
+// per area is the same everywhere on the lights of one radiance
+class LightList {
+ public:
+  LightList() = default;
+  ~LightList() = default;
+
+  // keeps the buffers for the next set of lights
+  void Clear();
+
+  void AddSphere(const glm::vec3& center, float radius,
+                 const glm::vec3& radiance);
+  // every triangle of the placed mesh
+  void AddMesh(const TriangleMesh& mesh, const glm::mat4& object_to_world,
+               const glm::vec3& radiance);
+
+  bool IsEmpty() const;
+  uint32_t GetCount() const;
+
+  // false when the picked light cannot be seen from origin
+  bool Sample(const glm::vec3& origin, Sampler& sampler,
+              LightSample& sample) const;
+
+  // density per solid angle of reaching point with normal from origin,
+  // found again when a scattered ray hits a light, Sample weighs its points
+  // with the same value so multiple importance weights sum to one, the
+  // shading normal only ever stands in for the geometric one there
+  float GetPdf(const glm::vec3& origin, const glm::vec3& point,
+               const glm::vec3& normal, const glm::vec3& radiance) const;
+
+ private:
+  struct SphereLight {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 radiance;
+  };
+
+  struct TriangleLight {
+    glm::vec3 p0;
+    glm::vec3 edge1;
+    glm::vec3 edge2;
+    // unit, the side that emits
+    glm::vec3 geometric_normal;
+    // vertex normals, all zero for flat meshes
+    glm::vec3 normals[3];
+    glm::vec3 radiance;
+  };
+
+  bool SampleSphere(const SphereLight& light, const glm::vec3& origin,
+                    Sampler& sampler, LightSample& sample) const;
+  bool SampleTriangle(const TriangleLight& light, const glm::vec3& origin,
+                      Sampler& sampler, LightSample& sample) const;
+
+  std::vector<SphereLight> spheres_;
+  std::vector<TriangleLight> triangles_;
+  // running sums of the power of the spheres, then of the triangles
+  std::vector<float> sphere_powers_;
+  std::vector<float> triangle_powers_;
+  float sphere_power_ = 0.f;
+  float power_ = 0.f;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_LIGHT_LIST_H_
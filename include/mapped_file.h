@@ -0,0 +1,54 @@
+/**
+ * @file mapped_file.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_MAPPED_FILE_H_
+#define RAY_TRACING_INCLUDE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rt {
+
+// memory mapping of a whole file, pages are only read from disk once they
+// are touched
+class MappedFile {
+ public:
+  // read-only
+  MappedFile(const std::string& path);
+  // new file of size bytes, replacing any old one, mapped for writing
+  MappedFile(const std::string& path, size_t size);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* GetData() const;
+  // null for read-only mappings
+  uint8_t* GetMutableData();
+  size_t GetSize() const;
+
+  // block until the written pages are on disk
+  void Flush();
+
+ private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  bool is_writable_ = false;
+
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_MAPPED_FILE_H_
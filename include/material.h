@@ -14,17 +14,50 @@
 #include <glm/glm.hpp>
 
 #include "hittable.h"
+#include "material_data.h"
 #include "ray.h"
+#include "sampler.h"
 
 namespace rt {
 
+// open end of the materials, the built-in ones also describe themselves as
+// MaterialData which MaterialTable shades without the virtual calls, new
+// materials derive from here and keep the OTHER kind
 class Material {
  public:
   Material() = default;
   virtual ~Material() = default;
 
+  inline const MaterialData& GetData() const { return data_; }
+
   virtual bool Scatter(const Ray& ray, const HitRecord& record,
-                       glm::vec3& attenuation, Ray& scattered) const = 0;
+                       glm::vec3& attenuation, Ray& scattered,
+                       Sampler& sampler) const = 0;
+
+  // radiance leaving the surface back along the ray, only lights emit
+  virtual glm::vec3 Emitted(const HitRecord& record) const {
+    (void)record;
+    return glm::vec3(0.f);
+  }
+
+  // brdf times cosine towards direction, with pdf the density per solid angle
+  // Scatter picks it with, next event estimation skips materials leaving
+  // both at zero, which suits mirrors and glass
+  virtual glm::vec3 Evaluate(const Ray& ray, const HitRecord& record,
+                             const glm::vec3& direction, float& pdf) const {
+    (void)ray;
+    (void)record;
+    (void)direction;
+    pdf = 0.f;
+    return glm::vec3(0.f);
+  }
+
+ protected:
+  // for the built-in materials only
+  explicit Material(const MaterialData& data) : data_{data} {}
+
+ private:
+  MaterialData data_{};
 };
 
 }  // namespace rt
@@ -0,0 +1,234 @@
+/**
+ * @file material_data.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_MATERIAL_DATA_H_
+#define RAY_TRACING_INCLUDE_MATERIAL_DATA_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "math_utils.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+// concrete type of a material, numbered like MaterialType so the same tag
+// works on the gpu, materials outside the closed set are OTHER
+enum class MaterialKind : uint32_t {
+  LAMBERTIAN = 0,
+  METAL,
+  DIELECTRIC,
+  DIFFUSE_LIGHT,
+  OTHER,
+  COUNT
+};
+
+// closed form of the built-in materials, a kind and its plain parameters,
+// in the order of the first 24 bytes of GpuMaterial
+struct MaterialData {
+  // albedo, the emitted radiance of lights
+  glm::vec3 albedo{0.f};
+  float fuzz = 0.f;
+  MaterialKind kind = MaterialKind::OTHER;
+  float refraction_index = 1.f;
+};
+
+// shading of the closed materials, everything is inline so a switch over the
+// kind or a call for a known kind compiles into the shading loop, the
+// built-in Material classes forward here so both paths agree
+class MaterialShading {
+ public:
+  // the switches take every kind but OTHER
+  static inline bool Scatter(const MaterialData& material, const Ray& ray,
+                             const HitRecord& record, glm::vec3& attenuation,
+                             Ray& scattered, Sampler& sampler);
+  static inline glm::vec3 Emitted(const MaterialData& material,
+                                  const HitRecord& record);
+  static inline glm::vec3 Evaluate(const MaterialData& material,
+                                   const HitRecord& record,
+                                   const glm::vec3& direction, float& pdf);
+
+  // see Material::Scatter
+  static inline bool ScatterLambertian(const MaterialData& material,
+                                       const HitRecord& record,
+                                       glm::vec3& attenuation, Ray& scattered,
+                                       Sampler& sampler);
+  static inline bool ScatterMetal(const MaterialData& material, const Ray& ray,
+                                  const HitRecord& record,
+                                  glm::vec3& attenuation, Ray& scattered,
+                                  Sampler& sampler);
+  static inline bool ScatterDielectric(const MaterialData& material,
+                                       const Ray& ray, const HitRecord& record,
+                                       glm::vec3& attenuation, Ray& scattered,
+                                       Sampler& sampler);
+  static inline bool ScatterDiffuseLight(const MaterialData& material,
+                                         glm::vec3& attenuation);
+
+  // see Material::Emitted and Material::Evaluate, the other kinds neither
+  // emit nor take light samples
+  static inline glm::vec3 EmittedDiffuseLight(const MaterialData& material,
+                                              const HitRecord& record);
+  static inline glm::vec3 EvaluateLambertian(const MaterialData& material,
+                                             const HitRecord& record,
+                                             const glm::vec3& direction,
+                                             float& pdf);
+
+ private:
+  // Schlick's approximation for reflectance
+  static inline float Reflectance(float cosine, float refraction_ratio);
+};
+
+inline bool MaterialShading::Scatter(const MaterialData& material,
+                                     const Ray& ray, const HitRecord& record,
+                                     glm::vec3& attenuation, Ray& scattered,
+                                     Sampler& sampler) {
+  switch (material.kind) {
+    case MaterialKind::LAMBERTIAN:
+      return ScatterLambertian(material, record, attenuation, scattered,
+                               sampler);
+    case MaterialKind::METAL:
+      return ScatterMetal(material, ray, record, attenuation, scattered,
+                          sampler);
+    case MaterialKind::DIELECTRIC:
+      return ScatterDielectric(material, ray, record, attenuation, scattered,
+                               sampler);
+    default:
+      return ScatterDiffuseLight(material, attenuation);
+  }
+}
+
+inline glm::vec3 MaterialShading::Emitted(const MaterialData& material,
+                                          const HitRecord& record) {
+  if (MaterialKind::DIFFUSE_LIGHT == material.kind) {
+    return EmittedDiffuseLight(material, record);
+  }
+
+  return glm::vec3(0.f);
+}
+
+inline glm::vec3 MaterialShading::Evaluate(const MaterialData& material,
+                                           const HitRecord& record,
+                                           const glm::vec3& direction,
+                                           float& pdf) {
+  if (MaterialKind::LAMBERTIAN == material.kind) {
+    return EvaluateLambertian(material, record, direction, pdf);
+  }
+
+  pdf = 0.f;
+  return glm::vec3(0.f);
+}
+
+inline bool MaterialShading::ScatterLambertian(const MaterialData& material,
+                                               const HitRecord& record,
+                                               glm::vec3& attenuation,
+                                               Ray& scattered,
+                                               Sampler& sampler) {
+  // a unit vector off the tip of the normal is cosine distributed
+  glm::vec3 scatter_direction =
+      record.normal + MathUtils::RandomUnitVector(sampler);
+
+  if (MathUtils::NearZero(scatter_direction)) {
+    scatter_direction = record.normal;
+  }
+
+  scattered = Ray(record.point, scatter_direction);
+  attenuation = material.albedo;
+
+  return true;
+}
+
+inline bool MaterialShading::ScatterMetal(const MaterialData& material,
+                                          const Ray& ray,
+                                          const HitRecord& record,
+                                          glm::vec3& attenuation,
+                                          Ray& scattered, Sampler& sampler) {
+  glm::vec3 reflection =
+      glm::reflect(glm::normalize(ray.GetDirection()), record.normal);
+
+  scattered =
+      Ray(record.point,
+          reflection + material.fuzz * MathUtils::RandomInUnitSphere(sampler));
+  attenuation = material.albedo;
+
+  return (glm::dot(scattered.GetDirection(), record.normal) > 0.f);
+}
+
+inline bool MaterialShading::ScatterDielectric(const MaterialData& material,
+                                               const Ray& ray,
+                                               const HitRecord& record,
+                                               glm::vec3& attenuation,
+                                               Ray& scattered,
+                                               Sampler& sampler) {
+  attenuation = glm::vec3(1.f, 1.f, 1.f);
+
+  float refraction_ratio = record.front_face
+                               ? (1.f / material.refraction_index)
+                               : material.refraction_index;
+  glm::vec3 unit_direction = glm::normalize(ray.GetDirection());
+
+  float cos_theta = std::fmin(glm::dot(-unit_direction, record.normal), 1.f);
+  float sin_theta = std::sqrt(1.f - cos_theta * cos_theta);
+
+  bool cannot_refract = refraction_ratio * sin_theta > 1.f;
+  glm::vec3 direction{};
+
+  if (cannot_refract || (Reflectance(cos_theta, refraction_ratio) >
+                         MathUtils::RandomFloat(sampler))) {  // reflect
+    direction = glm::reflect(unit_direction, record.normal);
+  } else {  // refract
+    direction = glm::refract(unit_direction, record.normal, refraction_ratio);
+  }
+
+  scattered = Ray(record.point, direction);
+
+  return true;
+}
+
+inline bool MaterialShading::ScatterDiffuseLight(const MaterialData& material,
+                                                 glm::vec3& attenuation) {
+  // the guides of the denoiser see the light like the background
+  attenuation = material.albedo;
+
+  return false;
+}
+
+inline glm::vec3 MaterialShading::EmittedDiffuseLight(
+    const MaterialData& material, const HitRecord& record) {
+  return record.front_face ? material.albedo : glm::vec3(0.f);
+}
+
+inline glm::vec3 MaterialShading::EvaluateLambertian(
+    const MaterialData& material, const HitRecord& record,
+    const glm::vec3& direction, float& pdf) {
+  // albedo / pi times the cosine, the same cosine over pi as the pdf
+  const float cosine = glm::dot(glm::normalize(direction), record.normal);
+  pdf = std::max(cosine, 0.f) / PI;
+
+  return material.albedo * pdf;
+}
+
+inline float MaterialShading::Reflectance(float cosine,
+                                          float refraction_ratio) {
+  float r = (1.f - refraction_ratio) / (1.f + refraction_ratio);
+  r = r * r;
+
+  return r + (1.f - r) * std::pow((1.f - cosine), 5.f);
+}
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_MATERIAL_DATA_H_
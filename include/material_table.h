@@ -0,0 +1,109 @@
+/**
+ * @file material_table.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_MATERIAL_TABLE_H_
+#define RAY_TRACING_INCLUDE_MATERIAL_TABLE_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "arena.h"
+#include "hittable.h"
+#include "material.h"
+#include "material_data.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+// scene owned materials, hittables and hit records refer to them by index so
+// tracing never touches a reference count, the materials themselves sit next
+// to each other in the table's arena, the built-in ones are also kept as
+// MaterialData and shaded by a switch over their kind instead of the vtable
+class MaterialTable {
+ public:
+  MaterialTable() = default;
+  ~MaterialTable() = default;
+
+  MaterialTable(const MaterialTable&) = delete;
+  MaterialTable& operator=(const MaterialTable&) = delete;
+  MaterialTable(MaterialTable&&) = default;
+  MaterialTable& operator=(MaterialTable&&) = default;
+
+  // returns the index of the added material, built in place
+  template <typename T, typename... Args>
+  uint32_t Add(Args&&... args) {
+    const T* material = arena_.Create<T>(std::forward<Args>(args)...);
+    materials_.push_back(material);
+    data_.push_back(material->GetData());
+
+    return static_cast<uint32_t>(materials_.size() - 1);
+  }
+  // keeps the arena blocks for the next scene
+  void Clear();
+
+  uint32_t GetCount() const;
+
+  inline const Material& Get(uint32_t index) const {
+    return *materials_[index];
+  }
+  inline const MaterialData& GetData(uint32_t index) const {
+    return data_[index];
+  }
+  inline MaterialKind GetKind(uint32_t index) const {
+    return data_[index].kind;
+  }
+
+  // same as the Material calls, only OTHER goes through the vtable
+  inline bool Scatter(uint32_t index, const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) const {
+    const MaterialData& data = data_[index];
+    if (MaterialKind::OTHER == data.kind) {
+      return materials_[index]->Scatter(ray, record, attenuation, scattered,
+                                        sampler);
+    }
+
+    return MaterialShading::Scatter(data, ray, record, attenuation, scattered,
+                                    sampler);
+  }
+  inline glm::vec3 Emitted(uint32_t index, const HitRecord& record) const {
+    const MaterialData& data = data_[index];
+    if (MaterialKind::OTHER == data.kind) {
+      return materials_[index]->Emitted(record);
+    }
+
+    return MaterialShading::Emitted(data, record);
+  }
+  inline glm::vec3 Evaluate(uint32_t index, const Ray& ray,
+                            const HitRecord& record,
+                            const glm::vec3& direction, float& pdf) const {
+    const MaterialData& data = data_[index];
+    if (MaterialKind::OTHER == data.kind) {
+      return materials_[index]->Evaluate(ray, record, direction, pdf);
+    }
+
+    return MaterialShading::Evaluate(data, record, direction, pdf);
+  }
+
+ private:
+  Arena arena_{};
+  std::vector<const Material*> materials_;
+  // indexed like materials_, packed for the shading switch
+  std::vector<MaterialData> data_;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_MATERIAL_TABLE_H_
@@ -0,0 +1,71 @@
+/**
+ * @file math_utils.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_MATH_UTILS_H_
+#define RAY_TRACING_INCLUDE_MATH_UTILS_H_
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "sampler.h"
+
+namespace rt {
+
+// cpu side helpers of the tracer, kept apart from Utils so that they never
+// pull in the window or Vulkan headers
+class MathUtils {
+ public:
+  // RGB to RGBA in hexadecimal
+  static uint32_t GetColor(const glm::vec3& color, int samples_per_pixel = 1,
+                           float gamma = 1.f);
+
+  // RGBA in hexadecimal
+  static uint32_t GetColor(const glm::vec4& color, int samples_per_pixel = 1,
+                           float gamma = 1.f);
+
+  // random float number
+  static float RandomFloat(Sampler& sampler, float min = 0.f, float max = 1.f);
+
+  // random 3-dimension vector
+  static glm::vec3 RandomVec3(Sampler& sampler, float min = 0.f,
+                              float max = 1.f);
+
+  // Rec. 709 luminance of linear RGB
+  static float Luminance(const glm::vec3& color);
+
+  // check vector is near zero
+  static bool NearZero(const glm::vec3& vec);
+
+  // multiple importance weight of the strategy sampling with density pdf
+  // against other_pdf, in ratios so huge densities cannot overflow
+  static float PowerHeuristic(float pdf, float other_pdf);
+
+  static glm::vec3 RandomInUnitSphere(Sampler& sampler);
+
+  // uniform on the unit sphere, from two floats without rejection
+  static glm::vec3 RandomUnitVector(Sampler& sampler);
+
+  static glm::vec3 RandomInHemiSphere(Sampler& sampler,
+                                      const glm::vec3& normal);
+
+  static glm::vec3 RandomInUnitDisk(Sampler& sampler);
+
+  static float DegreesToRadians(float degree);
+
+  // tangent and bitangent completing the unit vector w to a right handed
+  // orthonormal basis
+  static void MakeBasis(const glm::vec3& w, glm::vec3& u, glm::vec3& v);
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_MATH_UTILS_H_
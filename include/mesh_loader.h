@@ -0,0 +1,39 @@
+/**
+ * @file mesh_loader.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_MESH_LOADER_H_
+#define RAY_TRACING_INCLUDE_MESH_LOADER_H_
+
+#include <string>
+
+#include "triangle_mesh.h"
+
+namespace rt {
+
+// mesh files are read in one go and parsed in place straight into the
+// vertex and index arrays, polygons are split into triangle fans
+class MeshLoader {
+ public:
+  // format picked from the file extension, .obj or .ply
+  static MeshData Load(const std::string& path);
+
+  // positions, normals and faces, everything else is skipped
+  static MeshData LoadObj(const std::string& path);
+
+  // ascii and binary of either byte order
+  static MeshData LoadPly(const std::string& path);
+
+  // whole file as it is
+  static std::string ReadFile(const std::string& path);
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_MESH_LOADER_H_
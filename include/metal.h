@@ -16,20 +16,18 @@
 #include "hittable.h"
 #include "material.h"
 #include "ray.h"
+#include "sampler.h"
 
 namespace rt {
 
-class Metal : public Material {
+class Metal final : public Material {
  public:
   Metal(float fuzz, const glm::vec3& color);
   ~Metal() = default;
 
   virtual bool Scatter(const Ray& ray, const HitRecord& record,
-                       glm::vec3& attenuation, Ray& scattered) const;
-
- private:
-  float fuzz_;
-  glm::vec3 albedo_;
+                       glm::vec3& attenuation, Ray& scattered,
+                       Sampler& sampler) const;
 };
 
 }  // namespace rt
@@ -0,0 +1,82 @@
+/**
+ * @file path_integrator.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_PATH_INTEGRATOR_H_
+#define RAY_TRACING_INCLUDE_PATH_INTEGRATOR_H_
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+// first hit guides of the denoiser and the reprojection, albedo is the
+// attenuation of the first scatter and the background color on a miss,
+// where normal and position stay zero
+struct SurfaceAov {
+  glm::vec3 albedo{0.f};
+  glm::vec3 normal{0.f};
+  glm::vec3 position{0.f};
+};
+
+// iterative path tracer, carries a running throughput instead of recursing
+// once per bounce and ends low throughput paths early by russian roulette,
+// with lights given every diffuse bounce also samples one of them and both
+// estimates are combined by multiple importance sampling
+class PathIntegrator {
+ public:
+  PathIntegrator(const Hittable& world, const MaterialTable& materials,
+                 int max_depth, const LightList* lights = nullptr,
+                 int roulette_depth = ROULETTE_MIN_DEPTH);
+  ~PathIntegrator() = default;
+
+  // radiance arriving along the ray, aov receives the first hit if given
+  glm::vec3 Li(const Ray& ray, Sampler& sampler,
+               SurfaceAov* aov = nullptr) const;
+  // same as above for a ray whose closest hit is already known
+  glm::vec3 Li(const Ray& ray, const HitRecord& record, Sampler& sampler,
+               SurfaceAov* aov = nullptr) const;
+
+  int GetMaxDepth() const;
+
+  static glm::vec3 Background(const Ray& ray);
+
+  // ray offset that keeps bounces from hitting their own surface
+  static constexpr float T_MIN = 0.001f;
+  // share of a shadow ray left out at the light, so it never hits the light
+  // it aims at
+  static constexpr float SHADOW_EPSILON = 0.001f;
+
+ private:
+  // radiance a sampled light sends through the surface, weighted against
+  // scattering into it
+  glm::vec3 SampleLight(const Ray& ray, const HitRecord& record,
+                        Sampler& sampler) const;
+  // nothing blocks the segment between the points
+  bool IsVisible(const glm::vec3& from, const glm::vec3& to) const;
+
+  const Hittable& world_;
+  const MaterialTable& materials_;
+  // null or empty traces without next event estimation
+  const LightList* lights_;
+  int max_depth_;
+  int roulette_depth_;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_PATH_INTEGRATOR_H_
@@ -0,0 +1,52 @@
+/**
+ * @file ray_packet.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_RAY_PACKET_H_
+#define RAY_TRACING_INCLUDE_RAY_PACKET_H_
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "ray.h"
+
+namespace rt {
+
+class Hittable;
+
+// rays per packet, one AVX2 register or two SSE/NEON registers
+const int PACKET_SIZE = 8;
+const uint32_t PACKET_FULL_MASK = (1u << PACKET_SIZE) - 1u;
+
+// structure-of-arrays ray packet, lane i of every array belongs to ray i
+struct alignas(32) RayPacket {
+  float origin[3][PACKET_SIZE];
+  float direction[3][PACKET_SIZE];
+  float inv_direction[3][PACKET_SIZE];
+  float t_min = 0.001f;
+  // active lanes, bit i set when lane i carries a valid ray
+  uint32_t mask = 0;
+
+  void SetRay(int lane, const Ray& ray);
+  Ray GetRay(int lane) const;
+};
+
+// closest hit per lane, t doubles as the running t_max of each lane
+struct alignas(32) PacketHit {
+  float t[PACKET_SIZE];
+  const Hittable* object[PACKET_SIZE];
+
+  void Reset(float t_max);
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_RAY_PACKET_H_
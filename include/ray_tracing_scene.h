@@ -0,0 +1,125 @@
+/**
+ * @file ray_tracing_scene.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_RAY_TRACING_SCENE_H_
+#define RAY_TRACING_INCLUDE_RAY_TRACING_SCENE_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+
+#include "scene_file.h"
+
+namespace rt {
+
+// entry points of the ray tracing extensions, the loader does not export
+// them so they are looked up once per device
+struct RayTracingFunctions {
+  PFN_vkGetBufferDeviceAddress get_buffer_device_address = nullptr;
+  PFN_vkCreateAccelerationStructureKHR create_acceleration_structure = nullptr;
+  PFN_vkDestroyAccelerationStructureKHR destroy_acceleration_structure =
+      nullptr;
+  PFN_vkGetAccelerationStructureBuildSizesKHR
+      get_acceleration_structure_build_sizes = nullptr;
+  PFN_vkCmdBuildAccelerationStructuresKHR cmd_build_acceleration_structures =
+      nullptr;
+  PFN_vkGetAccelerationStructureDeviceAddressKHR
+      get_acceleration_structure_device_address = nullptr;
+  PFN_vkCreateRayTracingPipelinesKHR create_ray_tracing_pipelines = nullptr;
+  PFN_vkGetRayTracingShaderGroupHandlesKHR
+      get_ray_tracing_shader_group_handles = nullptr;
+  PFN_vkCmdTraceRaysKHR cmd_trace_rays = nullptr;
+
+  void Load(const VkDevice& device);
+};
+
+// hit group offsets of the shader binding table, instances of the top
+// level pick theirs
+const uint32_t TRIANGLE_HIT_GROUP = 0;
+const uint32_t SPHERE_HIT_GROUP = 1;
+
+// per mesh record of triangle.rchit, buffers are referenced by address
+struct GpuMesh {
+  uint64_t positions;
+  // zero without vertex normals
+  uint64_t normals;
+  uint64_t indices;
+  uint32_t material;
+  uint32_t padding;
+};
+
+struct AccelerationStructure {
+  VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+  VkDeviceAddress address = 0;
+};
+
+// hardware acceleration structures of a scene, the spheres are one bottom
+// level of boxes intersected by sphere.rint and every mesh gets a triangle
+// bottom level, the top level places them like SceneFile::BuildTopLevel
+class RayTracingScene {
+ public:
+  RayTracingScene() = delete;
+  RayTracingScene(VkPhysicalDevice& physical_device, VkDevice& device,
+                  VkQueue& queue, VkCommandPool& command_pool,
+                  const RayTracingFunctions& functions);
+  ~RayTracingScene();
+
+  // box i of the sphere level bounds sphere i of the scene and mesh i of
+  // the geometry is mesh i of the scene, the caller waits for the queue
+  void Build(const SceneDescription& scene, const SceneGeometry& geometry);
+  // rebuild the top level only, the bottom levels stay
+  void SetInstances(const std::vector<InstanceDescription>& instances);
+
+  VkAccelerationStructureKHR GetTopLevel() const;
+  VkBuffer GetMeshBuffer() const;
+
+ private:
+  // build a structure of one geometry in a one time command
+  AccelerationStructure BuildAccelerationStructure(
+      VkAccelerationStructureTypeKHR type,
+      const VkAccelerationStructureGeometryKHR& geometry,
+      uint32_t primitive_count);
+  void DestroyAccelerationStructure(AccelerationStructure& structure);
+
+  // device local input of the builds, kept until the next Build
+  VkDeviceAddress CreateInputBuffer(const void* data, VkDeviceSize size,
+                                    VkBufferUsageFlags usage);
+  VkDeviceAddress GetBufferAddress(VkBuffer buffer) const;
+  void Destroy();
+
+  VkPhysicalDevice& physical_device_;
+  VkDevice& device_;
+  VkQueue& queue_;
+  VkCommandPool& command_pool_;
+  const RayTracingFunctions& functions_;
+
+  VkDeviceSize scratch_alignment_ = 1;
+
+  std::vector<VkBuffer> input_buffers_{};
+  std::vector<VkDeviceMemory> input_buffer_memories_{};
+
+  AccelerationStructure spheres_{};
+  // null handles for meshes without triangles
+  std::vector<AccelerationStructure> meshes_{};
+  AccelerationStructure top_level_{};
+  VkBuffer instance_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory instance_buffer_memory_ = VK_NULL_HANDLE;
+
+  VkBuffer mesh_buffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory mesh_buffer_memory_ = VK_NULL_HANDLE;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_RAY_TRACING_SCENE_H_
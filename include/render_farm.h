@@ -0,0 +1,46 @@
+/**
+ * @file render_farm.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_RENDER_FARM_H_
+#define RAY_TRACING_INCLUDE_RENDER_FARM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "renderer.h"
+#include "scene_file.h"
+
+namespace rt {
+
+// one frame traced by headless workers on other machines: the coordinator
+// sends each of them the scene as a binary scene and the settings, then
+// hands out bands of FARM_BAND_ROWS rows as they finish the previous ones
+// and merges the sums they send back, the bands of a worker that failed or
+// timed out go to the others, samplers only depend on the pixel and the
+// sample so the merged image is the one a single renderer traces, meshes
+// are loaded by path so workers need them in the same place
+class RenderFarm {
+ public:
+  // workers as host:port, timeout in seconds is the longest one may take
+  // for a band, throws once no worker is left to trace the bands remaining
+  static void Render(const std::vector<std::string>& workers, float timeout,
+                     const SceneDescription& scene,
+                     const RenderSettings& settings,
+                     Accumulation& accumulation);
+
+  // trace the frames of one coordinator after the other, never returns but
+  // throws if port cannot be listened on
+  static void Serve(uint16_t port, uint32_t thread_count);
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_RENDER_FARM_H_
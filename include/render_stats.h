@@ -0,0 +1,115 @@
+/**
+ * @file render_stats.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_RENDER_STATS_H_
+#define RAY_TRACING_INCLUDE_RENDER_STATS_H_
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace rt {
+
+// bounces counted one by one, deeper rays share the last bucket
+const int STATS_DEPTH_COUNT = 16;
+
+// hot path counters, every thread bumps its own set without any atomics and
+// the renderer merges them once a tile is done
+struct RayCounters {
+  // closest hit queries by bounce, camera rays are depth 0
+  uint64_t rays[STATS_DEPTH_COUNT]{};
+  // visibility queries of next event estimation
+  uint64_t shadow_rays = 0;
+  // ray against sphere or triangle tests
+  uint64_t intersection_tests = 0;
+  // ray against bvh node box tests, a packet counts its active lanes
+  uint64_t bvh_nodes = 0;
+
+  void Merge(const RayCounters& other);
+  // closest hit and shadow rays
+  uint64_t GetRayCount() const;
+};
+
+// statistics of one finished pass of the cpu Renderer, counters and tile
+// times stay empty in builds without RAY_TRACING_ENABLE_STATS
+struct RenderStats {
+  RayCounters counters{};
+  // milliseconds, the resolve is part of the pass and the denoiser part of
+  // the resolve
+  float pass_time = 0.f;
+  float resolve_time = 0.f;
+  float denoise_time = 0.f;
+  // samples traced this pass and pixels adaptive sampling stopped so far
+  uint64_t samples = 0;
+  uint32_t converged_pixels = 0;
+
+  // milliseconds spent on every tile, row major
+  uint32_t tiles_x = 0;
+  uint32_t tiles_y = 0;
+  std::vector<float> tile_times;
+  // milliseconds every worker spent in tiles
+  std::vector<float> worker_times;
+
+  double GetMraysPerSecond() const;
+  // share of the pass a worker was busy
+  float GetUtilization(uint32_t worker) const;
+  float GetAverageUtilization() const;
+
+  // one json object, no trailing newline
+  void WriteJson(std::ostream& stream) const;
+};
+
+class Stats {
+ public:
+  static constexpr bool IsEnabled() {
+#ifdef RAY_TRACING_ENABLE_STATS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // counters of the calling thread
+  static inline RayCounters& GetLocal() {
+    thread_local RayCounters counters{};
+    return counters;
+  }
+
+  // hand the calling thread's counters over and restart them from zero
+  static RayCounters TakeLocal();
+
+  static inline uint64_t CountLanes(uint32_t mask) {
+    uint64_t count = 0;
+    for (; mask; mask &= mask - 1) {
+      ++count;
+    }
+    return count;
+  }
+
+  static inline void AddRay(int depth) {
+    ++GetLocal().rays[depth < STATS_DEPTH_COUNT ? depth
+                                                : STATS_DEPTH_COUNT - 1];
+  }
+};
+
+}  // namespace rt
+
+// compiled out entirely without RAY_TRACING_ENABLE_STATS, arguments are not
+// evaluated either
+#ifdef RAY_TRACING_ENABLE_STATS
+#define RAY_TRACING_STATS_ADD(counter, value) \
+  (::rt::Stats::GetLocal().counter += (value))
+#define RAY_TRACING_STATS_RAY(depth) (::rt::Stats::AddRay(depth))
+#else
+#define RAY_TRACING_STATS_ADD(counter, value) ((void)0)
+#define RAY_TRACING_STATS_RAY(depth) ((void)0)
+#endif
+
+#endif  // RAY_TRACING_INCLUDE_RENDER_STATS_H_
@@ -0,0 +1,318 @@
+/**
+ * @file renderer.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-13
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_RENDERER_H_
+#define RAY_TRACING_INCLUDE_RENDERER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "denoiser.h"
+#include "function_ref.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "sampler.h"
+#include "thread_pool.h"
+#include "wavefront_integrator.h"
+
+namespace rt {
+
+struct RenderSettings {
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  // camera
+  glm::vec3 origin{0.f, 4.f, 5.f};
+  glm::vec3 look_at{0.f};
+  float fov = 90.f;
+  float aperture = 0.1f;
+  float focus_dist = 10.f;
+
+  int samples_per_pixel = 64;
+  int samples_per_frame = 1;
+  int bounce_limit = 10;
+  int seed = 0;
+  // display transfer of the resolve: exposure in stops, then the tonemap,
+  // then the gamma
+  float gamma = 2.2f;
+  float exposure = 0.f;
+  Tonemap tonemap = Tonemap::NONE;
+  // filter the accumulation before the display transfer, guided by the
+  // albedo and normal of the first hits
+  DenoiseMode denoise = DenoiseMode::NONE;
+  bool progressive = true;
+  // stop pixels once their error fell below adaptive_threshold, but never
+  // before adaptive_min_samples, samples_per_pixel stays the upper bound
+  bool adaptive_sampling = false;
+  float adaptive_threshold = 0.005f;
+  int adaptive_min_samples = 32;
+  // trace primary rays as SIMD packets, secondary rays stay scalar
+  bool packet_tracing = true;
+  // sample a light at every diffuse bounce, see PathIntegrator
+  bool next_event_estimation = true;
+  // trace a tile's samples bounce by bounce, see WavefrontIntegrator, the
+  // image stays the same
+  bool wavefront = false;
+  // also publish the averaged linear radiance, for HDR image output
+  bool resolve_radiance = false;
+  // when only the camera moved, reproject the accumulation into the new view
+  // and keep it where the surfaces agree instead of starting over
+  bool reprojection = true;
+  // trace only rows [first_row, first_row + row_count), zero traces the
+  // whole image, the other pixels keep whatever they held and nothing is
+  // resolved, so only the accumulation of the rows is of any use
+  uint32_t first_row = 0;
+  uint32_t row_count = 0;
+
+  // whether accumulated samples are still valid under other settings
+  bool IsCompatible(const RenderSettings& other) const;
+  // whether other differs in origin, look_at or fov at most
+  bool IsCameraMove(const RenderSettings& other) const;
+
+  bool operator==(const RenderSettings& other) const;
+  bool operator!=(const RenderSettings& other) const;
+};
+
+// resolved RGBA8 image
+struct Framebuffer {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint32_t> pixels;
+  // linear RGB per pixel, only filled when resolve_radiance is set
+  std::vector<glm::vec3> radiance;
+};
+
+// running sums of rows [first_row, first_row + row_count) of an image,
+// what passes leave behind, enough to resolve it or to go on tracing it
+struct Accumulation {
+  // of the whole image
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t first_row = 0;
+  uint32_t row_count = 0;
+  // samples of every pixel that has not converged yet
+  int samples = 0;
+
+  // row by row, see Renderer
+  std::vector<glm::vec3> sums;
+  std::vector<int> sample_counts;
+  std::vector<float> luminance_squares;
+  std::vector<glm::vec3> albedo_sums;
+  std::vector<glm::vec3> normal_sums;
+  std::vector<glm::vec3> position_sums;
+};
+
+class CheckpointWriter;
+
+// traces the world on a background thread, the caller only submits settings
+// and picks up the latest finished pass, so it never waits for the tracer
+class Renderer {
+ public:
+  Renderer();
+  ~Renderer();
+
+  Renderer(const Renderer&) = delete;
+  Renderer& operator=(const Renderer&) = delete;
+
+  // materials referenced by the hit records of the world, lights are the
+  // emitters of the world for next event estimation, which is skipped
+  // without them
+  void SetWorld(std::shared_ptr<const Hittable> world,
+                std::shared_ptr<const MaterialTable> materials,
+                std::shared_ptr<const LightList> lights = nullptr);
+  // run edit while no pass traces the world, so the caller may modify the
+  // world it handed over in place, accumulation restarts afterwards
+  void EditWorld(const std::function<void()>& edit);
+  void SetSettings(const RenderSettings& settings);
+  // zero means one worker per hardware thread
+  void SetThreadCount(uint32_t thread_count);
+
+  // keep tracing passes until the image converged
+  void SetPlaying(bool playing);
+  // trace one pass: samples_per_frame samples in progressive mode, the full
+  // samples_per_pixel otherwise
+  void RequestRender();
+
+  // latest published image, nullptr if nothing new since the previous call,
+  // the returned buffer stays valid until the next call
+  const Framebuffer* AcquireFramebuffer();
+  // blocking version of the above for batch rendering, passes dropped by a
+  // world or settings change are never published, so keep both fixed while
+  // waiting
+  const Framebuffer* WaitForFramebuffer();
+
+  // copy of rows [first_row, first_row + row_count) of the accumulation,
+  // waits for the pass being traced to finish
+  void ReadAccumulation(uint32_t first_row, uint32_t row_count,
+                        Accumulation& accumulation);
+  // go on from accumulation instead of starting over, its rows replace
+  // those of the image, the next pass only traces the samples still missing
+  // and needs no world if there are none, set settings compatible with the
+  // ones it was traced with first
+  void LoadAccumulation(const Accumulation& accumulation);
+  // write the accumulation of the whole image to path every interval
+  // seconds of tracing and once it has all its samples, in the background
+  // between passes, see Checkpoint, scene_hash names the scene of the world,
+  // an empty path stops checkpointing
+  void SetCheckpoint(const std::string& path, float interval,
+                     uint64_t scene_hash);
+  // block until the pending checkpoint is written
+  void WaitForCheckpoint();
+  // error of the last checkpoint that failed since the previous call, empty
+  // if none did
+  std::string TakeCheckpointError();
+
+  int GetAccumulatedSamples() const;
+  // wall time of the last finished pass in milliseconds
+  float GetPassTime() const;
+  // counters and timings of the last finished pass
+  RenderStats GetStats() const;
+  // same, copied into stats so its buffers get reused
+  void GetStats(RenderStats& stats) const;
+
+ private:
+  // one pixel of the reprojection cache, means of what it had traced
+  struct HistoryPixel {
+    glm::vec3 radiance{0.f};
+    glm::vec3 albedo{0.f};
+    glm::vec3 normal{0.f};
+    glm::vec3 position{0.f};
+    // samples it stands for, zero where nothing was reused
+    int weight = 0;
+  };
+
+  void RenderLoop();
+  // whether the render thread has something to do, mutex must be held
+  bool HasWork() const;
+  bool RenderPass(const RenderSettings& settings, const Hittable& world,
+                  const MaterialTable& materials, const LightList* lights,
+                  int first_sample, int samples);
+  // display colors of the accumulation into the back buffer, denoised first
+  // if asked to, one kernel call per band of rows
+  bool ResolveFramebuffer(const RenderSettings& settings);
+  // run pixels [first, last) of the image in bands of TILE_SIZE rows
+  bool ForEachBand(uint32_t width, uint32_t height,
+                   const FunctionRef<void(size_t, size_t)>& pixels);
+  // means of every pixel, the accumulation merged with its history
+  bool SnapshotHistory(const RenderSettings& settings,
+                       std::vector<HistoryPixel>& snapshot);
+  // history_ from previous_ through the first hits of the accumulation
+  bool ReprojectHistory(const RenderSettings& settings);
+  // sums of the accumulation and history over their combined sample counts
+  bool MergeHistory(const RenderSettings& settings);
+  // rows of the accumulation traced with settings, samples deep
+  void CopyAccumulation(const RenderSettings& settings, int samples,
+                        uint32_t first_row, uint32_t row_count,
+                        Accumulation& accumulation) const;
+  // whether the sums of a pixel's samples estimate it closely enough
+  static bool IsConverged(const RenderSettings& settings,
+                          const glm::vec3& pixel_color,
+                          float luminance_squares, int sample_count);
+
+  ThreadPool thread_pool_{};
+  std::thread render_thread_;
+
+  // state shared with the caller thread
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  // signaled whenever a pass got published
+  std::condition_variable published_;
+  RenderSettings settings_{};
+  std::shared_ptr<const Hittable> world_;
+  std::shared_ptr<const MaterialTable> materials_;
+  std::shared_ptr<const LightList> lights_;
+  uint32_t thread_count_ = 0;
+  bool thread_count_changed_ = false;
+  bool playing_ = false;
+  bool render_requested_ = false;
+  bool resolve_requested_ = false;
+  bool reset_requested_ = true;
+  // the pending reset only moved the camera
+  bool reproject_requested_ = false;
+  bool edit_requested_ = false;
+  // the next pass keeps a loaded accumulation even in one-shot mode
+  bool load_requested_ = false;
+  // render thread is inside a pass, signaled through idle_ once it left
+  bool is_tracing_ = false;
+  std::condition_variable idle_;
+  bool stop_ = false;
+  int accumulated_samples_ = 0;
+  float pass_time_ = 0.f;
+  std::string checkpoint_path_{};
+  float checkpoint_interval_ = 0.f;
+  uint64_t checkpoint_scene_hash_ = 0;
+  RenderStats stats_{};
+
+  // triple buffering: tracer writes back, publishes into ready, caller reads
+  // front, so neither side ever blocks on the other
+  Framebuffer buffers_[3];
+  int back_ = 0;
+  int ready_ = 1;
+  int front_ = 2;
+  bool has_new_framebuffer_ = false;
+
+  // owned by the render thread, running sum of samples in linear RGB
+  std::vector<glm::vec3> accumulation_;
+  // samples and sum of squared sample luminance of every pixel
+  std::vector<int> sample_counts_;
+  std::vector<float> luminance_squares_;
+  // sums of the first hit albedo, normal and position of every sample
+  std::vector<glm::vec3> albedo_sums_;
+  std::vector<glm::vec3> normal_sums_;
+  std::vector<glm::vec3> position_sums_;
+  // settings the accumulation was traced with
+  RenderSettings accumulation_settings_{};
+
+  // owned by the render thread, a pixel's history stands in for the samples
+  // it has not traced yet, so it fades out as the accumulation catches up
+  std::vector<HistoryPixel> history_;
+  // last view before the camera moved, reprojected once the first pass of
+  // the new view found its first hits
+  std::vector<HistoryPixel> previous_;
+  RenderSettings previous_settings_{};
+  bool reproject_pending_ = false;
+  // accumulation and history merged for the resolve
+  std::vector<glm::vec3> merged_sums_;
+  std::vector<glm::vec3> merged_albedo_sums_;
+  std::vector<glm::vec3> merged_normal_sums_;
+  std::vector<int> merged_counts_;
+  // denoised copy of accumulation_, same sample counts
+  std::vector<glm::vec3> denoised_;
+  Denoiser denoiser_{};
+  ColorLut color_lut_{};
+  // owned by the render thread, stats of the pass being traced
+  RenderStats pass_stats_{};
+  std::vector<RayCounters> worker_counters_;
+  // wave buffers of every worker in wavefront mode
+  std::vector<WavefrontQueue> wavefront_queues_;
+  // owned by the render thread, when the last checkpoint was submitted
+  std::chrono::steady_clock::time_point last_checkpoint_{};
+  std::unique_ptr<CheckpointWriter> checkpoint_writer_;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_RENDERER_H_
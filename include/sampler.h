@@ -0,0 +1,58 @@
+/**
+ * @file sampler.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_SAMPLER_H_
+#define RAY_TRACING_INCLUDE_SAMPLER_H_
+
+#include <cstdint>
+
+namespace rt {
+
+// PCG32 random number generator, cheap enough to create one per sample so
+// every pixel/sample pair owns an independent, reproducible sequence
+class Sampler {
+ public:
+  Sampler() = default;
+  Sampler(uint64_t seed, uint64_t sequence = 0);
+  ~Sampler() = default;
+
+  // sampler for given render seed, pixel index and sample index
+  static Sampler ForPixel(uint32_t seed, uint32_t pixel, uint32_t sample);
+
+  // splitmix64 finalizer
+  static uint64_t Hash(uint64_t value);
+
+  inline uint32_t NextUint() {
+    uint64_t old_state = state_;
+    state_ = old_state * MULTIPLIER + increment_;
+
+    uint32_t xorshifted =
+        static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+    uint32_t rotation = static_cast<uint32_t>(old_state >> 59u);
+
+    return (xorshifted >> rotation) | (xorshifted << ((~rotation + 1u) & 31u));
+  }
+
+  // uniform float in [0, 1)
+  inline float NextFloat() {
+    // use the upper 24 bits so every result is exactly representable
+    return static_cast<float>(NextUint() >> 8) * (1.f / 16777216.f);
+  }
+
+ private:
+  static const uint64_t MULTIPLIER = 6364136223846793005ull;
+
+  uint64_t state_ = 0x853c49e6748fea9bull;
+  uint64_t increment_ = 0xda3e39cb94b95bdbull;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_SAMPLER_H_
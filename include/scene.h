@@ -12,18 +12,26 @@
 #define RAY_TRACING_INCLUDE_SCENE_H_
 
 #include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
 
 #define RAY_TRACING_INCLUDE_VULKAN
 #include <vulkan/vulkan.h>
 #define RAY_TRACING_INCLUDE_GLM
 #include <glm/glm.hpp>
 
-#include "hittable.h"
-#include "hittable_list.h"
+#include "bvh.h"
+#include "gpu_renderer.h"
 #include "image.h"
+#include "instance.h"
 #include "layer.h"
-#include "ray.h"
-#include "sphere.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "render_stats.h"
+#include "renderer.h"
+#include "scene_file.h"
 
 namespace rt {
 
@@ -31,25 +39,49 @@ class Scene : public Layer {
  public:
   Scene() = delete;
   Scene(VkPhysicalDevice& physical_device, VkDevice& device,
-        VkQueue& graphics_queue, VkCommandPool& command_pool);
+        VkQueue& graphics_queue, VkCommandPool& command_pool,
+        uint32_t graphics_family);
   virtual ~Scene();
 
   virtual void OnUIRender() override;
 
+  virtual void OnRecordCommands(VkCommandBuffer command_buffer,
+                                uint32_t frame_index) override;
+
   void Render();
 
-  glm::vec3 RayColor(const Ray& ray, const Hittable& world, int bounce);
+  // upload the latest image finished by the renderer
+  void UpdateImage();
+
+  // replace the world by a scene file, keeps the current one on failure
+  void LoadWorld(const std::string& path);
 
-  HittableList RandomScene();
+  // refit the top level to the turned instances, rebuilds it in the
+  // background once refits degraded it too much
+  void UpdateInstances();
+  // swap in a finished background rebuild
+  void UpdateRebuild();
 
  private:
+  // counters of the last cpu pass and its tile times as a heatmap
+  void RenderStatsUI();
+  // replace the viewport image, the old one is freed first
+  void ResizeImage(uint32_t width, uint32_t height);
+  // scene_hash_ of the world as it is traced, with the turn of its instances
+  uint64_t GetSceneHash() const;
+
   uint32_t width_ = 0;
   uint32_t height_ = 0;
 
-  Image* image_ = nullptr;
-  uint32_t* image_data_ = nullptr;
-  std::vector<uint32_t> horizontal_iterator_;
-  std::vector<uint32_t> vertical_iterator_;
+  std::unique_ptr<Image> image_{};
+
+  Renderer renderer_{};
+  int thread_count_ = 0;
+
+  // gpu backend, null when the device cannot run it
+  std::unique_ptr<GpuRenderer> gpu_renderer_{};
+  std::string gpu_error_{};
+  bool is_gpu_backend_ = false;
 
   VkPhysicalDevice& physical_device_;
   VkDevice& device_;
@@ -57,13 +89,55 @@ class Scene : public Layer {
   VkCommandPool& command_pool_;
 
   float delta_time_ = 0.f;
+  RenderStats stats_{};
   int samples_per_pixel_ = 64;
   int bounce_limit_ = 10;
-  float gamma_ = 1.05f;
+  int seed_ = 0;
+  float gamma_ = 2.2f;
+  float exposure_ = 0.f;
+  // index of Tonemap
+  int tonemap_ = 0;
+  bool is_progressive_ = true;
+  int samples_per_frame_ = 1;
+  bool is_packet_tracing_ = true;
+  bool is_next_event_estimation_ = true;
+  bool is_wavefront_ = false;
+  bool is_reprojecting_ = true;
+  // index of DenoiseMode
+  int denoise_ = 0;
+  bool is_adaptive_sampling_ = false;
+  float adaptive_threshold_ = 0.005f;
+  int adaptive_min_samples_ = 32;
   bool is_playing_ = false;
   const char* play_button_label_ = "Play";
 
+  char scene_path_[256] = "";
+  std::string scene_error_{};
+
+  // the accumulation is written to while tracing, see Checkpoint
+  char checkpoint_path_[256] = "";
+  // SceneFile::Hash of the loaded scene, before the instances turned
+  uint64_t scene_hash_ = 0;
+  bool is_resume_requested_ = false;
+  std::string checkpoint_error_{};
+
+  // bottom levels stay while instances move
+  std::shared_ptr<MaterialTable> materials_{};
+  SceneGeometry geometry_{};
+  std::vector<InstanceDescription> instances_{};
+  float instance_turn_ = 0.f;
+  // turned copies of the instances, created once and moved in place after
+  std::vector<InstanceDescription> turned_instances_{};
+  std::vector<std::shared_ptr<Instance> > turned_objects_{};
+  std::shared_ptr<Bvh> top_level_{};
+  // emitters of the turned instances, refreshed with the top level
+  std::shared_ptr<LightList> lights_{};
+  std::future<std::shared_ptr<Bvh> > rebuild_{};
+  // turn the background rebuild started from
+  float rebuild_turn_ = 0.f;
+
   float origin_[3] = {0.f, 4.f, 5.f};
+  float look_at_[3] = {0.f, 0.f, 0.f};
   float focus_dist_ = 10.f;
   float fov_ = 90.f;
   float aperture_ = 0.1f;
@@ -0,0 +1,186 @@
+/**
+ * @file scene_file.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_SCENE_FILE_H_
+#define RAY_TRACING_INCLUDE_SCENE_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material_table.h"
+
+namespace rt {
+
+// stored as is in binary scenes, new types only ever get appended
+enum class MaterialType : uint32_t {
+  LAMBERTIAN = 0,
+  METAL = 1,
+  DIELECTRIC = 2,
+  DIFFUSE_LIGHT = 3
+};
+
+struct MaterialDescription {
+  MaterialType type;
+  // emitted radiance of lights
+  glm::vec3 albedo;
+  float fuzz;
+  float refraction_index;
+};
+
+struct CameraDescription {
+  glm::vec3 origin;
+  glm::vec3 look_at;
+  float fov;
+  float aperture;
+  float focus_dist;
+};
+
+// triangle mesh loaded from its own file when the scene is built, it only
+// shows up through the instances placing it
+struct MeshDescription {
+  std::string path;
+  uint32_t material;
+};
+
+struct InstanceDescription {
+  uint32_t mesh;
+  glm::vec3 translation;
+  // degrees about x, then y, then z
+  glm::vec3 rotation;
+  float scale;
+
+  glm::mat4 GetTransform() const;
+  bool IsIdentity() const;
+  // false when the transform has no usable inverse, like for a zero scale
+  bool IsInvertible() const;
+};
+
+// bottom levels of a scene, built once and shared by every top level
+struct SceneGeometry {
+  std::shared_ptr<Bvh> spheres;
+  std::vector<std::shared_ptr<Hittable> > meshes;
+  // emissive spheres, meshes only become lights where instances place them
+  LightList sphere_lights;
+  // one per mesh, zero for meshes that do not emit
+  std::vector<glm::vec3> mesh_radiance;
+};
+
+// plain data of a scene, spheres are kept as columns just like the binary
+// file stores them so loading is one copy per column
+struct SceneDescription {
+  std::vector<MaterialDescription> materials;
+
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> radius;
+  std::vector<uint32_t> material;
+
+  std::vector<MeshDescription> meshes;
+  std::vector<InstanceDescription> instances;
+
+  bool has_camera = false;
+  CameraDescription camera{};
+
+  // returns the index of the added material
+  uint32_t AddMaterial(const MaterialDescription& description);
+  void AddSphere(const glm::vec3& center, float radius,
+                 uint32_t material_index);
+  // returns the index of the added mesh
+  uint32_t AddMesh(const std::string& path, uint32_t material_index);
+  void AddInstance(const InstanceDescription& instance);
+  void Reserve(uint32_t sphere_count);
+
+  uint32_t GetSphereCount() const;
+};
+
+// text scenes (.rts) are meant to be written by hand, one statement a line:
+//   material <name> lambertian <r> <g> <b>
+//   material <name> metal <r> <g> <b> <fuzz>
+//   material <name> dielectric <refraction index>
+//   material <name> light <r> <g> <b>
+//   sphere <x> <y> <z> <radius> <material name>
+//   geometry <name> <.obj or .ply path> <material name>
+//   instance <geometry name> <translation x y z> <rotation x y z> <scale>
+//   mesh <.obj or .ply path> <material name>
+//   camera <origin x y z> <look at x y z> <fov> <aperture> <focus dist>
+// with # starting a comment, binary scenes (.rtb) are mapped and copied
+// straight into the columns, relative mesh paths start at the scene file,
+// paths with spaces or # go in double quotes, a mesh statement is a geometry
+// placed once as it is
+class SceneFile {
+ public:
+  // format picked from the file extension, text if unknown
+  static bool IsBinary(const std::string& path);
+
+  static SceneDescription Load(const std::string& path);
+  static SceneDescription LoadText(const std::string& path);
+  static SceneDescription LoadBinary(const std::string& path);
+
+  static void Save(const std::string& path, const SceneDescription& scene);
+  static void SaveText(const std::string& path, const SceneDescription& scene);
+  static void SaveBinary(const std::string& path,
+                         const SceneDescription& scene);
+
+  // binary scenes in memory, path only names the data in errors and is
+  // where relative mesh paths start
+  static SceneDescription ReadBinary(const uint8_t* data, uint64_t size,
+                                     const std::string& path);
+  static void WriteBinary(std::ostream& file, const SceneDescription& scene);
+  // of the binary scene and the files of its meshes, tells apart images
+  // traced from different scenes
+  static uint64_t Hash(const SceneDescription& scene);
+
+  // BuildTopLevel over BuildGeometry, with the lights if asked for
+  static std::shared_ptr<Hittable> Build(const SceneDescription& scene,
+                                         MaterialTable& materials,
+                                         LightList* lights = nullptr);
+
+  // materials are appended to the table, spheres end up in one bvh and
+  // every mesh gets its own
+  static SceneGeometry BuildGeometry(const SceneDescription& scene,
+                                     MaterialTable& materials);
+
+  // bvh over the instances and the sphere bvh, in this order so object i
+  // of the top level is instance i, the bottom levels are only referenced
+  // so moving instances costs a refit or rebuild of this level alone
+  static std::shared_ptr<Bvh> BuildTopLevel(
+      const SceneGeometry& geometry,
+      const std::vector<InstanceDescription>& instances);
+
+  // emitters of the geometry as placed by the instances, lights is
+  // overwritten and keeps its buffers, so moved instances refresh it cheaply
+  static void BuildLights(const SceneGeometry& geometry,
+                          const std::vector<InstanceDescription>& instances,
+                          LightList& lights);
+
+  // top level object of one instance
+  static std::shared_ptr<Hittable> MakeInstance(
+      const SceneGeometry& geometry, const InstanceDescription& instance);
+
+ private:
+  static SceneDescription ParseText(const std::string& text,
+                                    const std::string& path);
+
+  static const uint32_t BINARY_VERSION = 3u;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_SCENE_FILE_H_
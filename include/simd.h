@@ -0,0 +1,107 @@
+/**
+ * @file simd.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_SIMD_H_
+#define RAY_TRACING_INCLUDE_SIMD_H_
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RAY_TRACING_SIMD_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RAY_TRACING_SIMD_NEON
+#endif
+
+namespace rt {
+
+enum class SimdIsa { SCALAR, SSE2, AVX2, NEON };
+
+// structure-of-arrays spheres, every array stays readable PACKET_SIZE - 1
+// elements past the last sphere so kernels never need a scalar tail
+struct SphereArrays {
+  const float* center[3];
+  const float* radius_squared;
+};
+
+// packet kernels, results of lanes outside mask are left unchanged
+struct PacketKernels {
+  // lanes whose ray overlaps the box within [t_min, t]
+  uint32_t (*intersect_box)(const RayPacket& packet, const glm::vec3& box_min,
+                            const glm::vec3& box_max, const float* t,
+                            uint32_t mask);
+
+  // lanes whose closest hit moved onto the sphere, t is updated in place
+  uint32_t (*intersect_sphere)(const RayPacket& packet,
+                               const glm::vec3& center, float radius, float* t,
+                               uint32_t mask);
+
+  // index of the closest sphere in [begin, end) hit by one ray within
+  // [t_min, t], t is updated to its distance, -1 if none got hit
+  int (*closest_sphere)(const Ray& ray, float t_min,
+                        const SphereArrays& spheres, uint32_t begin,
+                        uint32_t end, float& t);
+
+  // display colors of count pixels, same results as ResolveColors
+  void (*resolve_colors)(const glm::vec3* sums, const int* sample_counts,
+                         uint32_t count, const ResolveParams& params,
+                         uint32_t* pixels);
+};
+
+// closest of the per-lane candidates of closest_sphere, ties go to the
+// higher index just like a sequential scan
+inline int ReduceClosestSphere(const float* lane_t, const int* lane_index,
+                               int lane_count, float& t) {
+  int closest = -1;
+
+  for (int lane = 0; lane < lane_count; ++lane) {
+    if (lane_index[lane] < 0) {
+      continue;
+    }
+
+    if (closest < 0 || lane_t[lane] < t ||
+        (lane_t[lane] == t && lane_index[lane] > closest)) {
+      t = lane_t[lane];
+      closest = lane_index[lane];
+    }
+  }
+
+  return closest;
+}
+
+class Simd {
+ public:
+  // best instruction set supported by the running CPU
+  static SimdIsa DetectIsa();
+  static const char* GetIsaName(SimdIsa isa);
+
+  // kernels of the detected instruction set, detection runs once
+  static SimdIsa GetIsa();
+  static const PacketKernels& GetKernels();
+
+  static PacketKernels GetScalarKernels();
+#ifdef RAY_TRACING_SIMD_X86
+  static PacketKernels GetSse2Kernels();
+  static PacketKernels GetAvx2Kernels();
+#endif
+#ifdef RAY_TRACING_SIMD_NEON
+  static PacketKernels GetNeonKernels();
+#endif
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_SIMD_H_
@@ -0,0 +1,58 @@
+/**
+ * @file socket.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_SOCKET_H_
+#define RAY_TRACING_INCLUDE_SOCKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rt {
+
+// blocking TCP connection or listener, closed when destroyed, every failure
+// and a peer that hung up throw
+class Socket {
+ public:
+  Socket() = default;
+  ~Socket();
+
+  Socket(Socket&& other) noexcept;
+  Socket& operator=(Socket&& other) noexcept;
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+
+  // address as host:port
+  static Socket Connect(const std::string& address);
+  // on every interface
+  static Socket Listen(uint16_t port);
+  // next connection of a listener
+  Socket Accept() const;
+
+  // whole buffers or nothing
+  void Send(const void* data, size_t size) const;
+  void Receive(void* data, size_t size) const;
+
+  // longest a receive waits for data, zero waits forever
+  void SetTimeout(float seconds) const;
+
+  bool IsOpen() const;
+  void Close();
+
+ private:
+  explicit Socket(intptr_t handle);
+
+  // file descriptor or SOCKET, invalid ones are -1 either way
+  intptr_t handle_ = -1;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_SOCKET_H_
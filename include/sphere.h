@@ -11,30 +11,43 @@
 #ifndef RAY_TRACING_INCLUDE_SPHERE_H_
 #define RAY_TRACING_INCLUDE_SPHERE_H_
 
-#include <memory>
+#include <cstdint>
 
 #define RAY_TRACING_INCLUDE_GLM
 #include <glm/glm.hpp>
 
+#include "aabb.h"
 #include "hittable.h"
-#include "material.h"
 #include "ray.h"
+#include "ray_packet.h"
 
 namespace rt {
 
 class Sphere : public Hittable {
  public:
   Sphere() = default;
-  Sphere(glm::vec3 center, float radius, std::shared_ptr<Material> material);
+  Sphere(glm::vec3 center, float radius, uint32_t material_index);
   ~Sphere() = default;
 
   virtual bool Hit(const Ray& ray, float t_min, float t_max,
                    HitRecord& record) const override;
 
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
+  glm::vec3 GetCenter() const;
+  float GetRadius() const;
+  uint32_t GetMaterialIndex() const;
+
  private:
   float radius_;
   glm::vec3 center_;
-  std::shared_ptr<Material> material_;
+  uint32_t material_index_;
 };
 
 }  // namespace rt
@@ -0,0 +1,99 @@
+/**
+ * @file sphere_set.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_SPHERE_SET_H_
+#define RAY_TRACING_INCLUDE_SPHERE_SET_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "aligned_allocator.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "simd.h"
+#include "sphere.h"
+
+namespace rt {
+
+// spheres stored as structure of arrays, one ray is tested against a whole
+// SIMD register of spheres at once instead of one virtual call per sphere
+class SphereSet : public Hittable {
+ public:
+  SphereSet() = default;
+  ~SphereSet() = default;
+
+  void Add(const Sphere& sphere);
+  void Add(const glm::vec3& center, float radius, uint32_t material_index);
+  // slot that never gets hit, keeps indices in step with another container
+  void AddEmpty();
+  // copy slot index of another set, empty slots stay empty
+  void Append(const SphereSet& other, uint32_t index);
+  // overwrite an existing slot, the set box only ever grows
+  void Set(uint32_t index, const glm::vec3& center, float radius,
+           uint32_t material_index);
+  void SetEmpty(uint32_t index);
+  void Reserve(uint32_t count);
+  void Clear();
+
+  uint32_t GetCount() const;
+  bool IsEmpty(uint32_t index) const;
+  Aabb GetBoundingBox(uint32_t index) const;
+
+  // closest hit among spheres [begin, end)
+  bool HitRange(const Ray& ray, float t_min, float t_max, uint32_t begin,
+                uint32_t end, HitRecord& record) const;
+  // any hit among spheres [begin, end), no record is built
+  bool OccludedRange(const Ray& ray, float t_min, float t_max, uint32_t begin,
+                     uint32_t end) const;
+
+  // packet version of the above, hit objects are left to the caller,
+  // returns the lanes whose closest hit moved onto one of the spheres
+  uint32_t HitPacketRange(const RayPacket& packet, uint32_t mask,
+                          PacketHit& hit, uint32_t begin, uint32_t end) const;
+
+  virtual bool Hit(const Ray& ray, float t_min, float t_max,
+                   HitRecord& record) const override;
+
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
+ private:
+  void Push(const glm::vec3& center, float radius, float radius_squared,
+            uint32_t material_index);
+  SphereArrays GetArrays() const;
+
+  uint32_t count_ = 0;
+
+  // hot data read by the kernels, padded past count_ with empty slots
+  AlignedVector<float> center_x_;
+  AlignedVector<float> center_y_;
+  AlignedVector<float> center_z_;
+  AlignedVector<float> radius_squared_;
+
+  // only read once the closest sphere is known
+  std::vector<float> radii_;
+  std::vector<uint32_t> material_indices_;
+
+  Aabb box_{};
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_SPHERE_SET_H_
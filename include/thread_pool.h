@@ -0,0 +1,87 @@
+/**
+ * @file thread_pool.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_THREAD_POOL_H_
+#define RAY_TRACING_INCLUDE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "function_ref.h"
+
+namespace rt {
+
+// task index and index of the worker thread running it
+using ThreadPoolTask = FunctionRef<void(uint32_t task, uint32_t worker)>;
+
+// fixed set of worker threads, each owning a task queue, idle workers steal
+// from the back of other queues
+class ThreadPool {
+ public:
+  // zero thread count means one worker per hardware thread
+  ThreadPool(uint32_t thread_count = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // run tasks [0, task_count) and block until all of them finished, return
+  // false when the batch has been cancelled
+  bool ParallelFor(uint32_t task_count, const ThreadPoolTask& task);
+
+  // cancel the running batch, pending tasks are dropped and running tasks
+  // may poll IsCancelled() to bail out early
+  void Cancel();
+  bool IsCancelled() const;
+
+  void Resize(uint32_t thread_count);
+  uint32_t GetThreadCount() const;
+
+ private:
+  // a batch hands every worker a contiguous range of tasks, so the queue is
+  // that range, the owner pops from the front and thieves from the back
+  struct WorkQueue {
+    std::mutex mutex;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+  };
+
+  void Start(uint32_t thread_count);
+  void Stop();
+
+  // generation is the last batch the worker must not run
+  void WorkerLoop(uint32_t worker, uint64_t generation);
+  bool PopTask(uint32_t worker, uint32_t& task);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<WorkQueue> > queues_;
+
+  // serializes batches submitted from different threads
+  std::mutex submit_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  const ThreadPoolTask* task_ = nullptr;
+  uint64_t generation_ = 0;
+  uint32_t active_workers_ = 0;
+  bool stop_ = false;
+
+  std::atomic<bool> cancelled_{false};
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_THREAD_POOL_H_
@@ -0,0 +1,76 @@
+/**
+ * @file triangle_mesh.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_TRIANGLE_MESH_H_
+#define RAY_TRACING_INCLUDE_TRIANGLE_MESH_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+// indexed triangle buffers as read from a mesh file
+struct MeshData {
+  std::vector<glm::vec3> positions;
+  // either empty or one per position
+  std::vector<glm::vec3> normals;
+  // three per triangle
+  std::vector<uint32_t> indices;
+
+  uint32_t GetTriangleCount() const;
+};
+
+// whole mesh is a single hittable with its own bvh, triangles are only
+// referenced by index so a triangle costs 12 bytes plus its share of nodes
+class TriangleMesh : public Hittable {
+ public:
+  TriangleMesh() = default;
+  TriangleMesh(MeshData data, uint32_t material_index);
+  ~TriangleMesh() = default;
+
+  virtual bool Hit(const Ray& ray, float t_min, float t_max,
+                   HitRecord& record) const override;
+
+  virtual bool Occluded(const Ray& ray, float t_min,
+                        float t_max) const override;
+
+  virtual void HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const override;
+
+  virtual Aabb BoundingBox() const override;
+
+  uint32_t GetTriangleCount() const;
+
+  // raw buffers for device acceleration structures, triangles in leaf order
+  const std::vector<glm::vec3>& GetPositions() const;
+  const std::vector<glm::vec3>& GetNormals() const;
+  const std::vector<uint32_t>& GetIndices() const;
+
+ private:
+  std::vector<BvhNode> nodes_;
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::vec3> normals_;
+  // in leaf order, leaves reference contiguous triangle ranges
+  std::vector<uint32_t> indices_;
+  uint32_t material_index_ = 0;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_TRIANGLE_MESH_H_
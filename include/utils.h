@@ -50,6 +50,9 @@ class Utils {
   // Vulkan result validator
   static void CheckVulkanResult(const int result, const char* error_msg);
 
+  // Vulkan instance version to request, newest supported up to 1.2
+  static uint32_t QueryVulkanApiVersion();
+
   // Vulkan instance required extensions
   static std::vector<const char*> QueryVulkanInstanceExts();
 
@@ -81,10 +84,13 @@ class Utils {
   static QueueFamilies QueryQueueFamilies(
       const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface);
 
-  //  device required extensions
+  //  device required extensions, plus the ray tracing ones if supported
   static std::vector<const char*> QueryVulkanDeviceExts(
       const VkPhysicalDevice& physical_device);
 
+  // acceleration structures, ray tracing pipelines and everything they need
+  static bool QueryRayTracingSupport(const VkPhysicalDevice& physical_device);
+
   // swap chain support details
   static SwapChainSupportDetails QuerySwapChainSupport(
       const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface);
@@ -136,7 +142,8 @@ class Utils {
                            const VkDevice& device, const VkDeviceSize size,
                            const VkBufferUsageFlags usage,
                            const VkMemoryPropertyFlags properties,
-                           VkBuffer& buffer, VkDeviceMemory& buffer_memory);
+                           VkBuffer& buffer, VkDeviceMemory& buffer_memory,
+                           const VkMemoryAllocateFlags allocate_flags = 0);
 
   // copy buffer
   static void CopyBuffer(const VkDevice& device,
@@ -144,6 +151,14 @@ class Utils {
                          const VkQueue& graphics_queue, VkBuffer src_buffer,
                          VkBuffer dst_buffer, VkDeviceSize size);
 
+  // device local buffer filled through a one time staging copy, memory is
+  // allocated for device addresses when the usage asks for them
+  static void CreateDeviceLocalBuffer(
+      const VkPhysicalDevice& physical_device, const VkDevice& device,
+      const VkCommandPool& command_pool, const VkQueue& graphics_queue,
+      const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+      VkBuffer& buffer, VkDeviceMemory& buffer_memory);
+
   // create image
   static void CreateImage(uint32_t width, uint32_t height, VkFormat format,
                           VkImageTiling tiling, VkImageUsageFlags usage,
@@ -158,36 +173,19 @@ class Utils {
                                     VkImage image, VkImageLayout old_layout,
                                     VkImageLayout new_layout);
 
+  // record image transition into an existing command buffer, shader_stage
+  // is the stage writing the image in general layout
+  static void RecordImageLayoutTransition(
+      VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout,
+      VkImageLayout new_layout,
+      VkPipelineStageFlags shader_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
   // copy buffer to image
   static void CopyBufferToImage(const VkDevice& device,
                                 const VkQueue& graphics_queue,
                                 const VkCommandPool& command_pool,
                                 VkBuffer buffer, VkImage image, uint32_t width,
                                 uint32_t height);
-  // RGB to RGBA in hexadecimal
-  static uint32_t GetColor(const glm::vec3& color, int samples_per_pixel = 1,
-                           float gamma = 1.f);
-
-  // RGBA in hexadecimal
-  static uint32_t GetColor(const glm::vec4& color, int samples_per_pixel = 1,
-                           float gamma = 1.f);
-
-  // random float number
-  static float RandomFloat(float min = 0.f, float max = 1.f);
-
-  // random 3-dimension vector
-  static glm::vec3 RandomVec3(float min = 0.f, float max = 1.f);
-
-  // check vector is near zero
-  static bool NearZero(const glm::vec3& vec);
-
-  static glm::vec3 RandomInUnitSphere();
-
-  static glm::vec3 RandomInHemiSphere(const glm::vec3& normal);
-
-  static glm::vec3 RandomInUnitDisk();
-
-  static float DegreesToRadians(float degree);
 };
 
 }  // namespace rt
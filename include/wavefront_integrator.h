@@ -0,0 +1,111 @@
+/**
+ * @file wavefront_integrator.h
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_INCLUDE_WAVEFRONT_INTEGRATOR_H_
+#define RAY_TRACING_INCLUDE_WAVEFRONT_INTEGRATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material.h"
+#include "material_data.h"
+#include "material_table.h"
+#include "path_integrator.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+// one bin of hits per material kind
+const int WAVEFRONT_BIN_COUNT = static_cast<int>(MaterialKind::COUNT);
+
+// camera sample of a wave, the caller sets ray, sampler and pixel, Trace
+// writes radiance and aov
+struct WavefrontPath {
+  Ray ray;
+  Sampler sampler;
+  uint32_t pixel;
+  glm::vec3 radiance;
+  SurfaceAov aov;
+};
+
+// segment towards a sampled light and what it adds to its path when nothing
+// blocks it
+struct WavefrontShadowRay {
+  Ray ray;
+  float t_max;
+  uint32_t path;
+  glm::vec3 radiance;
+};
+
+// buffers of one wave, kept by the caller so steady passes never allocate,
+// the state arrays are indexed like paths
+struct WavefrontQueue {
+  std::vector<WavefrontPath> paths;
+
+  std::vector<glm::vec3> throughputs;
+  std::vector<HitRecord> records;
+  // see PathIntegrator::Li
+  std::vector<float> scatter_pdfs;
+  std::vector<glm::vec3> scatter_origins;
+
+  // paths still going, then the same paths grouped by material kind
+  std::vector<uint32_t> active;
+  std::vector<uint32_t> binned;
+  std::vector<WavefrontShadowRay> shadow_rays;
+};
+
+// breadth-first version of PathIntegrator, every bounce of a whole wave of
+// paths is traced before the next one: the closest hits of the queue, then
+// the hits grouped by material kind and shaded kind by kind with the code of
+// that kind inlined, then the shadow rays of the bounce, so each stage runs
+// one loop over similar work, paths draw their random numbers in the same
+// order as in PathIntegrator so both give the same image
+class WavefrontIntegrator {
+ public:
+  WavefrontIntegrator(const Hittable& world, const MaterialTable& materials,
+                      int max_depth, const LightList* lights = nullptr,
+                      int roulette_depth = ROULETTE_MIN_DEPTH);
+  ~WavefrontIntegrator() = default;
+
+  // trace queue.paths to their ends, packets bundle the camera rays
+  void Trace(WavefrontQueue& queue, bool use_packets) const;
+
+ private:
+  // closest hits of the active paths, misses end on the background
+  void Intersect(WavefrontQueue& queue, int depth, bool use_packets) const;
+  // active paths sorted by material kind into queue.binned, kind k takes
+  // [offsets[k], offsets[k + 1]), offsets holds WAVEFRONT_BIN_COUNT + 1
+  void Bin(WavefrontQueue& queue, uint32_t* offsets) const;
+  // one bounce of the binned paths [begin, end), all of material kind KIND,
+  // paths going on are appended to queue.active
+  template <MaterialKind KIND>
+  void Shade(WavefrontQueue& queue, uint32_t begin, uint32_t end,
+             int depth) const;
+  // shadow rays of the bounce, the visible ones add their radiance
+  void TraceShadowRays(WavefrontQueue& queue) const;
+
+  const Hittable& world_;
+  const MaterialTable& materials_;
+  // null or empty traces without next event estimation
+  const LightList* lights_;
+  int max_depth_;
+  int roulette_depth_;
+};
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_INCLUDE_WAVEFRONT_INTEGRATOR_H_
@@ -0,0 +1,278 @@
+/**
+ * @file common.glsl
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_SHADERS_COMMON_GLSL_
+#define RAY_TRACING_SHADERS_COMMON_GLSL_
+
+// types, sampler and materials shared by every shader stage, same as the cpu
+// renderer so all backends converge to the same image, includers enable
+// GL_ARB_gpu_shader_int64 first
+
+struct Sphere {
+  vec4 center_radius;
+  uint material;
+  uint padding[3];
+};
+
+const float PI = 3.14159265358979;
+
+// types match MaterialType
+const uint LAMBERTIAN = 0u;
+const uint METAL = 1u;
+const uint DIELECTRIC = 2u;
+const uint DIFFUSE_LIGHT = 3u;
+
+struct Material {
+  vec4 albedo_fuzz;
+  uint type;
+  float refraction_index;
+  uint padding[2];
+};
+
+// closest hit handed back to the integrator
+struct HitInfo {
+  float t;
+  // faces the ray
+  vec3 normal;
+  uint material;
+  bool front_face;
+};
+
+// ray payload of the ray tracing stages, t is negative on a miss
+struct Payload {
+  vec4 normal_t;
+  uint material;
+  uint front_face;
+};
+
+const float T_MIN = 0.001;
+const float INFINITY_F = uintBitsToFloat(0x7f800000u);
+// see BvhBuilder::MAX_DEPTH
+const int BVH_MAX_DEPTH = 64;
+
+// PCG32, see Sampler
+struct Sampler {
+  uint64_t state;
+  uint64_t increment;
+};
+
+uint NextUint(inout Sampler sampler) {
+  uint64_t old_state = sampler.state;
+  sampler.state = old_state * 6364136223846793005UL + sampler.increment;
+
+  uint xorshifted = uint(((old_state >> 18) ^ old_state) >> 27);
+  uint rotation = uint(old_state >> 59);
+
+  return (xorshifted >> rotation) | (xorshifted << ((~rotation + 1u) & 31u));
+}
+
+float NextFloat(inout Sampler sampler) {
+  return float(NextUint(sampler) >> 8) * (1.0 / 16777216.0);
+}
+
+uint64_t Hash(uint64_t value) {
+  value += 0x9e3779b97f4a7c15UL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9UL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebUL;
+
+  return value ^ (value >> 31);
+}
+
+Sampler ForPixel(uint seed, uint pixel, uint sample_index) {
+  uint64_t key = (uint64_t(seed) << 32) | uint64_t(pixel);
+
+  Sampler sampler;
+  sampler.state = 0UL;
+  sampler.increment = (uint64_t(sample_index) << 1) | 1UL;
+  NextUint(sampler);
+  sampler.state += Hash(key);
+  NextUint(sampler);
+
+  return sampler;
+}
+
+float RandomFloat(inout Sampler sampler, float min, float max) {
+  return min + (max - min) * NextFloat(sampler);
+}
+
+vec3 RandomVec3(inout Sampler sampler, float min, float max) {
+  float x = RandomFloat(sampler, min, max);
+  float y = RandomFloat(sampler, min, max);
+  float z = RandomFloat(sampler, min, max);
+
+  return vec3(x, y, z);
+}
+
+vec3 RandomInUnitSphere(inout Sampler sampler) {
+  while (true) {
+    vec3 point = RandomVec3(sampler, -1.0, 1.0);
+
+    if (dot(point, point) < 1.0) {
+      return point;
+    }
+  }
+}
+
+// uniform on the unit sphere, see MathUtils::RandomUnitVector
+vec3 RandomUnitVector(inout Sampler sampler) {
+  float z = RandomFloat(sampler, -1.0, 1.0);
+  float phi = RandomFloat(sampler, 0.0, 2.0 * PI);
+  float r = sqrt(max(1.0 - z * z, 0.0));
+
+  return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+vec3 RandomInUnitDisk(inout Sampler sampler) {
+  while (true) {
+    float x = RandomFloat(sampler, -1.0, 1.0);
+    float y = RandomFloat(sampler, -1.0, 1.0);
+    vec3 point = vec3(x, y, 0.0);
+
+    if (dot(point, point) < 1.0) {
+      return point;
+    }
+  }
+}
+
+bool NearZero(vec3 vec) { return all(lessThan(abs(vec), vec3(1e-8))); }
+
+// nearest root of the sphere in [t_min, t_max]
+bool HitSphere(vec4 sphere, vec3 origin, vec3 direction, float t_min,
+               float t_max, out float t) {
+  vec3 oc = origin - sphere.xyz;
+  float a = dot(direction, direction);
+  float half_b = dot(oc, direction);
+  float c = dot(oc, oc) - sphere.w * sphere.w;
+  float discriminant = half_b * half_b - a * c;
+
+  if (discriminant < 0.0) {
+    return false;
+  }
+
+  float sqrtd = sqrt(discriminant);
+  t = (-half_b - sqrtd) / a;
+
+  if (t < t_min || t > t_max) {
+    t = (-half_b + sqrtd) / a;
+
+    if (t < t_min || t > t_max) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// record of a hit at t, see Sphere::Hit
+HitInfo MakeSphereHit(Sphere sphere, vec3 origin, vec3 direction, float t) {
+  vec3 point = origin + t * direction;
+  vec3 outward_normal =
+      (point - sphere.center_radius.xyz) / sphere.center_radius.w;
+
+  HitInfo hit;
+  hit.t = t;
+  hit.front_face = dot(direction, outward_normal) < 0.0;
+  hit.normal = hit.front_face ? outward_normal : -outward_normal;
+  hit.material = sphere.material;
+
+  return hit;
+}
+
+float Reflectance(float cosine, float refraction_ratio) {
+  float r = (1.0 - refraction_ratio) / (1.0 + refraction_ratio);
+  r = r * r;
+
+  return r + (1.0 - r) * pow(1.0 - cosine, 5.0);
+}
+
+bool Scatter(Material material, vec3 direction, vec3 normal, bool front_face,
+             inout Sampler sampler, out vec3 attenuation,
+             out vec3 scattered) {
+  vec3 unit_direction = normalize(direction);
+
+  if (material.type == LAMBERTIAN) {
+    scattered = normal + RandomUnitVector(sampler);
+
+    if (NearZero(scattered)) {
+      scattered = normal;
+    }
+
+    attenuation = material.albedo_fuzz.rgb;
+
+    return true;
+  }
+
+  if (material.type == DIFFUSE_LIGHT) {
+    attenuation = material.albedo_fuzz.rgb;
+
+    return false;
+  }
+
+  if (material.type == METAL) {
+    scattered = reflect(unit_direction, normal) +
+                material.albedo_fuzz.w * RandomInUnitSphere(sampler);
+    attenuation = material.albedo_fuzz.rgb;
+
+    return dot(scattered, normal) > 0.0;
+  }
+
+  attenuation = vec3(1.0);
+
+  float refraction_ratio = front_face ? (1.0 / material.refraction_index)
+                                      : material.refraction_index;
+
+  float cos_theta = min(dot(-unit_direction, normal), 1.0);
+  float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+
+  bool cannot_refract = refraction_ratio * sin_theta > 1.0;
+
+  if (cannot_refract || (Reflectance(cos_theta, refraction_ratio) >
+                         RandomFloat(sampler, 0.0, 1.0))) {
+    scattered = reflect(unit_direction, normal);
+  } else {
+    scattered = refract(unit_direction, normal, refraction_ratio);
+  }
+
+  return true;
+}
+
+// see DiffuseLight::Emitted
+vec3 Emitted(Material material, bool front_face) {
+  return material.type == DIFFUSE_LIGHT && front_face
+             ? material.albedo_fuzz.rgb
+             : vec3(0.0);
+}
+
+vec3 Background(vec3 direction) {
+  float t = 0.5 * (normalize(direction).y + 1.0);
+
+  return (1.0 - t) * vec3(1.0) + t * vec3(0.5, 0.7, 1.0);
+}
+
+// see ResolveColors, the gpu evaluates the gamma instead of the lut
+const int TONEMAP_REINHARD = 1;
+const int TONEMAP_ACES = 2;
+
+vec4 GetColor(vec3 color, int samples_per_pixel, float exposure_scale,
+              int tonemap, float gamma) {
+  vec3 x = max(color * (exposure_scale / float(samples_per_pixel)), vec3(0.0));
+
+  if (TONEMAP_REINHARD == tonemap) {
+    x = x / (1.0 + x);
+  } else if (TONEMAP_ACES == tonemap) {
+    x = (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+  }
+
+  vec3 rgb = pow(clamp(x, vec3(0.0), vec3(1.0)), vec3(1.0 / gamma));
+
+  return vec4(floor(rgb * 255.0 + 0.5) / 255.0, 1.0);
+}
+
+#endif  // RAY_TRACING_SHADERS_COMMON_GLSL_
@@ -0,0 +1,130 @@
+/**
+ * @file integrator.glsl
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef RAY_TRACING_SHADERS_INTEGRATOR_GLSL_
+#define RAY_TRACING_SHADERS_INTEGRATOR_GLSL_
+
+#include "common.glsl"
+
+// camera rays and path integrator of the compute and ray generation shaders,
+// includers trace the scene through TraceClosest
+
+layout(binding = 0, rgba8) uniform writeonly image2D output_image;
+
+// sum of the samples traced so far per pixel
+layout(std430, binding = 1) buffer Accumulation { vec4 accumulation[]; };
+
+layout(std430, binding = 4) readonly buffer Materials { Material materials[]; };
+
+layout(push_constant) uniform Pass {
+  // w: lens radius
+  vec4 origin;
+  // w: gamma
+  vec4 lower_left;
+  // w: 2^exposure
+  vec4 horizontal;
+  // w: Tonemap
+  vec4 vertical;
+  vec4 right;
+  vec4 up;
+  // width, height, first sample, sample count
+  ivec4 extent;
+  // bounce limit, seed, roulette depth, bvh node count of the compute tracer
+  ivec4 trace;
+} pass;
+
+// closest hit along the ray in [T_MIN, infinity)
+bool TraceClosest(vec3 origin, vec3 direction, out HitInfo hit);
+
+// iterative path with russian roulette, see PathIntegrator::Li, lights are
+// only found by scattering here, the gpu does not sample them
+vec3 Li(vec3 origin, vec3 direction, inout Sampler sampler) {
+  const int max_depth = pass.trace.x;
+  const int roulette_depth = pass.trace.z;
+
+  vec3 radiance = vec3(0.0);
+  vec3 throughput = vec3(1.0);
+
+  for (int depth = 0; depth < max_depth; ++depth) {
+    HitInfo hit;
+    if (!TraceClosest(origin, direction, hit)) {
+      return radiance + throughput * Background(direction);
+    }
+
+    Material material = materials[hit.material];
+    radiance += throughput * Emitted(material, hit.front_face);
+
+    vec3 attenuation;
+    vec3 scattered;
+    if (!Scatter(material, direction, hit.normal, hit.front_face, sampler,
+                 attenuation, scattered)) {
+      return radiance;
+    }
+
+    throughput *= attenuation;
+
+    if (depth + 1 >= roulette_depth) {
+      float survival =
+          min(max(throughput.x, max(throughput.y, throughput.z)), 0.95);
+
+      if (survival <= 0.0 || RandomFloat(sampler, 0.0, 1.0) >= survival) {
+        return radiance;
+      }
+
+      throughput /= survival;
+    }
+
+    origin = origin + hit.t * direction;
+    direction = scattered;
+  }
+
+  return radiance;
+}
+
+// add this pass's samples of the pixel at coord and store its color
+void TracePixel(uvec2 coord) {
+  const uint width = uint(pass.extent.x);
+  const uint height = uint(pass.extent.y);
+
+  if (coord.x >= width || coord.y >= height) {
+    return;
+  }
+
+  const uint pixel = coord.y * width + coord.x;
+  const int first_sample = pass.extent.z;
+  const int total_samples = first_sample + pass.extent.w;
+
+  vec3 pixel_color = first_sample > 0 ? accumulation[pixel].rgb : vec3(0.0);
+
+  for (int s = first_sample; s < total_samples; ++s) {
+    Sampler sampler = ForPixel(uint(pass.trace.y), pixel, uint(s));
+
+    float u = (float(coord.x) + NextFloat(sampler)) / float(width - 1u);
+    float v =
+        1.0 - (float(coord.y) + NextFloat(sampler)) / float(height - 1u);
+
+    vec3 disk = pass.origin.w * RandomInUnitDisk(sampler);
+    vec3 offset = pass.right.xyz * disk.x + pass.up.xyz * disk.y;
+    vec3 origin = pass.origin.xyz + offset;
+    vec3 direction = pass.lower_left.xyz + u * pass.horizontal.xyz +
+                     v * pass.vertical.xyz - pass.origin.xyz - offset;
+
+    if (pass.trace.x > 0) {
+      pixel_color += Li(origin, direction, sampler);
+    }
+  }
+
+  accumulation[pixel] = vec4(pixel_color, 0.0);
+  imageStore(output_image, ivec2(coord),
+             GetColor(pixel_color, max(total_samples, 1), pass.horizontal.w,
+                      int(pass.vertical.w), pass.lower_left.w));
+}
+
+#endif  // RAY_TRACING_SHADERS_INTEGRATOR_GLSL_
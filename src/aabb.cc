@@ -0,0 +1,58 @@
+/**
+ * @file aabb.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "aabb.h"
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+namespace rt {
+
+Aabb::Aabb(const glm::vec3& minimum, const glm::vec3& maximum)
+    : min_{minimum}, max_{maximum} {}
+
+glm::vec3 Aabb::GetMin() const { return min_; }
+
+glm::vec3 Aabb::GetMax() const { return max_; }
+
+glm::vec3 Aabb::GetCentroid() const { return 0.5f * (min_ + max_); }
+
+glm::vec3 Aabb::GetExtent() const { return max_ - min_; }
+
+float Aabb::SurfaceArea() const {
+  if (IsEmpty()) {
+    return 0.f;
+  }
+
+  glm::vec3 extent = GetExtent();
+
+  return 2.f *
+         (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool Aabb::IsEmpty() const {
+  return min_.x > max_.x || min_.y > max_.y || min_.z > max_.z;
+}
+
+void Aabb::Expand(const Aabb& box) {
+  min_ = glm::min(min_, box.min_);
+  max_ = glm::max(max_, box.max_);
+}
+
+void Aabb::Expand(const glm::vec3& point) {
+  min_ = glm::min(min_, point);
+  max_ = glm::max(max_, point);
+}
+
+Aabb Aabb::Union(const Aabb& a, const Aabb& b) {
+  return Aabb(glm::min(a.min_, b.min_), glm::max(a.max_, b.max_));
+}
+
+}  // namespace rt
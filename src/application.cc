@@ -70,7 +70,8 @@ Application::Application() {
   SetupImGui();
 
   // setup scene layer
-  layer_ = new Scene(physical_device_, device_, graphics_queue_, command_pool_);
+  layer_ = new Scene(physical_device_, device_, graphics_queue_, command_pool_,
+                     queue_families_.graphics_family.value());
 }
 
 Application::~Application() {
@@ -166,7 +167,7 @@ void Application::CreateInstance() {
   app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   app_info.pEngineName = "No Engine";
   app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  app_info.apiVersion = VK_API_VERSION_1_0;
+  app_info.apiVersion = Utils::QueryVulkanApiVersion();
 
   instance_info.pApplicationInfo = &app_info;
 
@@ -273,8 +274,37 @@ void Application::CreateLogicalDevice() {
   VkPhysicalDeviceFeatures physical_device_features{};
   physical_device_features.samplerAnisotropy = VK_TRUE;
 
+  // 64 bit samplers of the compute path tracer, it is off without them
+  VkPhysicalDeviceFeatures supported_features{};
+  vkGetPhysicalDeviceFeatures(physical_device_, &supported_features);
+  physical_device_features.shaderInt64 = supported_features.shaderInt64;
+
   device_info.pEnabledFeatures = &physical_device_features;
 
+  // hardware ray tracing features, chained only where the extensions were
+  // found so other devices are created exactly as before
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR
+      acceleration_structure_features{};
+  acceleration_structure_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+  acceleration_structure_features.accelerationStructure = VK_TRUE;
+
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR ray_tracing_pipeline_features{};
+  ray_tracing_pipeline_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+  ray_tracing_pipeline_features.pNext = &acceleration_structure_features;
+  ray_tracing_pipeline_features.rayTracingPipeline = VK_TRUE;
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features{};
+  vulkan12_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12_features.pNext = &ray_tracing_pipeline_features;
+  vulkan12_features.bufferDeviceAddress = VK_TRUE;
+
+  if (Utils::QueryRayTracingSupport(physical_device_)) {
+    device_info.pNext = &vulkan12_features;
+  }
+
   //  physical device extensions
   std::vector<const char*> physical_device_extensions =
       Utils::QueryVulkanDeviceExts(physical_device_);
@@ -767,6 +797,12 @@ void Application::RecordCommandBuffer(VkCommandBuffer command_buffer,
   Utils::CheckVulkanResult(
       result, "Error::Vulkan: Failed to begin recording command buffer!");
 
+  // layer uploads, must be recorded outside the render pass
+  if (layer_) {
+    layer_->OnRecordCommands(command_buffer,
+                             static_cast<uint32_t>(current_frame_));
+  }
+
   VkRenderPassBeginInfo render_pass_info{};
   render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   render_pass_info.renderPass = render_pass_;
@@ -0,0 +1,115 @@
+/**
+ * @file arena.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+Arena::Arena(size_t block_size) : block_size_{block_size} {}
+
+Arena::~Arena() { Release(); }
+
+Arena::Arena(Arena&& other) noexcept
+    : block_size_{other.block_size_},
+      blocks_{std::move(other.blocks_)},
+      block_{other.block_},
+      offset_{other.offset_},
+      used_{other.used_},
+      destructors_{std::move(other.destructors_)} {
+  other.blocks_.clear();
+  other.destructors_.clear();
+  other.block_ = 0;
+  other.offset_ = 0;
+  other.used_ = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+  if (this != &other) {
+    Release();
+
+    block_size_ = other.block_size_;
+    blocks_ = std::move(other.blocks_);
+    block_ = other.block_;
+    offset_ = other.offset_;
+    used_ = other.used_;
+    destructors_ = std::move(other.destructors_);
+
+    other.blocks_.clear();
+    other.destructors_.clear();
+    other.block_ = 0;
+    other.offset_ = 0;
+    other.used_ = 0;
+  }
+
+  return *this;
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  while (block_ < blocks_.size()) {
+    unsigned char* memory = blocks_[block_].memory.get();
+    const uintptr_t base = reinterpret_cast<uintptr_t>(memory);
+    const size_t aligned = static_cast<size_t>(
+        ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base);
+
+    if (aligned + size <= blocks_[block_].size) {
+      offset_ = aligned + size;
+      return memory + aligned;
+    }
+
+    // the rest of the block stays unused until the next Reset
+    used_ += offset_;
+    offset_ = 0;
+    ++block_;
+  }
+
+  // out of blocks, the new one fits the request whatever its alignment
+  Block block{};
+  block.size = std::max(block_size_, size + alignment);
+  block.memory.reset(new unsigned char[block.size]);
+  blocks_.push_back(std::move(block));
+
+  return Allocate(size, alignment);
+}
+
+void Arena::Reset() {
+  for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) {
+    it->destroy(it->object);
+  }
+  destructors_.clear();
+
+  block_ = 0;
+  offset_ = 0;
+  used_ = 0;
+}
+
+size_t Arena::GetUsedBytes() const { return used_ + offset_; }
+
+size_t Arena::GetCapacity() const {
+  size_t capacity = 0;
+  for (const Block& block : blocks_) {
+    capacity += block.size;
+  }
+
+  return capacity;
+}
+
+void Arena::Release() {
+  Reset();
+  blocks_.clear();
+}
+
+}  // namespace rt
@@ -0,0 +1,610 @@
+/**
+ * @file bench.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "camera.h"
+#include "demo_scene.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "math_utils.h"
+#include "path_integrator.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "renderer.h"
+#include "sampler.h"
+#include "scene_file.h"
+#include "simd.h"
+#include "sphere.h"
+#include "triangle_mesh.h"
+
+namespace {
+
+// fixed seeds, every run builds the same scenes and traces the same rays
+const uint64_t SCENE_SEED = 2023u;
+const int RENDER_SEED = 0;
+
+// image traced by one iteration of the ray benchmarks
+const uint32_t BENCH_WIDTH = 128;
+const uint32_t BENCH_HEIGHT = 72;
+const int BENCH_BOUNCES = 10;
+
+// tessellation of the mesh scene's sphere, about 260k triangles
+const uint32_t MESH_SEGMENTS = 512;
+const uint32_t MESH_RINGS = 256;
+
+enum class BenchScene { DEMO, GRID, GLASS, MESH, ROOM };
+
+struct BenchWorld {
+  rt::SceneDescription scene;
+  rt::SceneGeometry geometry;
+  std::shared_ptr<rt::MaterialTable> materials;
+  std::shared_ptr<rt::Bvh> world;
+  std::shared_ptr<rt::LightList> lights;
+  rt::RenderSettings settings;
+};
+
+// the random 22x22 grid of small spheres around three big ones, glass
+// trades most of the diffuse spheres for glass and hollow glass
+rt::SceneDescription BuildGridScene(bool is_glass) {
+  rt::SceneDescription scene{};
+  rt::Sampler sampler(SCENE_SEED);
+
+  auto lambertian = [&](const glm::vec3& albedo) {
+    return scene.AddMaterial({rt::MaterialType::LAMBERTIAN, albedo, 0.f, 1.f});
+  };
+  auto metal = [&](float fuzz, const glm::vec3& albedo) {
+    return scene.AddMaterial({rt::MaterialType::METAL, albedo, fuzz, 1.f});
+  };
+  const uint32_t glass = scene.AddMaterial(
+      {rt::MaterialType::DIELECTRIC, glm::vec3(1.f), 0.f, 1.5f});
+
+  scene.AddSphere(glm::vec3(0.f, -1000.f, 0.f), 1000.f,
+                  lambertian(glm::vec3(0.5f)));
+
+  const float diffuse_share = is_glass ? 0.1f : 0.8f;
+  const float metal_share = is_glass ? 0.2f : 0.95f;
+
+  for (int i = -11; i < 11; ++i) {
+    for (int j = -11; j < 11; ++j) {
+      float choose_mat = rt::MathUtils::RandomFloat(sampler);
+      glm::vec3 center(i + 0.9f * rt::MathUtils::RandomFloat(sampler), 0.2f,
+                       j + 0.9f * rt::MathUtils::RandomFloat(sampler));
+
+      if (glm::length(center - glm::vec3(4.f, 0.2f, 0.f)) <= 0.9f) {
+        continue;
+      }
+
+      if (choose_mat < diffuse_share) {
+        glm::vec3 albedo = rt::MathUtils::RandomVec3(sampler) *
+                           rt::MathUtils::RandomVec3(sampler);
+        scene.AddSphere(center, 0.2f, lambertian(albedo));
+      } else if (choose_mat < metal_share) {
+        float fuzz = rt::MathUtils::RandomFloat(sampler, 0.f, 0.5f);
+        glm::vec3 albedo = rt::MathUtils::RandomVec3(sampler, 0.5f, 1.f);
+        scene.AddSphere(center, 0.2f, metal(fuzz, albedo));
+      } else {
+        scene.AddSphere(center, 0.2f, glass);
+        // a negative radius turns the normals inwards, a bubble in glass
+        if (is_glass && (i + j) % 2) {
+          scene.AddSphere(center, -0.15f, glass);
+        }
+      }
+    }
+  }
+
+  scene.AddSphere(glm::vec3(0.f, 1.f, 0.f), 1.f, glass);
+  scene.AddSphere(glm::vec3(-4.f, 1.f, 0.f), 1.f,
+                  is_glass ? glass : lambertian(glm::vec3(0.4f, 0.2f, 0.1f)));
+  scene.AddSphere(glm::vec3(4.f, 1.f, 0.f), 1.f,
+                  metal(0.f, glm::vec3(0.7f, 0.6f, 0.5f)));
+
+  scene.has_camera = true;
+  scene.camera = {glm::vec3(13.f, 2.f, 3.f), glm::vec3(0.f), 20.f, 0.1f, 10.f};
+
+  return scene;
+}
+
+// a few spheres inside a hollow one, lit only by a small sphere light near
+// the ceiling, where paths rarely find the light without sampling it
+rt::SceneDescription BuildRoomScene() {
+  rt::SceneDescription scene{};
+
+  const uint32_t wall = scene.AddMaterial(
+      {rt::MaterialType::LAMBERTIAN, glm::vec3(0.73f), 0.f, 1.f});
+  const uint32_t red = scene.AddMaterial(
+      {rt::MaterialType::LAMBERTIAN, glm::vec3(0.65f, 0.05f, 0.05f), 0.f,
+       1.f});
+  const uint32_t metal = scene.AddMaterial(
+      {rt::MaterialType::METAL, glm::vec3(0.8f), 0.2f, 1.f});
+  const uint32_t light = scene.AddMaterial(
+      {rt::MaterialType::DIFFUSE_LIGHT, glm::vec3(40.f), 0.f, 1.f});
+
+  // a negative radius turns the normals inwards, the walls face the room
+  scene.AddSphere(glm::vec3(0.f), -10.f, wall);
+  scene.AddSphere(glm::vec3(0.f, -1000.f, 0.f), 999.f, wall);
+  scene.AddSphere(glm::vec3(-1.5f, 0.f, 0.f), 1.f, red);
+  scene.AddSphere(glm::vec3(1.5f, 0.f, 0.f), 1.f, metal);
+  scene.AddSphere(glm::vec3(0.f, 4.f, 0.f), 0.5f, light);
+
+  scene.has_camera = true;
+  scene.camera = {glm::vec3(0.f, 1.f, 8.f), glm::vec3(0.f), 40.f, 0.f, 8.f};
+
+  return scene;
+}
+
+// uv sphere with vertex normals
+rt::MeshData TessellateSphere(const glm::vec3& center, float radius,
+                              uint32_t segments, uint32_t rings) {
+  rt::MeshData data{};
+
+  const float pi = 3.14159265358979f;
+  for (uint32_t ring = 0; ring <= rings; ++ring) {
+    const float theta = pi * static_cast<float>(ring) / rings;
+
+    for (uint32_t segment = 0; segment <= segments; ++segment) {
+      const float phi = 2.f * pi * static_cast<float>(segment) / segments;
+      glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta),
+                       std::sin(theta) * std::sin(phi));
+
+      data.positions.push_back(center + radius * normal);
+      data.normals.push_back(normal);
+    }
+  }
+
+  for (uint32_t ring = 0; ring < rings; ++ring) {
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+      const uint32_t first = ring * (segments + 1) + segment;
+      const uint32_t second = first + segments + 1;
+
+      data.indices.insert(data.indices.end(),
+                          {first, second, first + 1, second, second + 1,
+                           first + 1});
+    }
+  }
+
+  return data;
+}
+
+BenchWorld BuildWorld(BenchScene id) {
+  BenchWorld world{};
+
+  switch (id) {
+    case BenchScene::DEMO:
+      world.scene = rt::DemoScene::Build();
+      break;
+    case BenchScene::GRID:
+      world.scene = BuildGridScene(false);
+      break;
+    case BenchScene::GLASS:
+      world.scene = BuildGridScene(true);
+      break;
+    case BenchScene::MESH:
+      world.scene.AddSphere(
+          glm::vec3(0.f, -1000.f, 0.f), 1000.f,
+          world.scene.AddMaterial(
+              {rt::MaterialType::LAMBERTIAN, glm::vec3(0.5f), 0.f, 1.f}));
+      world.scene.AddMaterial(
+          {rt::MaterialType::METAL, glm::vec3(0.8f), 0.1f, 1.f});
+      break;
+    case BenchScene::ROOM:
+      world.scene = BuildRoomScene();
+      break;
+  }
+
+  world.materials = std::make_shared<rt::MaterialTable>();
+  world.geometry = rt::SceneFile::BuildGeometry(world.scene, *world.materials);
+
+  // the mesh is generated instead of loaded, placed by an identity instance
+  if (BenchScene::MESH == id) {
+    world.geometry.meshes.push_back(std::make_shared<rt::TriangleMesh>(
+        TessellateSphere(glm::vec3(0.f, 1.f, 0.f), 1.f, MESH_SEGMENTS,
+                         MESH_RINGS),
+        1u));
+    world.scene.AddInstance({0u, glm::vec3(0.f), glm::vec3(0.f), 1.f});
+  }
+
+  world.world =
+      rt::SceneFile::BuildTopLevel(world.geometry, world.scene.instances);
+  world.lights = std::make_shared<rt::LightList>();
+  rt::SceneFile::BuildLights(world.geometry, world.scene.instances,
+                             *world.lights);
+
+  world.settings.width = BENCH_WIDTH;
+  world.settings.height = BENCH_HEIGHT;
+  world.settings.samples_per_pixel = 1;
+  world.settings.bounce_limit = BENCH_BOUNCES;
+  world.settings.seed = RENDER_SEED;
+  world.settings.progressive = false;
+  if (world.scene.has_camera) {
+    world.settings.origin = world.scene.camera.origin;
+    world.settings.look_at = world.scene.camera.look_at;
+    world.settings.fov = world.scene.camera.fov;
+    world.settings.aperture = world.scene.camera.aperture;
+    world.settings.focus_dist = world.scene.camera.focus_dist;
+  }
+
+  return world;
+}
+
+// scenes are built once per process and shared by all benchmarks
+const BenchWorld& GetWorld(BenchScene id) {
+  static BenchWorld worlds[] = {
+      BuildWorld(BenchScene::DEMO), BuildWorld(BenchScene::GRID),
+      BuildWorld(BenchScene::GLASS), BuildWorld(BenchScene::MESH),
+      BuildWorld(BenchScene::ROOM)};
+
+  return worlds[static_cast<int>(id)];
+}
+
+rt::Camera MakeCamera(const rt::RenderSettings& settings) {
+  return rt::Camera(settings.origin, settings.look_at,
+                    glm::vec3(0.f, 1.f, 0.f), settings.fov,
+                    static_cast<float>(settings.width) /
+                        static_cast<float>(settings.height),
+                    settings.aperture, settings.focus_dist);
+}
+
+// camera ray of sample 0 of a pixel, same as Renderer
+rt::Ray GetPixelRay(const rt::Camera& camera, uint32_t width, uint32_t height,
+                    uint32_t x, uint32_t y, rt::Sampler& sampler) {
+  sampler = rt::Sampler::ForPixel(RENDER_SEED, y * width + x, 0u);
+
+  float u = static_cast<float>(x + rt::MathUtils::RandomFloat(sampler)) /
+            static_cast<float>(width - 1);
+  float v = 1.f - static_cast<float>(y + rt::MathUtils::RandomFloat(sampler)) /
+                      static_cast<float>(height - 1);
+
+  return camera.GetRay(u, v, sampler);
+}
+
+// counts the closest hit queries of a single threaded benchmark, packets
+// count one query per lane
+class CountingHittable : public rt::Hittable {
+ public:
+  CountingHittable(const rt::Hittable& world) : world_{world} {}
+
+  virtual bool Hit(const rt::Ray& ray, float t_min, float t_max,
+                   rt::HitRecord& record) const override {
+    ++count_;
+    return world_.Hit(ray, t_min, t_max, record);
+  }
+
+  virtual bool Occluded(const rt::Ray& ray, float t_min,
+                        float t_max) const override {
+    ++count_;
+    return world_.Occluded(ray, t_min, t_max);
+  }
+
+  virtual void HitPacket(const rt::RayPacket& packet, uint32_t mask,
+                         rt::PacketHit& hit) const override {
+    for (uint32_t lanes = mask & packet.mask; lanes; lanes &= lanes - 1) {
+      ++count_;
+    }
+    world_.HitPacket(packet, mask, hit);
+  }
+
+  virtual rt::Aabb BoundingBox() const override {
+    return world_.BoundingBox();
+  }
+
+  uint64_t GetCount() const { return count_; }
+
+ private:
+  const rt::Hittable& world_;
+  mutable uint64_t count_ = 0;
+};
+
+// bvh and primitive work per ray, only in builds with stats
+void SetWorkCounters(benchmark::State& state,
+                     const rt::RayCounters& counters) {
+  const uint64_t rays = counters.GetRayCount();
+  if (!rt::Stats::IsEnabled() || !rays) {
+    return;
+  }
+
+  state.counters["intersection_tests_per_ray"] =
+      static_cast<double>(counters.intersection_tests) / rays;
+  state.counters["bvh_nodes_per_ray"] =
+      static_cast<double>(counters.bvh_nodes) / rays;
+}
+
+// closest hits of the camera rays alone
+void BM_PrimaryRays(benchmark::State& state, BenchScene id) {
+  const BenchWorld& world = GetWorld(id);
+  const rt::RenderSettings& settings = world.settings;
+  const rt::Camera camera = MakeCamera(settings);
+
+  for (auto _ : state) {
+    for (uint32_t y = 0; y < settings.height; ++y) {
+      for (uint32_t x = 0; x < settings.width; ++x) {
+        rt::Sampler sampler{};
+        rt::Ray ray = GetPixelRay(camera, settings.width, settings.height, x,
+                                  y, sampler);
+
+        rt::HitRecord record{};
+        benchmark::DoNotOptimize(
+            world.world->Hit(ray, rt::PathIntegrator::T_MIN,
+                             std::numeric_limits<float>::infinity(), record));
+      }
+    }
+  }
+
+  const double rays = static_cast<double>(state.iterations()) *
+                      settings.width * settings.height;
+  state.counters["rays_per_second"] =
+      benchmark::Counter(rays, benchmark::Counter::kIsRate);
+  state.counters["primary_rays_per_second"] =
+      benchmark::Counter(rays, benchmark::Counter::kIsRate);
+}
+
+// full paths, every bounce and shadow ray is a query of the world
+void BM_Paths(benchmark::State& state, BenchScene id) {
+  const BenchWorld& world = GetWorld(id);
+  const rt::RenderSettings& settings = world.settings;
+  const rt::Camera camera = MakeCamera(settings);
+
+  CountingHittable counting_world(*world.world);
+  rt::PathIntegrator integrator(counting_world, *world.materials,
+                                settings.bounce_limit, world.lights.get());
+  rt::Stats::TakeLocal();
+
+  for (auto _ : state) {
+    for (uint32_t y = 0; y < settings.height; ++y) {
+      for (uint32_t x = 0; x < settings.width; ++x) {
+        rt::Sampler sampler{};
+        rt::Ray ray = GetPixelRay(camera, settings.width, settings.height, x,
+                                  y, sampler);
+
+        benchmark::DoNotOptimize(integrator.Li(ray, sampler));
+      }
+    }
+  }
+
+  const double rays = static_cast<double>(counting_world.GetCount());
+  const double primary_rays = static_cast<double>(state.iterations()) *
+                              settings.width * settings.height;
+  state.counters["rays_per_second"] =
+      benchmark::Counter(rays, benchmark::Counter::kIsRate);
+  state.counters["primary_rays_per_second"] =
+      benchmark::Counter(primary_rays, benchmark::Counter::kIsRate);
+  state.counters["secondary_rays_per_second"] =
+      benchmark::Counter(rays - primary_rays, benchmark::Counter::kIsRate);
+  state.counters["rays_per_path"] = rays / primary_rays;
+  SetWorkCounters(state, rt::Stats::TakeLocal());
+}
+
+// the Renderer end to end on all cores with packets, what the viewer gets,
+// wavefront traces the same image bounce by bounce
+void BM_Render(benchmark::State& state, BenchScene id, bool is_wavefront) {
+  const BenchWorld& world = GetWorld(id);
+
+  rt::RenderSettings settings = world.settings;
+  settings.wavefront = is_wavefront;
+
+  rt::Renderer renderer{};
+  renderer.SetWorld(world.world, world.materials, world.lights);
+  renderer.SetSettings(settings);
+
+  for (auto _ : state) {
+    renderer.RequestRender();
+    benchmark::DoNotOptimize(renderer.WaitForFramebuffer());
+  }
+
+  const double samples = static_cast<double>(state.iterations()) *
+                         world.settings.width * world.settings.height *
+                         world.settings.samples_per_pixel;
+  state.counters["samples_per_second"] =
+      benchmark::Counter(samples, benchmark::Counter::kIsRate);
+
+  // the last pass stands for all of them, every pass traces the same rays
+  const rt::RenderStats stats = renderer.GetStats();
+  SetWorkCounters(state, stats.counters);
+  if (rt::Stats::IsEnabled()) {
+    state.counters["pass_mrays_per_second"] = stats.GetMraysPerSecond();
+    state.counters["utilization"] = stats.GetAverageUtilization();
+  }
+}
+
+// segments from the primary hits to a point above the scene, answered by a
+// closest hit query or by the occlusion query the shadow rays use
+void BM_ShadowRays(benchmark::State& state, BenchScene id) {
+  const bool is_occluded = state.range(0) != 0;
+  const BenchWorld& world = GetWorld(id);
+  const rt::RenderSettings& settings = world.settings;
+  const rt::Camera camera = MakeCamera(settings);
+  const glm::vec3 light(0.f, 20.f, 0.f);
+
+  std::vector<rt::Ray> rays{};
+  std::vector<float> distances{};
+  for (uint32_t y = 0; y < settings.height; ++y) {
+    for (uint32_t x = 0; x < settings.width; ++x) {
+      rt::Sampler sampler{};
+      rt::Ray ray = GetPixelRay(camera, settings.width, settings.height, x, y,
+                                sampler);
+
+      rt::HitRecord record{};
+      if (world.world->Hit(ray, rt::PathIntegrator::T_MIN,
+                           std::numeric_limits<float>::infinity(), record)) {
+        const glm::vec3 offset = light - record.point;
+        distances.push_back(glm::length(offset));
+        rays.emplace_back(record.point, offset / distances.back());
+      }
+    }
+  }
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < rays.size(); ++i) {
+      if (is_occluded) {
+        benchmark::DoNotOptimize(world.world->Occluded(
+            rays[i], rt::PathIntegrator::T_MIN, distances[i]));
+      } else {
+        rt::HitRecord record{};
+        benchmark::DoNotOptimize(world.world->Hit(
+            rays[i], rt::PathIntegrator::T_MIN, distances[i], record));
+      }
+    }
+  }
+
+  state.counters["rays_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations()) * rays.size(),
+      benchmark::Counter::kIsRate);
+}
+
+// top level and bottom levels from scratch, the generated mesh on its own
+void BM_BvhBuild(benchmark::State& state, BenchScene id) {
+  const BenchWorld& world = GetWorld(id);
+
+  if (BenchScene::MESH == id) {
+    const rt::MeshData data = TessellateSphere(
+        glm::vec3(0.f, 1.f, 0.f), 1.f, MESH_SEGMENTS, MESH_RINGS);
+
+    for (auto _ : state) {
+      rt::TriangleMesh mesh(data, 0u);
+      benchmark::DoNotOptimize(mesh.GetTriangleCount());
+    }
+
+    state.counters["primitives"] = data.GetTriangleCount();
+    return;
+  }
+
+  for (auto _ : state) {
+    rt::MaterialTable materials{};
+    rt::SceneGeometry geometry =
+        rt::SceneFile::BuildGeometry(world.scene, materials);
+    benchmark::DoNotOptimize(
+        rt::SceneFile::BuildTopLevel(geometry, world.scene.instances));
+  }
+
+  state.counters["primitives"] = world.scene.GetSphereCount();
+}
+
+// rays from a shell around a unit sphere, aimed inside or just past it
+void BM_SphereHit(benchmark::State& state) {
+  const bool is_hit = state.range(0) != 0;
+  const rt::Sphere sphere(glm::vec3(0.f), 1.f, 0u);
+
+  rt::Sampler sampler(SCENE_SEED);
+  std::vector<rt::Ray> rays(1024);
+  for (rt::Ray& ray : rays) {
+    glm::vec3 origin = 5.f * glm::normalize(rt::MathUtils::RandomVec3(
+                                 sampler, -1.f, 1.f));
+    glm::vec3 target = rt::MathUtils::RandomInUnitSphere(sampler);
+    if (!is_hit) {
+      target = 1.5f * glm::normalize(glm::cross(origin, target));
+    }
+
+    ray = rt::Ray(origin, target - origin);
+  }
+
+  for (auto _ : state) {
+    for (const rt::Ray& ray : rays) {
+      rt::HitRecord record{};
+      benchmark::DoNotOptimize(
+          sphere.Hit(ray, rt::PathIntegrator::T_MIN,
+                     std::numeric_limits<float>::infinity(), record));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(rays.size()));
+}
+
+BENCHMARK_CAPTURE(BM_PrimaryRays, demo, BenchScene::DEMO);
+BENCHMARK_CAPTURE(BM_PrimaryRays, grid, BenchScene::GRID);
+BENCHMARK_CAPTURE(BM_PrimaryRays, glass, BenchScene::GLASS);
+BENCHMARK_CAPTURE(BM_PrimaryRays, mesh, BenchScene::MESH);
+BENCHMARK_CAPTURE(BM_PrimaryRays, room, BenchScene::ROOM);
+
+BENCHMARK_CAPTURE(BM_Paths, demo, BenchScene::DEMO);
+BENCHMARK_CAPTURE(BM_Paths, grid, BenchScene::GRID);
+BENCHMARK_CAPTURE(BM_Paths, glass, BenchScene::GLASS);
+BENCHMARK_CAPTURE(BM_Paths, mesh, BenchScene::MESH);
+BENCHMARK_CAPTURE(BM_Paths, room, BenchScene::ROOM);
+
+BENCHMARK_CAPTURE(BM_Render, demo, BenchScene::DEMO, false)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, grid, BenchScene::GRID, false)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, glass, BenchScene::GLASS, false)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, mesh, BenchScene::MESH, false)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, room, BenchScene::ROOM, false)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, wavefront_demo, BenchScene::DEMO, true)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, wavefront_grid, BenchScene::GRID, true)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, wavefront_glass, BenchScene::GLASS, true)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, wavefront_mesh, BenchScene::MESH, true)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, wavefront_room, BenchScene::ROOM, true)
+    ->UseRealTime();
+
+BENCHMARK_CAPTURE(BM_ShadowRays, grid, BenchScene::GRID)
+    ->ArgName("occluded")
+    ->Arg(0)
+    ->Arg(1);
+BENCHMARK_CAPTURE(BM_ShadowRays, mesh, BenchScene::MESH)
+    ->ArgName("occluded")
+    ->Arg(0)
+    ->Arg(1);
+
+BENCHMARK_CAPTURE(BM_BvhBuild, demo, BenchScene::DEMO);
+BENCHMARK_CAPTURE(BM_BvhBuild, grid, BenchScene::GRID);
+BENCHMARK_CAPTURE(BM_BvhBuild, glass, BenchScene::GLASS);
+BENCHMARK_CAPTURE(BM_BvhBuild, mesh, BenchScene::MESH);
+BENCHMARK_CAPTURE(BM_BvhBuild, room, BenchScene::ROOM);
+
+BENCHMARK(BM_SphereHit)->ArgName("hit")->Arg(1)->Arg(0);
+
+}  // namespace
+
+// json by default so release runs can be diffed, --benchmark_format still
+// picks another format for the console
+int main(int argc, char* argv[]) {
+  std::vector<char*> args(argv, argv + argc);
+  std::string format = "--benchmark_format=json";
+  bool has_format = false;
+  for (int i = 1; i < argc; ++i) {
+    has_format |= std::string(argv[i]).rfind("--benchmark_format", 0) == 0;
+  }
+  if (!has_format) {
+    args.insert(args.begin() + 1, &format[0]);
+  }
+
+  int arg_count = static_cast<int>(args.size());
+  benchmark::Initialize(&arg_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(arg_count, args.data())) {
+    return 1;
+  }
+
+  benchmark::AddCustomContext("simd_isa",
+                              rt::Simd::GetIsaName(rt::Simd::GetIsa()));
+  benchmark::AddCustomContext("scene_seed", std::to_string(SCENE_SEED));
+  benchmark::AddCustomContext("render_seed", std::to_string(RENDER_SEED));
+  benchmark::AddCustomContext("stats_enabled",
+                              rt::Stats::IsEnabled() ? "true" : "false");
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
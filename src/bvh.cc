@@ -0,0 +1,557 @@
+/**
+ * @file bvh.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-09
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "simd.h"
+#include "sphere.h"
+#include "sphere_set.h"
+
+namespace rt {
+
+namespace {
+
+// parent of the root
+const uint32_t NO_PARENT = UINT32_MAX;
+
+}  // namespace
+
+std::vector<BvhNode> BvhBuilder::Build(const std::vector<Aabb>& boxes,
+                                       std::vector<uint32_t>& indices) {
+  std::vector<BvhNode> nodes{};
+
+  indices.resize(boxes.size());
+  for (uint32_t i = 0; i < static_cast<uint32_t>(indices.size()); ++i) {
+    indices[i] = i;
+  }
+
+  if (boxes.empty()) {
+    return nodes;
+  }
+
+  std::vector<glm::vec3> centroids(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    centroids[i] = boxes[i].GetCentroid();
+  }
+
+  // a binary tree never has more than 2n - 1 nodes
+  nodes.reserve(2 * boxes.size() - 1);
+  BuildRecursive(boxes, centroids, indices, 0,
+                 static_cast<uint32_t>(indices.size()), 0, nodes);
+  nodes.shrink_to_fit();
+
+  return nodes;
+}
+
+float BvhBuilder::GetNodeCost(const BvhNode& node) {
+  return node.box.SurfaceArea() *
+         (node.IsLeaf() ? static_cast<float>(node.count) : TRAVERSAL_COST);
+}
+
+uint32_t BvhBuilder::BuildRecursive(const std::vector<Aabb>& boxes,
+                                    const std::vector<glm::vec3>& centroids,
+                                    std::vector<uint32_t>& indices,
+                                    uint32_t begin, uint32_t end,
+                                    uint32_t depth,
+                                    std::vector<BvhNode>& nodes) {
+  assert(depth <= MAX_DEPTH);
+  const uint32_t node_index = static_cast<uint32_t>(nodes.size());
+  nodes.emplace_back();
+
+  Aabb bounds{};
+  Aabb centroid_bounds{};
+  for (uint32_t i = begin; i < end; ++i) {
+    bounds.Expand(boxes[indices[i]]);
+    centroid_bounds.Expand(centroids[indices[i]]);
+  }
+
+  const uint32_t count = end - begin;
+  auto make_leaf = [&]() {
+    nodes[node_index].box = bounds;
+    nodes[node_index].offset = begin;
+    nodes[node_index].count = static_cast<uint16_t>(count);
+    nodes[node_index].axis = 0;
+    return node_index;
+  };
+
+  if (count <= 1) {
+    return make_leaf();
+  }
+
+  // split along the axis with the largest centroid extent
+  glm::vec3 extent = centroid_bounds.GetExtent();
+  int axis = 0;
+  if (extent.y > extent.x) {
+    axis = 1;
+  }
+  if (extent.z > extent[axis]) {
+    axis = 2;
+  }
+
+  uint32_t mid = begin;
+
+  // a tiny extent overflows the scale, those nodes take the median split
+  const float scale = static_cast<float>(BIN_COUNT) / extent[axis];
+
+  if (extent[axis] > 0.f && std::isfinite(scale) &&
+      depth < MAX_BINNED_DEPTH) {
+    // bin primitives by centroid
+    uint32_t bin_counts[BIN_COUNT]{};
+    Aabb bin_boxes[BIN_COUNT]{};
+
+    const float axis_min = centroid_bounds.GetMin()[axis];
+    auto bin_of = [&](uint32_t index) {
+      // clamped before the cast, written so that nan ends up in bin 0
+      float bin = (centroids[index][axis] - axis_min) * scale;
+      bin = bin > 0.f ? bin : 0.f;
+      bin = std::min(bin, static_cast<float>(BIN_COUNT - 1));
+      return static_cast<int>(bin);
+    };
+
+    for (uint32_t i = begin; i < end; ++i) {
+      int bin = bin_of(indices[i]);
+      ++bin_counts[bin];
+      bin_boxes[bin].Expand(boxes[indices[i]]);
+    }
+
+    // sweep from right to left to get suffix areas
+    float right_areas[BIN_COUNT]{};
+    uint32_t right_counts[BIN_COUNT]{};
+    Aabb right_box{};
+    uint32_t right_count = 0;
+    for (int i = BIN_COUNT - 1; i > 0; --i) {
+      right_box.Expand(bin_boxes[i]);
+      right_count += bin_counts[i];
+      right_areas[i] = right_box.SurfaceArea();
+      right_counts[i] = right_count;
+    }
+
+    // split between bin (i - 1) and bin i with the lowest cost
+    int best_split = -1;
+    float best_cost = INFINITY_F;
+    Aabb left_box{};
+    uint32_t left_count = 0;
+    for (int i = 1; i < BIN_COUNT; ++i) {
+      left_box.Expand(bin_boxes[i - 1]);
+      left_count += bin_counts[i - 1];
+
+      if (!left_count || !right_counts[i]) {
+        continue;
+      }
+
+      float cost = left_box.SurfaceArea() * left_count +
+                   right_areas[i] * right_counts[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_split = i;
+      }
+    }
+
+    const float parent_area = bounds.SurfaceArea();
+    best_cost = parent_area > 0.f
+                    ? TRAVERSAL_COST + best_cost / parent_area
+                    : INFINITY_F;
+
+    if (count <= MAX_LEAF_SIZE && best_cost >= static_cast<float>(count)) {
+      return make_leaf();
+    }
+
+    if (best_split > 0) {
+      mid = static_cast<uint32_t>(
+          std::partition(indices.begin() + begin, indices.begin() + end,
+                         [&](uint32_t index) {
+                           return bin_of(index) < best_split;
+                         }) -
+          indices.begin());
+    }
+  } else if (count <= MAX_LEAF_SIZE) {
+    return make_leaf();
+  }
+
+  // degenerated split, fall back to median split
+  if (mid == begin || mid == end) {
+    mid = begin + count / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + mid,
+                     indices.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return centroids[a][axis] < centroids[b][axis];
+                     });
+  }
+
+  BuildRecursive(boxes, centroids, indices, begin, mid, depth + 1, nodes);
+  uint32_t second_child =
+      BuildRecursive(boxes, centroids, indices, mid, end, depth + 1, nodes);
+
+  nodes[node_index].box = bounds;
+  nodes[node_index].offset = second_child;
+  nodes[node_index].count = 0;
+  nodes[node_index].axis = static_cast<uint8_t>(axis);
+
+  return node_index;
+}
+
+Bvh::Bvh(const HittableList& list) {
+  const std::vector<std::shared_ptr<Hittable> >& objects = list.GetObjects();
+
+  std::vector<Aabb> boxes(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i) {
+    boxes[i] = objects[i]->BoundingBox();
+  }
+
+  std::vector<uint32_t> indices{};
+  nodes_ = BvhBuilder::Build(boxes, indices);
+
+  // store objects in leaf order so that leaves reference contiguous ranges
+  objects_.reserve(objects.size());
+  slots_.resize(objects.size());
+  for (uint32_t index : indices) {
+    slots_[index] = static_cast<uint32_t>(objects_.size());
+    objects_.push_back(objects[index]);
+
+    const Sphere* sphere = dynamic_cast<const Sphere*>(objects[index].get());
+    if (sphere) {
+      spheres_.Add(*sphere);
+    } else {
+      spheres_.AddEmpty();
+    }
+  }
+
+  for (uint32_t i = 0; i < static_cast<uint32_t>(nodes_.size()); ++i) {
+    if (nodes_[i].IsLeaf()) {
+      UpdateSphereLeaf(i);
+    }
+  }
+
+  InitRefit();
+}
+
+Bvh::Bvh(const SphereSet& spheres) {
+  const uint32_t count = spheres.GetCount();
+
+  std::vector<Aabb> boxes(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    boxes[i] = spheres.GetBoundingBox(i);
+  }
+
+  std::vector<uint32_t> indices{};
+  nodes_ = BvhBuilder::Build(boxes, indices);
+
+  spheres_.Reserve(count);
+  for (uint32_t index : indices) {
+    spheres_.Append(spheres, index);
+  }
+
+  for (BvhNode& node : nodes_) {
+    if (node.IsLeaf()) {
+      node.flags |= BvhNode::SPHERE_LEAF;
+    }
+  }
+
+  InitRefit();
+}
+
+void Bvh::SetObject(uint32_t index, std::shared_ptr<Hittable> object) {
+  assert(index < slots_.size());
+  const uint32_t slot = slots_[index];
+  objects_[slot] = std::move(object);
+
+  const Sphere* sphere = dynamic_cast<const Sphere*>(objects_[slot].get());
+  if (sphere) {
+    spheres_.Set(slot, sphere->GetCenter(), sphere->GetRadius(),
+                 sphere->GetMaterialIndex());
+  } else {
+    spheres_.SetEmpty(slot);
+  }
+
+  UpdateSphereLeaf(leaves_[slot]);
+  dirty_leaves_.push_back(leaves_[slot]);
+}
+
+void Bvh::Refit() {
+  for (uint32_t leaf : dirty_leaves_) {
+    uint32_t node_index = leaf;
+
+    while (node_index != NO_PARENT) {
+      BvhNode& node = nodes_[node_index];
+
+      Aabb box{};
+      if (node.IsLeaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          box.Expand(objects_[i]->BoundingBox());
+        }
+      } else {
+        box = Aabb::Union(nodes_[node_index + 1].box, nodes_[node.offset].box);
+      }
+
+      // ancestors only depend on the boxes of their children
+      if (box.GetMin() == node.box.GetMin() &&
+          box.GetMax() == node.box.GetMax()) {
+        break;
+      }
+
+      cost_ -= BvhBuilder::GetNodeCost(node);
+      node.box = box;
+      cost_ += BvhBuilder::GetNodeCost(node);
+
+      node_index = parents_[node_index];
+    }
+  }
+
+  dirty_leaves_.clear();
+}
+
+float Bvh::GetCostRatio() const {
+  // not normalized by the root area, a growing root would hide the decay
+  return build_cost_ > 0.0 ? static_cast<float>(cost_ / build_cost_) : 1.f;
+}
+
+bool Bvh::Hit(const Ray& ray, float t_min, float t_max,
+              HitRecord& record) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+  const glm::vec3 inv_direction = 1.f / direction;
+  const bool direction_is_negative[3] = {direction.x < 0.f, direction.y < 0.f,
+                                         direction.z < 0.f};
+
+  bool hit_anything = false;
+  float closest_so_far = t_max;
+
+  // iterative traversal with explicit stack, visit nearer child first
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+    RAY_TRACING_STATS_ADD(bvh_nodes, 1);
+
+    if (node.box.Hit(origin, inv_direction, t_min, closest_so_far)) {
+      if (node.IsSphereLeaf()) {
+        if (spheres_.HitRange(ray, t_min, closest_so_far, node.offset,
+                              node.offset + node.count, record)) {
+          hit_anything = true;
+          closest_so_far = record.t;
+        }
+      } else if (node.IsLeaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          // objects only write the record on a successful hit
+          if (objects_[i]->Hit(ray, t_min, closest_so_far, record)) {
+            hit_anything = true;
+            closest_so_far = record.t;
+          }
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size++] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          node_index = node_index + 1;
+        }
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+
+  return hit_anything;
+}
+
+bool Bvh::Occluded(const Ray& ray, float t_min, float t_max) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+  const glm::vec3 inv_direction = 1.f / direction;
+  const bool direction_is_negative[3] = {direction.x < 0.f, direction.y < 0.f,
+                                         direction.z < 0.f};
+
+  // same traversal as Hit, the interval never shrinks and the first hit ends
+  // it, near children first still tend to find blockers sooner
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+    RAY_TRACING_STATS_ADD(bvh_nodes, 1);
+
+    if (node.box.Hit(origin, inv_direction, t_min, t_max)) {
+      if (node.IsSphereLeaf()) {
+        if (spheres_.OccludedRange(ray, t_min, t_max, node.offset,
+                                   node.offset + node.count)) {
+          return true;
+        }
+      } else if (node.IsLeaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          if (objects_[i]->Occluded(ray, t_min, t_max)) {
+            return true;
+          }
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size++] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          node_index = node_index + 1;
+        }
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+
+  return false;
+}
+
+void Bvh::HitPacket(const RayPacket& packet, uint32_t mask,
+                    PacketHit& hit) const {
+  mask &= packet.mask;
+  if (nodes_.empty() || !mask) {
+    return;
+  }
+
+  const PacketKernels& kernels = Simd::GetKernels();
+
+  // coherent packets share the traversal order of their first active lane
+  int first_lane = 0;
+  while (!(mask & (1u << first_lane))) {
+    ++first_lane;
+  }
+  const bool direction_is_negative[3] = {
+      packet.direction[0][first_lane] < 0.f,
+      packet.direction[1][first_lane] < 0.f,
+      packet.direction[2][first_lane] < 0.f};
+
+  // every stack entry carries the lanes that entered its parent
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  uint32_t stack_masks[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+    RAY_TRACING_STATS_ADD(bvh_nodes, Stats::CountLanes(mask));
+
+    uint32_t node_mask = kernels.intersect_box(packet, node.box.GetMin(),
+                                               node.box.GetMax(), hit.t, mask);
+
+    if (node_mask) {
+      if (node.IsSphereLeaf()) {
+        // Hit of the whole bvh finds the same sphere again
+        uint32_t hit_mask =
+            spheres_.HitPacketRange(packet, node_mask, hit, node.offset,
+                                    node.offset + node.count);
+        for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+          if (hit_mask & (1u << lane)) {
+            hit.object[lane] = this;
+          }
+        }
+      } else if (node.IsLeaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          objects_[i]->HitPacket(packet, node_mask, hit);
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size] = node.offset;
+          node_index = node_index + 1;
+        }
+        stack_masks[stack_size++] = node_mask;
+        mask = node_mask;
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    --stack_size;
+    node_index = stack[stack_size];
+    mask = stack_masks[stack_size];
+  }
+}
+
+Aabb Bvh::BoundingBox() const {
+  return nodes_.empty() ? Aabb() : nodes_[0].box;
+}
+
+void Bvh::InitRefit() {
+  parents_.assign(nodes_.size(), NO_PARENT);
+  leaves_.assign(spheres_.GetCount(), 0);
+  cost_ = 0.0;
+
+  for (uint32_t i = 0; i < static_cast<uint32_t>(nodes_.size()); ++i) {
+    const BvhNode& node = nodes_[i];
+    cost_ += BvhBuilder::GetNodeCost(node);
+
+    if (node.IsLeaf()) {
+      for (uint32_t slot = node.offset; slot < node.offset + node.count;
+           ++slot) {
+        leaves_[slot] = i;
+      }
+    } else {
+      parents_[i + 1] = i;
+      parents_[node.offset] = i;
+    }
+  }
+
+  build_cost_ = cost_;
+}
+
+void Bvh::UpdateSphereLeaf(uint32_t leaf) {
+  BvhNode& node = nodes_[leaf];
+
+  bool all_spheres = true;
+  for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+    all_spheres = all_spheres && !spheres_.IsEmpty(i);
+  }
+
+  if (all_spheres) {
+    node.flags |= BvhNode::SPHERE_LEAF;
+  } else {
+    node.flags = static_cast<uint8_t>(node.flags & ~BvhNode::SPHERE_LEAF);
+  }
+}
+
+}  // namespace rt
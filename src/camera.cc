@@ -10,15 +10,19 @@
  */
 #include "camera.h"
 
+#include <cstdint>
+
+#include "math_utils.h"
 #include "ray.h"
-#include "utils.h"
+#include "ray_packet.h"
+#include "sampler.h"
 
 namespace rt {
 
 Camera::Camera(glm::vec3 origin, glm::vec3 look_at, glm::vec3 world_up,
                float fov, float aspect_ratio, float aperture,
                float focus_dist) {
-  const float theta = Utils::DegreesToRadians(fov);
+  const float theta = MathUtils::DegreesToRadians(fov);
   const float height = glm::tan(theta / 2.f);
   const float viewport_height = 2.f * height;
   const float viewport_width = viewport_height * aspect_ratio;
@@ -34,14 +38,77 @@ Camera::Camera(glm::vec3 origin, glm::vec3 look_at, glm::vec3 world_up,
       origin_ - horizontal_ / 2.f - vertical_ / 2.f + focus_dist * forward_;
 
   lens_radius_ = aperture / 2.f;
+  focus_dist_ = focus_dist;
 }
 
-Ray Camera::GetRay(float u, float v) const {
-  glm::vec3 ray_direction = lens_radius_ * Utils::RandomInUnitDisk();
+Ray Camera::GetRay(float u, float v, Sampler& sampler) const {
+  glm::vec3 ray_direction = lens_radius_ * MathUtils::RandomInUnitDisk(sampler);
   glm::vec3 offset = right_ * ray_direction.x + up_ * ray_direction.y;
 
   return Ray(origin_ + offset,
              lower_left_ + u * horizontal_ + v * vertical_ - origin_ - offset);
 }
 
+void Camera::GetRayPacket(const float* u, const float* v, Sampler* samplers,
+                          uint32_t mask, RayPacket& packet) const {
+  // lens offsets use rejection sampling, so they are drawn lane by lane
+  float offset[3][PACKET_SIZE];
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    glm::vec3 disk(0.f);
+    if (mask & (1u << lane)) {
+      disk = lens_radius_ * MathUtils::RandomInUnitDisk(samplers[lane]);
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+      offset[axis][lane] = right_[axis] * disk.x + up_[axis] * disk.y;
+    }
+  }
+
+  // the rest is branch free over the lanes
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+      float origin = origin_[axis] + offset[axis][lane];
+      float direction = lower_left_[axis] + u[lane] * horizontal_[axis] +
+                        v[lane] * vertical_[axis] - origin_[axis] -
+                        offset[axis][lane];
+
+      packet.origin[axis][lane] = origin;
+      packet.direction[axis][lane] = direction;
+      packet.inv_direction[axis][lane] = 1.f / direction;
+    }
+  }
+
+  packet.mask = mask;
+}
+
+bool Camera::Project(const glm::vec3& point, float& u, float& v) const {
+  const glm::vec3 offset = point - origin_;
+  const float depth = glm::dot(offset, forward_);
+  if (depth <= 0.f) {
+    return false;
+  }
+
+  // onto the focus plane, which the screen spans
+  const glm::vec3 target =
+      origin_ + offset * (focus_dist_ / depth) - lower_left_;
+  u = glm::dot(target, horizontal_) / glm::dot(horizontal_, horizontal_);
+  v = glm::dot(target, vertical_) / glm::dot(vertical_, vertical_);
+
+  return true;
+}
+
+glm::vec3 Camera::GetOrigin() const { return origin_; }
+
+glm::vec3 Camera::GetLowerLeft() const { return lower_left_; }
+
+glm::vec3 Camera::GetHorizontal() const { return horizontal_; }
+
+glm::vec3 Camera::GetVertical() const { return vertical_; }
+
+glm::vec3 Camera::GetRight() const { return right_; }
+
+glm::vec3 Camera::GetUp() const { return up_; }
+
+float Camera::GetLensRadius() const { return lens_radius_; }
+
 }  // namespace rt
@@ -0,0 +1,306 @@
+/**
+ * @file checkpoint.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "checkpoint.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "renderer.h"
+
+namespace rt {
+
+namespace {
+
+// the marker tells files of the other byte order apart, like in scene files
+const char CHECKPOINT_MAGIC[8] = {'R', 'T', 'C', 'H', 'E', 'C', 'K', '\0'};
+const uint32_t CHECKPOINT_VERSION = 2u;
+const uint32_t BYTE_ORDER_MARKER = 0x01020304u;
+
+const uint32_t CHECKPOINT_ADAPTIVE_SAMPLING = 1u << 0;
+const uint32_t CHECKPOINT_NEXT_EVENT_ESTIMATION = 1u << 1;
+
+// everything RenderSettings::IsCompatible looks at
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t scene_hash;
+  uint32_t width;
+  uint32_t height;
+  int32_t samples;
+  int32_t bounce_limit;
+  int32_t seed;
+  int32_t adaptive_min_samples;
+  float adaptive_threshold;
+  uint32_t flags;
+  // origin, look at, fov, aperture, focus dist
+  float camera[9];
+  uint32_t padding;
+};
+static_assert(sizeof(CheckpointHeader) == 96,
+              "unexpected checkpoint header size");
+
+// sums, sample count, luminance squares, albedo, normal and position sums
+const uint64_t CHECKPOINT_PIXEL_SIZE =
+    4 * sizeof(glm::vec3) + sizeof(int32_t) + sizeof(float);
+
+}  // namespace
+
+bool Checkpoint::Read(const std::string& path, const RenderSettings& settings,
+                      uint64_t scene_hash, Accumulation& accumulation) {
+  MappedFile file(path);
+  const uint8_t* data = file.GetData();
+  const uint64_t size = file.GetSize();
+
+  auto fail = [&](const std::string& message) {
+    throw std::runtime_error("Error::Checkpoint: " + path + ": " + message +
+                             "!");
+  };
+
+  CheckpointHeader header{};
+  if (size < sizeof(header)) {
+    fail("File too small for a checkpoint");
+  }
+  std::memcpy(&header, data, sizeof(header));
+
+  if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))) {
+    fail("Not a checkpoint");
+  }
+  if (header.byte_order != BYTE_ORDER_MARKER) {
+    fail("Written on a host of another byte order");
+  }
+  if (header.version != CHECKPOINT_VERSION) {
+    fail("Unsupported version " + std::to_string(header.version));
+  }
+  if (header.scene_hash != scene_hash) {
+    fail("Traced from another scene");
+  }
+
+  const uint64_t pixel_count =
+      static_cast<uint64_t>(header.width) * header.height;
+  // divided so crafted dimensions cannot wrap the product around
+  const uint64_t body_size = size - sizeof(header);
+  if (pixel_count > body_size / CHECKPOINT_PIXEL_SIZE ||
+      body_size != pixel_count * CHECKPOINT_PIXEL_SIZE) {
+    fail("Size does not match the header");
+  }
+
+  RenderSettings traced = settings;
+  traced.width = header.width;
+  traced.height = header.height;
+  traced.origin =
+      glm::vec3(header.camera[0], header.camera[1], header.camera[2]);
+  traced.look_at =
+      glm::vec3(header.camera[3], header.camera[4], header.camera[5]);
+  traced.fov = header.camera[6];
+  traced.aperture = header.camera[7];
+  traced.focus_dist = header.camera[8];
+  traced.bounce_limit = header.bounce_limit;
+  traced.seed = header.seed;
+  traced.adaptive_min_samples = header.adaptive_min_samples;
+  traced.adaptive_threshold = header.adaptive_threshold;
+  traced.adaptive_sampling =
+      0 != (header.flags & CHECKPOINT_ADAPTIVE_SAMPLING);
+  traced.next_event_estimation =
+      0 != (header.flags & CHECKPOINT_NEXT_EVENT_ESTIMATION);
+
+  if (!settings.IsCompatible(traced)) {
+    return false;
+  }
+
+  accumulation.width = header.width;
+  accumulation.height = header.height;
+  accumulation.first_row = 0;
+  accumulation.row_count = header.height;
+  accumulation.samples = header.samples;
+
+  // columns are copied as they are
+  const uint8_t* cursor = data + sizeof(header);
+  auto read_column = [&](auto& column) {
+    column.resize(static_cast<size_t>(pixel_count));
+    const size_t column_size = column.size() * sizeof(column[0]);
+    if (column_size) {
+      std::memcpy(column.data(), cursor, column_size);
+    }
+    cursor += column_size;
+  };
+  read_column(accumulation.sums);
+  read_column(accumulation.sample_counts);
+  read_column(accumulation.luminance_squares);
+  read_column(accumulation.albedo_sums);
+  read_column(accumulation.normal_sums);
+  read_column(accumulation.position_sums);
+
+  return true;
+}
+
+void Checkpoint::Write(const std::string& path, const RenderSettings& settings,
+                       uint64_t scene_hash, const Accumulation& accumulation) {
+  const size_t pixel_count =
+      static_cast<size_t>(accumulation.width) * accumulation.height;
+  if (accumulation.width != settings.width ||
+      accumulation.height != settings.height || accumulation.first_row ||
+      accumulation.row_count != accumulation.height ||
+      accumulation.sums.size() != pixel_count ||
+      accumulation.sample_counts.size() != pixel_count ||
+      accumulation.luminance_squares.size() != pixel_count ||
+      accumulation.albedo_sums.size() != pixel_count ||
+      accumulation.normal_sums.size() != pixel_count ||
+      accumulation.position_sums.size() != pixel_count) {
+    throw std::runtime_error(
+        "Error::Checkpoint: Only whole images are checkpointed!");
+  }
+
+  CheckpointHeader header{};
+  std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = BYTE_ORDER_MARKER;
+  header.scene_hash = scene_hash;
+  header.width = accumulation.width;
+  header.height = accumulation.height;
+  header.samples = accumulation.samples;
+  header.bounce_limit = settings.bounce_limit;
+  header.seed = settings.seed;
+  header.adaptive_min_samples = settings.adaptive_min_samples;
+  header.adaptive_threshold = settings.adaptive_threshold;
+  header.flags =
+      (settings.adaptive_sampling ? CHECKPOINT_ADAPTIVE_SAMPLING : 0u) |
+      (settings.next_event_estimation ? CHECKPOINT_NEXT_EVENT_ESTIMATION
+                                      : 0u);
+
+  const float camera[9] = {
+      settings.origin.x,  settings.origin.y,  settings.origin.z,
+      settings.look_at.x, settings.look_at.y, settings.look_at.z,
+      settings.fov,       settings.aperture,  settings.focus_dist};
+  std::memcpy(header.camera, camera, sizeof(header.camera));
+
+  // a process killed meanwhile only leaves a stale temporary behind
+  const std::string temporary_path = path + ".tmp";
+  {
+    MappedFile file(temporary_path,
+                    sizeof(header) + pixel_count * CHECKPOINT_PIXEL_SIZE);
+    uint8_t* cursor = file.GetMutableData();
+
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+
+    auto write_column = [&](const auto& column) {
+      const size_t column_size = column.size() * sizeof(column[0]);
+      if (column_size) {
+        std::memcpy(cursor, column.data(), column_size);
+      }
+      cursor += column_size;
+    };
+    write_column(accumulation.sums);
+    write_column(accumulation.sample_counts);
+    write_column(accumulation.luminance_squares);
+    write_column(accumulation.albedo_sums);
+    write_column(accumulation.normal_sums);
+    write_column(accumulation.position_sums);
+
+    file.Flush();
+  }
+
+  std::error_code error{};
+  std::filesystem::rename(temporary_path, path, error);
+  if (error) {
+    throw std::runtime_error("Error::Checkpoint: Failed to move " +
+                             temporary_path + " to " + path + "!");
+  }
+}
+
+CheckpointWriter::CheckpointWriter() {
+  thread_ = std::thread(&CheckpointWriter::WriteLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+
+  // a submitted checkpoint is still written
+  thread_.join();
+}
+
+bool CheckpointWriter::IsBusy() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return is_busy_;
+}
+
+Accumulation& CheckpointWriter::GetBuffer() { return buffer_; }
+
+void CheckpointWriter::Submit(const std::string& path,
+                              const RenderSettings& settings,
+                              uint64_t scene_hash) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  written_.wait(lock, [this]() { return !is_busy_; });
+
+  path_ = path;
+  settings_ = settings;
+  scene_hash_ = scene_hash;
+  is_busy_ = true;
+  condition_.notify_all();
+}
+
+void CheckpointWriter::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  written_.wait(lock, [this]() { return !is_busy_; });
+}
+
+std::string CheckpointWriter::TakeError() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return std::exchange(error_, std::string{});
+}
+
+void CheckpointWriter::WriteLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    condition_.wait(lock, [this]() { return stop_ || is_busy_; });
+    if (!is_busy_) {
+      return;
+    }
+
+    // path, settings and buffer stay untouched while busy
+    lock.unlock();
+    std::string error{};
+    try {
+      Checkpoint::Write(path_, settings_, scene_hash_, buffer_);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    lock.lock();
+
+    if (!error.empty()) {
+      error_ = error;
+    }
+    is_busy_ = false;
+    written_.notify_all();
+  }
+}
+
+}  // namespace rt
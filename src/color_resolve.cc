@@ -0,0 +1,95 @@
+/**
+ * @file color_resolve.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "color_resolve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+namespace rt {
+
+namespace {
+
+float ApplyTonemap(float x, Tonemap tonemap) {
+  switch (tonemap) {
+    case Tonemap::REINHARD:
+      return x / (1.f + x);
+    case Tonemap::ACES:
+      return (x * (ACES_A * x + ACES_B)) / (x * (ACES_C * x + ACES_D) + ACES_E);
+    default:
+      return x;
+  }
+}
+
+uint32_t EncodeColor(float x, const uint8_t* lut) {
+  float min_value = 0.f;
+  float max_value = 0.f;
+  std::memcpy(&min_value, &COLOR_LUT_MIN_BITS, sizeof(float));
+  std::memcpy(&max_value, &COLOR_LUT_MAX_BITS, sizeof(float));
+
+  // written so that nan ends up black like in the simd kernels
+  x = x > min_value ? x : min_value;
+  x = x < max_value ? x : max_value;
+
+  uint32_t bits = 0;
+  std::memcpy(&bits, &x, sizeof(float));
+
+  return lut[(bits - COLOR_LUT_MIN_BITS) >> COLOR_LUT_SHIFT];
+}
+
+}  // namespace
+
+void ColorLut::Build(float gamma) {
+  gamma_ = gamma;
+  values_.resize(COLOR_LUT_SIZE);
+
+  const float inv_gamma = 1.f / std::max(gamma, 1e-3f);
+  for (uint32_t i = 0; i < COLOR_LUT_SIZE; ++i) {
+    // value at the center of the bucket, rounded to the nearest level
+    uint32_t bits = COLOR_LUT_MIN_BITS + (i << COLOR_LUT_SHIFT) +
+                    (1u << (COLOR_LUT_SHIFT - 1));
+    float x = 0.f;
+    std::memcpy(&x, &bits, sizeof(float));
+
+    values_[i] = static_cast<uint8_t>(
+        std::min(255.f * std::pow(x, inv_gamma) + 0.5f, 255.f));
+  }
+}
+
+float ColorLut::GetGamma() const { return gamma_; }
+
+const uint8_t* ColorLut::GetData() const { return values_.data(); }
+
+void ResolveColors(const glm::vec3* sums, const int* sample_counts,
+                   uint32_t count, const ResolveParams& params,
+                   uint32_t* pixels) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const float scale =
+        params.exposure_scale /
+        static_cast<float>(std::max(sample_counts[i], 1));
+
+    uint32_t R = EncodeColor(ApplyTonemap(sums[i].r * scale, params.tonemap),
+                             params.lut);
+    uint32_t G = EncodeColor(ApplyTonemap(sums[i].g * scale, params.tonemap),
+                             params.lut);
+    uint32_t B = EncodeColor(ApplyTonemap(sums[i].b * scale, params.tonemap),
+                             params.lut);
+
+    pixels[i] = (255u << 24) | (B << 16) | (G << 8) | R;
+  }
+}
+
+}  // namespace rt
@@ -0,0 +1,83 @@
+/**
+ * @file demo_scene.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "demo_scene.h"
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "math_utils.h"
+#include "sampler.h"
+#include "scene_file.h"
+
+namespace rt {
+
+SceneDescription DemoScene::Build() {
+  SceneDescription scene{};
+
+  // Sampler sampler(SEED);
+
+  auto lambertian = [&](const glm::vec3& albedo) {
+    return scene.AddMaterial({MaterialType::LAMBERTIAN, albedo, 0.f, 1.f});
+  };
+  auto metal = [&](float fuzz, const glm::vec3& albedo) {
+    return scene.AddMaterial({MaterialType::METAL, albedo, fuzz, 1.f});
+  };
+  auto dielectric = [&](float refraction_index) {
+    return scene.AddMaterial(
+        {MaterialType::DIELECTRIC, glm::vec3(1.f), 0.f, refraction_index});
+  };
+
+  uint32_t ground_material = lambertian(glm::vec3(0.5f));
+  scene.AddSphere(glm::vec3(0.f, -1000.f, 0.f), 1000.f, ground_material);
+
+  // for (int i = -11; i < 11; ++i) {
+  //   for (int j = -11; j < 11; ++j) {
+  //     float choose_mat = MathUtils::RandomFloat(sampler);
+  //     glm::vec3 center(i + 0.9f * MathUtils::RandomFloat(sampler), 0.2f,
+  //                      j + 0.9f * MathUtils::RandomFloat(sampler));
+
+  //     if (glm::length(center - glm::vec3(4.f, 0.2f, 0.f)) > 0.9f) {
+  //       uint32_t material{};
+
+  //       if (choose_mat < 0.8f) {
+  //         // diffuse
+  //         glm::vec3 albedo = MathUtils::RandomVec3(sampler);
+  //         material = lambertian(albedo);
+  //       } else if (choose_mat < 0.95f) {
+  //         // metal
+  //         float fuzz = MathUtils::RandomFloat(sampler, 0.f, 0.05f);
+  //         glm::vec3 albedo(MathUtils::RandomFloat(sampler, 0.5f, 1.f));
+  //         material = metal(fuzz, albedo);
+  //       } else {
+  //         // glass
+  //         material = dielectric(1.5f);
+  //       }
+
+  //       scene.AddSphere(center, 0.2f, material);
+  //     }
+  //   }
+  // }
+
+  uint32_t diffuse_material = lambertian(glm::vec3(0.4f, 0.2f, 0.1f));
+  scene.AddSphere(glm::vec3(-4.f, 1.f, 0.f), 1.f, diffuse_material);
+
+  uint32_t metal_material = metal(0.f, glm::vec3(0.7f, 0.6f, 0.5f));
+  scene.AddSphere(glm::vec3(4.f, 1.f, 0.f), 1.f, metal_material);
+
+  uint32_t dielectric_material = dielectric(1.5f);
+  scene.AddSphere(glm::vec3(0.f, 1.f, 0.f), 1.f, dielectric_material);
+
+  return scene;
+}
+
+}  // namespace rt
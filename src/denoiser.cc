@@ -0,0 +1,328 @@
+/**
+ * @file denoiser.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "denoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#ifdef RAY_TRACING_ENABLE_OIDN
+#include <OpenImageDenoise/oidn.hpp>
+#endif
+
+#include "config.h"
+#include "function_ref.h"
+#include "thread_pool.h"
+
+namespace rt {
+
+namespace {
+
+// B3 spline weights of the 5 taps along either axis
+const float ATROUS_KERNEL[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f,
+                                1.f / 16.f};
+
+// pixels of a row filtered at once, their sums stay in registers or l1
+const int ATROUS_SPAN = 64;
+
+// keeps the demodulation of black surfaces invertible
+const float ALBEDO_EPSILON = 1e-3f;
+
+// run rows [first, last) of the image in bands of TILE_SIZE rows
+bool ForEachBand(uint32_t height, ThreadPool& thread_pool,
+                 const FunctionRef<void(uint32_t, uint32_t)>& rows) {
+  const uint32_t bands = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+  return thread_pool.ParallelFor(bands, [&](uint32_t band, uint32_t) {
+    const uint32_t first = band * TILE_SIZE;
+    rows(first, std::min(first + TILE_SIZE, height));
+  });
+}
+
+// smallest argument of NegativeExp
+const float NEGATIVE_EXP_MIN = -30.f;
+
+// e^x for x <= 0 from the exponent bits and a quartic of the fraction,
+// within 0.3% which is plenty for filter weights, the argument is clamped
+// to e^-30 so products never turn into slow denormals, everything is
+// branch free so the tap loops vectorize
+float NegativeExp(float x) {
+  // written so that nan ends up at the minimum before the cast to int
+  x = x > NEGATIVE_EXP_MIN ? x : NEGATIVE_EXP_MIN;
+  x = x < 0.f ? x : 0.f;
+
+  // e^x = 2^y with y = whole + f and f in (-1, 0]
+  const float y = x * 1.44269504f;
+  const int whole = static_cast<int>(y);
+  const float f = (y - static_cast<float>(whole)) * 0.69314718f;
+  const float fraction =
+      1.f + f * (1.f + f * (0.5f + f * (1.f / 6.f + f * (1.f / 24.f))));
+
+  const uint32_t bits = static_cast<uint32_t>(whole + 127) << 23;
+  float scale = 0.f;
+  std::memcpy(&scale, &bits, sizeof(float));
+
+  return fraction * scale;
+}
+
+// nan or inf radiance would spread over the whole kernel, it is black
+// like in ResolveColors
+glm::vec3 FiniteColor(const glm::vec3& color) {
+  return glm::vec3(std::isfinite(color.r) ? color.r : 0.f,
+                   std::isfinite(color.g) ? color.g : 0.f,
+                   std::isfinite(color.b) ? color.b : 0.f);
+}
+
+glm::vec3 Demodulation(const glm::vec3& albedo) {
+  return glm::max(albedo, glm::vec3(ALBEDO_EPSILON));
+}
+
+}  // namespace
+
+bool Denoiser::Denoise(DenoiseMode mode, uint32_t width, uint32_t height,
+                       const glm::vec3* color_sums,
+                       const glm::vec3* albedo_sums,
+                       const glm::vec3* normal_sums, const int* sample_counts,
+                       glm::vec3* output_sums, ThreadPool& thread_pool) {
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+
+  if (DenoiseMode::NONE == mode) {
+    std::copy(color_sums, color_sums + pixel_count, output_sums);
+    return true;
+  }
+
+  color_.resize(pixel_count);
+  albedo_.resize(pixel_count);
+  normal_.resize(pixel_count);
+  filtered_.resize(pixel_count);
+
+  bool completed =
+      ForEachBand(height, thread_pool, [&](uint32_t first, uint32_t last) {
+        for (size_t pixel = static_cast<size_t>(first) * width;
+             pixel < static_cast<size_t>(last) * width; ++pixel) {
+          const float scale =
+              1.f / static_cast<float>(std::max(sample_counts[pixel], 1));
+
+          color_[pixel] = FiniteColor(color_sums[pixel] * scale);
+          albedo_[pixel] = albedo_sums[pixel] * scale;
+          normal_[pixel] = normal_sums[pixel] * scale;
+        }
+      });
+
+  // the a-trous result ends up in color_, the oidn one in filtered_
+  const std::vector<glm::vec3>* result = &color_;
+#ifdef RAY_TRACING_ENABLE_OIDN
+  if (DenoiseMode::OIDN == mode && FilterOidn(width, height)) {
+    result = &filtered_;
+  } else {
+    completed =
+        completed && FilterAtrous(width, height, sample_counts, thread_pool);
+  }
+#else
+  completed =
+      completed && FilterAtrous(width, height, sample_counts, thread_pool);
+#endif
+
+  return completed &&
+         ForEachBand(height, thread_pool, [&](uint32_t first, uint32_t last) {
+           for (size_t pixel = static_cast<size_t>(first) * width;
+                pixel < static_cast<size_t>(last) * width; ++pixel) {
+             output_sums[pixel] =
+                 (*result)[pixel] *
+                 static_cast<float>(std::max(sample_counts[pixel], 1));
+           }
+         });
+}
+
+bool Denoiser::FilterAtrous(uint32_t width, uint32_t height,
+                            const int* sample_counts,
+                            ThreadPool& thread_pool) {
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+
+  // planar copies, every tap then runs over a contiguous span of a row that
+  // the compiler vectorizes, planes are red, green and blue and for the
+  // guides normal xyz then albedo rgb
+  planes_.resize(pixel_count * 3);
+  filtered_planes_.resize(pixel_count * 3);
+  guide_planes_.resize(pixel_count * 6);
+  sample_weights_.resize(pixel_count);
+
+  float* planes = planes_.data();
+  float* guides = guide_planes_.data();
+
+  // texture lives in the albedo, filtering the irradiance alone keeps it
+  // sharp, the background has its own color as albedo and turns flat
+  bool completed =
+      ForEachBand(height, thread_pool, [&](uint32_t first, uint32_t last) {
+        for (size_t pixel = static_cast<size_t>(first) * width;
+             pixel < static_cast<size_t>(last) * width; ++pixel) {
+          const glm::vec3 irradiance =
+              color_[pixel] / Demodulation(albedo_[pixel]);
+
+          for (int c = 0; c < 3; ++c) {
+            planes[c * pixel_count + pixel] = irradiance[c];
+            guides[c * pixel_count + pixel] = normal_[pixel][c];
+            guides[(c + 3) * pixel_count + pixel] = albedo_[pixel][c];
+          }
+          sample_weights_[pixel] =
+              static_cast<float>(std::max(sample_counts[pixel], 1));
+        }
+      });
+
+  const int w = static_cast<int>(width);
+  const int h = static_cast<int>(height);
+  const float inv_normal = 1.f / (ATROUS_SIGMA_NORMAL * ATROUS_SIGMA_NORMAL);
+  const float inv_albedo = 1.f / (ATROUS_SIGMA_ALBEDO * ATROUS_SIGMA_ALBEDO);
+
+  for (int iteration = 0; completed && iteration < ATROUS_ITERATION_COUNT;
+       ++iteration) {
+    const int step = 1 << iteration;
+    const float sigma_color =
+        ATROUS_SIGMA_COLOR / static_cast<float>(1 << iteration);
+    const float inv_color = 1.f / (sigma_color * sigma_color);
+
+    const float* source = planes_.data();
+    float* target = filtered_planes_.data();
+
+    completed = ForEachBand(height, thread_pool, [&](uint32_t first,
+                                                     uint32_t last) {
+      const ptrdiff_t stride = static_cast<ptrdiff_t>(pixel_count);
+
+      for (int y = static_cast<int>(first); y < static_cast<int>(last); ++y) {
+        const size_t row = static_cast<size_t>(y) * width;
+        // planes of the row, stride apart
+        const float* center = source + row;
+        const float* center_guides = guides + row;
+        const float* weights = sample_weights_.data() + row;
+
+        for (int span = 0; span < w; span += ATROUS_SPAN) {
+          const int span_end = std::min(span + ATROUS_SPAN, w);
+
+          // weighted sums of the span, locals so the tap loop does not
+          // need to check for aliasing with the planes
+          float sum_r[ATROUS_SPAN]{};
+          float sum_g[ATROUS_SPAN]{};
+          float sum_b[ATROUS_SPAN]{};
+          float sum_w[ATROUS_SPAN]{};
+
+          for (int j = 0; j < 5; ++j) {
+            const int qy = y + (j - 2) * step;
+            if (qy < 0 || qy >= h) {
+              continue;
+            }
+
+            for (int i = 0; i < 5; ++i) {
+              const int dx = (i - 2) * step;
+              const float kernel = ATROUS_KERNEL[i] * ATROUS_KERNEL[j];
+
+              // pixels of the span whose tap lies inside the image
+              const int x0 = std::max(span, -dx);
+              const int x1 = std::min(span_end, w - dx);
+
+              const ptrdiff_t offset =
+                  (static_cast<ptrdiff_t>(qy) - y) * w + dx;
+              const float* tap = center + offset;
+              const float* tap_guides = center_guides + offset;
+
+              for (int x = x0; x < x1; ++x) {
+                const float dr = tap[x] - center[x];
+                const float dg = tap[x + stride] - center[x + stride];
+                const float db = tap[x + 2 * stride] - center[x + 2 * stride];
+                const float nx = tap_guides[x] - center_guides[x];
+                const float ny =
+                    tap_guides[x + stride] - center_guides[x + stride];
+                const float nz =
+                    tap_guides[x + 2 * stride] - center_guides[x + 2 * stride];
+                const float ar =
+                    tap_guides[x + 3 * stride] - center_guides[x + 3 * stride];
+                const float ag =
+                    tap_guides[x + 4 * stride] - center_guides[x + 4 * stride];
+                const float ab =
+                    tap_guides[x + 5 * stride] - center_guides[x + 5 * stride];
+
+                // one exp for all three edge stopping functions
+                const float weight =
+                    kernel *
+                    NegativeExp(-(dr * dr + dg * dg + db * db) * inv_color *
+                                    weights[x] -
+                                (nx * nx + ny * ny + nz * nz) * inv_normal -
+                                (ar * ar + ag * ag + ab * ab) * inv_albedo);
+
+                sum_r[x - span] += weight * tap[x];
+                sum_g[x - span] += weight * tap[x + stride];
+                sum_b[x - span] += weight * tap[x + 2 * stride];
+                sum_w[x - span] += weight;
+              }
+            }
+          }
+
+          // the center tap always has a positive weight
+          for (int x = span; x < span_end; ++x) {
+            const float inv_weight = 1.f / sum_w[x - span];
+            target[row + x] = sum_r[x - span] * inv_weight;
+            target[pixel_count + row + x] = sum_g[x - span] * inv_weight;
+            target[2 * pixel_count + row + x] = sum_b[x - span] * inv_weight;
+          }
+        }
+      }
+    });
+
+    std::swap(planes_, filtered_planes_);
+  }
+
+  return completed &&
+         ForEachBand(height, thread_pool, [&](uint32_t first, uint32_t last) {
+           for (size_t pixel = static_cast<size_t>(first) * width;
+                pixel < static_cast<size_t>(last) * width; ++pixel) {
+             const glm::vec3 irradiance(planes_[pixel],
+                                        planes_[pixel_count + pixel],
+                                        planes_[2 * pixel_count + pixel]);
+             color_[pixel] = irradiance * Demodulation(albedo_[pixel]);
+           }
+         });
+}
+
+#ifdef RAY_TRACING_ENABLE_OIDN
+bool Denoiser::FilterOidn(uint32_t width, uint32_t height) {
+  if (!device_) {
+    device_ = oidn::newDevice();
+    device_.commit();
+    filter_ = device_.newFilter("RT");
+  }
+
+  // buffers may have moved since the last call, committing the same size
+  // again is cheap
+  filter_.setImage("color", color_.data(), oidn::Format::Float3, width,
+                   height);
+  filter_.setImage("albedo", albedo_.data(), oidn::Format::Float3, width,
+                   height);
+  filter_.setImage("normal", normal_.data(), oidn::Format::Float3, width,
+                   height);
+  filter_.setImage("output", filtered_.data(), oidn::Format::Float3, width,
+                   height);
+  filter_.set("hdr", true);
+  filter_.commit();
+  filter_.execute();
+
+  // fall back to the built in filter on devices oidn does not support
+  const char* message = nullptr;
+  return oidn::Error::None == device_.getError(message);
+}
+#endif
+
+}  // namespace rt
@@ -0,0 +1,42 @@
+/**
+ * @file diffuse_light.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "diffuse_light.h"
+
+#include <glm/glm.hpp>
+
+#include "hittable.h"
+#include "material.h"
+#include "material_data.h"
+#include "ray.h"
+#include "sampler.h"
+
+namespace rt {
+
+DiffuseLight::DiffuseLight(const glm::vec3& radiance)
+    : Material(
+          MaterialData{radiance, 0.f, MaterialKind::DIFFUSE_LIGHT, 1.f}) {}
+
+bool DiffuseLight::Scatter(const Ray& ray, const HitRecord& record,
+                           glm::vec3& attenuation, Ray& scattered,
+                           Sampler& sampler) const {
+  (void)ray;
+  (void)record;
+  (void)scattered;
+  (void)sampler;
+
+  return MaterialShading::ScatterDiffuseLight(GetData(), attenuation);
+}
+
+glm::vec3 DiffuseLight::Emitted(const HitRecord& record) const {
+  return MaterialShading::EmittedDiffuseLight(GetData(), record);
+}
+
+}  // namespace rt
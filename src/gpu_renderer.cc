@@ -0,0 +1,818 @@
+/**
+ * @file gpu_renderer.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "gpu_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "bvh.h"
+#include "camera.h"
+#include "config.h"
+#include "image.h"
+#include "ray_tracing_scene.h"
+#include "renderer.h"
+#include "scene_file.h"
+#include "utils.h"
+
+namespace rt {
+
+namespace {
+
+// local size of path_tracer.comp in both dimensions
+const uint32_t WORKGROUP_SIZE = 8;
+
+float BitsToFloat(uint32_t bits) {
+  float value = 0.f;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+VkDeviceSize AlignUp(VkDeviceSize size, VkDeviceSize alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// stages of the ray tracing pipeline, in the order of its shader groups
+const uint32_t RAY_TRACING_STAGE_COUNT = 5;
+const char* const RAY_TRACING_STAGE_FILES[RAY_TRACING_STAGE_COUNT] = {
+    "ray_tracing.rgen.spv", "ray_tracing.rmiss.spv", "triangle.rchit.spv",
+    "sphere.rint.spv", "sphere.rchit.spv"};
+const VkShaderStageFlagBits RAY_TRACING_STAGES[RAY_TRACING_STAGE_COUNT] = {
+    VK_SHADER_STAGE_RAYGEN_BIT_KHR, VK_SHADER_STAGE_MISS_BIT_KHR,
+    VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, VK_SHADER_STAGE_INTERSECTION_BIT_KHR,
+    VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR};
+
+// ray generation, miss and the two hit groups
+const uint32_t RAY_TRACING_GROUP_COUNT = 4;
+
+}  // namespace
+
+GpuRenderer::GpuRenderer(VkPhysicalDevice& physical_device, VkDevice& device,
+                         VkQueue& queue, VkCommandPool& command_pool,
+                         uint32_t queue_family)
+    : physical_device_{physical_device},
+      device_{device},
+      queue_{queue},
+      command_pool_{command_pool} {
+  // pick backend
+  if (Utils::QueryRayTracingSupport(physical_device_)) {
+    backend_ = GpuBackend::RAY_TRACING;
+    bind_point_ = VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR;
+    shader_stage_ = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+    push_constant_stages_ =
+        VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR |
+        VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+        VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
+
+    functions_.Load(device_);
+    ray_tracing_scene_ = std::make_unique<RayTracingScene>(
+        physical_device_, device_, queue_, command_pool_, functions_);
+  }
+
+  // create descriptor set layout
+  CreateDescriptorSetLayout();
+  // create pipeline
+  CreatePipeline();
+  // create descriptor set
+  CreateDescriptorSet();
+  // create timestamp queries
+  CreateQueryPool(queue_family);
+}
+
+GpuRenderer::~GpuRenderer() {
+  ray_tracing_scene_.reset();
+  vkDestroyBuffer(device_, shader_binding_table_, nullptr);
+  vkFreeMemory(device_, shader_binding_table_memory_, nullptr);
+
+  DestroyWorldBuffers();
+  vkDestroyBuffer(device_, accumulation_buffer_, nullptr);
+  vkFreeMemory(device_, accumulation_buffer_memory_, nullptr);
+
+  vkDestroyQueryPool(device_, query_pool_, nullptr);
+  vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+  vkDestroyPipeline(device_, pipeline_, nullptr);
+  vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+  vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
+}
+
+bool GpuRenderer::IsSupported(const VkPhysicalDevice& physical_device,
+                              uint32_t queue_family) {
+  VkPhysicalDeviceFeatures features{};
+  vkGetPhysicalDeviceFeatures(physical_device, &features);
+  if (!features.shaderInt64) {
+    return false;
+  }
+
+  uint32_t family_cnt = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_cnt,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_cnt);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_cnt,
+                                           families.data());
+
+  return queue_family < family_cnt &&
+         (families[queue_family].queueFlags & VK_QUEUE_COMPUTE_BIT);
+}
+
+void GpuRenderer::SetWorld(const SceneDescription& scene,
+                           const SceneGeometry& geometry) {
+  const uint32_t sphere_count = scene.GetSphereCount();
+
+  // the ray tracing stages look spheres up by primitive id in scene order
+  std::vector<uint32_t> indices(sphere_count);
+  for (uint32_t i = 0; i < sphere_count; ++i) {
+    indices[i] = i;
+  }
+
+  std::vector<BvhNode> nodes{};
+  if (GpuBackend::COMPUTE == backend_) {
+    std::vector<Aabb> boxes(sphere_count);
+    for (uint32_t i = 0; i < sphere_count; ++i) {
+      glm::vec3 center(scene.center_x[i], scene.center_y[i],
+                       scene.center_z[i]);
+      glm::vec3 extent(std::fabs(scene.radius[i]));
+
+      boxes[i] = Aabb(center - extent, center + extent);
+    }
+
+    nodes = BvhBuilder::Build(boxes, indices);
+  }
+
+  std::vector<GpuBvhNode> gpu_nodes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const BvhNode& node = nodes[i];
+    const uint32_t count_axis = static_cast<uint32_t>(node.count) |
+                                (static_cast<uint32_t>(node.axis) << 16u);
+
+    gpu_nodes[i].min_offset =
+        glm::vec4(node.box.GetMin(), BitsToFloat(node.offset));
+    gpu_nodes[i].max_count =
+        glm::vec4(node.box.GetMax(), BitsToFloat(count_axis));
+  }
+
+  // compute spheres in leaf order so leaves reference contiguous ranges
+  std::vector<GpuSphere> spheres(sphere_count);
+  for (uint32_t slot = 0; slot < sphere_count; ++slot) {
+    const uint32_t index = indices[slot];
+
+    spheres[slot].center_radius =
+        glm::vec4(scene.center_x[index], scene.center_y[index],
+                  scene.center_z[index], scene.radius[index]);
+    spheres[slot].material = scene.material[index];
+  }
+
+  std::vector<GpuMaterial> materials(scene.materials.size());
+  for (size_t i = 0; i < scene.materials.size(); ++i) {
+    const MaterialDescription& material = scene.materials[i];
+
+    materials[i].albedo_fuzz = glm::vec4(material.albedo, material.fuzz);
+    materials[i].type = static_cast<uint32_t>(material.type);
+    materials[i].refraction_index = material.refraction_index;
+  }
+
+  node_count_ = static_cast<uint32_t>(gpu_nodes.size());
+  has_skipped_geometry_ =
+      GpuBackend::COMPUTE == backend_ && !scene.instances.empty();
+
+  // empty buffers are not allowed, the shader never reads these dummies
+  gpu_nodes.resize(std::max<size_t>(gpu_nodes.size(), 1));
+  spheres.resize(std::max<size_t>(spheres.size(), 1));
+  materials.resize(std::max<size_t>(materials.size(), 1));
+
+  // frames in flight may still read the previous world
+  vkQueueWaitIdle(queue_);
+  DestroyWorldBuffers();
+
+  if (GpuBackend::COMPUTE == backend_) {
+    CreateStorageBuffer(gpu_nodes.data(),
+                        sizeof(GpuBvhNode) * gpu_nodes.size(), node_buffer_,
+                        node_buffer_memory_);
+  }
+  CreateStorageBuffer(spheres.data(), sizeof(GpuSphere) * spheres.size(),
+                      sphere_buffer_, sphere_buffer_memory_);
+  CreateStorageBuffer(materials.data(),
+                      sizeof(GpuMaterial) * materials.size(), material_buffer_,
+                      material_buffer_memory_);
+
+  if (ray_tracing_scene_) {
+    ray_tracing_scene_->Build(scene, geometry);
+  }
+
+  is_descriptor_set_dirty_ = true;
+  reset_requested_ = true;
+}
+
+void GpuRenderer::SetInstances(
+    const std::vector<InstanceDescription>& instances) {
+  // the compute tracer has no instances to move
+  if (!ray_tracing_scene_) {
+    return;
+  }
+
+  // frames in flight may still trace the previous top level
+  vkQueueWaitIdle(queue_);
+  ray_tracing_scene_->SetInstances(instances);
+
+  is_descriptor_set_dirty_ = true;
+  reset_requested_ = true;
+}
+
+void GpuRenderer::SetSettings(const RenderSettings& settings) {
+  if (settings == settings_) {
+    return;
+  }
+
+  if (!settings.IsCompatible(settings_)) {
+    reset_requested_ = true;
+  } else if (settings.gamma != settings_.gamma ||
+             settings.exposure != settings_.exposure ||
+             settings.tonemap != settings_.tonemap) {
+    resolve_requested_ = true;
+  }
+
+  settings_ = settings;
+}
+
+void GpuRenderer::SetPlaying(bool playing) { playing_ = playing; }
+
+void GpuRenderer::RequestRender() { render_requested_ = true; }
+
+void GpuRenderer::RecordRender(VkCommandBuffer command_buffer,
+                               uint32_t frame_index, Image& image) {
+  ReadPassTime(frame_index);
+
+  const uint32_t width = image.GetWidth();
+  const uint32_t height = image.GetHeight();
+
+  // the image has to catch up with a resized viewport first
+  if (!sphere_buffer_ || !width || !height || width != settings_.width ||
+      height != settings_.height) {
+    return;
+  }
+
+  // a new image is sampled right away, so it always gets a pass, one of a
+  // new size may have been handed the view of the image it replaced
+  if (image.GetImageView() != image_view_ || width != accumulation_width_ ||
+      height != accumulation_height_) {
+    image_view_ = image.GetImageView();
+    is_descriptor_set_dirty_ = true;
+    render_requested_ = true;
+  }
+
+  if (!HasWork()) {
+    return;
+  }
+
+  if (width != accumulation_width_ || height != accumulation_height_) {
+    ResizeAccumulation(width, height);
+  }
+
+  if (is_descriptor_set_dirty_) {
+    UpdateDescriptorSet();
+  }
+
+  if (reset_requested_ || !settings_.progressive) {
+    reset_requested_ = false;
+    accumulated_samples_ = 0;
+  }
+
+  render_requested_ = false;
+  resolve_requested_ = false;
+
+  // samples to trace this pass, zero only re-resolves the image
+  const int first_sample = accumulated_samples_;
+  int samples = std::max(settings_.samples_per_pixel - first_sample, 0);
+  if (settings_.progressive) {
+    samples = std::min(samples, settings_.samples_per_frame);
+  }
+
+  // camera
+  glm::vec3 world_up(0.f, 1.f, 0.f);
+
+  Camera camera(settings_.origin, settings_.look_at, world_up, settings_.fov,
+                static_cast<float>(width) / static_cast<float>(height),
+                settings_.aperture, settings_.focus_dist);
+
+  GpuPass pass{};
+  pass.origin = glm::vec4(camera.GetOrigin(), camera.GetLensRadius());
+  pass.lower_left = glm::vec4(camera.GetLowerLeft(), settings_.gamma);
+  pass.horizontal =
+      glm::vec4(camera.GetHorizontal(), std::exp2(settings_.exposure));
+  pass.vertical = glm::vec4(camera.GetVertical(),
+                            static_cast<float>(settings_.tonemap));
+  pass.right = glm::vec4(camera.GetRight(), 0.f);
+  pass.up = glm::vec4(camera.GetUp(), 0.f);
+  pass.trace = glm::ivec4(settings_.bounce_limit, settings_.seed,
+                          ROULETTE_MIN_DEPTH, static_cast<int>(node_count_));
+
+  if (query_pool_) {
+    vkCmdResetQueryPool(command_buffer, query_pool_, 2 * frame_index, 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        query_pool_, 2 * frame_index);
+  }
+
+  image.RecordStorageBegin(command_buffer, shader_stage_);
+
+  vkCmdBindPipeline(command_buffer, bind_point_, pipeline_);
+  vkCmdBindDescriptorSets(command_buffer, bind_point_, pipeline_layout_, 0, 1,
+                          &descriptor_set_, 0, nullptr);
+
+  const uint32_t group_cnt_x = (width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+  const uint32_t group_cnt_y = (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+  // every dispatch adds to the sums of the one before, which may have been
+  // submitted by an earlier frame
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  const int total_samples = first_sample + samples;
+  int sample = first_sample;
+  do {
+    const int count =
+        std::min(total_samples - sample, GPU_SAMPLES_PER_DISPATCH);
+
+    vkCmdPipelineBarrier(command_buffer, shader_stage_, shader_stage_, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    pass.extent = glm::ivec4(static_cast<int>(width),
+                             static_cast<int>(height), sample, count);
+    vkCmdPushConstants(command_buffer, pipeline_layout_, push_constant_stages_,
+                       0, sizeof(GpuPass), &pass);
+
+    if (GpuBackend::RAY_TRACING == backend_) {
+      functions_.cmd_trace_rays(command_buffer, &raygen_region_, &miss_region_,
+                                &hit_region_, &callable_region_, width, height,
+                                1);
+    } else {
+      vkCmdDispatch(command_buffer, group_cnt_x, group_cnt_y, 1);
+    }
+
+    sample += count;
+  } while (sample < total_samples);
+
+  image.RecordStorageEnd(command_buffer, shader_stage_);
+
+  if (query_pool_) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        query_pool_, 2 * frame_index + 1);
+    has_timestamps_[frame_index] = true;
+  }
+
+  accumulated_samples_ = total_samples;
+}
+
+GpuBackend GpuRenderer::GetBackend() const { return backend_; }
+
+int GpuRenderer::GetAccumulatedSamples() const { return accumulated_samples_; }
+
+float GpuRenderer::GetPassTime() const { return pass_time_; }
+
+bool GpuRenderer::HasSkippedGeometry() const { return has_skipped_geometry_; }
+
+std::vector<VkDescriptorSetLayoutBinding> GpuRenderer::GetBindings() const {
+  // output image, accumulation, nodes, spheres and materials
+  std::vector<VkDescriptorSetLayoutBinding> bindings(5);
+  for (uint32_t i = 0; i < 5; ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = i ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                   : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  if (GpuBackend::COMPUTE == backend_) {
+    return bindings;
+  }
+
+  // the top level takes the place of the nodes, then the mesh records
+  bindings.resize(6);
+  bindings[5].binding = 5;
+  bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[5].descriptorCount = 1;
+
+  bindings[0].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  bindings[1].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+  bindings[2].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  bindings[3].stageFlags = VK_SHADER_STAGE_INTERSECTION_BIT_KHR |
+                           VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+  bindings[4].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  bindings[5].stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+
+  return bindings;
+}
+
+void GpuRenderer::CreateDescriptorSetLayout() {
+  std::vector<VkDescriptorSetLayoutBinding> bindings = GetBindings();
+
+  VkDescriptorSetLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+  layout_info.pBindings = bindings.data();
+
+  VkResult result = vkCreateDescriptorSetLayout(device_, &layout_info, nullptr,
+                                                &descriptor_set_layout_);
+  Utils::CheckVulkanResult(
+      result, "Error::Vulkan: Failed to create descriptor set layout!");
+}
+
+void GpuRenderer::CreatePipeline() {
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = push_constant_stages_;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(GpuPass);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info{};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &descriptor_set_layout_;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+  VkResult result = vkCreatePipelineLayout(device_, &pipeline_layout_info,
+                                           nullptr, &pipeline_layout_);
+  Utils::CheckVulkanResult(result,
+                           "Error::Vulkan: Failed to create pipeline layout!");
+
+  if (GpuBackend::RAY_TRACING == backend_) {
+    CreateRayTracingPipeline();
+    CreateShaderBindingTable();
+  } else {
+    CreateComputePipeline();
+  }
+}
+
+void GpuRenderer::CreateComputePipeline() {
+  VkShaderModule shader_module = Utils::CreateShaderMoudle(
+      device_, Utils::ReadFile(PATH_TRACER_SHADER_FILEPATH));
+
+  VkComputePipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = shader_module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = pipeline_layout_;
+
+  VkResult result = vkCreateComputePipelines(
+      device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_);
+  vkDestroyShaderModule(device_, shader_module, nullptr);
+  Utils::CheckVulkanResult(result,
+                           "Error::Vulkan: Failed to create compute pipeline!");
+}
+
+void GpuRenderer::CreateRayTracingPipeline() {
+  VkShaderModule shader_modules[RAY_TRACING_STAGE_COUNT]{};
+  VkPipelineShaderStageCreateInfo stages[RAY_TRACING_STAGE_COUNT]{};
+  for (uint32_t i = 0; i < RAY_TRACING_STAGE_COUNT; ++i) {
+    shader_modules[i] = Utils::CreateShaderMoudle(
+        device_, Utils::ReadFile(std::string(RAY_TRACING_SHADER_DIRECTORY) +
+                                 RAY_TRACING_STAGE_FILES[i]));
+
+    stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[i].stage = RAY_TRACING_STAGES[i];
+    stages[i].module = shader_modules[i];
+    stages[i].pName = "main";
+  }
+
+  // ray generation, miss, triangle hits and sphere hits, the hit groups in
+  // the order of TRIANGLE_HIT_GROUP and SPHERE_HIT_GROUP
+  VkRayTracingShaderGroupCreateInfoKHR groups[RAY_TRACING_GROUP_COUNT]{};
+  for (auto& group : groups) {
+    group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+    group.generalShader = VK_SHADER_UNUSED_KHR;
+    group.closestHitShader = VK_SHADER_UNUSED_KHR;
+    group.anyHitShader = VK_SHADER_UNUSED_KHR;
+    group.intersectionShader = VK_SHADER_UNUSED_KHR;
+  }
+
+  groups[0].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+  groups[0].generalShader = 0;
+  groups[1].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+  groups[1].generalShader = 1;
+  groups[2].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+  groups[2].closestHitShader = 2;
+  groups[3].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR;
+  groups[3].intersectionShader = 3;
+  groups[3].closestHitShader = 4;
+
+  // paths are traced iteratively from the ray generation shader
+  VkRayTracingPipelineCreateInfoKHR pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
+  pipeline_info.stageCount = RAY_TRACING_STAGE_COUNT;
+  pipeline_info.pStages = stages;
+  pipeline_info.groupCount = RAY_TRACING_GROUP_COUNT;
+  pipeline_info.pGroups = groups;
+  pipeline_info.maxPipelineRayRecursionDepth = 1;
+  pipeline_info.layout = pipeline_layout_;
+
+  VkResult result = functions_.create_ray_tracing_pipelines(
+      device_, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+      &pipeline_);
+  for (auto& shader_module : shader_modules) {
+    vkDestroyShaderModule(device_, shader_module, nullptr);
+  }
+  Utils::CheckVulkanResult(
+      result, "Error::Vulkan: Failed to create ray tracing pipeline!");
+}
+
+void GpuRenderer::CreateShaderBindingTable() {
+  VkPhysicalDeviceRayTracingPipelinePropertiesKHR ray_tracing_properties{};
+  ray_tracing_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &ray_tracing_properties;
+  vkGetPhysicalDeviceProperties2(physical_device_, &properties);
+
+  const uint32_t handle_size = ray_tracing_properties.shaderGroupHandleSize;
+  std::vector<uint8_t> handles(RAY_TRACING_GROUP_COUNT * handle_size);
+  VkResult result = functions_.get_ray_tracing_shader_group_handles(
+      device_, pipeline_, 0, RAY_TRACING_GROUP_COUNT, handles.size(),
+      handles.data());
+  Utils::CheckVulkanResult(
+      result, "Error::Vulkan: Failed to get shader group handles!");
+
+  // regions start base aligned, the records in them handle aligned
+  const VkDeviceSize stride = AlignUp(
+      handle_size, ray_tracing_properties.shaderGroupHandleAlignment);
+  const VkDeviceSize base_alignment =
+      ray_tracing_properties.shaderGroupBaseAlignment;
+  const VkDeviceSize raygen_size = AlignUp(stride, base_alignment);
+  const VkDeviceSize miss_size = AlignUp(stride, base_alignment);
+  const VkDeviceSize hit_size = AlignUp(2 * stride, base_alignment);
+
+  const VkDeviceSize record_offsets[RAY_TRACING_GROUP_COUNT] = {
+      0, raygen_size, raygen_size + miss_size,
+      raygen_size + miss_size + stride};
+
+  std::vector<uint8_t> table(raygen_size + miss_size + hit_size);
+  for (uint32_t i = 0; i < RAY_TRACING_GROUP_COUNT; ++i) {
+    memcpy(table.data() + record_offsets[i],
+           handles.data() + i * handle_size, handle_size);
+  }
+
+  Utils::CreateDeviceLocalBuffer(
+      physical_device_, device_, command_pool_, queue_, table.data(),
+      table.size(),
+      VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      shader_binding_table_, shader_binding_table_memory_);
+
+  VkBufferDeviceAddressInfo address_info{};
+  address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+  address_info.buffer = shader_binding_table_;
+  const VkDeviceAddress address =
+      functions_.get_buffer_device_address(device_, &address_info);
+
+  // the ray generation stride has to equal its size
+  raygen_region_.deviceAddress = address;
+  raygen_region_.stride = raygen_size;
+  raygen_region_.size = raygen_size;
+  miss_region_.deviceAddress = address + raygen_size;
+  miss_region_.stride = stride;
+  miss_region_.size = miss_size;
+  hit_region_.deviceAddress = address + raygen_size + miss_size;
+  hit_region_.stride = stride;
+  hit_region_.size = hit_size;
+}
+
+void GpuRenderer::CreateDescriptorSet() {
+  std::vector<VkDescriptorSetLayoutBinding> bindings = GetBindings();
+
+  std::vector<VkDescriptorPoolSize> pool_sizes{};
+  for (const auto& binding : bindings) {
+    auto pool_size = std::find_if(
+        pool_sizes.begin(), pool_sizes.end(), [&](const auto& size) {
+          return size.type == binding.descriptorType;
+        });
+
+    if (pool_size == pool_sizes.end()) {
+      pool_sizes.push_back({binding.descriptorType, 1});
+    } else {
+      ++pool_size->descriptorCount;
+    }
+  }
+
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+  pool_info.pPoolSizes = pool_sizes.data();
+
+  VkResult result =
+      vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool_);
+  Utils::CheckVulkanResult(result,
+                           "Error::Vulkan: Failed to create descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = descriptor_pool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &descriptor_set_layout_;
+
+  result = vkAllocateDescriptorSets(device_, &alloc_info, &descriptor_set_);
+  Utils::CheckVulkanResult(result,
+                           "Error::Vulkan: Failed to allocate descriptor set!");
+}
+
+void GpuRenderer::CreateQueryPool(uint32_t queue_family) {
+  uint32_t family_cnt = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_cnt,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_cnt);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_cnt,
+                                           families.data());
+
+  // pass times are simply not shown without timestamps
+  if (queue_family >= family_cnt ||
+      !families[queue_family].timestampValidBits) {
+    return;
+  }
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physical_device_, &properties);
+  timestamp_period_ = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo query_pool_info{};
+  query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_info.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+  VkResult result =
+      vkCreateQueryPool(device_, &query_pool_info, nullptr, &query_pool_);
+  Utils::CheckVulkanResult(result,
+                           "Error::Vulkan: Failed to create query pool!");
+}
+
+void GpuRenderer::CreateStorageBuffer(const void* data, VkDeviceSize size,
+                                      VkBuffer& buffer,
+                                      VkDeviceMemory& buffer_memory) {
+  Utils::CreateDeviceLocalBuffer(physical_device_, device_, command_pool_,
+                                 queue_, data, size,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer,
+                                 buffer_memory);
+}
+
+void GpuRenderer::DestroyWorldBuffers() {
+  vkDestroyBuffer(device_, node_buffer_, nullptr);
+  vkFreeMemory(device_, node_buffer_memory_, nullptr);
+  vkDestroyBuffer(device_, sphere_buffer_, nullptr);
+  vkFreeMemory(device_, sphere_buffer_memory_, nullptr);
+  vkDestroyBuffer(device_, material_buffer_, nullptr);
+  vkFreeMemory(device_, material_buffer_memory_, nullptr);
+
+  node_buffer_ = VK_NULL_HANDLE;
+  node_buffer_memory_ = VK_NULL_HANDLE;
+  sphere_buffer_ = VK_NULL_HANDLE;
+  sphere_buffer_memory_ = VK_NULL_HANDLE;
+  material_buffer_ = VK_NULL_HANDLE;
+  material_buffer_memory_ = VK_NULL_HANDLE;
+}
+
+void GpuRenderer::ResizeAccumulation(uint32_t width, uint32_t height) {
+  // frames in flight may still add to the previous sums
+  vkQueueWaitIdle(queue_);
+
+  vkDestroyBuffer(device_, accumulation_buffer_, nullptr);
+  vkFreeMemory(device_, accumulation_buffer_memory_, nullptr);
+
+  // never read before the first pass wrote it
+  VkDeviceSize size =
+      static_cast<VkDeviceSize>(width) * height * sizeof(glm::vec4);
+  Utils::CreateBuffer(physical_device_, device_, size,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                      accumulation_buffer_, accumulation_buffer_memory_);
+
+  accumulation_width_ = width;
+  accumulation_height_ = height;
+  is_descriptor_set_dirty_ = true;
+  reset_requested_ = true;
+}
+
+void GpuRenderer::UpdateDescriptorSet() {
+  // the set must not be in use by a frame in flight
+  vkQueueWaitIdle(queue_);
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings = GetBindings();
+
+  VkDescriptorImageInfo image_info{};
+  image_info.imageView = image_view_;
+  image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkAccelerationStructureKHR top_level =
+      ray_tracing_scene_ ? ray_tracing_scene_->GetTopLevel() : VK_NULL_HANDLE;
+
+  VkWriteDescriptorSetAccelerationStructureKHR top_level_info{};
+  top_level_info.sType =
+      VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+  top_level_info.accelerationStructureCount = 1;
+  top_level_info.pAccelerationStructures = &top_level;
+
+  // by binding, the image and the top level are written separately
+  const VkBuffer buffers[6] = {
+      VK_NULL_HANDLE,
+      accumulation_buffer_,
+      node_buffer_,
+      sphere_buffer_,
+      material_buffer_,
+      ray_tracing_scene_ ? ray_tracing_scene_->GetMeshBuffer()
+                         : VK_NULL_HANDLE};
+
+  std::vector<VkDescriptorBufferInfo> buffer_infos(bindings.size());
+  std::vector<VkWriteDescriptorSet> writes(bindings.size());
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptor_set_;
+    writes[i].dstBinding = bindings[i].binding;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = bindings[i].descriptorType;
+
+    switch (bindings[i].descriptorType) {
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        writes[i].pImageInfo = &image_info;
+        break;
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        writes[i].pNext = &top_level_info;
+        break;
+      default:
+        buffer_infos[i].buffer = buffers[bindings[i].binding];
+        buffer_infos[i].offset = 0;
+        buffer_infos[i].range = VK_WHOLE_SIZE;
+        writes[i].pBufferInfo = &buffer_infos[i];
+        break;
+    }
+  }
+
+  vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+
+  is_descriptor_set_dirty_ = false;
+}
+
+bool GpuRenderer::HasWork() const {
+  if (render_requested_) {
+    return true;
+  }
+
+  if (resolve_requested_ && accumulated_samples_ > 0) {
+    return true;
+  }
+
+  if (!playing_) {
+    return false;
+  }
+
+  // one-shot renders keep re-rendering while playing
+  if (!settings_.progressive) {
+    return true;
+  }
+
+  return reset_requested_ ||
+         accumulated_samples_ < settings_.samples_per_pixel;
+}
+
+void GpuRenderer::ReadPassTime(uint32_t frame_index) {
+  if (!query_pool_ || !has_timestamps_[frame_index]) {
+    return;
+  }
+
+  // the frame's fence has been waited on, so its queries are available
+  uint64_t timestamps[2]{};
+  VkResult result = vkGetQueryPoolResults(
+      device_, query_pool_, 2 * frame_index, 2, sizeof(timestamps),
+      timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  has_timestamps_[frame_index] = false;
+
+  if (VK_SUCCESS == result) {
+    pass_time_ = static_cast<float>(timestamps[1] - timestamps[0]) *
+                 timestamp_period_ / 1000000.f;
+  }
+}
+
+}  // namespace rt
@@ -0,0 +1,391 @@
+/**
+ * @file headless.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "checkpoint.h"
+#include "config.h"
+#include "demo_scene.h"
+#include "hittable.h"
+#include "image_writer.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "render_farm.h"
+#include "render_stats.h"
+#include "renderer.h"
+#include "scene_file.h"
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::clog
+      << "Usage: " << program << " [options]\n"
+      << "  --scene <path>          scene file, .rtb binary or text\n"
+      << "  --save-scene <path>     write the scene, .rtb binary or text\n"
+      << "  --output <path>         image file, .png, .pfm or .exr\n"
+      << "  --width <pixels>        image width\n"
+      << "  --height <pixels>       image height\n"
+      << "  --samples <count>       samples per pixel\n"
+      << "  --bounces <count>       bounce limit\n"
+      << "  --seed <value>          sampler seed\n"
+      << "  --gamma <value>         display gamma of png output\n"
+      << "  --exposure <stops>      exposure of png output\n"
+      << "  --tonemap <name>        none, reinhard or aces for png output\n"
+      << "  --denoise <name>        none, atrous or oidn\n"
+      << "  --origin <x> <y> <z>    camera origin\n"
+      << "  --look-at <x> <y> <z>   camera target\n"
+      << "  --fov <degrees>         vertical field of view\n"
+      << "  --aperture <value>      lens aperture\n"
+      << "  --focus-dist <value>    focus distance\n"
+      << "  --threads <count>       render threads, 0 for all cores\n"
+      << "  --no-packets            disable SIMD packet tracing\n"
+      << "  --no-nee                disable light sampling\n"
+      << "  --wavefront             trace tiles bounce by bounce\n"
+      << "  --adaptive <threshold>  stop converged pixels, --samples is the "
+         "maximum\n"
+      << "  --min-samples <count>   samples before a pixel may stop\n"
+      << "  --stats <path>          write render statistics as json, - for "
+         "stdout\n"
+      << "  --worker <port>         trace bands for coordinators on port\n"
+      << "  --workers <list>        trace on comma separated host:port "
+         "workers\n"
+      << "  --worker-timeout <s>    longest a worker may take for a band\n"
+      << "  --checkpoint <path>     resume from and write a checkpoint\n"
+      << "  --checkpoint-interval <s>\n"
+      << "                          seconds between checkpoints\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  rt::RenderSettings settings{};
+  settings.width = rt::WIDTH;
+  settings.height = rt::HEIGHT;
+  // trace every sample in a single pass
+  settings.progressive = false;
+
+  std::string output = "output.png";
+  std::string scene_path{};
+  std::string save_scene_path{};
+  std::string stats_path{};
+  uint32_t thread_count = 0;
+  // render farm, either serving a port or coordinating the workers
+  int worker_port = 0;
+  std::vector<std::string> workers{};
+  float worker_timeout = 300.f;
+  std::string checkpoint_path{};
+  float checkpoint_interval = rt::CHECKPOINT_INTERVAL;
+
+  // the camera of a scene file is applied first so options can override it
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string(argv[i]) == "--scene") {
+      scene_path = argv[i + 1];
+    }
+  }
+
+  rt::SceneDescription scene{};
+  try {
+    auto begin = std::chrono::high_resolution_clock::now();
+    scene = scene_path.empty() ? rt::DemoScene::Build()
+                               : rt::SceneFile::Load(scene_path);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (!scene_path.empty()) {
+      std::clog << "Loaded " << scene.GetSphereCount() << " spheres and "
+                << scene.instances.size() << " instances in "
+                << std::chrono::duration_cast<std::chrono::microseconds>(
+                       end - begin)
+                           .count() /
+                       1000.f
+                << "ms: " << scene_path << '\n';
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (scene.has_camera) {
+    settings.origin = scene.camera.origin;
+    settings.look_at = scene.camera.look_at;
+    settings.fov = scene.camera.fov;
+    settings.aperture = scene.camera.aperture;
+    settings.focus_dist = scene.camera.focus_dist;
+  }
+
+  try {
+    int i = 1;
+    auto next = [&](const std::string& option) -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("missing value of " + option);
+      }
+      return argv[++i];
+    };
+    auto next_vec3 = [&](const std::string& option) {
+      float x = std::stof(next(option));
+      float y = std::stof(next(option));
+      float z = std::stof(next(option));
+      return glm::vec3(x, y, z);
+    };
+
+    for (; i < argc; ++i) {
+      const std::string option = argv[i];
+
+      if (option == "--help" || option == "-h") {
+        PrintUsage(argv[0]);
+        return EXIT_SUCCESS;
+      } else if (option == "--scene") {
+        // loaded above
+        next(option);
+      } else if (option == "--save-scene") {
+        save_scene_path = next(option);
+      } else if (option == "--output" || option == "-o") {
+        output = next(option);
+      } else if (option == "--width") {
+        settings.width = static_cast<uint32_t>(std::stoul(next(option)));
+      } else if (option == "--height") {
+        settings.height = static_cast<uint32_t>(std::stoul(next(option)));
+      } else if (option == "--samples") {
+        settings.samples_per_pixel = std::stoi(next(option));
+      } else if (option == "--bounces") {
+        settings.bounce_limit = std::stoi(next(option));
+      } else if (option == "--seed") {
+        settings.seed = std::stoi(next(option));
+      } else if (option == "--gamma") {
+        settings.gamma = std::stof(next(option));
+      } else if (option == "--exposure") {
+        settings.exposure = std::stof(next(option));
+      } else if (option == "--tonemap") {
+        const std::string tonemap = next(option);
+        if ("none" == tonemap) {
+          settings.tonemap = rt::Tonemap::NONE;
+        } else if ("reinhard" == tonemap) {
+          settings.tonemap = rt::Tonemap::REINHARD;
+        } else if ("aces" == tonemap) {
+          settings.tonemap = rt::Tonemap::ACES;
+        } else {
+          throw std::invalid_argument("unknown tonemap " + tonemap);
+        }
+      } else if (option == "--denoise") {
+        const std::string denoise = next(option);
+        if ("none" == denoise) {
+          settings.denoise = rt::DenoiseMode::NONE;
+        } else if ("atrous" == denoise) {
+          settings.denoise = rt::DenoiseMode::ATROUS;
+        } else if ("oidn" == denoise) {
+          settings.denoise = rt::DenoiseMode::OIDN;
+        } else {
+          throw std::invalid_argument("unknown denoiser " + denoise);
+        }
+      } else if (option == "--origin") {
+        settings.origin = next_vec3(option);
+      } else if (option == "--look-at") {
+        settings.look_at = next_vec3(option);
+      } else if (option == "--fov") {
+        settings.fov = std::stof(next(option));
+      } else if (option == "--aperture") {
+        settings.aperture = std::stof(next(option));
+      } else if (option == "--focus-dist") {
+        settings.focus_dist = std::stof(next(option));
+      } else if (option == "--threads") {
+        thread_count = static_cast<uint32_t>(std::stoul(next(option)));
+      } else if (option == "--no-packets") {
+        settings.packet_tracing = false;
+      } else if (option == "--no-nee") {
+        settings.next_event_estimation = false;
+      } else if (option == "--wavefront") {
+        settings.wavefront = true;
+      } else if (option == "--adaptive") {
+        settings.adaptive_sampling = true;
+        settings.adaptive_threshold = std::stof(next(option));
+      } else if (option == "--min-samples") {
+        settings.adaptive_min_samples = std::stoi(next(option));
+      } else if (option == "--stats") {
+        stats_path = next(option);
+      } else if (option == "--worker") {
+        worker_port = std::stoi(next(option));
+        if (worker_port < 1 || worker_port > 65535) {
+          throw std::invalid_argument("invalid port of --worker");
+        }
+      } else if (option == "--workers") {
+        std::istringstream list(next(option));
+        std::string address{};
+        while (std::getline(list, address, ',')) {
+          if (!address.empty()) {
+            workers.push_back(address);
+          }
+        }
+      } else if (option == "--worker-timeout") {
+        worker_timeout = std::stof(next(option));
+      } else if (option == "--checkpoint") {
+        checkpoint_path = next(option);
+      } else if (option == "--checkpoint-interval") {
+        checkpoint_interval = std::stof(next(option));
+      } else {
+        throw std::invalid_argument("unknown option " + option);
+      }
+    }
+
+    if (settings.width < 2 || settings.height < 2 ||
+        settings.samples_per_pixel < 1) {
+      throw std::invalid_argument("image needs at least 2 * 2 pixels and 1 "
+                                  "sample");
+    }
+    if (!workers.empty() && !stats_path.empty()) {
+      throw std::invalid_argument("no statistics of --workers renders");
+    }
+    if (!workers.empty() && !checkpoint_path.empty()) {
+      throw std::invalid_argument("no checkpoints of --workers renders");
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error::Arguments: " << e.what() << '\n';
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  settings.resolve_radiance =
+      rt::ImageWriter::IsHdr(rt::ImageWriter::GetFormat(output));
+
+  try {
+    if (worker_port) {
+      rt::RenderFarm::Serve(static_cast<uint16_t>(worker_port), thread_count);
+    }
+
+    if (!save_scene_path.empty()) {
+      rt::SceneFile::Save(save_scene_path, scene);
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    rt::Renderer renderer{};
+    renderer.SetThreadCount(thread_count);
+
+    if (workers.empty()) {
+      std::shared_ptr<rt::MaterialTable> materials =
+          std::make_shared<rt::MaterialTable>();
+      std::shared_ptr<rt::LightList> lights =
+          std::make_shared<rt::LightList>();
+      std::shared_ptr<rt::Hittable> world =
+          rt::SceneFile::Build(scene, *materials, lights.get());
+
+      renderer.SetWorld(world, materials, lights);
+
+      if (!checkpoint_path.empty()) {
+        // checkpoints are taken between passes, which are neither denoised
+        // nor resolved to radiance until the last one
+        rt::RenderSettings traced = settings;
+        traced.progressive = true;
+        traced.samples_per_frame = rt::CHECKPOINT_PASS_SAMPLES;
+        traced.denoise = rt::DenoiseMode::NONE;
+        traced.resolve_radiance = false;
+        renderer.SetSettings(traced);
+
+        const uint64_t scene_hash = rt::SceneFile::Hash(scene);
+        if (std::filesystem::exists(checkpoint_path)) {
+          rt::Accumulation accumulation{};
+          if (!rt::Checkpoint::Read(checkpoint_path, traced, scene_hash,
+                                    accumulation)) {
+            throw std::runtime_error("Error::Headless: " + checkpoint_path +
+                                     " was traced with other settings!");
+          }
+          renderer.LoadAccumulation(accumulation);
+
+          std::clog << "Resuming at " << accumulation.samples
+                    << " spp: " << checkpoint_path << '\n';
+        }
+
+        renderer.SetCheckpoint(checkpoint_path, checkpoint_interval,
+                               scene_hash);
+        while (renderer.GetAccumulatedSamples() < traced.samples_per_pixel) {
+          renderer.RequestRender();
+          renderer.WaitForFramebuffer();
+        }
+
+        renderer.WaitForCheckpoint();
+        const std::string error = renderer.TakeCheckpointError();
+        if (!error.empty()) {
+          throw std::runtime_error(error);
+        }
+
+        // compatible with the traced settings, so only resolved again
+        settings.progressive = true;
+      }
+      renderer.SetSettings(settings);
+    } else {
+      // only the merged sums are left to resolve
+      rt::Accumulation accumulation{};
+      rt::RenderFarm::Render(workers, worker_timeout, scene, settings,
+                             accumulation);
+
+      renderer.SetSettings(settings);
+      renderer.LoadAccumulation(accumulation);
+    }
+    renderer.RequestRender();
+
+    const rt::Framebuffer* framebuffer = renderer.WaitForFramebuffer();
+    rt::ImageWriter::Write(output, *framebuffer);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    const auto total_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - begin)
+            .count();
+    if (!checkpoint_path.empty()) {
+      std::clog << "Rendered " << settings.width << " * " << settings.height
+                << " at " << renderer.GetAccumulatedSamples()
+                << " spp with checkpoints in " << total_time
+                << "ms: " << output << '\n';
+    } else if (workers.empty()) {
+      std::clog << "Rendered " << settings.width << " * " << settings.height
+                << " at " << settings.samples_per_pixel << " spp in "
+                << renderer.GetPassTime() << "ms, " << total_time
+                << "ms total: " << output << '\n';
+    } else {
+      std::clog << "Rendered " << settings.width << " * " << settings.height
+                << " at " << settings.samples_per_pixel << " spp on "
+                << workers.size() << " workers in " << total_time
+                << "ms: " << output << '\n';
+    }
+
+    if (!stats_path.empty()) {
+      const rt::RenderStats stats = renderer.GetStats();
+
+      if ("-" == stats_path) {
+        stats.WriteJson(std::cout);
+        std::cout << '\n';
+      } else {
+        std::ofstream file(stats_path);
+        if (!file) {
+          throw std::runtime_error("Error::Headless: Failed to open " +
+                                   stats_path + "!");
+        }
+        stats.WriteJson(file);
+        file << '\n';
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
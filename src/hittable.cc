@@ -0,0 +1,42 @@
+/**
+ * @file hittable.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "hittable.h"
+
+#include <cstdint>
+
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+bool Hittable::Occluded(const Ray& ray, float t_min, float t_max) const {
+  HitRecord record{};
+
+  return Hit(ray, t_min, t_max, record);
+}
+
+void Hittable::HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const {
+  HitRecord record{};
+
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (!(mask & (1u << lane))) {
+      continue;
+    }
+
+    if (Hit(packet.GetRay(lane), packet.t_min, hit.t[lane], record)) {
+      hit.t[lane] = record.t;
+      hit.object[lane] = this;
+    }
+  }
+}
+
+}  // namespace rt
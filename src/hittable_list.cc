@@ -10,17 +10,21 @@
  */
 #include "hittable_list.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "aabb.h"
 #include "hittable.h"
 #include "ray.h"
+#include "ray_packet.h"
 
 namespace rt {
 
 HittableList::HittableList(std::shared_ptr<Hittable> object) { Add(object); }
 
-std::vector<std::shared_ptr<Hittable> > HittableList::GetObjects() {
+const std::vector<std::shared_ptr<Hittable> >& HittableList::GetObjects()
+    const {
   return objects_;
 }
 
@@ -34,17 +38,44 @@ bool HittableList::Hit(const Ray& ray, float t_min, float t_max,
                        HitRecord& record) const {
   bool hit_anything = false;
   float closest_so_far = t_max;
-  HitRecord temp_record{};
 
   for (const auto& object : objects_) {
-    if (object->Hit(ray, t_min, closest_so_far, temp_record)) {
+    // objects only write the record on a successful hit
+    if (object->Hit(ray, t_min, closest_so_far, record)) {
       hit_anything = true;
-      closest_so_far = temp_record.t;
-      record = temp_record;
+      closest_so_far = record.t;
     }
   }
 
   return hit_anything;
 }
 
+bool HittableList::Occluded(const Ray& ray, float t_min,
+                            float t_max) const {
+  for (const auto& object : objects_) {
+    if (object->Occluded(ray, t_min, t_max)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void HittableList::HitPacket(const RayPacket& packet, uint32_t mask,
+                             PacketHit& hit) const {
+  for (const auto& object : objects_) {
+    object->HitPacket(packet, mask, hit);
+  }
+}
+
+Aabb HittableList::BoundingBox() const {
+  Aabb box{};
+
+  for (const auto& object : objects_) {
+    box.Expand(object->BoundingBox());
+  }
+
+  return box;
+}
+
 }  // namespace rt
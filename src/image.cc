@@ -10,6 +10,9 @@
  */
 #include "image.h"
 
+#include <cstring>
+#include <vector>
+
 #include <vulkan/vulkan.h>
 
 #define RAY_TRACING_INCLUDE_IMGUI
@@ -45,6 +48,8 @@ Image::Image(uint32_t width, uint32_t height, VkPhysicalDevice& physical_device,
 }
 
 Image::~Image() {
+  ImGui_ImplVulkan_RemoveTexture(descriptor_set_);
+  DestroyStagingBuffers();
   vkDestroySampler(device_, texture_sampler_, nullptr);
   vkDestroyImageView(device_, texture_image_view_, nullptr);
   vkDestroyImage(device_, texture_image_, nullptr);
@@ -67,8 +72,9 @@ void Image::CreateTextureImage() {
   image_info.arrayLayers = 1;
   image_info.samples = VK_SAMPLE_COUNT_1_BIT;
   image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-  image_info.usage =
-      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT |
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                     VK_IMAGE_USAGE_STORAGE_BIT;
   image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -138,46 +144,137 @@ void Image::CreateDescriptorSet() {
                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
+void Image::CreateStagingBuffers() {
+  VkDeviceSize image_size = static_cast<VkDeviceSize>(width_) * height_ * 4;
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    Utils::CreateBuffer(physical_device_, device_, image_size,
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        staging_buffers_[i], staging_buffer_memories_[i]);
+
+    VkResult result = vkMapMemory(device_, staging_buffer_memories_[i], 0,
+                                  image_size, 0, &staging_maps_[i]);
+    Utils::CheckVulkanResult(result,
+                             "Error::Vulkan: Failed to map staging buffer!");
+  }
+}
+
+void Image::DestroyStagingBuffers() {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (staging_maps_[i]) {
+      vkUnmapMemory(device_, staging_buffer_memories_[i]);
+      staging_maps_[i] = nullptr;
+    }
+
+    vkDestroyBuffer(device_, staging_buffers_[i], nullptr);
+    vkFreeMemory(device_, staging_buffer_memories_[i], nullptr);
+    staging_buffers_[i] = VK_NULL_HANDLE;
+    staging_buffer_memories_[i] = VK_NULL_HANDLE;
+  }
+}
+
 void Image::SetData(const void* data) {
-  size_t image_size = width_ * height_ * 4;
+  VkRect2D region{};
+  region.extent = {width_, height_};
 
-  // create staging buffer
-  VkBuffer staging_buffer;
-  VkDeviceMemory staging_buffer_memory;
+  dirty_regions_.clear();
+  SetData(data, region);
+}
 
-  Utils::CreateBuffer(physical_device_, device_, image_size,
-                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                      staging_buffer, staging_buffer_memory);
+void Image::SetData(const void* data, const VkRect2D& region) {
+  pending_data_ = data;
+  dirty_regions_.push_back(region);
+}
 
-  VkMemoryRequirements mem_requirements{};
-  vkGetBufferMemoryRequirements(device_, staging_buffer, &mem_requirements);
-
-  // map data to memory
-  void* map;
-  vkMapMemory(device_, staging_buffer_memory, 0, image_size, 0, &map);
-  memcpy(map, data, static_cast<size_t>(image_size));
-  VkMappedMemoryRange range[1]{};
-  range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  range[0].memory = staging_buffer_memory;
-  range[0].size = mem_requirements.size;
-  vkFlushMappedMemoryRanges(device_, 1, range);
-  vkUnmapMemory(device_, staging_buffer_memory);
-
-  Utils::TransitionImageLayout(device_, graphics_queue_, command_pool_,
-                               texture_image_, VK_IMAGE_LAYOUT_UNDEFINED,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  Utils::CopyBufferToImage(
-      device_, graphics_queue_, command_pool_, staging_buffer, texture_image_,
-      static_cast<uint32_t>(width_), static_cast<uint32_t>(height_));
-  Utils::TransitionImageLayout(device_, graphics_queue_, command_pool_,
-                               texture_image_,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-  vkDestroyBuffer(device_, staging_buffer, nullptr);
-  vkFreeMemory(device_, staging_buffer_memory, nullptr);
+void Image::RecordUpload(VkCommandBuffer command_buffer,
+                         uint32_t frame_index) {
+  if (!pending_data_ || dirty_regions_.empty()) {
+    return;
+  }
+
+  // the first upload has to define every texel
+  if (!is_initialized_) {
+    VkRect2D region{};
+    region.extent = {width_, height_};
+
+    dirty_regions_.assign(1, region);
+  }
+
+  if (!staging_maps_[frame_index]) {
+    CreateStagingBuffers();
+  }
+
+  // staging buffer has the same layout as the image
+  const size_t row_pitch = static_cast<size_t>(width_) * 4;
+  auto src = static_cast<const unsigned char*>(pending_data_);
+  auto dst = static_cast<unsigned char*>(staging_maps_[frame_index]);
+
+  std::vector<VkBufferImageCopy> copy_regions{};
+  copy_regions.reserve(dirty_regions_.size());
+
+  for (const auto& region : dirty_regions_) {
+    const size_t x = static_cast<size_t>(region.offset.x);
+    const size_t y = static_cast<size_t>(region.offset.y);
+    const size_t row_size = static_cast<size_t>(region.extent.width) * 4;
+
+    for (uint32_t row = 0; row < region.extent.height; ++row) {
+      size_t offset = (y + row) * row_pitch + x * 4;
+      memcpy(dst + offset, src + offset, row_size);
+    }
+
+    VkBufferImageCopy copy_region{};
+    copy_region.bufferOffset = y * row_pitch + x * 4;
+    copy_region.bufferRowLength = width_;
+    copy_region.bufferImageHeight = height_;
+    copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_region.imageSubresource.mipLevel = 0;
+    copy_region.imageSubresource.baseArrayLayer = 0;
+    copy_region.imageSubresource.layerCount = 1;
+    copy_region.imageOffset = {region.offset.x, region.offset.y, 0};
+    copy_region.imageExtent = {region.extent.width, region.extent.height, 1};
+
+    copy_regions.push_back(copy_region);
+  }
+
+  Utils::RecordImageLayoutTransition(
+      command_buffer, texture_image_,
+      is_initialized_ ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                      : VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  vkCmdCopyBufferToImage(command_buffer, staging_buffers_[frame_index],
+                         texture_image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(copy_regions.size()),
+                         copy_regions.data());
+  Utils::RecordImageLayoutTransition(command_buffer, texture_image_,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  is_initialized_ = true;
+  pending_data_ = nullptr;
+  dirty_regions_.clear();
+}
+
+void Image::RecordStorageBegin(VkCommandBuffer command_buffer,
+                               VkPipelineStageFlags shader_stage) {
+  Utils::RecordImageLayoutTransition(
+      command_buffer, texture_image_,
+      is_initialized_ ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                      : VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_GENERAL, shader_stage);
+}
+
+void Image::RecordStorageEnd(VkCommandBuffer command_buffer,
+                             VkPipelineStageFlags shader_stage) {
+  Utils::RecordImageLayoutTransition(
+      command_buffer, texture_image_, VK_IMAGE_LAYOUT_GENERAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shader_stage);
+
+  // shader writes replace any upload still pending
+  is_initialized_ = true;
+  pending_data_ = nullptr;
+  dirty_regions_.clear();
 }
 
 void Image::Resize(uint32_t width, uint32_t height) {
@@ -188,6 +285,7 @@ void Image::Resize(uint32_t width, uint32_t height) {
   width_ = width;
   height_ = height;
 
+  DestroyStagingBuffers();
   vkDestroySampler(device_, texture_sampler_, nullptr);
   vkDestroyImageView(device_, texture_image_view_, nullptr);
   vkDestroyImage(device_, texture_image_, nullptr);
@@ -196,12 +294,18 @@ void Image::Resize(uint32_t width, uint32_t height) {
   CreateTextureImage();
   CreateTextureImageView();
   CreateTextureSampler();
+
+  is_initialized_ = false;
+  pending_data_ = nullptr;
+  dirty_regions_.clear();
 }
 
 uint32_t Image::GetWidth() const { return width_; }
 
 uint32_t Image::GetHeight() const { return height_; }
 
+VkImageView Image::GetImageView() const { return texture_image_view_; }
+
 VkDescriptorSet Image::GetDescritorSet() const { return descriptor_set_; }
 
 }  // namespace rt
\ No newline at end of file
@@ -0,0 +1,338 @@
+/**
+ * @file image_writer.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+
+namespace rt {
+
+namespace {
+
+// all formats below are written byte by byte, independent of host endianness
+void PutU8(std::vector<uint8_t>& bytes, uint32_t value) {
+  bytes.push_back(static_cast<uint8_t>(value & 0xffu));
+}
+
+void PutU16LE(std::vector<uint8_t>& bytes, uint32_t value) {
+  PutU8(bytes, value);
+  PutU8(bytes, value >> 8);
+}
+
+void PutU32LE(std::vector<uint8_t>& bytes, uint32_t value) {
+  PutU16LE(bytes, value);
+  PutU16LE(bytes, value >> 16);
+}
+
+void PutU64LE(std::vector<uint8_t>& bytes, uint64_t value) {
+  PutU32LE(bytes, static_cast<uint32_t>(value));
+  PutU32LE(bytes, static_cast<uint32_t>(value >> 32));
+}
+
+void PutU32BE(std::vector<uint8_t>& bytes, uint32_t value) {
+  PutU8(bytes, value >> 24);
+  PutU8(bytes, value >> 16);
+  PutU8(bytes, value >> 8);
+  PutU8(bytes, value);
+}
+
+void PutF32LE(std::vector<uint8_t>& bytes, float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  PutU32LE(bytes, bits);
+}
+
+void PutString(std::vector<uint8_t>& bytes, const char* value) {
+  // including the terminating zero
+  bytes.insert(bytes.end(), value, value + std::strlen(value) + 1);
+}
+
+// exr header attribute: name, type, size, then the value written by caller
+void PutExrAttribute(std::vector<uint8_t>& bytes, const char* name,
+                     const char* type, uint32_t size) {
+  PutString(bytes, name);
+  PutString(bytes, type);
+  PutU32LE(bytes, size);
+}
+
+void CheckRadiance(uint32_t width, uint32_t height,
+                   const std::vector<glm::vec3>& radiance) {
+  if (radiance.size() != static_cast<size_t>(width) * height) {
+    throw std::runtime_error(
+        "Error::ImageWriter: Radiance buffer does not match image size!");
+  }
+}
+
+}  // namespace
+
+ImageFormat ImageWriter::GetFormat(const std::string& path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) {
+    return ImageFormat::PNG;
+  }
+
+  std::string extension = path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (extension == "pfm") {
+    return ImageFormat::PFM;
+  }
+  if (extension == "exr") {
+    return ImageFormat::EXR;
+  }
+
+  return ImageFormat::PNG;
+}
+
+bool ImageWriter::IsHdr(ImageFormat format) {
+  return format == ImageFormat::PFM || format == ImageFormat::EXR;
+}
+
+void ImageWriter::Write(const std::string& path,
+                        const Framebuffer& framebuffer) {
+  switch (GetFormat(path)) {
+    case ImageFormat::PFM:
+      WritePfm(path, framebuffer.width, framebuffer.height,
+               framebuffer.radiance);
+      break;
+    case ImageFormat::EXR:
+      WriteExr(path, framebuffer.width, framebuffer.height,
+               framebuffer.radiance);
+      break;
+    default:
+      WritePng(path, framebuffer.width, framebuffer.height,
+               framebuffer.pixels);
+      break;
+  }
+}
+
+void ImageWriter::WritePng(const std::string& path, uint32_t width,
+                           uint32_t height,
+                           const std::vector<uint32_t>& pixels) {
+  if (pixels.size() != static_cast<size_t>(width) * height) {
+    throw std::runtime_error(
+        "Error::ImageWriter: Pixel buffer does not match image size!");
+  }
+
+  // scanlines with filter type none, pixels are packed as 0xAABBGGRR
+  std::vector<uint8_t> raw{};
+  raw.reserve((static_cast<size_t>(width) * 4 + 1) * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    raw.push_back(0);
+    for (uint32_t x = 0; x < width; ++x) {
+      PutU32LE(raw, pixels[static_cast<size_t>(y) * width + x]);
+    }
+  }
+
+  // zlib stream of stored deflate blocks
+  std::vector<uint8_t> zlib{0x78, 0x01};
+  const size_t MAX_BLOCK = 65535;
+  size_t offset = 0;
+  do {
+    size_t length = std::min(MAX_BLOCK, raw.size() - offset);
+    bool is_final = offset + length == raw.size();
+
+    PutU8(zlib, is_final ? 1u : 0u);
+    PutU16LE(zlib, static_cast<uint32_t>(length));
+    PutU16LE(zlib, static_cast<uint32_t>(~length & 0xffffu));
+    zlib.insert(zlib.end(), raw.begin() + offset,
+                raw.begin() + offset + length);
+
+    offset += length;
+  } while (offset < raw.size());
+
+  // adler-32 of the uncompressed data
+  uint32_t a = 1u;
+  uint32_t b = 0u;
+  for (uint8_t byte : raw) {
+    a = (a + byte) % 65521u;
+    b = (b + a) % 65521u;
+  }
+  PutU32BE(zlib, (b << 16) | a);
+
+  std::vector<uint8_t> bytes{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  auto put_chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+    PutU32BE(bytes, static_cast<uint32_t>(data.size()));
+
+    size_t start = bytes.size();
+    bytes.insert(bytes.end(), type, type + 4);
+    bytes.insert(bytes.end(), data.begin(), data.end());
+
+    PutU32BE(bytes, Crc32(bytes.data() + start, bytes.size() - start));
+  };
+
+  // 8-bit RGBA, default compression, filter and no interlace
+  std::vector<uint8_t> header{};
+  PutU32BE(header, width);
+  PutU32BE(header, height);
+  header.insert(header.end(), {8, 6, 0, 0, 0});
+
+  put_chunk("IHDR", header);
+  put_chunk("IDAT", zlib);
+  put_chunk("IEND", {});
+
+  WriteFile(path, bytes);
+}
+
+void ImageWriter::WritePfm(const std::string& path, uint32_t width,
+                           uint32_t height,
+                           const std::vector<glm::vec3>& radiance) {
+  CheckRadiance(width, height, radiance);
+
+  // negative scale marks little-endian data
+  std::string header = "PF\n" + std::to_string(width) + " " +
+                       std::to_string(height) + "\n-1.0\n";
+
+  std::vector<uint8_t> bytes(header.begin(), header.end());
+  bytes.reserve(bytes.size() + radiance.size() * 12);
+
+  for (uint32_t row = 0; row < height; ++row) {
+    const size_t y = height - 1 - row;
+    for (uint32_t x = 0; x < width; ++x) {
+      const glm::vec3& color = radiance[y * width + x];
+      PutF32LE(bytes, color.r);
+      PutF32LE(bytes, color.g);
+      PutF32LE(bytes, color.b);
+    }
+  }
+
+  WriteFile(path, bytes);
+}
+
+void ImageWriter::WriteExr(const std::string& path, uint32_t width,
+                           uint32_t height,
+                           const std::vector<glm::vec3>& radiance) {
+  CheckRadiance(width, height, radiance);
+
+  const uint32_t FLOAT_PIXEL = 2u;
+  // channels must be listed in alphabetical order
+  const char* const channels[3] = {"B", "G", "R"};
+  const int channel_components[3] = {2, 1, 0};
+
+  std::vector<uint8_t> bytes{};
+  PutU32LE(bytes, 20000630u);
+  // single part scanline file
+  PutU32LE(bytes, 2u);
+
+  PutExrAttribute(bytes, "channels", "chlist", 3 * 18 + 1);
+  for (const char* channel : channels) {
+    PutString(bytes, channel);
+    PutU32LE(bytes, FLOAT_PIXEL);
+    // linear flag and reserved bytes
+    PutU32LE(bytes, 0u);
+    // x and y sampling
+    PutU32LE(bytes, 1u);
+    PutU32LE(bytes, 1u);
+  }
+  PutU8(bytes, 0u);
+
+  PutExrAttribute(bytes, "compression", "compression", 1);
+  PutU8(bytes, 0u);
+
+  for (const char* window : {"dataWindow", "displayWindow"}) {
+    PutExrAttribute(bytes, window, "box2i", 16);
+    PutU32LE(bytes, 0u);
+    PutU32LE(bytes, 0u);
+    PutU32LE(bytes, width - 1);
+    PutU32LE(bytes, height - 1);
+  }
+
+  PutExrAttribute(bytes, "lineOrder", "lineOrder", 1);
+  PutU8(bytes, 0u);
+
+  PutExrAttribute(bytes, "pixelAspectRatio", "float", 4);
+  PutF32LE(bytes, 1.f);
+
+  PutExrAttribute(bytes, "screenWindowCenter", "v2f", 8);
+  PutF32LE(bytes, 0.f);
+  PutF32LE(bytes, 0.f);
+
+  PutExrAttribute(bytes, "screenWindowWidth", "float", 4);
+  PutF32LE(bytes, 1.f);
+
+  // end of header
+  PutU8(bytes, 0u);
+
+  // one chunk per scanline: y, byte count, then every channel of the line
+  const uint64_t line_size = static_cast<uint64_t>(width) * 3 * 4;
+  const uint64_t chunk_size = 8 + line_size;
+  const uint64_t first_chunk =
+      bytes.size() + static_cast<uint64_t>(height) * 8;
+  for (uint32_t y = 0; y < height; ++y) {
+    PutU64LE(bytes, first_chunk + y * chunk_size);
+  }
+
+  bytes.reserve(bytes.size() + height * chunk_size);
+  for (uint32_t y = 0; y < height; ++y) {
+    PutU32LE(bytes, y);
+    PutU32LE(bytes, static_cast<uint32_t>(line_size));
+
+    for (int component : channel_components) {
+      for (uint32_t x = 0; x < width; ++x) {
+        const size_t pixel = static_cast<size_t>(y) * width + x;
+        PutF32LE(bytes, radiance[pixel][component]);
+      }
+    }
+  }
+
+  WriteFile(path, bytes);
+}
+
+uint32_t ImageWriter::Crc32(const uint8_t* data, size_t size, uint32_t crc) {
+  static const std::vector<uint32_t> table = []() {
+    std::vector<uint32_t> entries(256);
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1u) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      entries[n] = c;
+    }
+    return entries;
+  }();
+
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xffu] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+void ImageWriter::WriteFile(const std::string& path,
+                            const std::vector<uint8_t>& bytes) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Error::ImageWriter: Failed to open " + path +
+                             "!");
+  }
+
+  file.write(reinterpret_cast<const char*>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    throw std::runtime_error("Error::ImageWriter: Failed to write " + path +
+                             "!");
+  }
+}
+
+}  // namespace rt
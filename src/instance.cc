@@ -0,0 +1,120 @@
+/**
+ * @file instance.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "instance.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+Instance::Instance(std::shared_ptr<const Hittable> geometry,
+                   const glm::mat4& object_to_world)
+    : geometry_{std::move(geometry)} {
+  SetTransform(object_to_world);
+}
+
+void Instance::SetTransform(const glm::mat4& object_to_world) {
+  object_to_world_ = object_to_world;
+  world_to_object_ = glm::inverse(object_to_world);
+  normal_to_world_ = glm::transpose(glm::mat3(world_to_object_));
+
+  // world box around the transformed corners of the object box
+  box_ = Aabb{};
+  const Aabb object_box = geometry_->BoundingBox();
+  if (object_box.IsEmpty()) {
+    return;
+  }
+
+  const glm::vec3 corners[2] = {object_box.GetMin(), object_box.GetMax()};
+  for (int i = 0; i < 8; ++i) {
+    glm::vec4 corner(corners[i & 1].x, corners[(i >> 1) & 1].y,
+                     corners[(i >> 2) & 1].z, 1.f);
+    glm::vec4 world_corner = object_to_world_ * corner;
+    box_.Expand(glm::vec3(world_corner.x, world_corner.y, world_corner.z));
+  }
+}
+
+bool Instance::Hit(const Ray& ray, float t_min, float t_max,
+                   HitRecord& record) const {
+  if (!geometry_->Hit(ToObject(ray), t_min, t_max, record)) {
+    return false;
+  }
+
+  // front face is invariant under the transform, only the vectors move
+  record.point = ray.At(record.t);
+  record.normal = glm::normalize(normal_to_world_ * record.normal);
+
+  return true;
+}
+
+bool Instance::Occluded(const Ray& ray, float t_min, float t_max) const {
+  return geometry_->Occluded(ToObject(ray), t_min, t_max);
+}
+
+void Instance::HitPacket(const RayPacket& packet, uint32_t mask,
+                         PacketHit& hit) const {
+  mask &= packet.mask;
+  if (!mask) {
+    return;
+  }
+
+  // lanes go through ToObject just like Hit so both find the same t
+  RayPacket object_packet{};
+  object_packet.t_min = packet.t_min;
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (mask & (1u << lane)) {
+      object_packet.SetRay(lane, ToObject(packet.GetRay(lane)));
+    }
+  }
+
+  PacketHit object_hit = hit;
+  geometry_->HitPacket(object_packet, mask, object_hit);
+
+  // the record of any lane that moved is rebuilt through the instance
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (object_hit.object[lane] != hit.object[lane] ||
+        object_hit.t[lane] != hit.t[lane]) {
+      hit.t[lane] = object_hit.t[lane];
+      hit.object[lane] = this;
+    }
+  }
+}
+
+Aabb Instance::BoundingBox() const { return box_; }
+
+const std::shared_ptr<const Hittable>& Instance::GetGeometry() const {
+  return geometry_;
+}
+
+glm::mat4 Instance::GetTransform() const { return object_to_world_; }
+
+Ray Instance::ToObject(const Ray& ray) const {
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+
+  glm::vec4 object_origin = world_to_object_ * glm::vec4(origin, 1.f);
+  glm::vec4 object_direction = world_to_object_ * glm::vec4(direction, 0.f);
+
+  return Ray(glm::vec3(object_origin.x, object_origin.y, object_origin.z),
+             glm::vec3(object_direction.x, object_direction.y,
+                       object_direction.z));
+}
+
+}  // namespace rt
@@ -14,27 +14,30 @@
 
 #include "hittable.h"
 #include "material.h"
+#include "material_data.h"
 #include "ray.h"
-#include "utils.h"
+#include "sampler.h"
 
 namespace rt {
 
-Lambertian::Lambertian(const glm::vec3& color) : albedo_{color} {}
+Lambertian::Lambertian(const glm::vec3& color)
+    : Material(MaterialData{color, 0.f, MaterialKind::LAMBERTIAN, 1.f}) {}
 
 bool Lambertian::Scatter(const Ray& ray, const HitRecord& record,
-                         glm::vec3& attenuation, Ray& scattered) const {
-  glm::vec3 scatter_direction =
-      glm::reflect(glm::normalize(ray.GetDirection()), record.normal) +
-      glm::normalize(Utils::RandomVec3());
+                         glm::vec3& attenuation, Ray& scattered,
+                         Sampler& sampler) const {
+  (void)ray;
 
-  if (Utils::NearZero(scatter_direction)) {
-    scatter_direction = record.normal;
-  }
+  return MaterialShading::ScatterLambertian(GetData(), record, attenuation,
+                                            scattered, sampler);
+}
 
-  scattered = Ray(record.point, scatter_direction);
-  attenuation = albedo_;
+glm::vec3 Lambertian::Evaluate(const Ray& ray, const HitRecord& record,
+                               const glm::vec3& direction, float& pdf) const {
+  (void)ray;
 
-  return true;
+  return MaterialShading::EvaluateLambertian(GetData(), record, direction,
+                                             pdf);
 }
 
 }  // namespace rt
@@ -0,0 +1,222 @@
+/**
+ * @file light_list.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "light_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "math_utils.h"
+#include "sampler.h"
+#include "triangle_mesh.h"
+
+namespace rt {
+
+namespace {
+
+// index of the light whose slice of the running sums holds value
+uint32_t FindLight(const std::vector<float>& powers, float value) {
+  const size_t index =
+      std::upper_bound(powers.begin(), powers.end(), value) - powers.begin();
+
+  return static_cast<uint32_t>(std::min(index, powers.size() - 1));
+}
+
+}  // namespace
+
+void LightList::Clear() {
+  spheres_.clear();
+  triangles_.clear();
+  sphere_powers_.clear();
+  triangle_powers_.clear();
+  sphere_power_ = 0.f;
+  power_ = 0.f;
+}
+
+void LightList::AddSphere(const glm::vec3& center, float radius,
+                          const glm::vec3& radiance) {
+  const float luminance = MathUtils::Luminance(radiance);
+  if (radius <= 0.f || luminance <= 0.f) {
+    return;
+  }
+
+  // only the half facing the shaded point is ever sampled
+  const float power = 2.f * PI * radius * radius * luminance;
+  sphere_power_ += power;
+  power_ += power;
+
+  spheres_.push_back({center, radius, radiance});
+  sphere_powers_.push_back(sphere_power_);
+}
+
+void LightList::AddMesh(const TriangleMesh& mesh,
+                        const glm::mat4& object_to_world,
+                        const glm::vec3& radiance) {
+  const float luminance = MathUtils::Luminance(radiance);
+  if (luminance <= 0.f) {
+    return;
+  }
+
+  const std::vector<glm::vec3>& positions = mesh.GetPositions();
+  const std::vector<glm::vec3>& normals = mesh.GetNormals();
+  const std::vector<uint32_t>& indices = mesh.GetIndices();
+
+  // normals move like in Instance, which keeps the emitting side under
+  // mirroring transforms
+  const glm::mat3 normal_to_world =
+      glm::transpose(glm::mat3(glm::inverse(object_to_world)));
+  auto to_world = [&](const glm::vec3& position) {
+    glm::vec4 world = object_to_world * glm::vec4(position, 1.f);
+    return glm::vec3(world.x, world.y, world.z);
+  };
+
+  float triangle_power =
+      triangle_powers_.empty() ? 0.f : triangle_powers_.back();
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const glm::vec3& o0 = positions[indices[i]];
+    const glm::vec3& o1 = positions[indices[i + 1]];
+    const glm::vec3& o2 = positions[indices[i + 2]];
+
+    TriangleLight light{};
+    light.p0 = to_world(o0);
+    light.edge1 = to_world(o1) - light.p0;
+    light.edge2 = to_world(o2) - light.p0;
+    light.radiance = radiance;
+
+    const float area = 0.5f * glm::length(glm::cross(light.edge1, light.edge2));
+    const glm::vec3 object_normal = glm::cross(o1 - o0, o2 - o0);
+    if (area <= 0.f || MathUtils::NearZero(object_normal)) {
+      continue;
+    }
+
+    light.geometric_normal =
+        glm::normalize(normal_to_world * glm::normalize(object_normal));
+    if (!normals.empty()) {
+      for (int k = 0; k < 3; ++k) {
+        light.normals[k] =
+            glm::normalize(normal_to_world * normals[indices[i + k]]);
+      }
+    }
+
+    const float power = area * luminance;
+    triangle_power += power;
+    power_ += power;
+
+    triangles_.push_back(light);
+    triangle_powers_.push_back(triangle_power);
+  }
+}
+
+bool LightList::IsEmpty() const { return power_ <= 0.f; }
+
+uint32_t LightList::GetCount() const {
+  return static_cast<uint32_t>(spheres_.size() + triangles_.size());
+}
+
+bool LightList::Sample(const glm::vec3& origin, Sampler& sampler,
+                       LightSample& sample) const {
+  if (IsEmpty()) {
+    return false;
+  }
+
+  const float value = MathUtils::RandomFloat(sampler, 0.f, power_);
+  if (value < sphere_power_) {
+    return SampleSphere(spheres_[FindLight(sphere_powers_, value)], origin,
+                        sampler, sample);
+  }
+
+  return SampleTriangle(
+      triangles_[FindLight(triangle_powers_, value - sphere_power_)], origin,
+      sampler, sample);
+}
+
+float LightList::GetPdf(const glm::vec3& origin, const glm::vec3& point,
+                        const glm::vec3& normal,
+                        const glm::vec3& radiance) const {
+  const glm::vec3 to_origin = origin - point;
+  const float distance_squared = glm::dot(to_origin, to_origin);
+  const float cosine =
+      std::abs(glm::dot(normal, to_origin)) / std::sqrt(distance_squared);
+
+  if (IsEmpty() || !(cosine > 0.f)) {
+    return 0.f;
+  }
+
+  return MathUtils::Luminance(radiance) / power_ * distance_squared / cosine;
+}
+
+bool LightList::SampleSphere(const SphereLight& light,
+                             const glm::vec3& origin, Sampler& sampler,
+                             LightSample& sample) const {
+  glm::vec3 axis = origin - light.center;
+  const float distance = glm::length(axis);
+  if (distance <= light.radius) {
+    return false;
+  }
+  axis /= distance;
+
+  // uniform over the hemisphere facing origin, z is uniform in area
+  glm::vec3 u{};
+  glm::vec3 v{};
+  MathUtils::MakeBasis(axis, u, v);
+
+  const float z = MathUtils::RandomFloat(sampler);
+  const float phi = MathUtils::RandomFloat(sampler, 0.f, 2.f * PI);
+  const float r = std::sqrt(std::max(1.f - z * z, 0.f));
+  const glm::vec3 normal =
+      r * std::cos(phi) * u + r * std::sin(phi) * v + z * axis;
+
+  sample.point = light.center + light.radius * normal;
+  sample.normal = normal;
+  sample.radiance = light.radiance;
+
+  // the rim of the hemisphere hides behind the front of the sphere
+  sample.pdf = GetPdf(origin, sample.point, normal, light.radiance);
+  return glm::dot(normal, origin - sample.point) > 0.f && sample.pdf > 0.f;
+}
+
+bool LightList::SampleTriangle(const TriangleLight& light,
+                               const glm::vec3& origin, Sampler& sampler,
+                               LightSample& sample) const {
+  // uniform in area
+  const float root = std::sqrt(MathUtils::RandomFloat(sampler));
+  const float t = MathUtils::RandomFloat(sampler);
+  const glm::vec3 barycentric(1.f - root, root * (1.f - t), root * t);
+
+  sample.point =
+      light.p0 + barycentric.y * light.edge1 + barycentric.z * light.edge2;
+  sample.radiance = light.radiance;
+
+  // only the geometric normal gives the true density
+  const glm::vec3 to_origin = origin - sample.point;
+  if (glm::dot(light.geometric_normal, to_origin) <= 0.f) {
+    return false;
+  }
+  sample.pdf =
+      GetPdf(origin, sample.point, light.geometric_normal, light.radiance);
+
+  sample.normal = light.geometric_normal;
+  if (!MathUtils::NearZero(light.normals[0])) {
+    sample.normal = glm::normalize(barycentric.x * light.normals[0] +
+                                   barycentric.y * light.normals[1] +
+                                   barycentric.z * light.normals[2]);
+  }
+
+  return sample.pdf > 0.f;
+}
+
+}  // namespace rt
@@ -0,0 +1,228 @@
+/**
+ * @file mapped_file.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rt {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Error::MappedFile: Failed to open " + path +
+                             "!");
+  }
+  file_ = file;
+
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Error::MappedFile: Failed to stat " + path +
+                             "!");
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+
+  // empty files cannot be mapped
+  if (!size_) {
+    return;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                       : nullptr;
+  if (!data) {
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    throw std::runtime_error("Error::MappedFile: Failed to map " + path +
+                             "!");
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<uint8_t*>(data);
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size)
+    : size_{size}, is_writable_{true} {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                            nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Error::MappedFile: Failed to create " + path +
+                             "!");
+  }
+  file_ = file;
+
+  // empty files cannot be mapped
+  if (!size_) {
+    return;
+  }
+
+  // the mapping grows the file to its size
+  const uint64_t mapped_size = size_;
+  HANDLE mapping = CreateFileMappingA(
+      file, nullptr, PAGE_READWRITE, static_cast<DWORD>(mapped_size >> 32),
+      static_cast<DWORD>(mapped_size & 0xffffffffu), nullptr);
+  void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0)
+                       : nullptr;
+  if (!data) {
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    throw std::runtime_error("Error::MappedFile: Failed to map " + path +
+                             "!");
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+}
+
+void MappedFile::Flush() {
+  if (!is_writable_ || !data_) {
+    return;
+  }
+
+  if (!FlushViewOfFile(data_, 0) || !FlushFileBuffers(file_)) {
+    throw std::runtime_error("Error::MappedFile: Failed to flush!");
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Error::MappedFile: Failed to open " + path +
+                             "!");
+  }
+
+  struct stat status {};
+  if (fstat(file, &status) < 0) {
+    close(file);
+    throw std::runtime_error("Error::MappedFile: Failed to stat " + path +
+                             "!");
+  }
+  size_ = static_cast<size_t>(status.st_size);
+
+  // empty files cannot be mapped
+  if (!size_) {
+    close(file);
+    return;
+  }
+
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+  // the mapping keeps its own reference to the file
+  close(file);
+
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Error::MappedFile: Failed to map " + path +
+                             "!");
+  }
+
+  // whole file is read front to back by the loaders
+  madvise(data, size_, MADV_SEQUENTIAL);
+
+  data_ = static_cast<uint8_t*>(data);
+}
+
+MappedFile::MappedFile(const std::string& path, size_t size)
+    : size_{size}, is_writable_{true} {
+  int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file < 0) {
+    throw std::runtime_error("Error::MappedFile: Failed to create " + path +
+                             "!");
+  }
+
+  // empty files cannot be mapped
+  if (!size_) {
+    close(file);
+    return;
+  }
+
+  if (ftruncate(file, static_cast<off_t>(size_)) < 0) {
+    close(file);
+    throw std::runtime_error("Error::MappedFile: Failed to resize " + path +
+                             "!");
+  }
+
+  void* data =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  // the mapping keeps its own reference to the file
+  close(file);
+
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Error::MappedFile: Failed to map " + path +
+                             "!");
+  }
+
+  data_ = static_cast<uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+void MappedFile::Flush() {
+  if (!is_writable_ || !data_) {
+    return;
+  }
+
+  if (msync(data_, size_, MS_SYNC) < 0) {
+    throw std::runtime_error("Error::MappedFile: Failed to flush!");
+  }
+}
+
+#endif
+
+const uint8_t* MappedFile::GetData() const { return data_; }
+
+uint8_t* MappedFile::GetMutableData() {
+  return is_writable_ ? data_ : nullptr;
+}
+
+size_t MappedFile::GetSize() const { return size_; }
+
+}  // namespace rt
@@ -0,0 +1,31 @@
+/**
+ * @file material_table.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "material_table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "material.h"
+
+namespace rt {
+
+void MaterialTable::Clear() {
+  materials_.clear();
+  data_.clear();
+  arena_.Reset();
+}
+
+uint32_t MaterialTable::GetCount() const {
+  return static_cast<uint32_t>(materials_.size());
+}
+
+}  // namespace rt
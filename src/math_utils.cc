@@ -0,0 +1,147 @@
+/**
+ * @file math_utils.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "math_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "sampler.h"
+
+namespace rt {
+
+uint32_t MathUtils::GetColor(const glm::vec3& color, int samples_per_pixel,
+                         float gamma) {
+  float scale = static_cast<float>(1.f / samples_per_pixel);
+
+  glm::vec3 RGB = glm::clamp(color * scale, glm::vec3(0.f), glm::vec3(1.f));
+
+  uint32_t R =
+      static_cast<uint32_t>(255.f * std::pow(RGB.r, 1.f / gamma) + 0.5f);
+  uint32_t G =
+      static_cast<uint32_t>(255.f * std::pow(RGB.g, 1.f / gamma) + 0.5f);
+  uint32_t B =
+      static_cast<uint32_t>(255.f * std::pow(RGB.b, 1.f / gamma) + 0.5f);
+
+  return (255 << 24) | (B << 16) | (G << 8) | R;
+}
+
+uint32_t MathUtils::GetColor(const glm::vec4& color, int samples_per_pixel,
+                         float gamma) {
+  float scale = static_cast<float>(1.f / samples_per_pixel);
+
+  glm::vec4 RGBA = glm::clamp(color * scale, glm::vec4(0.f), glm::vec4(1.f));
+
+  uint32_t R =
+      static_cast<uint32_t>(255.f * std::pow(RGBA.r, 1.f / gamma) + 0.5f);
+  uint32_t G =
+      static_cast<uint32_t>(255.f * std::pow(RGBA.g, 1.f / gamma) + 0.5f);
+  uint32_t B =
+      static_cast<uint32_t>(255.f * std::pow(RGBA.b, 1.f / gamma) + 0.5f);
+  // alpha is coverage, it stays linear
+  uint32_t A = static_cast<uint32_t>(255.f * RGBA.a + 0.5f);
+
+  return (A << 24) | (B << 16) | (G << 8) | R;
+}
+
+float MathUtils::RandomFloat(Sampler& sampler, float min, float max) {
+  return min + (max - min) * sampler.NextFloat();
+}
+
+glm::vec3 MathUtils::RandomVec3(Sampler& sampler, float min, float max) {
+  // evaluate in a fixed order, argument evaluation order is unspecified
+  float x = RandomFloat(sampler, min, max);
+  float y = RandomFloat(sampler, min, max);
+  float z = RandomFloat(sampler, min, max);
+
+  return glm::vec3(x, y, z);
+}
+
+float MathUtils::Luminance(const glm::vec3& color) {
+  return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+}
+
+float MathUtils::PowerHeuristic(float pdf, float other_pdf) {
+  const float ratio = other_pdf / pdf;
+
+  return 1.f / (1.f + ratio * ratio);
+}
+
+bool MathUtils::NearZero(const glm::vec3& vec) {
+  const float delta = static_cast<float>(1e-8);
+
+  return (std::fabs(vec.x) < delta) && (std::fabs(vec.y) < delta) &&
+         (std::fabs(vec.z) < delta);
+}
+
+glm::vec3 MathUtils::RandomInUnitSphere(Sampler& sampler) {
+  while (true) {
+    glm::vec3 point = MathUtils::RandomVec3(sampler, -1.f, 1.f);
+
+    if (glm::dot(point, point) >= 1) {
+      continue;
+    }
+
+    return point;
+  }
+}
+
+glm::vec3 MathUtils::RandomUnitVector(Sampler& sampler) {
+  float z = RandomFloat(sampler, -1.f, 1.f);
+  float phi = RandomFloat(sampler, 0.f, 2.f * PI);
+  float r = std::sqrt(std::max(1.f - z * z, 0.f));
+
+  return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+glm::vec3 MathUtils::RandomInHemiSphere(Sampler& sampler,
+                                     const glm::vec3& normal) {
+  glm::vec3 in_unit_sphere = RandomInUnitSphere(sampler);
+
+  // whether in current normal semi-sphere or not
+  if (glm::dot(in_unit_sphere, normal) > 0.f) {
+    return in_unit_sphere;
+  } else {
+    return -in_unit_sphere;
+  }
+}
+
+glm::vec3 MathUtils::RandomInUnitDisk(Sampler& sampler) {
+  while (true) {
+    float x = RandomFloat(sampler, -1.f, 1.f);
+    float y = RandomFloat(sampler, -1.f, 1.f);
+    glm::vec3 point(x, y, 0.f);
+
+    if (glm::dot(point, point) >= 1.f) {
+      continue;
+    }
+
+    return point;
+  }
+}
+
+float MathUtils::DegreesToRadians(float degree) { return PI / 180.f * degree; }
+
+void MathUtils::MakeBasis(const glm::vec3& w, glm::vec3& u, glm::vec3& v) {
+  // Duff et al., branchless apart from the sign
+  const float sign = std::copysign(1.f, w.z);
+  const float a = -1.f / (sign + w.z);
+  const float b = w.x * w.y * a;
+
+  u = glm::vec3(1.f + sign * w.x * w.x * a, sign * b, -sign * w.x);
+  v = glm::vec3(b, sign + w.y * w.y * a, -w.y);
+}
+
+}  // namespace rt
@@ -0,0 +1,651 @@
+/**
+ * @file mesh_loader.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "mesh_loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "triangle_mesh.h"
+
+namespace rt {
+
+namespace {
+
+const uint32_t NO_INDEX = UINT32_MAX;
+
+enum class PlyType {
+  INT8,
+  UINT8,
+  INT16,
+  UINT16,
+  INT32,
+  UINT32,
+  FLOAT32,
+  FLOAT64
+};
+
+struct PlyProperty {
+  std::string name;
+  PlyType type;
+  bool is_list;
+  PlyType count_type;
+};
+
+struct PlyElement {
+  std::string name;
+  uint32_t count;
+  std::vector<PlyProperty> properties;
+};
+
+bool ParsePlyType(const std::string& name, PlyType& type) {
+  if (name == "char" || name == "int8") {
+    type = PlyType::INT8;
+  } else if (name == "uchar" || name == "uint8") {
+    type = PlyType::UINT8;
+  } else if (name == "short" || name == "int16") {
+    type = PlyType::INT16;
+  } else if (name == "ushort" || name == "uint16") {
+    type = PlyType::UINT16;
+  } else if (name == "int" || name == "int32") {
+    type = PlyType::INT32;
+  } else if (name == "uint" || name == "uint32") {
+    type = PlyType::UINT32;
+  } else if (name == "float" || name == "float32") {
+    type = PlyType::FLOAT32;
+  } else if (name == "double" || name == "float64") {
+    type = PlyType::FLOAT64;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+size_t GetPlyTypeSize(PlyType type) {
+  switch (type) {
+    case PlyType::INT8:
+    case PlyType::UINT8:
+      return 1;
+    case PlyType::INT16:
+    case PlyType::UINT16:
+      return 2;
+    case PlyType::INT32:
+    case PlyType::UINT32:
+    case PlyType::FLOAT32:
+      return 4;
+    case PlyType::FLOAT64:
+      return 8;
+  }
+
+  return 0;
+}
+
+bool IsHostLittleEndian() {
+  const uint16_t value = 1u;
+  uint8_t first_byte = 0;
+  std::memcpy(&first_byte, &value, 1);
+
+  return first_byte == 1u;
+}
+
+// absolute index of a one-based or negative relative obj index
+bool ResolveObjIndex(long index, size_t count, uint32_t& resolved) {
+  if (index > 0 && static_cast<size_t>(index) <= count) {
+    resolved = static_cast<uint32_t>(index - 1);
+    return true;
+  }
+  if (index < 0 && static_cast<size_t>(-index) <= count) {
+    resolved = static_cast<uint32_t>(count + index);
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace
+
+MeshData MeshLoader::Load(const std::string& path) {
+  const size_t dot = path.find_last_of('.');
+  std::string extension =
+      dot == std::string::npos ? std::string() : path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (extension == "obj") {
+    return LoadObj(path);
+  } else if (extension == "ply") {
+    return LoadPly(path);
+  }
+
+  throw std::runtime_error("Error::MeshLoader: Unknown mesh format " + path +
+                           "!");
+}
+
+MeshData MeshLoader::LoadObj(const std::string& path) {
+  const std::string text = ReadFile(path);
+
+  std::vector<glm::vec3> positions{};
+  std::vector<glm::vec3> normals{};
+  // position and normal index of every triangle corner
+  std::vector<uint32_t> position_indices{};
+  std::vector<uint32_t> normal_indices{};
+  bool has_normals = true;
+
+  const char* cursor = text.c_str();
+  uint32_t line_number = 0;
+
+  auto fail = [&](const std::string& message) {
+    throw std::runtime_error("Error::MeshLoader: " + path + ":" +
+                             std::to_string(line_number) + ": " + message +
+                             "!");
+  };
+  auto skip_spaces = [&]() {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+      ++cursor;
+    }
+  };
+  auto at_line_end = [&]() {
+    skip_spaces();
+    return !*cursor || *cursor == '\n' || *cursor == '#';
+  };
+  auto next_float = [&]() {
+    if (at_line_end()) {
+      fail("Missing value");
+    }
+    char* end = nullptr;
+    float value = std::strtof(cursor, &end);
+    if (end == cursor) {
+      fail("Expected a number");
+    }
+    cursor = end;
+    return value;
+  };
+  auto next_vec3 = [&]() {
+    float x = next_float();
+    float y = next_float();
+    float z = next_float();
+    return glm::vec3(x, y, z);
+  };
+  auto next_index = [&]() {
+    char* end = nullptr;
+    long value = std::strtol(cursor, &end, 10);
+    if (end == cursor) {
+      fail("Expected an index");
+    }
+    cursor = end;
+    return value;
+  };
+
+  // corners of the current polygon, reused across faces
+  std::vector<uint32_t> polygon_positions{};
+  std::vector<uint32_t> polygon_normals{};
+
+  while (*cursor) {
+    ++line_number;
+
+    if (!at_line_end()) {
+      const char* keyword = cursor;
+      while (*cursor && *cursor != ' ' && *cursor != '\t' &&
+             *cursor != '\r' && *cursor != '\n') {
+        ++cursor;
+      }
+      const size_t keyword_size = static_cast<size_t>(cursor - keyword);
+
+      auto is_keyword = [&](const char* name) {
+        return keyword_size == std::strlen(name) &&
+               !std::strncmp(keyword, name, keyword_size);
+      };
+
+      if (is_keyword("v")) {
+        positions.push_back(next_vec3());
+      } else if (is_keyword("vn")) {
+        normals.push_back(next_vec3());
+      } else if (is_keyword("f")) {
+        polygon_positions.clear();
+        polygon_normals.clear();
+
+        // v, v/vt, v//vn or v/vt/vn
+        while (!at_line_end()) {
+          uint32_t position = NO_INDEX;
+          uint32_t normal = NO_INDEX;
+
+          if (!ResolveObjIndex(next_index(), positions.size(), position)) {
+            fail("Position index out of range");
+          }
+          if (*cursor == '/') {
+            ++cursor;
+            if (*cursor != '/') {
+              next_index();
+            }
+            if (*cursor == '/') {
+              ++cursor;
+              if (!ResolveObjIndex(next_index(), normals.size(), normal)) {
+                fail("Normal index out of range");
+              }
+            }
+          }
+
+          polygon_positions.push_back(position);
+          polygon_normals.push_back(normal);
+          has_normals = has_normals && normal != NO_INDEX;
+        }
+
+        if (polygon_positions.size() < 3) {
+          fail("Face with less than 3 corners");
+        }
+
+        for (size_t i = 2; i < polygon_positions.size(); ++i) {
+          const size_t corners[3] = {0, i - 1, i};
+          for (size_t corner : corners) {
+            position_indices.push_back(polygon_positions[corner]);
+            normal_indices.push_back(polygon_normals[corner]);
+          }
+        }
+      }
+      // texture coordinates, groups and materials are not needed
+    }
+
+    while (*cursor && *cursor != '\n') {
+      ++cursor;
+    }
+    if (*cursor) {
+      ++cursor;
+    }
+  }
+
+  MeshData mesh{};
+
+  // normals unless some corner goes without one
+  has_normals = has_normals && !position_indices.empty();
+  bool shared_indices = normals.size() == positions.size();
+  for (size_t i = 0; has_normals && shared_indices && i < normal_indices.size();
+       ++i) {
+    shared_indices = normal_indices[i] == position_indices[i];
+  }
+
+  if (!has_normals || shared_indices) {
+    mesh.positions = std::move(positions);
+    if (has_normals) {
+      mesh.normals = std::move(normals);
+    }
+    mesh.indices = std::move(position_indices);
+
+    return mesh;
+  }
+
+  // one vertex per distinct position and normal pair, found by sorting the
+  // pairs instead of hashing them
+  const size_t corner_count = position_indices.size();
+  std::vector<uint64_t> keys(corner_count);
+  for (size_t i = 0; i < corner_count; ++i) {
+    keys[i] = static_cast<uint64_t>(position_indices[i]) << 32 |
+              normal_indices[i];
+  }
+
+  std::vector<uint64_t> vertices = keys;
+  std::sort(vertices.begin(), vertices.end());
+  vertices.erase(std::unique(vertices.begin(), vertices.end()),
+                 vertices.end());
+
+  mesh.positions.resize(vertices.size());
+  mesh.normals.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    mesh.positions[i] = positions[vertices[i] >> 32];
+    mesh.normals[i] = normals[vertices[i] & 0xffffffffu];
+  }
+
+  mesh.indices.resize(corner_count);
+  for (size_t i = 0; i < corner_count; ++i) {
+    mesh.indices[i] = static_cast<uint32_t>(
+        std::lower_bound(vertices.begin(), vertices.end(), keys[i]) -
+        vertices.begin());
+  }
+
+  return mesh;
+}
+
+MeshData MeshLoader::LoadPly(const std::string& path) {
+  const std::string text = ReadFile(path);
+  const char* cursor = text.c_str();
+  const char* const end = text.c_str() + text.size();
+
+  auto fail = [&](const std::string& message) {
+    throw std::runtime_error("Error::MeshLoader: " + path + ": " + message +
+                             "!");
+  };
+
+  // line of the cursor, counted through the ascii body as well
+  uint32_t line_number = 1;
+
+  // header, one keyword per line up to end_header
+  auto next_line = [&]() {
+    const char* begin = cursor;
+    while (cursor < end && *cursor != '\n') {
+      ++cursor;
+    }
+    std::string line(begin, cursor);
+    if (cursor < end) {
+      ++cursor;
+      ++line_number;
+    }
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    return line;
+  };
+  auto split = [](const std::string& line) {
+    std::vector<std::string> words{};
+    size_t begin = 0;
+    while (begin < line.size()) {
+      size_t word_end = line.find_first_of(" \t", begin);
+      if (word_end == std::string::npos) {
+        word_end = line.size();
+      }
+      if (word_end > begin) {
+        words.push_back(line.substr(begin, word_end - begin));
+      }
+      begin = word_end + 1;
+    }
+    return words;
+  };
+
+  if (next_line() != "ply") {
+    fail("Not a ply file");
+  }
+
+  enum class PlyFormat { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+  PlyFormat format = PlyFormat::ASCII;
+  std::vector<PlyElement> elements{};
+
+  while (true) {
+    if (cursor >= end) {
+      fail("Missing end_header");
+    }
+
+    const std::vector<std::string> words = split(next_line());
+    if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+      continue;
+    }
+
+    if (words[0] == "end_header") {
+      break;
+    } else if (words[0] == "format" && words.size() >= 2) {
+      if (words[1] == "ascii") {
+        format = PlyFormat::ASCII;
+      } else if (words[1] == "binary_little_endian") {
+        format = PlyFormat::BINARY_LITTLE_ENDIAN;
+      } else if (words[1] == "binary_big_endian") {
+        format = PlyFormat::BINARY_BIG_ENDIAN;
+      } else {
+        fail("Unknown format " + words[1]);
+      }
+    } else if (words[0] == "element" && words.size() >= 3) {
+      PlyElement element{};
+      element.name = words[1];
+      // digits only, strtoull would take a sign and wrap it around
+      const std::string& count = words[2];
+      char* count_end = nullptr;
+      const unsigned long long value =
+          std::isdigit(static_cast<unsigned char>(count[0]))
+              ? std::strtoull(count.c_str(), &count_end, 10)
+              : 0ull;
+      if (count_end != count.c_str() + count.size() || value > UINT32_MAX) {
+        fail("Invalid count " + count + " of element " + element.name);
+      }
+      element.count = static_cast<uint32_t>(value);
+      elements.push_back(element);
+    } else if (words[0] == "property" && !elements.empty()) {
+      PlyProperty property{};
+      bool is_valid = false;
+      if (words.size() >= 5 && words[1] == "list") {
+        property.is_list = true;
+        property.name = words[4];
+        is_valid = ParsePlyType(words[2], property.count_type) &&
+                   ParsePlyType(words[3], property.type);
+      } else if (words.size() >= 3) {
+        property.is_list = false;
+        property.name = words[2];
+        is_valid = ParsePlyType(words[1], property.type);
+      }
+      if (!is_valid) {
+        fail("Unknown property type");
+      }
+      elements.back().properties.push_back(property);
+    } else {
+      fail("Unexpected header line " + words[0]);
+    }
+  }
+
+  const bool swap_bytes =
+      format != PlyFormat::ASCII &&
+      (format == PlyFormat::BINARY_LITTLE_ENDIAN) != IsHostLittleEndian();
+
+  // binary bodies have no lines, their records are counted instead
+  const PlyElement* element = nullptr;
+  uint32_t record = 0;
+  auto fail_at = [&](const std::string& message) {
+    const std::string location =
+        format == PlyFormat::ASCII
+            ? std::to_string(line_number)
+            : element->name + " " + std::to_string(record);
+    throw std::runtime_error("Error::MeshLoader: " + path + ":" + location +
+                             ": " + message + "!");
+  };
+
+  // every value goes through double, exact for all ply types
+  auto read_value = [&](PlyType type) -> double {
+    if (format == PlyFormat::ASCII) {
+      char* value_end = nullptr;
+      double value = std::strtod(cursor, &value_end);
+      if (value_end == cursor) {
+        fail_at("Expected a number");
+      }
+      line_number += static_cast<uint32_t>(
+          std::count(cursor, static_cast<const char*>(value_end), '\n'));
+      cursor = value_end;
+      return value;
+    }
+
+    const size_t size = GetPlyTypeSize(type);
+    if (static_cast<size_t>(end - cursor) < size) {
+      fail_at("Unexpected end of file");
+    }
+
+    uint8_t bytes[8];
+    std::memcpy(bytes, cursor, size);
+    cursor += size;
+    if (swap_bytes) {
+      std::reverse(bytes, bytes + size);
+    }
+
+    switch (type) {
+      case PlyType::INT8: {
+        int8_t value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::UINT8:
+        return bytes[0];
+      case PlyType::INT16: {
+        int16_t value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::UINT16: {
+        uint16_t value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::INT32: {
+        int32_t value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::UINT32: {
+        uint32_t value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::FLOAT32: {
+        float value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+      case PlyType::FLOAT64: {
+        double value;
+        std::memcpy(&value, bytes, size);
+        return value;
+      }
+    }
+
+    return 0.0;
+  };
+
+  // list counts and vertex indices, anything else is undefined to cast
+  auto read_index = [&](PlyType type) {
+    const double value = read_value(type);
+    if (!(value >= 0.0 && value < 4294967296.0) ||
+        value != std::floor(value)) {
+      fail_at("Expected an index");
+    }
+    return static_cast<uint32_t>(value);
+  };
+
+  MeshData mesh{};
+  std::vector<uint32_t> polygon{};
+
+  for (const PlyElement& current : elements) {
+    element = &current;
+    record = 0;
+
+    // each record takes at least a byte per ascii value, so a header
+    // claiming more than the body holds fails before allocating for it
+    size_t record_size = 0;
+    for (const PlyProperty& property : current.properties) {
+      record_size += format == PlyFormat::ASCII
+                         ? 1
+                         : GetPlyTypeSize(property.is_list ? property.count_type
+                                                           : property.type);
+    }
+    if (record_size &&
+        current.count > static_cast<size_t>(end - cursor) / record_size) {
+      fail_at("Unexpected end of file");
+    }
+
+    // map vertex properties onto position and normal components
+    int components[16]{};
+    const size_t property_count = current.properties.size();
+    if (current.name == "vertex") {
+      if (property_count > 16) {
+        fail("Too many vertex properties");
+      }
+
+      const char* const names[6] = {"x", "y", "z", "nx", "ny", "nz"};
+      int found = 0;
+      for (size_t i = 0; i < property_count; ++i) {
+        components[i] = -1;
+        for (int j = 0; j < 6; ++j) {
+          if (!current.properties[i].is_list &&
+              current.properties[i].name == names[j]) {
+            components[i] = j;
+            found |= 1 << j;
+          }
+        }
+      }
+
+      if ((found & 0x7) != 0x7) {
+        fail("Vertex without position");
+      }
+      mesh.positions.resize(current.count);
+      if ((found & 0x38) == 0x38) {
+        mesh.normals.resize(current.count);
+      }
+    }
+
+    if (current.name == "face") {
+      mesh.indices.reserve(3 * static_cast<size_t>(current.count));
+    }
+
+    for (uint32_t i = 0; i < current.count; ++i, ++record) {
+      for (size_t j = 0; j < property_count; ++j) {
+        const PlyProperty& property = current.properties[j];
+
+        if (!property.is_list) {
+          float value = static_cast<float>(read_value(property.type));
+          if (current.name == "vertex" && components[j] >= 0) {
+            if (components[j] < 3) {
+              mesh.positions[i][components[j]] = value;
+            } else if (!mesh.normals.empty()) {
+              mesh.normals[i][components[j] - 3] = value;
+            }
+          }
+          continue;
+        }
+
+        const uint32_t count = read_index(property.count_type);
+        const bool is_face = current.name == "face" &&
+                             (property.name == "vertex_indices" ||
+                              property.name == "vertex_index");
+
+        polygon.clear();
+        for (uint32_t k = 0; k < count; ++k) {
+          if (is_face) {
+            polygon.push_back(read_index(property.type));
+          } else {
+            read_value(property.type);
+          }
+        }
+
+        if (is_face && count >= 3) {
+          for (uint32_t k = 2; k < count; ++k) {
+            mesh.indices.push_back(polygon[0]);
+            mesh.indices.push_back(polygon[k - 1]);
+            mesh.indices.push_back(polygon[k]);
+          }
+        }
+      }
+    }
+  }
+
+  return mesh;
+}
+
+std::string MeshLoader::ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Error::MeshLoader: Failed to open " + path +
+                             "!");
+  }
+
+  // whole file in one read, parsed in place afterwards
+  std::string text(static_cast<size_t>(file.tellg()), '\0');
+  file.seekg(0);
+  file.read(&text[0], static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw std::runtime_error("Error::MeshLoader: Failed to read " + path +
+                             "!");
+  }
+
+  return text;
+}
+
+}  // namespace rt
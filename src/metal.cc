@@ -14,24 +14,20 @@
 
 #include "hittable.h"
 #include "material.h"
+#include "material_data.h"
 #include "ray.h"
-#include "utils.h"
+#include "sampler.h"
 
 namespace rt {
 
 Metal::Metal(float fuzz, const glm::vec3& color)
-    : fuzz_{fuzz}, albedo_{color} {}
+    : Material(MaterialData{color, fuzz, MaterialKind::METAL, 1.f}) {}
 
 bool Metal::Scatter(const Ray& ray, const HitRecord& record,
-                    glm::vec3& attenuation, Ray& scattered) const {
-  glm::vec3 reflection =
-      glm::reflect(glm::normalize(ray.GetDirection()), record.normal);
-
-  scattered =
-      Ray(record.point, reflection + fuzz_ * Utils::RandomInUnitSphere());
-  attenuation = albedo_;
-
-  return (glm::dot(scattered.GetDirection(), record.normal) > 0.f);
+                    glm::vec3& attenuation, Ray& scattered,
+                    Sampler& sampler) const {
+  return MaterialShading::ScatterMetal(GetData(), ray, record, attenuation,
+                                       scattered, sampler);
 }
 
 }  // namespace rt
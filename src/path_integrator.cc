@@ -0,0 +1,185 @@
+/**
+ * @file path_integrator.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "path_integrator.h"
+
+#include <algorithm>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "math_utils.h"
+#include "ray.h"
+#include "render_stats.h"
+#include "sampler.h"
+
+namespace rt {
+
+PathIntegrator::PathIntegrator(const Hittable& world,
+                               const MaterialTable& materials, int max_depth,
+                               const LightList* lights, int roulette_depth)
+    : world_{world},
+      materials_{materials},
+      lights_{lights && !lights->IsEmpty() ? lights : nullptr},
+      max_depth_{max_depth},
+      roulette_depth_{roulette_depth} {}
+
+glm::vec3 PathIntegrator::Li(const Ray& ray, Sampler& sampler,
+                             SurfaceAov* aov) const {
+  // check whether exceed the ray bounce limit
+  if (max_depth_ <= 0) {
+    return glm::vec3(0.f);
+  }
+
+  HitRecord record{};
+  RAY_TRACING_STATS_RAY(0);
+  if (!world_.Hit(ray, T_MIN, INFINITY_F, record)) {
+    const glm::vec3 background = Background(ray);
+    if (aov) {
+      *aov = SurfaceAov{background, glm::vec3(0.f), glm::vec3(0.f)};
+    }
+
+    return background;
+  }
+
+  return Li(ray, record, sampler, aov);
+}
+
+glm::vec3 PathIntegrator::Li(const Ray& ray, const HitRecord& record,
+                             Sampler& sampler, SurfaceAov* aov) const {
+  glm::vec3 radiance(0.f);
+  glm::vec3 throughput(1.f);
+  Ray current = ray;
+  HitRecord current_record = record;
+  // density of the last scatter when its vertex also sampled a light, zero
+  // leaves the lights it hits unweighted
+  float scatter_pdf = 0.f;
+  glm::vec3 scatter_origin(0.f);
+
+  for (int depth = 0; depth < max_depth_; ++depth) {
+    // the first hit is given, later ones are traced here
+    if (depth > 0) {
+      RAY_TRACING_STATS_RAY(depth);
+      if (!world_.Hit(current, T_MIN, INFINITY_F, current_record)) {
+        return radiance + throughput * Background(current);
+      }
+    }
+
+    const uint32_t material = current_record.material_index;
+
+    const glm::vec3 emitted = materials_.Emitted(material, current_record);
+    if (!MathUtils::NearZero(emitted)) {
+      float weight = 1.f;
+      if (scatter_pdf > 0.f) {
+        weight = MathUtils::PowerHeuristic(
+            scatter_pdf, lights_->GetPdf(scatter_origin, current_record.point,
+                                         current_record.normal, emitted));
+      }
+
+      radiance += throughput * emitted * weight;
+    }
+
+    Ray scattered{};
+    glm::vec3 attenuation{};
+    const bool is_scattered = materials_.Scatter(
+        material, current, current_record, attenuation, scattered, sampler);
+
+    // materials set the attenuation even for absorbed rays
+    if (aov && 0 == depth) {
+      *aov = SurfaceAov{attenuation, current_record.normal,
+                        current_record.point};
+    }
+
+    // absorbed
+    if (!is_scattered) {
+      return radiance;
+    }
+
+    // a light sample stands for the next bounce, so the last bounce has
+    // none, neither have mirrors and glass which Evaluate leaves at zero
+    scatter_pdf = 0.f;
+    if (lights_ && depth + 1 < max_depth_) {
+      materials_.Evaluate(material, current, current_record,
+                          scattered.GetDirection(), scatter_pdf);
+      if (scatter_pdf > 0.f) {
+        scatter_origin = current_record.point;
+        radiance += throughput * SampleLight(current, current_record, sampler);
+      }
+    }
+
+    throughput *= attenuation;
+
+    // survive with the probability of the brightest channel and reweight,
+    // the estimate stays unbiased but dark paths stop early
+    if (depth + 1 >= roulette_depth_) {
+      float survival = std::min(
+          std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.95f);
+
+      if (survival <= 0.f || MathUtils::RandomFloat(sampler) >= survival) {
+        return radiance;
+      }
+
+      throughput /= survival;
+    }
+
+    current = scattered;
+  }
+
+  // ran out of bounces
+  return radiance;
+}
+
+int PathIntegrator::GetMaxDepth() const { return max_depth_; }
+
+glm::vec3 PathIntegrator::SampleLight(const Ray& ray, const HitRecord& record,
+                                      Sampler& sampler) const {
+  LightSample light{};
+  if (!lights_->Sample(record.point, sampler, light)) {
+    return glm::vec3(0.f);
+  }
+
+  float pdf = 0.f;
+  const glm::vec3 value = materials_.Evaluate(
+      record.material_index, ray, record, light.point - record.point, pdf);
+  if (pdf <= 0.f || !IsVisible(record.point, light.point)) {
+    return glm::vec3(0.f);
+  }
+
+  const float weight = MathUtils::PowerHeuristic(
+      lights_->GetPdf(record.point, light.point, light.normal, light.radiance),
+      pdf);
+
+  return value * light.radiance * (weight / light.pdf);
+}
+
+bool PathIntegrator::IsVisible(const glm::vec3& from,
+                               const glm::vec3& to) const {
+  const glm::vec3 offset = to - from;
+  const float distance = glm::length(offset);
+
+  RAY_TRACING_STATS_ADD(shadow_rays, 1);
+  return !world_.Occluded(Ray(from, offset / distance), T_MIN,
+                          distance * (1.f - SHADOW_EPSILON));
+}
+
+glm::vec3 PathIntegrator::Background(const Ray& ray) {
+  // background color
+  glm::vec3 unit_direction = glm::normalize(ray.GetDirection());
+  float t = 0.5f * (unit_direction.y + 1.f);
+
+  return (1.f - t) * glm::vec3(1.f, 1.f, 1.f) + t * glm::vec3(0.5f, 0.7f, 1.f);
+}
+
+}  // namespace rt
@@ -0,0 +1,46 @@
+/**
+ * @file ray_packet.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "ray_packet.h"
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "ray.h"
+
+namespace rt {
+
+void RayPacket::SetRay(int lane, const Ray& ray) {
+  const glm::vec3 ray_origin = ray.GetOrigin();
+  const glm::vec3 ray_direction = ray.GetDirection();
+
+  for (int axis = 0; axis < 3; ++axis) {
+    origin[axis][lane] = ray_origin[axis];
+    direction[axis][lane] = ray_direction[axis];
+    inv_direction[axis][lane] = 1.f / ray_direction[axis];
+  }
+
+  mask |= 1u << lane;
+}
+
+Ray RayPacket::GetRay(int lane) const {
+  return Ray(glm::vec3(origin[0][lane], origin[1][lane], origin[2][lane]),
+             glm::vec3(direction[0][lane], direction[1][lane],
+                       direction[2][lane]));
+}
+
+void PacketHit::Reset(float t_max) {
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    t[lane] = t_max;
+    object[lane] = nullptr;
+  }
+}
+
+}  // namespace rt
@@ -0,0 +1,415 @@
+/**
+ * @file ray_tracing_scene.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "ray_tracing_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_VULKAN
+#include <vulkan/vulkan.h>
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "scene_file.h"
+#include "triangle_mesh.h"
+#include "utils.h"
+
+namespace rt {
+
+namespace {
+
+template <typename T>
+void LoadFunction(const VkDevice& device, const char* name, T& function) {
+  function = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+
+  if (!function) {
+    throw std::runtime_error(std::string("Error::Vulkan: Failed to load ") +
+                             name + "!");
+  }
+}
+
+}  // namespace
+
+void RayTracingFunctions::Load(const VkDevice& device) {
+  LoadFunction(device, "vkGetBufferDeviceAddress", get_buffer_device_address);
+  LoadFunction(device, "vkCreateAccelerationStructureKHR",
+               create_acceleration_structure);
+  LoadFunction(device, "vkDestroyAccelerationStructureKHR",
+               destroy_acceleration_structure);
+  LoadFunction(device, "vkGetAccelerationStructureBuildSizesKHR",
+               get_acceleration_structure_build_sizes);
+  LoadFunction(device, "vkCmdBuildAccelerationStructuresKHR",
+               cmd_build_acceleration_structures);
+  LoadFunction(device, "vkGetAccelerationStructureDeviceAddressKHR",
+               get_acceleration_structure_device_address);
+  LoadFunction(device, "vkCreateRayTracingPipelinesKHR",
+               create_ray_tracing_pipelines);
+  LoadFunction(device, "vkGetRayTracingShaderGroupHandlesKHR",
+               get_ray_tracing_shader_group_handles);
+  LoadFunction(device, "vkCmdTraceRaysKHR", cmd_trace_rays);
+}
+
+RayTracingScene::RayTracingScene(VkPhysicalDevice& physical_device,
+                                 VkDevice& device, VkQueue& queue,
+                                 VkCommandPool& command_pool,
+                                 const RayTracingFunctions& functions)
+    : physical_device_{physical_device},
+      device_{device},
+      queue_{queue},
+      command_pool_{command_pool},
+      functions_{functions} {
+  // scratch addresses of the builds have to be aligned
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR
+      acceleration_structure_properties{};
+  acceleration_structure_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &acceleration_structure_properties;
+  vkGetPhysicalDeviceProperties2(physical_device_, &properties);
+
+  scratch_alignment_ = std::max<VkDeviceSize>(
+      acceleration_structure_properties
+          .minAccelerationStructureScratchOffsetAlignment,
+      1);
+}
+
+RayTracingScene::~RayTracingScene() { Destroy(); }
+
+void RayTracingScene::Build(const SceneDescription& scene,
+                            const SceneGeometry& geometry) {
+  Destroy();
+
+  // spheres, a box per sphere in scene order
+  const uint32_t sphere_count = scene.GetSphereCount();
+  if (sphere_count) {
+    std::vector<VkAabbPositionsKHR> boxes(sphere_count);
+    for (uint32_t i = 0; i < sphere_count; ++i) {
+      const float radius = std::fabs(scene.radius[i]);
+
+      boxes[i].minX = scene.center_x[i] - radius;
+      boxes[i].minY = scene.center_y[i] - radius;
+      boxes[i].minZ = scene.center_z[i] - radius;
+      boxes[i].maxX = scene.center_x[i] + radius;
+      boxes[i].maxY = scene.center_y[i] + radius;
+      boxes[i].maxZ = scene.center_z[i] + radius;
+    }
+
+    VkAccelerationStructureGeometryKHR sphere_geometry{};
+    sphere_geometry.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    sphere_geometry.geometryType = VK_GEOMETRY_TYPE_AABBS_KHR;
+    sphere_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    sphere_geometry.geometry.aabbs.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR;
+    sphere_geometry.geometry.aabbs.data.deviceAddress = CreateInputBuffer(
+        boxes.data(), sizeof(VkAabbPositionsKHR) * boxes.size(),
+        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+    sphere_geometry.geometry.aabbs.stride = sizeof(VkAabbPositionsKHR);
+
+    spheres_ = BuildAccelerationStructure(
+        VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sphere_geometry,
+        sphere_count);
+  }
+
+  // meshes, their buffers double as the vertex data of triangle.rchit
+  const VkBufferUsageFlags mesh_usage =
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+  std::vector<GpuMesh> gpu_meshes(geometry.meshes.size());
+  meshes_.resize(geometry.meshes.size());
+  for (size_t i = 0; i < geometry.meshes.size(); ++i) {
+    std::shared_ptr<const TriangleMesh> mesh =
+        std::dynamic_pointer_cast<const TriangleMesh>(geometry.meshes[i]);
+    if (!mesh || !mesh->GetTriangleCount()) {
+      continue;
+    }
+
+    const std::vector<glm::vec3>& positions = mesh->GetPositions();
+    const std::vector<glm::vec3>& normals = mesh->GetNormals();
+    const std::vector<uint32_t>& indices = mesh->GetIndices();
+
+    GpuMesh& gpu_mesh = gpu_meshes[i];
+    gpu_mesh.positions = CreateInputBuffer(
+        positions.data(), sizeof(glm::vec3) * positions.size(), mesh_usage);
+    gpu_mesh.normals =
+        normals.empty()
+            ? 0
+            : CreateInputBuffer(normals.data(),
+                                sizeof(glm::vec3) * normals.size(),
+                                mesh_usage);
+    gpu_mesh.indices = CreateInputBuffer(
+        indices.data(), sizeof(uint32_t) * indices.size(), mesh_usage);
+    gpu_mesh.material = i < scene.meshes.size() ? scene.meshes[i].material : 0;
+
+    VkAccelerationStructureGeometryKHR mesh_geometry{};
+    mesh_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    mesh_geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+    mesh_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+    VkAccelerationStructureGeometryTrianglesDataKHR& triangles =
+        mesh_geometry.geometry.triangles;
+    triangles.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    triangles.vertexData.deviceAddress = gpu_mesh.positions;
+    triangles.vertexStride = sizeof(glm::vec3);
+    triangles.maxVertex = static_cast<uint32_t>(positions.size() - 1);
+    triangles.indexType = VK_INDEX_TYPE_UINT32;
+    triangles.indexData.deviceAddress = gpu_mesh.indices;
+
+    meshes_[i] = BuildAccelerationStructure(
+        VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, mesh_geometry,
+        mesh->GetTriangleCount());
+  }
+
+  // empty buffers are not allowed, the shader never reads this dummy
+  gpu_meshes.resize(std::max<size_t>(gpu_meshes.size(), 1));
+  Utils::CreateDeviceLocalBuffer(
+      physical_device_, device_, command_pool_, queue_, gpu_meshes.data(),
+      sizeof(GpuMesh) * gpu_meshes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      mesh_buffer_, mesh_buffer_memory_);
+
+  SetInstances(scene.instances);
+}
+
+void RayTracingScene::SetInstances(
+    const std::vector<InstanceDescription>& instances) {
+  DestroyAccelerationStructure(top_level_);
+  vkDestroyBuffer(device_, instance_buffer_, nullptr);
+  vkFreeMemory(device_, instance_buffer_memory_, nullptr);
+  instance_buffer_ = VK_NULL_HANDLE;
+  instance_buffer_memory_ = VK_NULL_HANDLE;
+
+  std::vector<VkAccelerationStructureInstanceKHR> records{};
+  records.reserve(instances.size() + 1);
+
+  // the spheres are in world space already
+  if (spheres_.handle) {
+    VkAccelerationStructureInstanceKHR record{};
+    record.transform.matrix[0][0] = 1.f;
+    record.transform.matrix[1][1] = 1.f;
+    record.transform.matrix[2][2] = 1.f;
+    record.mask = 0xff;
+    record.instanceShaderBindingTableRecordOffset = SPHERE_HIT_GROUP;
+    record.accelerationStructureReference = spheres_.address;
+
+    records.push_back(record);
+  }
+
+  for (const InstanceDescription& instance : instances) {
+    if (instance.mesh >= meshes_.size() || !meshes_[instance.mesh].handle) {
+      continue;
+    }
+
+    // rows of the 3x4 transform are the rows of the column major glm matrix
+    const glm::mat4 transform = instance.GetTransform();
+
+    VkAccelerationStructureInstanceKHR record{};
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 4; ++column) {
+        record.transform.matrix[row][column] = transform[column][row];
+      }
+    }
+    record.instanceCustomIndex = instance.mesh;
+    record.mask = 0xff;
+    record.instanceShaderBindingTableRecordOffset = TRIANGLE_HIT_GROUP;
+    // meshes are not closed in general, both faces are hit like on the cpu
+    record.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+    record.accelerationStructureReference = meshes_[instance.mesh].address;
+
+    records.push_back(record);
+  }
+
+  // an empty top level is still built so the descriptor is always valid
+  const uint32_t instance_count = static_cast<uint32_t>(records.size());
+  records.resize(std::max<size_t>(records.size(), 1));
+
+  Utils::CreateDeviceLocalBuffer(
+      physical_device_, device_, command_pool_, queue_, records.data(),
+      sizeof(VkAccelerationStructureInstanceKHR) * records.size(),
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      instance_buffer_, instance_buffer_memory_);
+
+  VkAccelerationStructureGeometryKHR instance_geometry{};
+  instance_geometry.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+  instance_geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+  instance_geometry.geometry.instances.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+  instance_geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+  instance_geometry.geometry.instances.data.deviceAddress =
+      GetBufferAddress(instance_buffer_);
+
+  top_level_ = BuildAccelerationStructure(
+      VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, instance_geometry,
+      instance_count);
+}
+
+VkAccelerationStructureKHR RayTracingScene::GetTopLevel() const {
+  return top_level_.handle;
+}
+
+VkBuffer RayTracingScene::GetMeshBuffer() const { return mesh_buffer_; }
+
+AccelerationStructure RayTracingScene::BuildAccelerationStructure(
+    VkAccelerationStructureTypeKHR type,
+    const VkAccelerationStructureGeometryKHR& geometry,
+    uint32_t primitive_count) {
+  VkAccelerationStructureBuildGeometryInfoKHR build_info{};
+  build_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+  build_info.type = type;
+  build_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+  build_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+  build_info.geometryCount = 1;
+  build_info.pGeometries = &geometry;
+
+  VkAccelerationStructureBuildSizesInfoKHR build_sizes{};
+  build_sizes.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+  functions_.get_acceleration_structure_build_sizes(
+      device_, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info,
+      &primitive_count, &build_sizes);
+
+  // structure
+  AccelerationStructure structure{};
+  Utils::CreateBuffer(
+      physical_device_, device_, build_sizes.accelerationStructureSize,
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, structure.buffer,
+      structure.buffer_memory, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+
+  VkAccelerationStructureCreateInfoKHR structure_info{};
+  structure_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+  structure_info.buffer = structure.buffer;
+  structure_info.size = build_sizes.accelerationStructureSize;
+  structure_info.type = type;
+
+  VkResult result = functions_.create_acceleration_structure(
+      device_, &structure_info, nullptr, &structure.handle);
+  Utils::CheckVulkanResult(
+      result, "Error::Vulkan: Failed to create acceleration structure!");
+
+  // scratch, over-allocated so the start can be aligned
+  VkBuffer scratch_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory scratch_buffer_memory = VK_NULL_HANDLE;
+  Utils::CreateBuffer(
+      physical_device_, device_,
+      build_sizes.buildScratchSize + scratch_alignment_,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratch_buffer,
+      scratch_buffer_memory, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+
+  const VkDeviceAddress scratch_address =
+      (GetBufferAddress(scratch_buffer) + scratch_alignment_ - 1) /
+      scratch_alignment_ * scratch_alignment_;
+
+  build_info.dstAccelerationStructure = structure.handle;
+  build_info.scratchData.deviceAddress = scratch_address;
+
+  VkAccelerationStructureBuildRangeInfoKHR build_range{};
+  build_range.primitiveCount = primitive_count;
+  const VkAccelerationStructureBuildRangeInfoKHR* build_ranges = &build_range;
+
+  // waits for the build, so scratch can go right after
+  VkCommandBuffer command_buffer =
+      Utils::BeginSingleTimeCommand(device_, command_pool_);
+  functions_.cmd_build_acceleration_structures(command_buffer, 1, &build_info,
+                                               &build_ranges);
+  Utils::EndSingleTimeCommand(device_, queue_, command_pool_, command_buffer);
+
+  vkDestroyBuffer(device_, scratch_buffer, nullptr);
+  vkFreeMemory(device_, scratch_buffer_memory, nullptr);
+
+  VkAccelerationStructureDeviceAddressInfoKHR address_info{};
+  address_info.sType =
+      VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+  address_info.accelerationStructure = structure.handle;
+  structure.address = functions_.get_acceleration_structure_device_address(
+      device_, &address_info);
+
+  return structure;
+}
+
+void RayTracingScene::DestroyAccelerationStructure(
+    AccelerationStructure& structure) {
+  if (structure.handle) {
+    functions_.destroy_acceleration_structure(device_, structure.handle,
+                                              nullptr);
+  }
+  vkDestroyBuffer(device_, structure.buffer, nullptr);
+  vkFreeMemory(device_, structure.buffer_memory, nullptr);
+
+  structure = AccelerationStructure{};
+}
+
+VkDeviceAddress RayTracingScene::CreateInputBuffer(const void* data,
+                                                   VkDeviceSize size,
+                                                   VkBufferUsageFlags usage) {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+  Utils::CreateDeviceLocalBuffer(
+      physical_device_, device_, command_pool_, queue_, data, size,
+      usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, buffer,
+      buffer_memory);
+
+  input_buffers_.push_back(buffer);
+  input_buffer_memories_.push_back(buffer_memory);
+
+  return GetBufferAddress(buffer);
+}
+
+VkDeviceAddress RayTracingScene::GetBufferAddress(VkBuffer buffer) const {
+  VkBufferDeviceAddressInfo address_info{};
+  address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+  address_info.buffer = buffer;
+
+  return functions_.get_buffer_device_address(device_, &address_info);
+}
+
+void RayTracingScene::Destroy() {
+  DestroyAccelerationStructure(top_level_);
+  for (AccelerationStructure& mesh : meshes_) {
+    DestroyAccelerationStructure(mesh);
+  }
+  meshes_.clear();
+  DestroyAccelerationStructure(spheres_);
+
+  vkDestroyBuffer(device_, instance_buffer_, nullptr);
+  vkFreeMemory(device_, instance_buffer_memory_, nullptr);
+  vkDestroyBuffer(device_, mesh_buffer_, nullptr);
+  vkFreeMemory(device_, mesh_buffer_memory_, nullptr);
+  instance_buffer_ = VK_NULL_HANDLE;
+  instance_buffer_memory_ = VK_NULL_HANDLE;
+  mesh_buffer_ = VK_NULL_HANDLE;
+  mesh_buffer_memory_ = VK_NULL_HANDLE;
+
+  for (size_t i = 0; i < input_buffers_.size(); ++i) {
+    vkDestroyBuffer(device_, input_buffers_[i], nullptr);
+    vkFreeMemory(device_, input_buffer_memories_[i], nullptr);
+  }
+  input_buffers_.clear();
+  input_buffer_memories_.clear();
+}
+
+}  // namespace rt
@@ -0,0 +1,400 @@
+/**
+ * @file render_farm.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "render_farm.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "renderer.h"
+#include "scene_file.h"
+#include "socket.h"
+
+namespace rt {
+
+namespace {
+
+// messages are sent in host byte order like binary scenes, the marker
+// tells hosts of the other byte order apart
+const char JOB_MAGIC[8] = {'R', 'T', 'F', 'A', 'R', 'M', '\0', '\0'};
+const uint32_t PROTOCOL_VERSION = 1u;
+const uint32_t BYTE_ORDER_MARKER = 0x01020304u;
+
+const uint32_t JOB_ADAPTIVE_SAMPLING = 1u << 0;
+const uint32_t JOB_PACKET_TRACING = 1u << 1;
+const uint32_t JOB_NEXT_EVENT_ESTIMATION = 1u << 2;
+const uint32_t JOB_WAVEFRONT = 1u << 3;
+
+// first message of a connection, the binary scene follows
+struct JobHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t width;
+  uint32_t height;
+  // origin, look at, fov, aperture, focus dist
+  float camera[9];
+  int32_t samples_per_pixel;
+  int32_t bounce_limit;
+  int32_t seed;
+  int32_t adaptive_min_samples;
+  float adaptive_threshold;
+  uint32_t flags;
+  uint32_t padding;
+  uint64_t scene_size;
+};
+static_assert(sizeof(JobHeader) == 96, "unexpected job header size");
+
+// band to trace, no rows ends the frame
+struct BandHeader {
+  uint32_t first_row;
+  uint32_t row_count;
+};
+
+// traced band, the columns of Accumulation follow in its order
+struct ResultHeader {
+  uint32_t first_row;
+  uint32_t row_count;
+  int32_t samples;
+  uint32_t pixel_count;
+};
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float),
+              "columns are sent as they are");
+
+JobHeader MakeJob(const RenderSettings& settings, uint64_t scene_size) {
+  JobHeader job{};
+  std::memcpy(job.magic, JOB_MAGIC, sizeof(JOB_MAGIC));
+  job.version = PROTOCOL_VERSION;
+  job.byte_order = BYTE_ORDER_MARKER;
+  job.width = settings.width;
+  job.height = settings.height;
+
+  const float camera[9] = {
+      settings.origin.x,  settings.origin.y,  settings.origin.z,
+      settings.look_at.x, settings.look_at.y, settings.look_at.z,
+      settings.fov,       settings.aperture,  settings.focus_dist};
+  std::memcpy(job.camera, camera, sizeof(job.camera));
+
+  job.samples_per_pixel = settings.samples_per_pixel;
+  job.bounce_limit = settings.bounce_limit;
+  job.seed = settings.seed;
+  job.adaptive_min_samples = settings.adaptive_min_samples;
+  job.adaptive_threshold = settings.adaptive_threshold;
+  job.flags = (settings.adaptive_sampling ? JOB_ADAPTIVE_SAMPLING : 0u) |
+              (settings.packet_tracing ? JOB_PACKET_TRACING : 0u) |
+              (settings.next_event_estimation ? JOB_NEXT_EVENT_ESTIMATION
+                                              : 0u) |
+              (settings.wavefront ? JOB_WAVEFRONT : 0u);
+  job.scene_size = scene_size;
+
+  return job;
+}
+
+// one-shot settings of the worker, the display transfer is left to the
+// coordinator
+RenderSettings ReadJob(const JobHeader& job) {
+  if (std::memcmp(job.magic, JOB_MAGIC, sizeof(JOB_MAGIC)) ||
+      job.version != PROTOCOL_VERSION) {
+    throw std::runtime_error("Error::RenderFarm: Not a coordinator of this "
+                             "version!");
+  }
+  if (job.byte_order != BYTE_ORDER_MARKER) {
+    throw std::runtime_error("Error::RenderFarm: Coordinator runs on a host "
+                             "of another byte order!");
+  }
+  if (job.width < 2 || job.height < 2 || job.samples_per_pixel < 1) {
+    throw std::runtime_error("Error::RenderFarm: Invalid image size or "
+                             "sample count!");
+  }
+  // checked before anything gets allocated for them
+  if (static_cast<uint64_t>(job.width) * job.height > FARM_MAX_PIXEL_COUNT ||
+      job.scene_size > FARM_MAX_SCENE_SIZE) {
+    throw std::runtime_error("Error::RenderFarm: Image or scene too large!");
+  }
+
+  RenderSettings settings{};
+  settings.width = job.width;
+  settings.height = job.height;
+  settings.origin = glm::vec3(job.camera[0], job.camera[1], job.camera[2]);
+  settings.look_at = glm::vec3(job.camera[3], job.camera[4], job.camera[5]);
+  settings.fov = job.camera[6];
+  settings.aperture = job.camera[7];
+  settings.focus_dist = job.camera[8];
+  settings.samples_per_pixel = job.samples_per_pixel;
+  settings.bounce_limit = job.bounce_limit;
+  settings.seed = job.seed;
+  settings.adaptive_min_samples = job.adaptive_min_samples;
+  settings.adaptive_threshold = job.adaptive_threshold;
+  settings.adaptive_sampling = 0 != (job.flags & JOB_ADAPTIVE_SAMPLING);
+  settings.packet_tracing = 0 != (job.flags & JOB_PACKET_TRACING);
+  settings.next_event_estimation =
+      0 != (job.flags & JOB_NEXT_EVENT_ESTIMATION);
+  settings.wavefront = 0 != (job.flags & JOB_WAVEFRONT);
+  settings.progressive = false;
+
+  return settings;
+}
+
+template <typename T>
+void SendColumn(const Socket& socket, const std::vector<T>& column) {
+  socket.Send(column.data(), column.size() * sizeof(T));
+}
+
+template <typename T>
+void ReceiveColumn(const Socket& socket, size_t count,
+                   std::vector<T>& column) {
+  column.resize(count);
+  socket.Receive(column.data(), count * sizeof(T));
+}
+
+// whole frame of one coordinator, bands are traced as they come in
+void ServeFrame(const Socket& socket, uint32_t thread_count) {
+  // a coordinator lost to the network must not hold up the next ones
+  socket.SetTimeout(FARM_WORKER_TIMEOUT);
+
+  JobHeader job{};
+  socket.Receive(&job, sizeof(job));
+  RenderSettings settings = ReadJob(job);
+
+  std::vector<uint8_t> scene_data(static_cast<size_t>(job.scene_size));
+  socket.Receive(scene_data.data(), scene_data.size());
+  const SceneDescription scene = SceneFile::ReadBinary(
+      scene_data.data(), scene_data.size(), "scene of the coordinator");
+
+  std::shared_ptr<MaterialTable> materials =
+      std::make_shared<MaterialTable>();
+  std::shared_ptr<LightList> lights = std::make_shared<LightList>();
+  std::shared_ptr<Hittable> world =
+      SceneFile::Build(scene, *materials, lights.get());
+
+  Renderer renderer{};
+  renderer.SetThreadCount(thread_count);
+  renderer.SetWorld(world, materials, lights);
+
+  Accumulation band{};
+  uint32_t band_count = 0;
+
+  while (true) {
+    BandHeader request{};
+    socket.Receive(&request, sizeof(request));
+    if (!request.row_count) {
+      break;
+    }
+    if (request.first_row >= settings.height ||
+        request.row_count > settings.height - request.first_row) {
+      throw std::runtime_error("Error::RenderFarm: Band outside the image!");
+    }
+
+    settings.first_row = request.first_row;
+    settings.row_count = request.row_count;
+    renderer.SetSettings(settings);
+    renderer.RequestRender();
+    renderer.WaitForFramebuffer();
+    renderer.ReadAccumulation(request.first_row, request.row_count, band);
+
+    ResultHeader result{};
+    result.first_row = band.first_row;
+    result.row_count = band.row_count;
+    result.samples = band.samples;
+    result.pixel_count = static_cast<uint32_t>(band.sums.size());
+
+    socket.Send(&result, sizeof(result));
+    SendColumn(socket, band.sums);
+    SendColumn(socket, band.sample_counts);
+    SendColumn(socket, band.luminance_squares);
+    SendColumn(socket, band.albedo_sums);
+    SendColumn(socket, band.normal_sums);
+    SendColumn(socket, band.position_sums);
+    ++band_count;
+  }
+
+  std::clog << "Traced " << band_count << " bands of " << settings.width
+            << " * " << settings.height << " at " << settings.samples_per_pixel
+            << " spp\n";
+}
+
+}  // namespace
+
+void RenderFarm::Render(const std::vector<std::string>& workers,
+                        float timeout, const SceneDescription& scene,
+                        const RenderSettings& settings,
+                        Accumulation& accumulation) {
+  std::ostringstream scene_stream(std::ios::binary);
+  SceneFile::WriteBinary(scene_stream, scene);
+  const std::string scene_data = scene_stream.str();
+  const JobHeader job = MakeJob(settings, scene_data.size());
+
+  const uint32_t width = settings.width;
+  const uint32_t height = settings.height;
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+
+  accumulation.width = width;
+  accumulation.height = height;
+  accumulation.first_row = 0;
+  accumulation.row_count = height;
+  accumulation.samples = settings.samples_per_pixel;
+  accumulation.sums.assign(pixel_count, glm::vec3(0.f));
+  accumulation.sample_counts.assign(pixel_count, 0);
+  accumulation.luminance_squares.assign(pixel_count, 0.f);
+  accumulation.albedo_sums.assign(pixel_count, glm::vec3(0.f));
+  accumulation.normal_sums.assign(pixel_count, glm::vec3(0.f));
+  accumulation.position_sums.assign(pixel_count, glm::vec3(0.f));
+
+  // bands nobody traces right now, failed workers put theirs back in front
+  const uint32_t band_count = (height + FARM_BAND_ROWS - 1) / FARM_BAND_ROWS;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<uint32_t> pending;
+  uint32_t finished = 0;
+  for (uint32_t band = 0; band < band_count; ++band) {
+    pending.push_back(band);
+  }
+
+  // one connection, the worker holds up to FARM_QUEUE_DEPTH bands and sends
+  // them back in order
+  auto serve = [&](const std::string& address) {
+    std::deque<uint32_t> assigned;
+
+    try {
+      Socket socket = Socket::Connect(address);
+      socket.SetTimeout(timeout);
+      socket.Send(&job, sizeof(job));
+      socket.Send(scene_data.data(), scene_data.size());
+
+      Accumulation band{};
+      while (true) {
+        std::vector<uint32_t> requested;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          if (assigned.empty()) {
+            // bands of failing workers may still come back
+            changed.wait(lock, [&]() {
+              return !pending.empty() || finished == band_count;
+            });
+          }
+
+          while (assigned.size() < FARM_QUEUE_DEPTH && !pending.empty()) {
+            requested.push_back(pending.front());
+            assigned.push_back(pending.front());
+            pending.pop_front();
+          }
+        }
+
+        if (assigned.empty()) {
+          const BandHeader done{0, 0};
+          socket.Send(&done, sizeof(done));
+          break;
+        }
+
+        for (uint32_t index : requested) {
+          const uint32_t first_row = index * FARM_BAND_ROWS;
+          const BandHeader request{
+              first_row, std::min(FARM_BAND_ROWS, height - first_row)};
+          socket.Send(&request, sizeof(request));
+        }
+
+        ResultHeader result{};
+        socket.Receive(&result, sizeof(result));
+
+        const uint32_t first_row = assigned.front() * FARM_BAND_ROWS;
+        const uint32_t row_count = std::min(FARM_BAND_ROWS, height - first_row);
+        const size_t count = static_cast<size_t>(width) * row_count;
+        if (result.first_row != first_row || result.row_count != row_count ||
+            result.pixel_count != count) {
+          throw std::runtime_error("Error::RenderFarm: Unexpected band!");
+        }
+
+        ReceiveColumn(socket, count, band.sums);
+        ReceiveColumn(socket, count, band.sample_counts);
+        ReceiveColumn(socket, count, band.luminance_squares);
+        ReceiveColumn(socket, count, band.albedo_sums);
+        ReceiveColumn(socket, count, band.normal_sums);
+        ReceiveColumn(socket, count, band.position_sums);
+
+        // bands never overlap, so merging needs no lock
+        const size_t first = static_cast<size_t>(first_row) * width;
+        auto merge = [&](const auto& rows, auto& column) {
+          std::copy(rows.begin(), rows.end(), column.begin() + first);
+        };
+        merge(band.sums, accumulation.sums);
+        merge(band.sample_counts, accumulation.sample_counts);
+        merge(band.luminance_squares, accumulation.luminance_squares);
+        merge(band.albedo_sums, accumulation.albedo_sums);
+        merge(band.normal_sums, accumulation.normal_sums);
+        merge(band.position_sums, accumulation.position_sums);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        assigned.pop_front();
+        if (++finished == band_count) {
+          changed.notify_all();
+        }
+      }
+    } catch (const std::exception& e) {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::clog << "Lost worker " << address << ", " << assigned.size()
+                << " bands go to the others: " << e.what() << '\n';
+
+      pending.insert(pending.begin(), assigned.begin(), assigned.end());
+      changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> connections;
+  connections.reserve(workers.size());
+  for (const std::string& address : workers) {
+    connections.emplace_back(serve, address);
+  }
+  for (std::thread& connection : connections) {
+    connection.join();
+  }
+
+  if (finished != band_count) {
+    throw std::runtime_error("Error::RenderFarm: No worker left for " +
+                             std::to_string(band_count - finished) +
+                             " bands!");
+  }
+}
+
+void RenderFarm::Serve(uint16_t port, uint32_t thread_count) {
+  Socket listener = Socket::Listen(port);
+  std::clog << "Waiting for coordinators on port " << port << '\n';
+
+  while (true) {
+    // a coordinator that went away only ends its own frame
+    try {
+      Socket socket = listener.Accept();
+      ServeFrame(socket, thread_count);
+    } catch (const std::exception& e) {
+      std::clog << e.what() << '\n';
+    }
+  }
+}
+
+}  // namespace rt
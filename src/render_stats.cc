@@ -0,0 +1,110 @@
+/**
+ * @file render_stats.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "render_stats.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace rt {
+
+namespace {
+
+void WriteJsonArray(std::ostream& stream, const std::vector<float>& values) {
+  stream << '[';
+  for (size_t i = 0; i < values.size(); ++i) {
+    stream << (i ? "," : "") << values[i];
+  }
+  stream << ']';
+}
+
+}  // namespace
+
+void RayCounters::Merge(const RayCounters& other) {
+  for (int depth = 0; depth < STATS_DEPTH_COUNT; ++depth) {
+    rays[depth] += other.rays[depth];
+  }
+  shadow_rays += other.shadow_rays;
+  intersection_tests += other.intersection_tests;
+  bvh_nodes += other.bvh_nodes;
+}
+
+uint64_t RayCounters::GetRayCount() const {
+  uint64_t count = shadow_rays;
+  for (int depth = 0; depth < STATS_DEPTH_COUNT; ++depth) {
+    count += rays[depth];
+  }
+
+  return count;
+}
+
+double RenderStats::GetMraysPerSecond() const {
+  if (pass_time <= 0.f) {
+    return 0.0;
+  }
+
+  // rays per millisecond / 1000
+  return static_cast<double>(counters.GetRayCount()) / pass_time / 1000.0;
+}
+
+float RenderStats::GetUtilization(uint32_t worker) const {
+  if (pass_time <= 0.f || worker >= worker_times.size()) {
+    return 0.f;
+  }
+
+  return worker_times[worker] / pass_time;
+}
+
+float RenderStats::GetAverageUtilization() const {
+  if (worker_times.empty()) {
+    return 0.f;
+  }
+
+  float utilization = 0.f;
+  for (uint32_t worker = 0; worker < worker_times.size(); ++worker) {
+    utilization += GetUtilization(worker);
+  }
+
+  return utilization / static_cast<float>(worker_times.size());
+}
+
+void RenderStats::WriteJson(std::ostream& stream) const {
+  stream << "{\"stats_enabled\":" << (Stats::IsEnabled() ? "true" : "false")
+         << ",\"pass_time_ms\":" << pass_time
+         << ",\"resolve_time_ms\":" << resolve_time
+         << ",\"denoise_time_ms\":" << denoise_time
+         << ",\"samples\":" << samples
+         << ",\"converged_pixels\":" << converged_pixels
+         << ",\"rays\":" << counters.GetRayCount() << ",\"rays_by_depth\":[";
+  for (int depth = 0; depth < STATS_DEPTH_COUNT; ++depth) {
+    stream << (depth ? "," : "") << counters.rays[depth];
+  }
+  stream << "],\"shadow_rays\":" << counters.shadow_rays
+         << ",\"intersection_tests\":" << counters.intersection_tests
+         << ",\"bvh_nodes\":" << counters.bvh_nodes
+         << ",\"mrays_per_second\":" << GetMraysPerSecond()
+         << ",\"tiles_x\":" << tiles_x << ",\"tiles_y\":" << tiles_y
+         << ",\"tile_times_ms\":";
+  WriteJsonArray(stream, tile_times);
+  stream << ",\"worker_times_ms\":";
+  WriteJsonArray(stream, worker_times);
+  stream << ",\"utilization\":" << GetAverageUtilization() << '}';
+}
+
+RayCounters Stats::TakeLocal() {
+  RayCounters& local = GetLocal();
+  RayCounters counters = local;
+  local = RayCounters{};
+
+  return counters;
+}
+
+}  // namespace rt
@@ -0,0 +1,1196 @@
+/**
+ * @file renderer.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-13
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "checkpoint.h"
+#include "color_resolve.h"
+#include "config.h"
+#include "denoiser.h"
+#include "function_ref.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "math_utils.h"
+#include "path_integrator.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "sampler.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "wavefront_integrator.h"
+
+namespace rt {
+
+namespace {
+
+Camera MakeCamera(const RenderSettings& settings) {
+  glm::vec3 world_up(0.f, 1.f, 0.f);
+
+  return Camera(settings.origin, settings.look_at, world_up, settings.fov,
+                static_cast<float>(settings.width) /
+                    static_cast<float>(settings.height),
+                settings.aperture, settings.focus_dist);
+}
+
+}  // namespace
+
+bool RenderSettings::IsCompatible(const RenderSettings& other) const {
+  return width == other.width && height == other.height &&
+         origin == other.origin && look_at == other.look_at &&
+         fov == other.fov && aperture == other.aperture &&
+         focus_dist == other.focus_dist && bounce_limit == other.bounce_limit &&
+         seed == other.seed && progressive == other.progressive &&
+         adaptive_sampling == other.adaptive_sampling &&
+         adaptive_threshold == other.adaptive_threshold &&
+         adaptive_min_samples == other.adaptive_min_samples &&
+         next_event_estimation == other.next_event_estimation &&
+         first_row == other.first_row && row_count == other.row_count;
+}
+
+bool RenderSettings::IsCameraMove(const RenderSettings& other) const {
+  RenderSettings moved = other;
+  moved.origin = origin;
+  moved.look_at = look_at;
+  moved.fov = fov;
+
+  return IsCompatible(moved);
+}
+
+bool RenderSettings::operator==(const RenderSettings& other) const {
+  return IsCompatible(other) && samples_per_pixel == other.samples_per_pixel &&
+         samples_per_frame == other.samples_per_frame && gamma == other.gamma &&
+         exposure == other.exposure && tonemap == other.tonemap &&
+         denoise == other.denoise && packet_tracing == other.packet_tracing &&
+         wavefront == other.wavefront && reprojection == other.reprojection;
+}
+
+bool RenderSettings::operator!=(const RenderSettings& other) const {
+  return !(*this == other);
+}
+
+Renderer::Renderer()
+    : checkpoint_writer_{std::make_unique<CheckpointWriter>()} {
+  render_thread_ = std::thread(&Renderer::RenderLoop, this);
+}
+
+Renderer::~Renderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  thread_pool_.Cancel();
+  condition_.notify_all();
+
+  render_thread_.join();
+}
+
+void Renderer::SetWorld(std::shared_ptr<const Hittable> world,
+                        std::shared_ptr<const MaterialTable> materials,
+                        std::shared_ptr<const LightList> lights) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    world_ = world;
+    materials_ = materials;
+    lights_ = lights;
+    reset_requested_ = true;
+    reproject_requested_ = false;
+    load_requested_ = false;
+  }
+  thread_pool_.Cancel();
+  condition_.notify_all();
+}
+
+void Renderer::EditWorld(const std::function<void()>& edit) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // no new pass starts until the edit is done
+  edit_requested_ = true;
+  thread_pool_.Cancel();
+  idle_.wait(lock, [this]() { return !is_tracing_; });
+
+  edit();
+
+  edit_requested_ = false;
+  reset_requested_ = true;
+  reproject_requested_ = false;
+  load_requested_ = false;
+  condition_.notify_all();
+}
+
+void Renderer::SetSettings(const RenderSettings& settings) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (settings == settings_) {
+    return;
+  }
+
+  if (!settings.IsCompatible(settings_)) {
+    // camera moves keep their history unless another reset is pending
+    reproject_requested_ = settings.reprojection &&
+                           settings.IsCameraMove(settings_) &&
+                           (!reset_requested_ || reproject_requested_);
+
+    // stop tracing the stale frame as soon as possible
+    reset_requested_ = true;
+    load_requested_ = false;
+    thread_pool_.Cancel();
+  } else if (settings.gamma != settings_.gamma ||
+             settings.exposure != settings_.exposure ||
+             settings.tonemap != settings_.tonemap ||
+             settings.denoise != settings_.denoise) {
+    resolve_requested_ = true;
+  }
+
+  settings_ = settings;
+  condition_.notify_all();
+}
+
+void Renderer::SetThreadCount(uint32_t thread_count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (thread_count != thread_count_) {
+    thread_count_ = thread_count;
+    thread_count_changed_ = true;
+  }
+}
+
+void Renderer::SetPlaying(bool playing) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (playing != playing_) {
+    playing_ = playing;
+    condition_.notify_all();
+  }
+}
+
+void Renderer::RequestRender() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  render_requested_ = true;
+  condition_.notify_all();
+}
+
+const Framebuffer* Renderer::AcquireFramebuffer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!has_new_framebuffer_) {
+    return nullptr;
+  }
+
+  std::swap(front_, ready_);
+  has_new_framebuffer_ = false;
+
+  return &buffers_[front_];
+}
+
+const Framebuffer* Renderer::WaitForFramebuffer() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  published_.wait(lock, [this]() { return has_new_framebuffer_; });
+
+  std::swap(front_, ready_);
+  has_new_framebuffer_ = false;
+
+  return &buffers_[front_];
+}
+
+void Renderer::ReadAccumulation(uint32_t first_row, uint32_t row_count,
+                                Accumulation& accumulation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // the render thread owns the buffers, no pass may start meanwhile
+  edit_requested_ = true;
+  idle_.wait(lock, [this]() { return !is_tracing_; });
+
+  CopyAccumulation(accumulation_settings_, accumulated_samples_, first_row,
+                   row_count, accumulation);
+
+  edit_requested_ = false;
+  condition_.notify_all();
+}
+
+void Renderer::LoadAccumulation(const Accumulation& accumulation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  const size_t count =
+      static_cast<size_t>(accumulation.width) * accumulation.row_count;
+  if (accumulation.width != settings_.width ||
+      accumulation.height != settings_.height ||
+      accumulation.first_row + accumulation.row_count > accumulation.height ||
+      accumulation.sums.size() != count ||
+      accumulation.sample_counts.size() != count ||
+      accumulation.luminance_squares.size() != count ||
+      accumulation.albedo_sums.size() != count ||
+      accumulation.normal_sums.size() != count ||
+      accumulation.position_sums.size() != count) {
+    throw std::runtime_error(
+        "Error::Renderer: Accumulation does not match the image!");
+  }
+
+  // the render thread owns the buffers, no pass may start meanwhile
+  edit_requested_ = true;
+  idle_.wait(lock, [this]() { return !is_tracing_; });
+
+  // rows outside of accumulation only survive if they are still valid
+  const size_t pixel_count =
+      static_cast<size_t>(settings_.width) * settings_.height;
+  if (reset_requested_ || !accumulated_samples_ ||
+      accumulation_.size() != pixel_count) {
+    accumulation_.assign(pixel_count, glm::vec3(0.f));
+    sample_counts_.assign(pixel_count, 0);
+    luminance_squares_.assign(pixel_count, 0.f);
+    albedo_sums_.assign(pixel_count, glm::vec3(0.f));
+    normal_sums_.assign(pixel_count, glm::vec3(0.f));
+    position_sums_.assign(pixel_count, glm::vec3(0.f));
+  }
+
+  const size_t first =
+      static_cast<size_t>(accumulation.first_row) * accumulation.width;
+  auto copy = [&](const auto& rows, auto& column) {
+    std::copy(rows.begin(), rows.end(), column.begin() + first);
+  };
+  copy(accumulation.sums, accumulation_);
+  copy(accumulation.sample_counts, sample_counts_);
+  copy(accumulation.luminance_squares, luminance_squares_);
+  copy(accumulation.albedo_sums, albedo_sums_);
+  copy(accumulation.normal_sums, normal_sums_);
+  copy(accumulation.position_sums, position_sums_);
+
+  history_.clear();
+  reproject_pending_ = false;
+  accumulation_settings_ = settings_;
+  accumulated_samples_ = accumulation.samples;
+  reset_requested_ = false;
+  reproject_requested_ = false;
+  load_requested_ = true;
+
+  edit_requested_ = false;
+  condition_.notify_all();
+}
+
+void Renderer::SetCheckpoint(const std::string& path, float interval,
+                             uint64_t scene_hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  checkpoint_path_ = path;
+  checkpoint_interval_ = interval;
+  checkpoint_scene_hash_ = scene_hash;
+}
+
+void Renderer::WaitForCheckpoint() { checkpoint_writer_->Wait(); }
+
+std::string Renderer::TakeCheckpointError() {
+  return checkpoint_writer_->TakeError();
+}
+
+int Renderer::GetAccumulatedSamples() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return accumulated_samples_;
+}
+
+float Renderer::GetPassTime() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return pass_time_;
+}
+
+RenderStats Renderer::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return stats_;
+}
+
+void Renderer::GetStats(RenderStats& stats) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  stats = stats_;
+}
+
+void Renderer::RenderLoop() {
+  while (true) {
+    RenderSettings settings{};
+    std::shared_ptr<const Hittable> world{};
+    std::shared_ptr<const MaterialTable> materials{};
+    std::shared_ptr<const LightList> lights{};
+    uint32_t thread_count = 0;
+    bool resize_pool = false;
+    int first_sample = 0;
+    bool reproject = false;
+    std::string checkpoint_path{};
+    float checkpoint_interval = 0.f;
+    uint64_t checkpoint_scene_hash = 0;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() {
+        return stop_ || (!edit_requested_ && HasWork());
+      });
+
+      if (stop_) {
+        return;
+      }
+
+      is_tracing_ = true;
+
+      if ((reset_requested_ || !settings_.progressive) && !load_requested_) {
+        reproject = reset_requested_ && reproject_requested_;
+        reset_requested_ = false;
+        reproject_requested_ = false;
+        accumulated_samples_ = 0;
+      }
+      load_requested_ = false;
+
+      settings = settings_;
+      world = world_;
+      materials = materials_;
+      lights = lights_;
+      first_sample = accumulated_samples_;
+      render_requested_ = false;
+      resolve_requested_ = false;
+
+      thread_count = thread_count_;
+      resize_pool = thread_count_changed_;
+      thread_count_changed_ = false;
+
+      checkpoint_path = checkpoint_path_;
+      checkpoint_interval = checkpoint_interval_;
+      checkpoint_scene_hash = checkpoint_scene_hash_;
+    }
+
+    if (resize_pool) {
+      thread_pool_.Resize(thread_count);
+    }
+
+    const size_t pixel_count =
+        static_cast<size_t>(settings.width) * settings.height;
+    if (!first_sample || accumulation_.size() != pixel_count) {
+      // a snapshot not reprojected yet survives cancelled passes, it has
+      // more samples than whatever they traced
+      if (!reproject) {
+        reproject_pending_ = false;
+      } else if (!reproject_pending_ && accumulation_.size() == pixel_count) {
+        reproject_pending_ =
+            SnapshotHistory(accumulation_settings_, previous_);
+        previous_settings_ = accumulation_settings_;
+      }
+
+      first_sample = 0;
+      if (settings.row_count && accumulation_.size() == pixel_count) {
+        // bands only clear their own rows, so a worker's cost stays with
+        // the rows it traces
+        const uint32_t first_row =
+            std::min(settings.first_row, settings.height);
+        const uint32_t row_count =
+            std::min(settings.row_count, settings.height - first_row);
+        const size_t first = static_cast<size_t>(first_row) * settings.width;
+        const size_t last =
+            first + static_cast<size_t>(row_count) * settings.width;
+        auto clear = [&](auto& column, const auto& value) {
+          std::fill(column.begin() + first, column.begin() + last, value);
+        };
+        clear(accumulation_, glm::vec3(0.f));
+        clear(sample_counts_, 0);
+        clear(luminance_squares_, 0.f);
+        clear(albedo_sums_, glm::vec3(0.f));
+        clear(normal_sums_, glm::vec3(0.f));
+        clear(position_sums_, glm::vec3(0.f));
+      } else {
+        accumulation_.assign(pixel_count, glm::vec3(0.f));
+        sample_counts_.assign(pixel_count, 0);
+        luminance_squares_.assign(pixel_count, 0.f);
+        albedo_sums_.assign(pixel_count, glm::vec3(0.f));
+        normal_sums_.assign(pixel_count, glm::vec3(0.f));
+        position_sums_.assign(pixel_count, glm::vec3(0.f));
+      }
+      history_.clear();
+    }
+    accumulation_settings_ = settings;
+
+    // samples to trace this pass, zero only re-resolves the image
+    int samples = std::max(settings.samples_per_pixel - first_sample, 0);
+    if (settings.progressive) {
+      samples = std::min(samples, settings.samples_per_frame);
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    // checkpoint intervals count from the start of the accumulation
+    if (!first_sample ||
+        last_checkpoint_ == std::chrono::steady_clock::time_point{}) {
+      last_checkpoint_ = std::chrono::steady_clock::now();
+    }
+
+    // zero samples only resolves the image again for new display settings
+    bool completed = pixel_count &&
+                     (!samples ||
+                      (world && materials &&
+                       RenderPass(settings, *world, *materials, lights.get(),
+                                  first_sample, samples)));
+    // the first pass of a moved camera found the first hits to reproject to
+    completed =
+        completed && (!reproject_pending_ || ReprojectHistory(settings));
+
+    auto traced = std::chrono::high_resolution_clock::now();
+
+    // bands are only read back as accumulation
+    completed =
+        completed && (settings.row_count || ResolveFramebuffer(settings));
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // only whole images are checkpointed, and never twice at a time, so the
+    // last pass waits for the previous checkpoint instead of skipping it
+    const bool checkpoint =
+        completed && samples && !checkpoint_path.empty() && !settings.row_count;
+    const bool is_final =
+        first_sample + samples >= settings.samples_per_pixel ||
+        (settings.adaptive_sampling &&
+         pass_stats_.converged_pixels == pixel_count);
+    if (checkpoint && is_final) {
+      checkpoint_writer_->Wait();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    is_tracing_ = false;
+    idle_.notify_all();
+
+    // drop passes that were cancelled or went stale while tracing
+    if (!completed || reset_requested_) {
+      reset_requested_ = true;
+      continue;
+    }
+
+    accumulated_samples_ = first_sample + samples;
+    // nothing left to trace once every pixel converged
+    if (settings.adaptive_sampling && pixel_count &&
+        pass_stats_.converged_pixels == pixel_count) {
+      accumulated_samples_ =
+          std::max(accumulated_samples_, settings.samples_per_pixel);
+    }
+    pass_time_ =
+        std::chrono::duration_cast<std::chrono::duration<float, std::micro>>(
+            end - begin)
+            .count() /
+        1000.f;
+
+    // passes that only re-resolve keep the stats of the last traced one
+    if (samples) {
+      pass_stats_.pass_time = pass_time_;
+      pass_stats_.resolve_time =
+          std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(
+              end - traced)
+              .count();
+      stats_ = pass_stats_;
+    }
+
+    // copied while the buffers cannot be read or loaded, written meanwhile
+    const auto now = std::chrono::steady_clock::now();
+    if (checkpoint &&
+        (is_final ||
+         (std::chrono::duration<float>(now - last_checkpoint_).count() >=
+              checkpoint_interval &&
+          !checkpoint_writer_->IsBusy()))) {
+      CopyAccumulation(settings, accumulated_samples_, 0, settings.height,
+                       checkpoint_writer_->GetBuffer());
+      checkpoint_writer_->Submit(checkpoint_path, settings,
+                                 checkpoint_scene_hash);
+      last_checkpoint_ = now;
+    }
+
+    std::swap(back_, ready_);
+    has_new_framebuffer_ = true;
+    published_.notify_all();
+  }
+}
+
+bool Renderer::HasWork() const {
+  if (render_requested_) {
+    return true;
+  }
+
+  if (resolve_requested_ && accumulated_samples_ > 0) {
+    return true;
+  }
+
+  if (!playing_) {
+    return false;
+  }
+
+  // one-shot renders keep re-rendering while playing
+  if (!settings_.progressive) {
+    return true;
+  }
+
+  return reset_requested_ ||
+         accumulated_samples_ < settings_.samples_per_pixel;
+}
+
+bool Renderer::RenderPass(const RenderSettings& settings,
+                          const Hittable& world,
+                          const MaterialTable& materials,
+                          const LightList* lights, int first_sample,
+                          int samples) {
+  const uint32_t width = settings.width;
+  const uint32_t height = settings.height;
+
+  Camera camera = MakeCamera(settings);
+
+  const LightList* sampled_lights =
+      settings.next_event_estimation ? lights : nullptr;
+  PathIntegrator integrator(world, materials, settings.bounce_limit,
+                            sampled_lights);
+  WavefrontIntegrator wavefront(world, materials, settings.bounce_limit,
+                                sampled_lights);
+
+  const uint32_t seed = static_cast<uint32_t>(settings.seed);
+  const int total_samples = first_sample + samples;
+
+  // samples traced and pixels converged, summed once per tile
+  std::atomic<uint64_t> traced_samples{0};
+  std::atomic<uint32_t> converged_pixels{0};
+
+  // store the running sums of a pixel, ResolveFramebuffer displays them
+  auto store_pixel = [&](uint32_t pixel, const glm::vec3& pixel_color,
+                         int sample_count) {
+    accumulation_[pixel] = pixel_color;
+    sample_counts_[pixel] = sample_count;
+  };
+
+  auto add_sample = [&](uint32_t pixel, glm::vec3& pixel_color,
+                        const glm::vec3& color, const SurfaceAov& aov) {
+    pixel_color += color;
+    albedo_sums_[pixel] += aov.albedo;
+    normal_sums_[pixel] += aov.normal;
+    position_sums_[pixel] += aov.position;
+
+    const float luminance = MathUtils::Luminance(color);
+    luminance_squares_[pixel] += luminance * luminance;
+  };
+
+  auto is_converged = [&](uint32_t pixel, const glm::vec3& pixel_color,
+                          int sample_count) {
+    return IsConverged(settings, pixel_color, luminance_squares_[pixel],
+                       sample_count);
+  };
+
+  // trace samples [first_sample, total_samples) of one pixel, samples are
+  // added in index order so a progressive render matches a one-shot render,
+  // adaptive sampling stops a pixel at the first converged sample count,
+  // until then its count is always first_sample when a pass starts
+  auto trace_pixel = [&](uint32_t x, uint32_t y, uint64_t& tile_samples,
+                         uint32_t& tile_converged) {
+    const uint32_t pixel = y * width + x;
+    glm::vec3 pixel_color = accumulation_[pixel];
+
+    int s = sample_counts_[pixel];
+    for (; s < total_samples; ++s) {
+      if (is_converged(pixel, pixel_color, s)) {
+        break;
+      }
+
+      Sampler sampler =
+          Sampler::ForPixel(seed, pixel, static_cast<uint32_t>(s));
+
+      float u = static_cast<float>(x + MathUtils::RandomFloat(sampler)) /
+                static_cast<float>(width - 1);
+      float v = 1.f - static_cast<float>(y + MathUtils::RandomFloat(sampler)) /
+                          static_cast<float>(height - 1);
+
+      Ray ray = camera.GetRay(u, v, sampler);
+      SurfaceAov aov{};
+      glm::vec3 color = integrator.Li(ray, sampler, &aov);
+      add_sample(pixel, pixel_color, color, aov);
+      ++tile_samples;
+    }
+
+    tile_converged += is_converged(pixel, pixel_color, s) ? 1u : 0u;
+    store_pixel(pixel, pixel_color, s);
+  };
+
+  // trace the same samples for a row of up to PACKET_SIZE pixels, primary
+  // rays go through the packet kernels, bounces continue lane by lane
+  auto trace_packet = [&](uint32_t x, uint32_t y, int lane_count,
+                          uint64_t& tile_samples, uint32_t& tile_converged) {
+    const uint32_t first_pixel = y * width + x;
+
+    glm::vec3 pixel_colors[PACKET_SIZE];
+    int sample_counts[PACKET_SIZE]{};
+    for (int lane = 0; lane < lane_count; ++lane) {
+      pixel_colors[lane] = accumulation_[first_pixel + lane];
+      sample_counts[lane] = sample_counts_[first_pixel + lane];
+    }
+
+    for (int s = first_sample; s < total_samples; ++s) {
+      // converged lanes drop out of the packet
+      uint32_t mask = 0;
+      for (int lane = 0; lane < lane_count; ++lane) {
+        if (sample_counts[lane] == s &&
+            !is_converged(first_pixel + lane, pixel_colors[lane], s)) {
+          mask |= 1u << lane;
+        }
+      }
+      if (!mask) {
+        break;
+      }
+
+      Sampler samplers[PACKET_SIZE];
+      float u[PACKET_SIZE]{};
+      float v[PACKET_SIZE]{};
+
+      for (int lane = 0; lane < lane_count; ++lane) {
+        if (!(mask & (1u << lane))) {
+          continue;
+        }
+
+        samplers[lane] = Sampler::ForPixel(seed, first_pixel + lane,
+                                           static_cast<uint32_t>(s));
+
+        u[lane] = static_cast<float>(x + lane +
+                                     MathUtils::RandomFloat(samplers[lane])) /
+                  static_cast<float>(width - 1);
+        v[lane] = 1.f - static_cast<float>(
+                            y + MathUtils::RandomFloat(samplers[lane])) /
+                            static_cast<float>(height - 1);
+      }
+
+      RayPacket packet{};
+      camera.GetRayPacket(u, v, samplers, mask, packet);
+      packet.t_min = PathIntegrator::T_MIN;
+
+      PacketHit hit{};
+      hit.Reset(INFINITY_F);
+      RAY_TRACING_STATS_ADD(rays[0], Stats::CountLanes(mask));
+      world.HitPacket(packet, mask, hit);
+
+      for (int lane = 0; lane < lane_count; ++lane) {
+        if (!(mask & (1u << lane))) {
+          continue;
+        }
+
+        Ray ray = packet.GetRay(lane);
+        const Hittable* object = hit.object[lane];
+        glm::vec3 color{};
+
+        // rebuild the full record from the closest object only, the packet
+        // kernels agree with the scalar ones so t bounds the search
+        HitRecord record{};
+        SurfaceAov aov{};
+        if (!object) {
+          color = PathIntegrator::Background(ray);
+          aov.albedo = color;
+        } else if (object->Hit(ray, PathIntegrator::T_MIN, hit.t[lane],
+                               record)) {
+          color = integrator.Li(ray, record, samplers[lane], &aov);
+        } else {
+          color = integrator.Li(ray, samplers[lane], &aov);
+        }
+
+        add_sample(first_pixel + lane, pixel_colors[lane], color, aov);
+        ++sample_counts[lane];
+        ++tile_samples;
+      }
+    }
+
+    for (int lane = 0; lane < lane_count; ++lane) {
+      const uint32_t pixel = first_pixel + lane;
+      tile_converged +=
+          is_converged(pixel, pixel_colors[lane], sample_counts[lane]) ? 1u
+                                                                       : 0u;
+      store_pixel(pixel, pixel_colors[lane], sample_counts[lane]);
+    }
+  };
+
+  // trace one sample index of every unconverged pixel of a tile as a wave,
+  // waves run in sample order so the sums match the other paths
+  auto trace_wave = [&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+                        bool use_packets, WavefrontQueue& queue,
+                        uint64_t& tile_samples, uint32_t& tile_converged) {
+    for (int s = first_sample; s < total_samples; ++s) {
+      if (thread_pool_.IsCancelled()) {
+        return;
+      }
+
+      queue.paths.clear();
+      for (uint32_t y = y0; y < y1; ++y) {
+        for (uint32_t x = x0; x < x1; ++x) {
+          const uint32_t pixel = y * width + x;
+          if (sample_counts_[pixel] != s ||
+              is_converged(pixel, accumulation_[pixel], s)) {
+            continue;
+          }
+
+          WavefrontPath path{};
+          path.pixel = pixel;
+          path.sampler =
+              Sampler::ForPixel(seed, pixel, static_cast<uint32_t>(s));
+
+          float u = static_cast<float>(x + MathUtils::RandomFloat(
+                                               path.sampler)) /
+                    static_cast<float>(width - 1);
+          float v = 1.f - static_cast<float>(y + MathUtils::RandomFloat(
+                                                     path.sampler)) /
+                              static_cast<float>(height - 1);
+
+          path.ray = camera.GetRay(u, v, path.sampler);
+          queue.paths.push_back(path);
+        }
+      }
+      if (queue.paths.empty()) {
+        break;
+      }
+
+      wavefront.Trace(queue, use_packets);
+
+      for (const WavefrontPath& path : queue.paths) {
+        add_sample(path.pixel, accumulation_[path.pixel], path.radiance,
+                   path.aov);
+        ++sample_counts_[path.pixel];
+      }
+      tile_samples += queue.paths.size();
+    }
+
+    for (uint32_t y = y0; y < y1; ++y) {
+      for (uint32_t x = x0; x < x1; ++x) {
+        const uint32_t pixel = y * width + x;
+        tile_converged += is_converged(pixel, accumulation_[pixel],
+                                       sample_counts_[pixel])
+                              ? 1u
+                              : 0u;
+      }
+    }
+  };
+
+  // zero bounces never reach the world, nothing to gain from packets
+  const bool use_packets = settings.packet_tracing && settings.bounce_limit > 0;
+
+  // queues only grow, steady passes reuse them
+  if (settings.wavefront &&
+      wavefront_queues_.size() < thread_pool_.GetThreadCount()) {
+    wavefront_queues_.resize(thread_pool_.GetThreadCount());
+  }
+
+  // set image pixel data tile by tile
+  const uint32_t tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  const uint32_t tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+  // tiles stay on the grid of the whole image and are cut at the rows
+  const uint32_t first_row =
+      settings.row_count ? std::min(settings.first_row, height) : 0;
+  const uint32_t last_row =
+      settings.row_count ? std::min(settings.row_count, height - first_row) +
+                               first_row
+                         : height;
+  const uint32_t first_tile = first_row / TILE_SIZE * tiles_x;
+  const uint32_t tile_count =
+      (last_row + TILE_SIZE - 1) / TILE_SIZE * tiles_x - first_tile;
+
+  auto trace_tile = [&](uint32_t tile, uint32_t worker) {
+    const uint32_t x0 = (tile % tiles_x) * TILE_SIZE;
+    const uint32_t y0 = std::max((tile / tiles_x) * TILE_SIZE, first_row);
+    const uint32_t x1 = std::min(x0 + TILE_SIZE, width);
+    const uint32_t y1 = std::min((tile / tiles_x + 1) * TILE_SIZE, last_row);
+
+    uint64_t tile_samples = 0;
+    uint32_t tile_converged = 0;
+
+    if (settings.wavefront) {
+      trace_wave(x0, y0, x1, y1, use_packets, wavefront_queues_[worker],
+                 tile_samples, tile_converged);
+      traced_samples += tile_samples;
+      converged_pixels += tile_converged;
+      return;
+    }
+
+    for (uint32_t y = y0; y < y1; ++y) {
+      if (thread_pool_.IsCancelled()) {
+        return;
+      }
+
+      if (use_packets) {
+        for (uint32_t x = x0; x < x1; x += PACKET_SIZE) {
+          trace_packet(
+              x, y,
+              static_cast<int>(std::min<uint32_t>(PACKET_SIZE, x1 - x)),
+              tile_samples, tile_converged);
+        }
+        continue;
+      }
+
+      for (uint32_t x = x0; x < x1; ++x) {
+        trace_pixel(x, y, tile_samples, tile_converged);
+      }
+    }
+
+    traced_samples += tile_samples;
+    converged_pixels += tile_converged;
+  };
+
+  // published along with the pass
+  auto finish_pass = [&](bool completed) {
+    pass_stats_.samples = traced_samples.load();
+    pass_stats_.converged_pixels = converged_pixels.load();
+    return completed;
+  };
+
+  if (!Stats::IsEnabled()) {
+    return finish_pass(thread_pool_.ParallelFor(
+        tile_count, [&](uint32_t tile, uint32_t worker) {
+          trace_tile(first_tile + tile, worker);
+        }));
+  }
+
+  // every tile and worker slot is written by one worker at a time, the
+  // thread local counters are handed over once a tile is done
+  const uint32_t worker_count = thread_pool_.GetThreadCount();
+  pass_stats_.counters = RayCounters{};
+  pass_stats_.tiles_x = tiles_x;
+  pass_stats_.tiles_y = tiles_y;
+  pass_stats_.tile_times.assign(tiles_x * tiles_y, 0.f);
+  pass_stats_.worker_times.assign(worker_count, 0.f);
+  worker_counters_.assign(worker_count, RayCounters{});
+
+  bool completed = thread_pool_.ParallelFor(
+      tile_count, [&](uint32_t index, uint32_t worker) {
+        const uint32_t tile = first_tile + index;
+        auto begin = std::chrono::high_resolution_clock::now();
+
+        trace_tile(tile, worker);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        float tile_time = std::chrono::duration_cast<
+                              std::chrono::duration<float, std::milli>>(
+                              end - begin)
+                              .count();
+
+        pass_stats_.tile_times[tile] = tile_time;
+        pass_stats_.worker_times[worker] += tile_time;
+        worker_counters_[worker].Merge(Stats::TakeLocal());
+      });
+
+  for (const RayCounters& counters : worker_counters_) {
+    pass_stats_.counters.Merge(counters);
+  }
+
+  return finish_pass(completed);
+}
+
+bool Renderer::ResolveFramebuffer(const RenderSettings& settings) {
+  const uint32_t width = settings.width;
+  const uint32_t height = settings.height;
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+
+  Framebuffer& framebuffer = buffers_[back_];
+  framebuffer.width = width;
+  framebuffer.height = height;
+  framebuffer.pixels.resize(pixel_count);
+  framebuffer.radiance.resize(settings.resolve_radiance ? pixel_count : 0);
+
+  if (color_lut_.GetGamma() != settings.gamma) {
+    color_lut_.Build(settings.gamma);
+  }
+
+  // reprojected history counts as samples of its own
+  const glm::vec3* sums = accumulation_.data();
+  const glm::vec3* albedo_sums = albedo_sums_.data();
+  const glm::vec3* normal_sums = normal_sums_.data();
+  const int* sample_counts = sample_counts_.data();
+  if (!history_.empty()) {
+    if (!MergeHistory(settings)) {
+      return false;
+    }
+
+    sums = merged_sums_.data();
+    albedo_sums = merged_albedo_sums_.data();
+    normal_sums = merged_normal_sums_.data();
+    sample_counts = merged_counts_.data();
+  }
+
+  // the kernels below display the denoised sums instead
+  if (DenoiseMode::NONE != settings.denoise) {
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    denoised_.resize(pixel_count);
+    if (!denoiser_.Denoise(settings.denoise, width, height, sums,
+                           albedo_sums, normal_sums, sample_counts,
+                           denoised_.data(), thread_pool_)) {
+      return false;
+    }
+    sums = denoised_.data();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    pass_stats_.denoise_time =
+        std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(
+            end - begin)
+            .count();
+  } else {
+    pass_stats_.denoise_time = 0.f;
+  }
+
+  ResolveParams params{};
+  params.exposure_scale = std::exp2(settings.exposure);
+  params.tonemap = settings.tonemap;
+  params.lut = color_lut_.GetData();
+
+  const PacketKernels& kernels = Simd::GetKernels();
+
+  // bands of whole rows keep every kernel call on contiguous memory
+  return ForEachBand(width, height, [&](size_t first, size_t last) {
+    kernels.resolve_colors(&sums[first], &sample_counts[first],
+                           static_cast<uint32_t>(last - first), params,
+                           &framebuffer.pixels[first]);
+
+    if (settings.resolve_radiance) {
+      for (size_t pixel = first; pixel < last; ++pixel) {
+        framebuffer.radiance[pixel] =
+            sums[pixel] /
+            static_cast<float>(std::max(sample_counts[pixel], 1));
+      }
+    }
+  });
+}
+
+bool Renderer::ForEachBand(
+    uint32_t width, uint32_t height,
+    const FunctionRef<void(size_t, size_t)>& pixels) {
+  const size_t pixel_count = static_cast<size_t>(width) * height;
+  const uint32_t bands = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+  return thread_pool_.ParallelFor(bands, [&](uint32_t band, uint32_t) {
+    const size_t first = static_cast<size_t>(band) * TILE_SIZE * width;
+    pixels(first, std::min(first + TILE_SIZE * width, pixel_count));
+  });
+}
+
+bool Renderer::SnapshotHistory(const RenderSettings& settings,
+                               std::vector<HistoryPixel>& snapshot) {
+  snapshot.assign(accumulation_.size(), HistoryPixel{});
+
+  return ForEachBand(settings.width, settings.height, [&](size_t first,
+                                                         size_t last) {
+    for (size_t pixel = first; pixel < last; ++pixel) {
+      const int samples = sample_counts_[pixel];
+      const HistoryPixel* history =
+          history_.empty() ? nullptr : &history_[pixel];
+      const int history_weight =
+          history ? std::max(history->weight - samples, 0) : 0;
+
+      const int weight = samples + history_weight;
+      if (!weight) {
+        continue;
+      }
+
+      HistoryPixel& merged = snapshot[pixel];
+      merged.radiance = accumulation_[pixel];
+      merged.albedo = albedo_sums_[pixel];
+      merged.normal = normal_sums_[pixel];
+      merged.position = position_sums_[pixel];
+      if (history_weight) {
+        const float scale = static_cast<float>(history_weight);
+        merged.radiance += history->radiance * scale;
+        merged.albedo += history->albedo * scale;
+        merged.normal += history->normal * scale;
+        merged.position += history->position * scale;
+      }
+
+      const float scale = 1.f / static_cast<float>(weight);
+      merged.radiance *= scale;
+      merged.albedo *= scale;
+      merged.normal *= scale;
+      merged.position *= scale;
+      merged.weight = std::min(weight, REPROJECTION_MAX_SAMPLES);
+    }
+  });
+}
+
+bool Renderer::ReprojectHistory(const RenderSettings& settings) {
+  const uint32_t width = settings.width;
+  const uint32_t height = settings.height;
+  const Camera previous_camera = MakeCamera(previous_settings_);
+
+  history_.assign(accumulation_.size(), HistoryPixel{});
+
+  bool completed = ForEachBand(width, height, [&](size_t first, size_t last) {
+    for (size_t pixel = first; pixel < last; ++pixel) {
+      const int samples = sample_counts_[pixel];
+      if (!samples) {
+        continue;
+      }
+
+      const float scale = 1.f / static_cast<float>(samples);
+      const glm::vec3 position = position_sums_[pixel] * scale;
+      const glm::vec3 normal = normal_sums_[pixel] * scale;
+      const float normal_length = glm::length(normal);
+
+      float u = 0.f;
+      float v = 0.f;
+      if (normal_length < REPROJECTION_MIN_NORMAL_LENGTH ||
+          !previous_camera.Project(position, u, v)) {
+        continue;
+      }
+
+      // continuous pixel coordinates of the previous view, the inverse of
+      // the mapping RenderPass jitters over
+      const float x = u * static_cast<float>(width - 1) - 0.5f;
+      const float y = (1.f - v) * static_cast<float>(height - 1) - 0.5f;
+      const float x0 = std::floor(x);
+      const float y0 = std::floor(y);
+      const float tolerance = REPROJECTION_DEPTH_TOLERANCE *
+                              glm::length(position - settings.origin);
+
+      // bilinear over the previous pixels that saw the same surface
+      HistoryPixel reprojected{};
+      float weight_sum = 0.f;
+      float sample_sum = 0.f;
+      for (int tap = 0; tap < 4; ++tap) {
+        const float tap_x = x0 + static_cast<float>(tap & 1);
+        const float tap_y = y0 + static_cast<float>(tap >> 1);
+        if (tap_x < 0.f || tap_y < 0.f || tap_x >= static_cast<float>(width) ||
+            tap_y >= static_cast<float>(height)) {
+          continue;
+        }
+
+        const HistoryPixel& previous =
+            previous_[static_cast<size_t>(tap_y) * width +
+                      static_cast<size_t>(tap_x)];
+        const float previous_length = glm::length(previous.normal);
+        if (!previous.weight ||
+            previous_length < REPROJECTION_MIN_NORMAL_LENGTH ||
+            glm::dot(previous.normal, normal) <
+                REPROJECTION_MIN_COS * previous_length * normal_length ||
+            glm::length(previous.position - position) > tolerance) {
+          continue;
+        }
+
+        const float weight = (1.f - std::abs(x - tap_x)) *
+                             (1.f - std::abs(y - tap_y));
+        reprojected.radiance += previous.radiance * weight;
+        reprojected.albedo += previous.albedo * weight;
+        reprojected.normal += previous.normal * weight;
+        reprojected.position += previous.position * weight;
+        sample_sum += static_cast<float>(previous.weight) * weight;
+        weight_sum += weight;
+      }
+
+      // disoccluded, only fresh samples
+      if (weight_sum <= 0.f) {
+        continue;
+      }
+
+      const float inv_weight = 1.f / weight_sum;
+      reprojected.radiance *= inv_weight;
+      reprojected.albedo *= inv_weight;
+      reprojected.normal *= inv_weight;
+      reprojected.position *= inv_weight;
+      reprojected.weight = static_cast<int>(sample_sum * inv_weight + 0.5f);
+      history_[pixel] = reprojected;
+    }
+  });
+
+  reproject_pending_ = !completed;
+
+  return completed;
+}
+
+bool Renderer::MergeHistory(const RenderSettings& settings) {
+  const size_t pixel_count = accumulation_.size();
+  merged_sums_.resize(pixel_count);
+  merged_albedo_sums_.resize(pixel_count);
+  merged_normal_sums_.resize(pixel_count);
+  merged_counts_.resize(pixel_count);
+
+  return ForEachBand(settings.width, settings.height, [&](size_t first,
+                                                         size_t last) {
+    for (size_t pixel = first; pixel < last; ++pixel) {
+      const HistoryPixel& history = history_[pixel];
+      const int history_weight =
+          std::max(history.weight - sample_counts_[pixel], 0);
+      const float scale = static_cast<float>(history_weight);
+
+      merged_sums_[pixel] = accumulation_[pixel] + history.radiance * scale;
+      merged_albedo_sums_[pixel] = albedo_sums_[pixel] + history.albedo * scale;
+      merged_normal_sums_[pixel] = normal_sums_[pixel] + history.normal * scale;
+      merged_counts_[pixel] = sample_counts_[pixel] + history_weight;
+    }
+  });
+}
+
+void Renderer::CopyAccumulation(const RenderSettings& settings, int samples,
+                                uint32_t first_row, uint32_t row_count,
+                                Accumulation& accumulation) const {
+  // empty before the first pass
+  const size_t pixel_count =
+      static_cast<size_t>(settings.width) * settings.height;
+  const bool is_traced = pixel_count && accumulation_.size() == pixel_count;
+
+  accumulation.width = is_traced ? settings.width : 0;
+  accumulation.height = is_traced ? settings.height : 0;
+  accumulation.first_row = std::min(first_row, accumulation.height);
+  accumulation.row_count =
+      std::min(row_count, accumulation.height - accumulation.first_row);
+  accumulation.samples = is_traced ? samples : 0;
+
+  const size_t first =
+      static_cast<size_t>(accumulation.first_row) * accumulation.width;
+  const size_t last =
+      first + static_cast<size_t>(accumulation.row_count) * accumulation.width;
+  auto copy = [&](const auto& column, auto& rows) {
+    rows.assign(column.begin() + first, column.begin() + last);
+  };
+  copy(accumulation_, accumulation.sums);
+  copy(sample_counts_, accumulation.sample_counts);
+  copy(luminance_squares_, accumulation.luminance_squares);
+  copy(albedo_sums_, accumulation.albedo_sums);
+  copy(normal_sums_, accumulation.normal_sums);
+  copy(position_sums_, accumulation.position_sums);
+}
+
+bool Renderer::IsConverged(const RenderSettings& settings,
+                           const glm::vec3& pixel_color,
+                           float luminance_squares, int sample_count) {
+  if (!settings.adaptive_sampling ||
+      sample_count < std::max(settings.adaptive_min_samples, 2)) {
+    return false;
+  }
+
+  const float count = static_cast<float>(sample_count);
+  const float mean = MathUtils::Luminance(pixel_color) / count;
+  const float variance = std::max(luminance_squares / count - mean * mean,
+                                  0.f) *
+                         count / (count - 1.f);
+
+  // standard error of the square root of the mean, roughly the error on
+  // screen, so dark pixels are not held to an absolute bound
+  const float error =
+      std::sqrt(variance / count) / (2.f * std::sqrt(std::max(mean, 0.f)) +
+                                     ADAPTIVE_ERROR_EPSILON);
+
+  return error < settings.adaptive_threshold;
+}
+
+}  // namespace rt
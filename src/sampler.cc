@@ -0,0 +1,38 @@
+/**
+ * @file sampler.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "sampler.h"
+
+#include <cstdint>
+
+namespace rt {
+
+Sampler::Sampler(uint64_t seed, uint64_t sequence)
+    : state_{0u}, increment_{(sequence << 1u) | 1u} {
+  NextUint();
+  state_ += seed;
+  NextUint();
+}
+
+Sampler Sampler::ForPixel(uint32_t seed, uint32_t pixel, uint32_t sample) {
+  uint64_t key = (static_cast<uint64_t>(seed) << 32u) | pixel;
+
+  return Sampler(Hash(key), sample);
+}
+
+uint64_t Sampler::Hash(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30u)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27u)) * 0x94d049bb133111ebull;
+
+  return value ^ (value >> 31u);
+}
+
+}  // namespace rt
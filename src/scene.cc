@@ -12,8 +12,14 @@
 
 #include <algorithm>
 #include <chrono>
-#include <execution>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <future>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #define RAY_TRACING_INCLUDE_IMGUI
 #include <imgui.h>
@@ -25,31 +31,61 @@
 #define RAY_TRACING_INCLUDE_GLM
 #include <glm/glm.hpp>
 
-#include "camera.h"
+#include "bvh.h"
+#include "checkpoint.h"
 #include "config.h"
-#include "dielectric.h"
-#include "hittable_list.h"
-#include "lambertian.h"
-#include "material.h"
-#include "metal.h"
-#include "ray.h"
-#include "sphere.h"
-#include "utils.h"
+#include "demo_scene.h"
+#include "denoiser.h"
+#include "gpu_renderer.h"
+#include "hittable.h"
+#include "image.h"
+#include "instance.h"
+#include "light_list.h"
+#include "material_table.h"
+#include "render_stats.h"
+#include "renderer.h"
+#include "sampler.h"
+#include "scene_file.h"
+#include "simd.h"
 
 namespace rt {
 
 Scene::Scene(VkPhysicalDevice& physical_device, VkDevice& device,
-             VkQueue& graphics_queue, VkCommandPool& command_pool)
+             VkQueue& graphics_queue, VkCommandPool& command_pool,
+             uint32_t graphics_family)
     : physical_device_{physical_device},
       device_{device},
       graphics_queue_{graphics_queue},
-      command_pool_{command_pool} {}
-
-Scene::~Scene() {
-  delete[] image_;
-  delete[] image_data_;
+      command_pool_{command_pool} {
+  // world is built once and shared with the render thread
+  SceneDescription scene = DemoScene::Build();
+  scene_hash_ = SceneFile::Hash(scene);
+  materials_ = std::make_shared<MaterialTable>();
+  geometry_ = SceneFile::BuildGeometry(scene, *materials_);
+  instances_ = scene.instances;
+  top_level_ = SceneFile::BuildTopLevel(geometry_, instances_);
+  lights_ = std::make_shared<LightList>();
+  SceneFile::BuildLights(geometry_, instances_, *lights_);
+  renderer_.SetWorld(top_level_, materials_, lights_);
+
+  // the viewer still works on the cpu without the compute backend
+  if (GpuRenderer::IsSupported(physical_device_, graphics_family)) {
+    try {
+      gpu_renderer_ = std::make_unique<GpuRenderer>(
+          physical_device_, device_, graphics_queue_, command_pool_,
+          graphics_family);
+      gpu_renderer_->SetWorld(scene, geometry_);
+    } catch (const std::exception& e) {
+      gpu_renderer_.reset();
+      gpu_error_ = e.what();
+    }
+  } else {
+    gpu_error_ = "GPU: no 64 bit integers or compute on this device";
+  }
 }
 
+Scene::~Scene() = default;
+
 void Scene::OnUIRender() {
   // imgui: scene viewport
   ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.f, 0.f));
@@ -58,6 +94,10 @@ void Scene::OnUIRender() {
   width_ = static_cast<uint32_t>(ImGui::GetContentRegionAvail().x);
   height_ = static_cast<uint32_t>(ImGui::GetContentRegionAvail().y);
 
+  // pick up the latest finished pass before drawing
+  UpdateRebuild();
+  UpdateImage();
+
   // imgui: draw image
   if (image_ && width_ && height_) {
     ImGui::Image(image_->GetDescritorSet(),
@@ -92,11 +132,26 @@ void Scene::OnUIRender() {
   // ImGui::Text("FPS: %.2f", delta_time_ ? 1000.f / delta_time_ : 0.f);
   // imgui text: scene extent detail
   ImGui::Text("Scene: %d * %d", width_, height_);
+  // imgui text: packet kernels picked for this cpu
+  ImGui::Text("SIMD: %s", Simd::GetIsaName(Simd::GetIsa()));
+
+  ImGui::EndChild();
+
+  // imgui child window: profile
+  ImGui::BeginChild("Profile", ImVec2(0.f, 230.f), true,
+                    window_flags & ~ImGuiWindowFlags_NoScrollWithMouse);
+
+  if (ImGui::BeginMenuBar()) {
+    ImGui::BeginMenu("Profile", false);
+    ImGui::EndMenuBar();
+  }
+
+  RenderStatsUI();
 
   ImGui::EndChild();
 
   //  imgui child window: ray
-  ImGui::BeginChild("Ray", ImVec2(0.f, 150.f), true, window_flags);
+  ImGui::BeginChild("Ray", ImVec2(0.f, 200.f), true, window_flags);
 
   if (ImGui::BeginMenuBar()) {
     ImGui::BeginMenu("Ray", false);
@@ -117,6 +172,13 @@ void Scene::OnUIRender() {
   ImGui::DragInt("##BounceLimit", &bounce_limit_, 1.f, 1, 1000, "%d",
                  ImGuiSliderFlags_AlwaysClamp);
 
+  // imgui input: seed
+  ImGui::Text("Seed");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(50.f);
+  ImGui::DragInt("##Seed", &seed_, 1.f, 0, INT32_MAX, "%d",
+                 ImGuiSliderFlags_AlwaysClamp);
+
   // imgui input: gamma
   ImGui::Text("Gamma");
   ImGui::SameLine();
@@ -124,10 +186,59 @@ void Scene::OnUIRender() {
   ImGui::DragFloat("##Gamma", &gamma_, 0.01f, 0.f, 10.f, "%.2f",
                    ImGuiSliderFlags_AlwaysClamp);
 
+  // imgui input: exposure in stops
+  ImGui::Text("Exposure");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(50.f);
+  ImGui::DragFloat("##Exposure", &exposure_, 0.05f, -10.f, 10.f, "%.2f",
+                   ImGuiSliderFlags_AlwaysClamp);
+
+  // imgui combo: tonemap
+  const char* const tonemaps[] = {"None", "Reinhard", "ACES"};
+  ImGui::Text("Tonemap");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(90.f);
+  ImGui::Combo("##Tonemap", &tonemap_, tonemaps, 3);
+
+  ImGui::EndChild();
+
+  // imgui child window: world
+  ImGui::BeginChild("World", ImVec2(0.f, 100.f), true, window_flags);
+
+  if (ImGui::BeginMenuBar()) {
+    ImGui::BeginMenu("World", false);
+    ImGui::EndMenuBar();
+  }
+
+  // imgui input: scene file, .rtb binary or text
+  ImGui::Text("File");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(150.f);
+  ImGui::InputText("##ScenePath", scene_path_, sizeof(scene_path_));
+  ImGui::SameLine();
+  if (ImGui::Button("Load")) {
+    LoadWorld(scene_path_);
+  }
+
+  // imgui input: extra turn of every instance about its own y axis
+  if (!instances_.empty()) {
+    ImGui::Text("Turn");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(50.f);
+    if (ImGui::DragFloat("##InstanceTurn", &instance_turn_, 0.5f, -360.f,
+                         360.f, "%.1f", ImGuiSliderFlags_AlwaysClamp)) {
+      UpdateInstances();
+    }
+  }
+
+  if (!scene_error_.empty()) {
+    ImGui::TextWrapped("%s", scene_error_.c_str());
+  }
+
   ImGui::EndChild();
 
   // imgui child window: camera
-  ImGui::BeginChild("Camera", ImVec2(0.f, 150.f), true, window_flags);
+  ImGui::BeginChild("Camera", ImVec2(0.f, 175.f), true, window_flags);
 
   if (ImGui::BeginMenuBar()) {
     ImGui::BeginMenu("Camera", false);
@@ -139,6 +250,11 @@ void Scene::OnUIRender() {
   ImGui::SetNextItemWidth(150.f);
   ImGui::DragFloat3("##CameraOrigin", origin_, 0.01f, 0.f, 0.f, "%.2f");
 
+  ImGui::Text("Look At ");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(150.f);
+  ImGui::DragFloat3("##CameraLookAt", look_at_, 0.01f, 0.f, 0.f, "%.2f");
+
   ImGui::Text("FOV ");
   ImGui::SameLine();
   ImGui::SetNextItemWidth(50.f);
@@ -153,23 +269,143 @@ void Scene::OnUIRender() {
   ImGui::EndChild();
 
   //  imgui child window: render
-  ImGui::BeginChild("Render", ImVec2(0.f, 100.f), true, window_flags);
+  const float render_height = (is_adaptive_sampling_ ? 415.f : 350.f) +
+                              (checkpoint_error_.empty() ? 0.f : 25.f);
+  ImGui::BeginChild("Render", ImVec2(0.f, render_height), true,
+                    window_flags);
 
   if (ImGui::BeginMenuBar()) {
     ImGui::BeginMenu("Render", false);
     ImGui::EndMenuBar();
   }
 
+  // imgui combo: backend, without ray tracing the gpu traces spheres only
+  const bool is_ray_tracing =
+      gpu_renderer_ &&
+      GpuBackend::RAY_TRACING == gpu_renderer_->GetBackend();
+  const char* backends[] = {"CPU", is_ray_tracing ? "GPU (RT)" : "GPU"};
+  int backend = is_gpu_backend_ ? 1 : 0;
+  ImGui::Text("Backend");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(75.f);
+  if (ImGui::Combo("##Backend", &backend, backends, gpu_renderer_ ? 2 : 1)) {
+    is_gpu_backend_ = 1 == backend;
+  }
+
+  if (!gpu_renderer_) {
+    ImGui::TextWrapped("%s", gpu_error_.c_str());
+  } else if (is_gpu_backend_ && gpu_renderer_->HasSkippedGeometry()) {
+    ImGui::TextWrapped("GPU: meshes are not traced");
+  }
+
+  // imgui checkbox: progressive accumulation
+  ImGui::Checkbox("Progressive", &is_progressive_);
+
+  // imgui checkbox: simd packets for primary rays
+  ImGui::Checkbox("Packets", &is_packet_tracing_);
+
+  // imgui checkbox: sample the lights at every diffuse bounce
+  ImGui::Checkbox("Light Sampling", &is_next_event_estimation_);
+
+  // imgui checkbox: trace tiles bounce by bounce, same image
+  ImGui::Checkbox("Wavefront", &is_wavefront_);
+
+  // imgui checkbox: keep the accumulation where it survives a camera move
+  ImGui::Checkbox("Reproject", &is_reprojecting_);
+
+  // imgui checkbox: adaptive sampling, samples per pixel is the maximum
+  ImGui::Checkbox("Adaptive", &is_adaptive_sampling_);
+  if (is_adaptive_sampling_) {
+    ImGui::Text("Threshold");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(60.f);
+    ImGui::DragFloat("##AdaptiveThreshold", &adaptive_threshold_, 0.0005f,
+                     0.001f, 0.2f, "%.4f", ImGuiSliderFlags_AlwaysClamp);
+
+    ImGui::Text("Min/Max SPP");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(50.f);
+    ImGui::DragInt("##AdaptiveMinSamples", &adaptive_min_samples_, 1.f, 2,
+                   samples_per_pixel_, "%d", ImGuiSliderFlags_AlwaysClamp);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(50.f);
+    ImGui::DragInt("##AdaptiveMaxSamples", &samples_per_pixel_, 1.f, 1, 1000,
+                   "%d", ImGuiSliderFlags_AlwaysClamp);
+
+    if (is_gpu_backend_) {
+      ImGui::TextWrapped("GPU: samples every pixel uniformly");
+    }
+  }
+
+  // imgui combo: denoiser of the accumulation, oidn only if built with it
+  const char* const denoisers[] = {"None", "A-Trous", "OIDN"};
+  ImGui::Text("Denoise");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(90.f);
+  ImGui::Combo("##Denoise", &denoise_, denoisers,
+               Denoiser::HasOidn() ? 3 : 2);
+  if (denoise_ && is_gpu_backend_) {
+    ImGui::TextWrapped("GPU: not denoised");
+  }
+
+  // imgui input: samples per frame
+  ImGui::Text("Samples/Frame");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(50.f);
+  ImGui::DragInt("##SamplesPerFrame", &samples_per_frame_, 1.f, 1, 1000, "%d",
+                 ImGuiSliderFlags_AlwaysClamp);
+
+  // imgui input: render threads, zero means one per hardware thread
+  ImGui::Text("Threads");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(50.f);
+  if (ImGui::DragInt("##ThreadCount", &thread_count_, 0.1f, 0, 256, "%d",
+                     ImGuiSliderFlags_AlwaysClamp)) {
+    renderer_.SetThreadCount(static_cast<uint32_t>(thread_count_));
+  }
+
+  // imgui input: checkpoint file, resumed from once compatible settings are
+  // set, empty writes none
+  ImGui::Text("Checkpoint");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(110.f);
+  ImGui::InputText("##CheckpointPath", checkpoint_path_,
+                   sizeof(checkpoint_path_));
+  ImGui::SameLine();
+  if (ImGui::Button("Resume")) {
+    is_resume_requested_ = true;
+  }
+  if (!checkpoint_error_.empty()) {
+    ImGui::TextWrapped("%s", checkpoint_error_.c_str());
+  } else if (checkpoint_path_[0] && is_gpu_backend_) {
+    ImGui::TextWrapped("GPU: not checkpointed");
+  }
+
+  // imgui text: accumulated samples
+  ImGui::Text("Accumulated: %d/%d",
+              is_gpu_backend_ ? gpu_renderer_->GetAccumulatedSamples()
+                              : renderer_.GetAccumulatedSamples(),
+              samples_per_pixel_);
+
+  // imgui text: pixels adaptive sampling stopped
+  if (is_adaptive_sampling_ && !is_gpu_backend_ && width_ && height_) {
+    ImGui::Text("Converged: %.1f%%",
+                100.f * stats_.converged_pixels /
+                    (static_cast<float>(width_) * height_));
+  }
+
   // imgui: test button
   if (ImGui::Button("Test")) {
     Render();
   }
 
+  ImGui::SameLine();
+
   // imgui: play/pause button
-  // if (ImGui::Button(play_button_label_)) {
-  //   is_playing_ = !is_playing_;
-  //   play_button_label_ = is_playing_ ? "Pause" : "Play";
-  // }
+  if (ImGui::Button(play_button_label_)) {
+    is_playing_ = !is_playing_;
+    play_button_label_ = is_playing_ ? "Pause" : "Play";
+  }
 
   ImGui::EndChild();
   ImGui::PopStyleVar();
@@ -178,191 +414,332 @@ void Scene::OnUIRender() {
   ImGui::End();
   ImGui::PopStyleVar();
 
-  if (is_playing_) {
-    Render();
+  // hand the current settings to the render thread
+  RenderSettings settings{};
+  settings.width = width_;
+  settings.height = height_;
+  settings.origin = glm::vec3(origin_[0], origin_[1], origin_[2]);
+  settings.look_at = glm::vec3(look_at_[0], look_at_[1], look_at_[2]);
+  settings.fov = fov_;
+  settings.aperture = aperture_;
+  settings.focus_dist = focus_dist_;
+  settings.samples_per_pixel = samples_per_pixel_;
+  settings.samples_per_frame = samples_per_frame_;
+  settings.bounce_limit = bounce_limit_;
+  settings.seed = seed_;
+  settings.gamma = gamma_;
+  settings.exposure = exposure_;
+  settings.tonemap = static_cast<Tonemap>(tonemap_);
+  settings.denoise = static_cast<DenoiseMode>(denoise_);
+  settings.progressive = is_progressive_;
+  settings.packet_tracing = is_packet_tracing_;
+  settings.next_event_estimation = is_next_event_estimation_;
+  settings.wavefront = is_wavefront_;
+  settings.reprojection = is_reprojecting_;
+  settings.adaptive_sampling = is_adaptive_sampling_;
+  settings.adaptive_threshold = adaptive_threshold_;
+  settings.adaptive_min_samples = adaptive_min_samples_;
+
+  // only the selected backend traces
+  renderer_.SetSettings(settings);
+  renderer_.SetPlaying(is_playing_ && !is_gpu_backend_);
+
+  renderer_.SetCheckpoint(checkpoint_path_, CHECKPOINT_INTERVAL,
+                          GetSceneHash());
+  const std::string checkpoint_error = renderer_.TakeCheckpointError();
+  if (!checkpoint_error.empty()) {
+    checkpoint_error_ = checkpoint_error;
+  }
+  if (is_resume_requested_) {
+    is_resume_requested_ = false;
+
+    try {
+      Accumulation accumulation{};
+      if (!Checkpoint::Read(checkpoint_path_, settings, GetSceneHash(),
+                            accumulation)) {
+        throw std::runtime_error(
+            "Error::Scene: Checkpoint was traced with other settings!");
+      }
+      renderer_.LoadAccumulation(accumulation);
+      checkpoint_error_.clear();
+    } catch (const std::exception& e) {
+      checkpoint_error_ = e.what();
+    }
+  }
+
+  if (gpu_renderer_) {
+    gpu_renderer_->SetSettings(settings);
+    gpu_renderer_->SetPlaying(is_playing_ && is_gpu_backend_);
   }
 }
 
-void Scene::Render() {
-  // begin time
-  auto begin = std::chrono::high_resolution_clock::now();
-
-  if (!image_ || width_ != image_->GetWidth() ||
-      height_ != image_->GetHeight()) {
-    // create new image
-    image_ = new Image(width_, height_, physical_device_, device_,
-                       graphics_queue_, command_pool_);
-    // clear previous image data
-    delete[] image_data_;
-    // allocate new image data
-    image_data_ = new uint32_t[width_ * height_];
-
-    for (uint32_t i = 0; i < width_; ++i) {
-      horizontal_iterator_.push_back(i);
+void Scene::LoadWorld(const std::string& path) {
+  try {
+    SceneDescription scene = SceneFile::Load(path);
+    const uint64_t scene_hash = SceneFile::Hash(scene);
+
+    std::shared_ptr<MaterialTable> materials =
+        std::make_shared<MaterialTable>();
+    SceneGeometry geometry = SceneFile::BuildGeometry(scene, *materials);
+    std::shared_ptr<Bvh> top_level =
+        SceneFile::BuildTopLevel(geometry, scene.instances);
+    std::shared_ptr<LightList> lights = std::make_shared<LightList>();
+    SceneFile::BuildLights(geometry, scene.instances, *lights);
+
+    // a rebuild of the previous world must not be swapped in later
+    if (rebuild_.valid()) {
+      rebuild_.wait();
+      rebuild_ = {};
+    }
+
+    top_level_ = top_level;
+    lights_ = lights;
+    renderer_.SetWorld(top_level_, materials, lights_);
+    if (gpu_renderer_) {
+      gpu_renderer_->SetWorld(scene, geometry);
     }
-    for (uint32_t i = 0; i < height_; ++i) {
-      vertical_iterator_.push_back(i);
+
+    materials_ = materials;
+    geometry_ = geometry;
+    instances_ = scene.instances;
+    instance_turn_ = 0.f;
+    turned_objects_.clear();
+    scene_hash_ = scene_hash;
+
+    if (scene.has_camera) {
+      const CameraDescription& camera = scene.camera;
+      for (int i = 0; i < 3; ++i) {
+        origin_[i] = camera.origin[i];
+        look_at_[i] = camera.look_at[i];
+      }
+      fov_ = camera.fov;
+      aperture_ = camera.aperture;
+      focus_dist_ = camera.focus_dist;
     }
+
+    scene_error_.clear();
+  } catch (const std::exception& e) {
+    scene_error_ = e.what();
+  }
+}
+
+void Scene::UpdateInstances() {
+  if (instances_.empty()) {
+    return;
   }
 
-  // camera
-  glm::vec3 origin(origin_[0], origin_[1], origin_[2]);
-  glm::vec3 lookat(0.f);
-  glm::vec3 world_up(0.f, 1.f, 0.f);
+  // instances only allocate the first time they turn, later frames rewrite
+  // their transforms
+  turned_instances_ = instances_;
+  if (turned_objects_.size() != instances_.size()) {
+    turned_objects_.clear();
+    for (const InstanceDescription& instance : instances_) {
+      turned_objects_.push_back(std::make_shared<Instance>(
+          geometry_.meshes[instance.mesh], instance.GetTransform()));
+    }
+  }
 
-  Camera camera(origin, lookat, world_up, fov_,
-                static_cast<float>(width_ / height_), aperture_, focus_dist_);
+  for (InstanceDescription& instance : turned_instances_) {
+    instance.rotation.y += instance_turn_;
+  }
 
-  // world
-  HittableList world = RandomScene();
+  // object i of the top level is instance i
+  renderer_.EditWorld([this]() {
+    for (size_t i = 0; i < turned_objects_.size(); ++i) {
+      turned_objects_[i]->SetTransform(turned_instances_[i].GetTransform());
+      top_level_->SetObject(static_cast<uint32_t>(i), turned_objects_[i]);
+    }
+    top_level_->Refit();
+    // emissive instances move their lights along
+    SceneFile::BuildLights(geometry_, turned_instances_, *lights_);
+  });
+
+  // the hardware top level is rebuilt right away, it is cheap to build
+  if (gpu_renderer_) {
+    gpu_renderer_->SetInstances(turned_instances_);
+  }
 
-  // set image pixel data
-#ifdef __APPLE__
-  for (uint32_t j = 0; j < height_; ++j) {
-    for (uint32_t i = 0; i < width_; ++i) {
-      glm::vec3 pixel_color{};
+  if (top_level_->GetCostRatio() > BVH_REBUILD_COST_RATIO &&
+      !rebuild_.valid()) {
+    rebuild_turn_ = instance_turn_;
+    rebuild_ = std::async(std::launch::async,
+                          [geometry = geometry_,
+                           instances = turned_instances_]() {
+                            return SceneFile::BuildTopLevel(geometry,
+                                                            instances);
+                          });
+  }
+}
 
-      for (int s = 0; s < samples_per_pixel_; ++s) {
-        float u = static_cast<float>(i + Utils::RandomFloat()) /
-                  static_cast<float>(width_ - 1);
-        float v = 1.f - static_cast<float>(j + Utils::RandomFloat()) /
-                            static_cast<float>(height_ - 1);
+void Scene::UpdateRebuild() {
+  if (!rebuild_.valid() || rebuild_.wait_for(std::chrono::seconds(0)) !=
+                               std::future_status::ready) {
+    return;
+  }
 
-        Ray ray = camera.GetRay(u, v);
-        pixel_color += RayColor(ray, world, bounce_limit_);
-      }
+  std::shared_ptr<Bvh> top_level = rebuild_.get();
 
-      image_data_[j * width_ + i] =
-          Utils::GetColor(pixel_color, samples_per_pixel_, gamma_);
+  // instances kept turning while building, the new tree is not shared yet
+  // so it is refit without pausing the renderer
+  if (rebuild_turn_ != instance_turn_) {
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      InstanceDescription instance = instances_[i];
+      instance.rotation.y += instance_turn_;
+      top_level->SetObject(static_cast<uint32_t>(i),
+                           SceneFile::MakeInstance(geometry_, instance));
     }
+    top_level->Refit();
   }
-#else
-  std::for_each(
-      std::execution::par, vertical_iterator_.begin(), vertical_iterator_.end(),
-      [&](uint32_t y) {
-        std::for_each(
-            std::execution::par, horizontal_iterator_.begin(),
-            horizontal_iterator_.end(), [&](uint32_t x) {
-              glm::vec3 pixel_color{};
-
-              for (int s = 0; s < samples_per_pixel_; ++s) {
-                float u = static_cast<float>(x + Utils::RandomFloat()) /
-                          static_cast<float>(width_ - 1);
-                float v = 1.f - static_cast<float>(y + Utils::RandomFloat()) /
-                                    static_cast<float>(height_ - 1);
-
-                Ray ray = camera.GetRay(u, v);
-                pixel_color += RayColor(ray, world, bounce_limit_);
-              }
-
-              image_data_[y * width_ + x] =
-                  Utils::GetColor(pixel_color, samples_per_pixel_, gamma_);
-            });
-      });
-#endif
 
-  // set image data
-  image_->SetData(image_data_);
+  top_level_ = top_level;
+  renderer_.SetWorld(top_level_, materials_, lights_);
+}
+
+void Scene::OnRecordCommands(VkCommandBuffer command_buffer,
+                             uint32_t frame_index) {
+  if (!image_) {
+    return;
+  }
 
-  // end time
-  auto end = std::chrono::high_resolution_clock::now();
+  if (is_gpu_backend_) {
+    gpu_renderer_->RecordRender(command_buffer, frame_index, *image_);
+  } else {
+    image_->RecordUpload(command_buffer, frame_index);
+  }
+}
 
-  // delta time
-  delta_time_ =
-      std::chrono::duration_cast<std::chrono::duration<float, std::micro>>(
-          end - begin)
-          .count() /
-      1000.f;
+void Scene::Render() {
+  if (is_gpu_backend_) {
+    gpu_renderer_->RequestRender();
+  } else {
+    renderer_.RequestRender();
+  }
 }
 
-glm::vec3 Scene::RayColor(const Ray& ray, const Hittable& world, int bounce) {
-  // hit record
-  HitRecord record{};
+void Scene::UpdateImage() {
+  // the compute backend writes the image itself, it only follows the
+  // viewport size
+  if (is_gpu_backend_) {
+    if (width_ && height_ &&
+        (!image_ || width_ != image_->GetWidth() ||
+         height_ != image_->GetHeight())) {
+      ResizeImage(width_, height_);
+    }
+
+    delta_time_ = gpu_renderer_->GetPassTime();
+    return;
+  }
 
-  // check whether exceed the ray bounce limit
-  if (bounce <= 0) {
-    return glm::vec3(0.f, 0.f, 0.f);
+  const Framebuffer* framebuffer = renderer_.AcquireFramebuffer();
+  if (!framebuffer || !framebuffer->width || !framebuffer->height) {
+    return;
   }
 
-  // hittable objects color
-  if (world.Hit(ray, 0.001f, INFINITY_F, record)) {
-    Ray scattered{};
-    glm::vec3 attenuation{};
+  if (!image_ || framebuffer->width != image_->GetWidth() ||
+      framebuffer->height != image_->GetHeight()) {
+    ResizeImage(framebuffer->width, framebuffer->height);
+  }
 
-    if (record.material->Scatter(ray, record, attenuation, scattered)) {
-      return attenuation * RayColor(scattered, world, bounce - 1);
-    }
+  // set image data
+  image_->SetData(framebuffer->pixels.data());
+
+  delta_time_ = renderer_.GetPassTime();
+  renderer_.GetStats(stats_);
+}
+
+void Scene::ResizeImage(uint32_t width, uint32_t height) {
+  // frames in flight may still sample the old image, freeing it before the
+  // new one is created keeps the footprint flat across resizes
+  if (image_) {
+    vkDeviceWaitIdle(device_);
+    image_.reset();
+  }
+
+  image_ = std::make_unique<Image>(width, height, physical_device_, device_,
+                                   graphics_queue_, command_pool_);
+}
 
-    return glm::vec3(0.f, 0.f, 0.f);
+uint64_t Scene::GetSceneHash() const {
+  if (instances_.empty() || 0.f == instance_turn_) {
+    return scene_hash_;
   }
 
-  // background color
-  glm::vec3 unit_direction = glm::normalize(ray.GetDirection());
-  float t = 0.5f * (unit_direction.y + 1.f);
-  glm::vec3 color =
-      (1.f - t) * glm::vec3(1.f, 1.f, 1.f) + t * glm::vec3(0.5f, 0.7f, 1.f);
+  uint32_t turn = 0;
+  std::memcpy(&turn, &instance_turn_, sizeof(turn));
 
-  return color;
+  return Sampler::Hash(scene_hash_ ^ turn);
 }
 
-HittableList Scene::RandomScene() {
-  HittableList world{};
-
-  std::shared_ptr<Material> ground_material =
-      std::make_shared<Lambertian>(glm::vec3(0.5f));
-  std::shared_ptr<Hittable> ground = std::make_shared<Sphere>(
-      glm::vec3(0.f, -1000.f, 0.f), 1000.f, ground_material);
-  world.Add(ground);
-
-  // for (int i = -11; i < 11; ++i) {
-  //   for (int j = -11; j < 11; ++j) {
-  //     float choose_mat = Utils::RandomFloat();
-  //     glm::vec3 center(i + 0.9f * Utils::RandomFloat(), 0.2f,
-  //                      j + 0.9f * Utils::RandomFloat());
-
-  //     if (glm::length(center - glm::vec3(4.f, 0.2f, 0.f)) > 0.9f) {
-  //       std::shared_ptr<Material> material{};
-
-  //       if (choose_mat < 0.8f) {
-  //         // diffuse
-  //         glm::vec3 albedo = Utils::RandomVec3();
-  //         material = std::make_shared<Lambertian>(albedo);
-  //       } else if (choose_mat < 0.95f) {
-  //         // metal
-  //         float fuzz = Utils::RandomFloat(0.f, 0.05f);
-  //         glm::vec3 albedo(Utils::RandomFloat(0.5f, 1.f));
-  //         material = std::make_shared<Metal>(fuzz, albedo);
-  //       } else {
-  //         // glass
-  //         material = std::make_shared<Dielectric>(1.5f);
-  //       }
-
-  //       std::shared_ptr<Sphere> sphere =
-  //           std::make_shared<Sphere>(center, 0.2f, material);
-  //       world.Add(sphere);
-  //     }
-  //   }
-  // }
-
-  std::shared_ptr<Material> diffuse_material =
-      std::make_shared<Lambertian>(glm::vec3(0.4f, 0.2f, 0.1f));
-  std::shared_ptr<Sphere> diffuse_sphere = std::make_shared<Sphere>(
-      glm::vec3(-4.f, 1.f, 0.f), 1.f, diffuse_material);
-  world.Add(diffuse_sphere);
-
-  std::shared_ptr<Material> metal_material =
-      std::make_shared<Metal>(0.f, glm::vec3(0.7f, 0.6f, 0.5f));
-  std::shared_ptr<Sphere> metal_sphere =
-      std::make_shared<Sphere>(glm::vec3(4.f, 1.f, 0.f), 1.f, metal_material);
-  world.Add(metal_sphere);
-
-  std::shared_ptr<Material> dielectric_material =
-      std::make_shared<Dielectric>(1.5f);
-  std::shared_ptr<Sphere> dielectric_sphere = std::make_shared<Sphere>(
-      glm::vec3(0.f, 1.f, 0.f), 1.f, dielectric_material);
-  world.Add(dielectric_sphere);
-
-  return world;
+void Scene::RenderStatsUI() {
+  if (!Stats::IsEnabled()) {
+    ImGui::TextWrapped("Counters are compiled out of this build");
+    return;
+  }
+  if (is_gpu_backend_) {
+    ImGui::TextWrapped("Counters are collected by the CPU backend only");
+    return;
+  }
+
+  const RayCounters& counters = stats_.counters;
+  const uint64_t rays = counters.GetRayCount();
+  const double per_ray = rays ? 1.0 / static_cast<double>(rays) : 0.0;
+
+  // imgui text: throughput
+  ImGui::Text("Throughput: %.2f Mrays/s", stats_.GetMraysPerSecond());
+  ImGui::Text("Rays: %llu primary, %llu secondary, %llu shadow",
+              static_cast<unsigned long long>(counters.rays[0]),
+              static_cast<unsigned long long>(rays - counters.rays[0] -
+                                              counters.shadow_rays),
+              static_cast<unsigned long long>(counters.shadow_rays));
+  ImGui::Text("Per Ray: %.1f tests, %.1f nodes",
+              counters.intersection_tests * per_ray,
+              counters.bvh_nodes * per_ray);
+  ImGui::Text("Threads: %.0f%% busy", 100.f * stats_.GetAverageUtilization());
+
+  // imgui tree: rays by bounce
+  if (ImGui::TreeNode("Bounces")) {
+    for (int depth = 0; depth < STATS_DEPTH_COUNT; ++depth) {
+      if (counters.rays[depth]) {
+        ImGui::Text("%d%s: %llu", depth,
+                    STATS_DEPTH_COUNT - 1 == depth ? "+" : "",
+                    static_cast<unsigned long long>(counters.rays[depth]));
+      }
+    }
+    ImGui::TreePop();
+  }
+
+  // imgui tree: per thread busy share
+  if (ImGui::TreeNode("Threads")) {
+    for (uint32_t worker = 0; worker < stats_.worker_times.size(); ++worker) {
+      ImGui::Text("%u: %.0f%%", worker, 100.f * stats_.GetUtilization(worker));
+    }
+    ImGui::TreePop();
+  }
+
+  // imgui: tile times heatmap, blue is the fastest tile and red the slowest
+  if (!stats_.tiles_x || !stats_.tiles_y || stats_.tile_times.empty()) {
+    return;
+  }
+
+  const float max_time =
+      *std::max_element(stats_.tile_times.begin(), stats_.tile_times.end());
+  const float cell = std::max(
+      std::min(ImGui::GetContentRegionAvail().x / stats_.tiles_x, 12.f), 1.f);
+
+  ImDrawList* draw_list = ImGui::GetWindowDrawList();
+  ImVec2 corner = ImGui::GetCursorScreenPos();
+  for (uint32_t tile = 0; tile < stats_.tile_times.size(); ++tile) {
+    float heat = max_time > 0.f ? stats_.tile_times[tile] / max_time : 0.f;
+    ImVec2 min(corner.x + (tile % stats_.tiles_x) * cell,
+               corner.y + (tile / stats_.tiles_x) * cell);
+    ImVec2 max(min.x + cell, min.y + cell);
+
+    draw_list->AddRectFilled(min, max,
+                             ImGui::ColorConvertFloat4ToU32(
+                                 ImVec4(heat, 0.2f, 1.f - heat, 1.f)));
+  }
+  ImGui::Dummy(ImVec2(cell * stats_.tiles_x, cell * stats_.tiles_y));
+  ImGui::Text("Slowest Tile: %.2fms", max_time);
 }
 
 }  // namespace rt
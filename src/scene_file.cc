@@ -0,0 +1,886 @@
+/**
+ * @file scene_file.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+#include "dielectric.h"
+#include "diffuse_light.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "lambertian.h"
+#include "light_list.h"
+#include "mapped_file.h"
+#include "material_data.h"
+#include "material_table.h"
+#include "math_utils.h"
+#include "mesh_loader.h"
+#include "metal.h"
+#include "sphere_set.h"
+#include "triangle_mesh.h"
+
+namespace rt {
+
+namespace {
+
+// binary scenes are stored in host byte order so columns can be copied as
+// they are, the marker tells files of the other byte order apart
+const char BINARY_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+const uint32_t BYTE_ORDER_MARKER = 0x01020304u;
+
+// the tag of MaterialData is the stored type, on the cpu and the gpu alike
+static_assert(static_cast<uint32_t>(MaterialKind::LAMBERTIAN) ==
+                      static_cast<uint32_t>(MaterialType::LAMBERTIAN) &&
+                  static_cast<uint32_t>(MaterialKind::METAL) ==
+                      static_cast<uint32_t>(MaterialType::METAL) &&
+                  static_cast<uint32_t>(MaterialKind::DIELECTRIC) ==
+                      static_cast<uint32_t>(MaterialType::DIELECTRIC) &&
+                  static_cast<uint32_t>(MaterialKind::DIFFUSE_LIGHT) ==
+                      static_cast<uint32_t>(MaterialType::DIFFUSE_LIGHT),
+              "MaterialKind must be numbered like MaterialType");
+
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t material_count;
+  uint32_t sphere_count;
+  uint32_t has_camera;
+  // origin, look at, fov, aperture, focus dist
+  float camera[9];
+};
+static_assert(sizeof(BinaryHeader) == 64, "unexpected binary header size");
+
+struct BinaryMaterial {
+  uint32_t type;
+  float albedo[3];
+  float fuzz;
+  float refraction_index;
+};
+static_assert(sizeof(BinaryMaterial) == 24,
+              "unexpected binary material size");
+
+// every sphere takes center x, y, z, radius and material index
+const uint64_t BINARY_SPHERE_SIZE = 5 * sizeof(uint32_t);
+
+struct BinaryInstance {
+  uint32_t mesh;
+  float translation[3];
+  float rotation[3];
+  float scale;
+};
+static_assert(sizeof(BinaryInstance) == 32,
+              "unexpected binary instance size");
+
+// mesh paths of a scene file are relative to the file itself, they are
+// kept absolute afterwards so saving the scene elsewhere keeps them valid
+std::string ResolvePath(const std::string& scene_path,
+                        const std::string& path) {
+  std::filesystem::path mesh_path(path);
+  if (mesh_path.is_relative()) {
+    mesh_path = std::filesystem::path(scene_path).parent_path() / mesh_path;
+  }
+
+  return std::filesystem::absolute(mesh_path).lexically_normal().string();
+}
+
+// mesh path as ParseText reads it back, quoted when a word would end early
+std::string QuotePath(const std::string& path) {
+  if (path.find_first_of("\"\n") != std::string::npos) {
+    throw std::runtime_error("Error::SceneFile: Mesh path " + path +
+                             " cannot be written to a text scene!");
+  }
+  if (!path.empty() && path.find_first_of(" \t\r#") == std::string::npos) {
+    return path;
+  }
+
+  return "\"" + path + "\"";
+}
+
+// 64 bit fnv-1a
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+uint64_t HashBytes(uint64_t hash, const std::string& bytes) {
+  for (const char byte : bytes) {
+    hash = (hash ^ static_cast<uint8_t>(byte)) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+}  // namespace
+
+uint32_t SceneDescription::AddMaterial(const MaterialDescription& description) {
+  materials.push_back(description);
+
+  return static_cast<uint32_t>(materials.size() - 1);
+}
+
+void SceneDescription::AddSphere(const glm::vec3& center, float radius,
+                                 uint32_t material_index) {
+  center_x.push_back(center.x);
+  center_y.push_back(center.y);
+  center_z.push_back(center.z);
+  this->radius.push_back(radius);
+  material.push_back(material_index);
+}
+
+glm::mat4 InstanceDescription::GetTransform() const {
+  glm::mat4 transform = glm::translate(glm::mat4(1.f), translation);
+  transform = glm::rotate(transform, glm::radians(rotation.z),
+                          glm::vec3(0.f, 0.f, 1.f));
+  transform = glm::rotate(transform, glm::radians(rotation.y),
+                          glm::vec3(0.f, 1.f, 0.f));
+  transform = glm::rotate(transform, glm::radians(rotation.x),
+                          glm::vec3(1.f, 0.f, 0.f));
+
+  return glm::scale(transform, glm::vec3(scale));
+}
+
+bool InstanceDescription::IsIdentity() const {
+  return translation == glm::vec3(0.f) && rotation == glm::vec3(0.f) &&
+         scale == 1.f;
+}
+
+bool InstanceDescription::IsInvertible() const {
+  // a normal determinant keeps the inverse finite, nan is not normal either
+  return std::isnormal(glm::determinant(GetTransform()));
+}
+
+uint32_t SceneDescription::AddMesh(const std::string& path,
+                                   uint32_t material_index) {
+  meshes.push_back({path, material_index});
+
+  return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+void SceneDescription::AddInstance(const InstanceDescription& instance) {
+  instances.push_back(instance);
+}
+
+void SceneDescription::Reserve(uint32_t sphere_count) {
+  center_x.reserve(sphere_count);
+  center_y.reserve(sphere_count);
+  center_z.reserve(sphere_count);
+  radius.reserve(sphere_count);
+  material.reserve(sphere_count);
+}
+
+uint32_t SceneDescription::GetSphereCount() const {
+  return static_cast<uint32_t>(center_x.size());
+}
+
+bool SceneFile::IsBinary(const std::string& path) {
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+
+  std::string extension = path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  return extension == "rtb";
+}
+
+SceneDescription SceneFile::Load(const std::string& path) {
+  return IsBinary(path) ? LoadBinary(path) : LoadText(path);
+}
+
+SceneDescription SceneFile::LoadText(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Error::SceneFile: Failed to open " + path + "!");
+  }
+
+  // whole file in one read, parsed in place afterwards
+  std::string text(static_cast<size_t>(file.tellg()), '\0');
+  file.seekg(0);
+  file.read(&text[0], static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw std::runtime_error("Error::SceneFile: Failed to read " + path + "!");
+  }
+
+  return ParseText(text, path);
+}
+
+SceneDescription SceneFile::LoadBinary(const std::string& path) {
+  MappedFile file(path);
+
+  return ReadBinary(file.GetData(), file.GetSize(), path);
+}
+
+SceneDescription SceneFile::ReadBinary(const uint8_t* data, uint64_t size,
+                                       const std::string& path) {
+  auto fail = [&](const std::string& message) {
+    throw std::runtime_error("Error::SceneFile: " + path + ": " + message +
+                             "!");
+  };
+
+  BinaryHeader header{};
+  if (size < sizeof(header)) {
+    fail("File too small for a scene");
+  }
+  std::memcpy(&header, data, sizeof(header));
+
+  if (std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC))) {
+    fail("Not a binary scene");
+  }
+  if (header.byte_order != BYTE_ORDER_MARKER) {
+    fail("Written on a host of another byte order");
+  }
+  if (header.version != BINARY_VERSION) {
+    fail("Unsupported version " + std::to_string(header.version));
+  }
+
+  const uint64_t expected_size =
+      sizeof(header) +
+      static_cast<uint64_t>(header.material_count) * sizeof(BinaryMaterial) +
+      static_cast<uint64_t>(header.sphere_count) * BINARY_SPHERE_SIZE;
+  // mesh and instance tables follow the columns, at least their counts
+  if (size < expected_size + 2 * sizeof(uint32_t)) {
+    fail("Size does not match the header");
+  }
+
+  SceneDescription scene{};
+
+  scene.has_camera = header.has_camera != 0;
+  scene.camera.origin =
+      glm::vec3(header.camera[0], header.camera[1], header.camera[2]);
+  scene.camera.look_at =
+      glm::vec3(header.camera[3], header.camera[4], header.camera[5]);
+  scene.camera.fov = header.camera[6];
+  scene.camera.aperture = header.camera[7];
+  scene.camera.focus_dist = header.camera[8];
+
+  const uint8_t* cursor = data + sizeof(header);
+
+  scene.materials.resize(header.material_count);
+  for (MaterialDescription& material : scene.materials) {
+    BinaryMaterial stored{};
+    std::memcpy(&stored, cursor, sizeof(stored));
+    cursor += sizeof(stored);
+
+    if (stored.type > static_cast<uint32_t>(MaterialType::DIFFUSE_LIGHT)) {
+      fail("Unknown material type " + std::to_string(stored.type));
+    }
+
+    material.type = static_cast<MaterialType>(stored.type);
+    material.albedo =
+        glm::vec3(stored.albedo[0], stored.albedo[1], stored.albedo[2]);
+    material.fuzz = stored.fuzz;
+    material.refraction_index = stored.refraction_index;
+  }
+
+  // columns are copied as they are, no per sphere work at all
+  auto read_column = [&](auto& column) {
+    column.resize(header.sphere_count);
+    const size_t column_size = column.size() * sizeof(column[0]);
+    if (column_size) {
+      std::memcpy(column.data(), cursor, column_size);
+    }
+    cursor += column_size;
+  };
+  read_column(scene.center_x);
+  read_column(scene.center_y);
+  read_column(scene.center_z);
+  read_column(scene.radius);
+  read_column(scene.material);
+
+  // mesh count, then material index, path size and path of every mesh,
+  // instance count and the instances after it
+  const uint8_t* const end = data + size;
+  auto read_u32 = [&]() {
+    uint32_t value = 0;
+    if (static_cast<size_t>(end - cursor) < sizeof(value)) {
+      fail("Truncated mesh table");
+    }
+    std::memcpy(&value, cursor, sizeof(value));
+    cursor += sizeof(value);
+    return value;
+  };
+
+  const uint32_t mesh_count = read_u32();
+  for (uint32_t i = 0; i < mesh_count; ++i) {
+    const uint32_t material = read_u32();
+    const uint32_t path_size = read_u32();
+    if (static_cast<uint64_t>(end - cursor) < path_size) {
+      fail("Truncated mesh table");
+    }
+
+    std::string mesh_path(reinterpret_cast<const char*>(cursor), path_size);
+    cursor += path_size;
+    scene.AddMesh(ResolvePath(path, mesh_path), material);
+  }
+
+  const uint32_t instance_count = read_u32();
+  if (static_cast<uint64_t>(end - cursor) <
+      static_cast<uint64_t>(instance_count) * sizeof(BinaryInstance)) {
+    fail("Truncated instance table");
+  }
+
+  scene.instances.resize(instance_count);
+  for (InstanceDescription& instance : scene.instances) {
+    BinaryInstance stored{};
+    std::memcpy(&stored, cursor, sizeof(stored));
+    cursor += sizeof(stored);
+
+    instance.mesh = stored.mesh;
+    instance.translation = glm::vec3(
+        stored.translation[0], stored.translation[1], stored.translation[2]);
+    instance.rotation =
+        glm::vec3(stored.rotation[0], stored.rotation[1], stored.rotation[2]);
+    instance.scale = stored.scale;
+    if (!instance.IsInvertible()) {
+      fail("Instance transform is not invertible");
+    }
+  }
+
+  if (cursor != end) {
+    fail("Size does not match the header");
+  }
+
+  return scene;
+}
+
+void SceneFile::Save(const std::string& path, const SceneDescription& scene) {
+  if (IsBinary(path)) {
+    SaveBinary(path, scene);
+  } else {
+    SaveText(path, scene);
+  }
+}
+
+void SceneFile::SaveText(const std::string& path,
+                         const SceneDescription& scene) {
+  std::string text{};
+  char line[256];
+
+  // 9 significant digits round trip every float exactly
+  if (scene.has_camera) {
+    const CameraDescription& camera = scene.camera;
+    std::snprintf(line, sizeof(line),
+                  "camera %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+                  camera.origin.x, camera.origin.y, camera.origin.z,
+                  camera.look_at.x, camera.look_at.y, camera.look_at.z,
+                  camera.fov, camera.aperture, camera.focus_dist);
+    text += line;
+  }
+
+  for (size_t i = 0; i < scene.materials.size(); ++i) {
+    const MaterialDescription& material = scene.materials[i];
+    const glm::vec3& albedo = material.albedo;
+
+    switch (material.type) {
+      case MaterialType::LAMBERTIAN:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu lambertian %.9g %.9g %.9g\n", i,
+                      albedo.r, albedo.g, albedo.b);
+        break;
+      case MaterialType::METAL:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu metal %.9g %.9g %.9g %.9g\n", i, albedo.r,
+                      albedo.g, albedo.b, material.fuzz);
+        break;
+      case MaterialType::DIELECTRIC:
+        std::snprintf(line, sizeof(line), "material m%zu dielectric %.9g\n", i,
+                      material.refraction_index);
+        break;
+      case MaterialType::DIFFUSE_LIGHT:
+        std::snprintf(line, sizeof(line),
+                      "material m%zu light %.9g %.9g %.9g\n", i, albedo.r,
+                      albedo.g, albedo.b);
+        break;
+    }
+    text += line;
+  }
+
+  for (uint32_t i = 0; i < scene.GetSphereCount(); ++i) {
+    std::snprintf(line, sizeof(line), "sphere %.9g %.9g %.9g %.9g m%u\n",
+                  scene.center_x[i], scene.center_y[i], scene.center_z[i],
+                  scene.radius[i], scene.material[i]);
+    text += line;
+  }
+
+  for (size_t i = 0; i < scene.meshes.size(); ++i) {
+    const MeshDescription& mesh = scene.meshes[i];
+    text += "geometry g" + std::to_string(i) + " " + QuotePath(mesh.path) +
+            " m" + std::to_string(mesh.material) + "\n";
+  }
+
+  for (const InstanceDescription& instance : scene.instances) {
+    std::snprintf(line, sizeof(line),
+                  "instance g%u %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+                  instance.mesh, instance.translation.x,
+                  instance.translation.y, instance.translation.z,
+                  instance.rotation.x, instance.rotation.y,
+                  instance.rotation.z, instance.scale);
+    text += line;
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Error::SceneFile: Failed to open " + path + "!");
+  }
+
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw std::runtime_error("Error::SceneFile: Failed to write " + path +
+                             "!");
+  }
+}
+
+void SceneFile::SaveBinary(const std::string& path,
+                           const SceneDescription& scene) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Error::SceneFile: Failed to open " + path + "!");
+  }
+
+  WriteBinary(file, scene);
+
+  if (!file) {
+    throw std::runtime_error("Error::SceneFile: Failed to write " + path +
+                             "!");
+  }
+}
+
+void SceneFile::WriteBinary(std::ostream& file,
+                            const SceneDescription& scene) {
+  BinaryHeader header{};
+  std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  header.version = BINARY_VERSION;
+  header.byte_order = BYTE_ORDER_MARKER;
+  header.material_count = static_cast<uint32_t>(scene.materials.size());
+  header.sphere_count = scene.GetSphereCount();
+  header.has_camera = scene.has_camera ? 1u : 0u;
+
+  const CameraDescription& camera = scene.camera;
+  const float camera_values[9] = {
+      camera.origin.x,  camera.origin.y,  camera.origin.z,
+      camera.look_at.x, camera.look_at.y, camera.look_at.z,
+      camera.fov,       camera.aperture,  camera.focus_dist};
+  std::memcpy(header.camera, camera_values, sizeof(header.camera));
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  for (const MaterialDescription& material : scene.materials) {
+    BinaryMaterial stored{};
+    stored.type = static_cast<uint32_t>(material.type);
+    stored.albedo[0] = material.albedo.r;
+    stored.albedo[1] = material.albedo.g;
+    stored.albedo[2] = material.albedo.b;
+    stored.fuzz = material.fuzz;
+    stored.refraction_index = material.refraction_index;
+
+    file.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+  }
+
+  auto write_column = [&](const auto& column) {
+    file.write(reinterpret_cast<const char*>(column.data()),
+               static_cast<std::streamsize>(header.sphere_count *
+                                            sizeof(column[0])));
+  };
+  write_column(scene.center_x);
+  write_column(scene.center_y);
+  write_column(scene.center_z);
+  write_column(scene.radius);
+  write_column(scene.material);
+
+  auto write_u32 = [&](uint32_t value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+
+  write_u32(static_cast<uint32_t>(scene.meshes.size()));
+  for (const MeshDescription& mesh : scene.meshes) {
+    write_u32(mesh.material);
+    write_u32(static_cast<uint32_t>(mesh.path.size()));
+    file.write(mesh.path.data(),
+               static_cast<std::streamsize>(mesh.path.size()));
+  }
+
+  write_u32(static_cast<uint32_t>(scene.instances.size()));
+  for (const InstanceDescription& instance : scene.instances) {
+    BinaryInstance stored{};
+    stored.mesh = instance.mesh;
+    for (int axis = 0; axis < 3; ++axis) {
+      stored.translation[axis] = instance.translation[axis];
+      stored.rotation[axis] = instance.rotation[axis];
+    }
+    stored.scale = instance.scale;
+
+    file.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+  }
+}
+
+uint64_t SceneFile::Hash(const SceneDescription& scene) {
+  std::ostringstream binary(std::ios::binary);
+  WriteBinary(binary, scene);
+  uint64_t hash = HashBytes(FNV_OFFSET_BASIS, binary.str());
+
+  // binary scenes only name their meshes
+  for (const MeshDescription& mesh : scene.meshes) {
+    hash = HashBytes(hash, MeshLoader::ReadFile(mesh.path));
+  }
+
+  return hash;
+}
+
+std::shared_ptr<Hittable> SceneFile::Build(const SceneDescription& scene,
+                                           MaterialTable& materials,
+                                           LightList* lights) {
+  const SceneGeometry geometry = BuildGeometry(scene, materials);
+  if (lights) {
+    BuildLights(geometry, scene.instances, *lights);
+  }
+
+  return BuildTopLevel(geometry, scene.instances);
+}
+
+SceneGeometry SceneFile::BuildGeometry(const SceneDescription& scene,
+                                       MaterialTable& materials) {
+  const uint32_t sphere_count = scene.GetSphereCount();
+  if (scene.center_y.size() != sphere_count ||
+      scene.center_z.size() != sphere_count ||
+      scene.radius.size() != sphere_count ||
+      scene.material.size() != sphere_count) {
+    throw std::runtime_error(
+        "Error::SceneFile: Sphere columns differ in length!");
+  }
+
+  const uint32_t first_material = materials.GetCount();
+  for (const MaterialDescription& material : scene.materials) {
+    switch (material.type) {
+      case MaterialType::LAMBERTIAN:
+        materials.Add<Lambertian>(material.albedo);
+        break;
+      case MaterialType::METAL:
+        materials.Add<Metal>(material.fuzz, material.albedo);
+        break;
+      case MaterialType::DIELECTRIC:
+        materials.Add<Dielectric>(material.refraction_index);
+        break;
+      case MaterialType::DIFFUSE_LIGHT:
+        materials.Add<DiffuseLight>(material.albedo);
+        break;
+    }
+  }
+
+  const uint32_t material_count =
+      static_cast<uint32_t>(scene.materials.size());
+
+  SceneGeometry geometry{};
+  SphereSet spheres{};
+  spheres.Reserve(sphere_count);
+  for (uint32_t i = 0; i < sphere_count; ++i) {
+    if (scene.material[i] >= material_count) {
+      throw std::runtime_error("Error::SceneFile: Sphere " +
+                               std::to_string(i) +
+                               " refers to a missing material!");
+    }
+
+    glm::vec3 center(scene.center_x[i], scene.center_y[i], scene.center_z[i]);
+    spheres.Add(center, scene.radius[i], first_material + scene.material[i]);
+
+    const MaterialDescription& material = scene.materials[scene.material[i]];
+    if (MaterialType::DIFFUSE_LIGHT == material.type) {
+      // a light the light list leaves out would be weighted against samples
+      // that never come
+      if (scene.radius[i] <= 0.f) {
+        throw std::runtime_error("Error::SceneFile: Light sphere " +
+                                 std::to_string(i) +
+                                 " needs a positive radius!");
+      }
+      geometry.sphere_lights.AddSphere(center, scene.radius[i],
+                                       material.albedo);
+    }
+  }
+
+  geometry.spheres = std::make_shared<Bvh>(spheres);
+
+  for (const MeshDescription& mesh : scene.meshes) {
+    if (mesh.material >= material_count) {
+      throw std::runtime_error("Error::SceneFile: Mesh " + mesh.path +
+                               " refers to a missing material!");
+    }
+
+    geometry.meshes.push_back(std::make_shared<TriangleMesh>(
+        MeshLoader::Load(mesh.path), first_material + mesh.material));
+
+    const MaterialDescription& material = scene.materials[mesh.material];
+    geometry.mesh_radiance.push_back(
+        MaterialType::DIFFUSE_LIGHT == material.type ? material.albedo
+                                                     : glm::vec3(0.f));
+  }
+
+  return geometry;
+}
+
+void SceneFile::BuildLights(const SceneGeometry& geometry,
+                            const std::vector<InstanceDescription>& instances,
+                            LightList& lights) {
+  lights = geometry.sphere_lights;
+
+  for (const InstanceDescription& instance : instances) {
+    if (instance.mesh >= geometry.mesh_radiance.size() ||
+        MathUtils::NearZero(geometry.mesh_radiance[instance.mesh])) {
+      continue;
+    }
+
+    const TriangleMesh* mesh =
+        dynamic_cast<const TriangleMesh*>(geometry.meshes[instance.mesh].get());
+    if (mesh) {
+      lights.AddMesh(*mesh, instance.GetTransform(),
+                     geometry.mesh_radiance[instance.mesh]);
+    }
+  }
+}
+
+std::shared_ptr<Bvh> SceneFile::BuildTopLevel(
+    const SceneGeometry& geometry,
+    const std::vector<InstanceDescription>& instances) {
+  if (instances.empty()) {
+    return geometry.spheres;
+  }
+
+  HittableList world{};
+  for (const InstanceDescription& instance : instances) {
+    world.Add(MakeInstance(geometry, instance));
+  }
+
+  if (!geometry.spheres->BoundingBox().IsEmpty()) {
+    world.Add(geometry.spheres);
+  }
+
+  return std::make_shared<Bvh>(world);
+}
+
+std::shared_ptr<Hittable> SceneFile::MakeInstance(
+    const SceneGeometry& geometry, const InstanceDescription& instance) {
+  if (instance.mesh >= geometry.meshes.size()) {
+    throw std::runtime_error(
+        "Error::SceneFile: Instance refers to a missing mesh!");
+  }
+
+  // untransformed instances skip the detour through object space
+  const std::shared_ptr<Hittable>& mesh = geometry.meshes[instance.mesh];
+  if (instance.IsIdentity()) {
+    return mesh;
+  }
+  if (!instance.IsInvertible()) {
+    throw std::runtime_error(
+        "Error::SceneFile: Instance transform is not invertible!");
+  }
+
+  return std::make_shared<Instance>(mesh, instance.GetTransform());
+}
+
+SceneDescription SceneFile::ParseText(const std::string& text,
+                                      const std::string& path) {
+  SceneDescription scene{};
+  std::unordered_map<std::string, uint32_t> material_indices{};
+  std::unordered_map<std::string, uint32_t> mesh_indices{};
+
+  // most lines of big scenes are spheres
+  scene.Reserve(static_cast<uint32_t>(
+      std::count(text.begin(), text.end(), '\n') + 1));
+
+  const char* cursor = text.c_str();
+  uint32_t line_number = 0;
+
+  auto fail = [&](const std::string& message) {
+    throw std::runtime_error("Error::SceneFile: " + path + ":" +
+                             std::to_string(line_number) + ": " + message +
+                             "!");
+  };
+  // spaces only, tokens never continue on the next line
+  auto skip_spaces = [&]() {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+      ++cursor;
+    }
+  };
+  auto at_line_end = [&]() {
+    skip_spaces();
+    return !*cursor || *cursor == '\n' || *cursor == '#';
+  };
+  auto next_word = [&]() {
+    if (at_line_end()) {
+      fail("Missing value");
+    }
+    const char* begin = cursor;
+    while (*cursor && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' &&
+           *cursor != '\n' && *cursor != '#') {
+      ++cursor;
+    }
+    return std::string(begin, cursor);
+  };
+  // a word, or everything up to the closing quote on the same line
+  auto next_path = [&]() {
+    skip_spaces();
+    if (*cursor != '"') {
+      return next_word();
+    }
+    const char* begin = ++cursor;
+    while (*cursor && *cursor != '"' && *cursor != '\n') {
+      ++cursor;
+    }
+    if (*cursor != '"') {
+      fail("Unterminated quote");
+    }
+    return std::string(begin, cursor++);
+  };
+  auto next_float = [&]() {
+    if (at_line_end()) {
+      fail("Missing value");
+    }
+    char* end = nullptr;
+    float value = std::strtof(cursor, &end);
+    if (end == cursor) {
+      fail("Expected a number");
+    }
+    cursor = end;
+    return value;
+  };
+  auto next_vec3 = [&]() {
+    float x = next_float();
+    float y = next_float();
+    float z = next_float();
+    return glm::vec3(x, y, z);
+  };
+
+  while (*cursor) {
+    ++line_number;
+
+    if (!at_line_end()) {
+      const std::string keyword = next_word();
+
+      if (keyword == "sphere") {
+        glm::vec3 center = next_vec3();
+        float radius = next_float();
+
+        auto material = material_indices.find(next_word());
+        if (material == material_indices.end()) {
+          fail("Unknown material");
+        }
+
+        scene.AddSphere(center, radius, material->second);
+      } else if (keyword == "instance") {
+        auto mesh = mesh_indices.find(next_word());
+        if (mesh == mesh_indices.end()) {
+          fail("Unknown geometry");
+        }
+
+        InstanceDescription instance{};
+        instance.mesh = mesh->second;
+        instance.translation = next_vec3();
+        instance.rotation = next_vec3();
+        instance.scale = next_float();
+        if (!instance.IsInvertible()) {
+          fail("Instance transform is not invertible");
+        }
+        scene.AddInstance(instance);
+      } else if (keyword == "geometry" || keyword == "mesh") {
+        const bool is_placed = keyword == "mesh";
+        const std::string name = is_placed ? std::string() : next_word();
+        const std::string mesh_path = next_path();
+
+        auto material = material_indices.find(next_word());
+        if (material == material_indices.end()) {
+          fail("Unknown material");
+        }
+
+        uint32_t mesh =
+            scene.AddMesh(ResolvePath(path, mesh_path), material->second);
+        if (is_placed) {
+          scene.AddInstance({mesh, glm::vec3(0.f), glm::vec3(0.f), 1.f});
+        } else if (!mesh_indices.emplace(name, mesh).second) {
+          fail("Geometry " + name + " defined twice");
+        }
+      } else if (keyword == "material") {
+        const std::string name = next_word();
+        const std::string type = next_word();
+
+        MaterialDescription material{};
+        material.albedo = glm::vec3(1.f);
+        material.refraction_index = 1.f;
+
+        if (type == "lambertian") {
+          material.type = MaterialType::LAMBERTIAN;
+          material.albedo = next_vec3();
+        } else if (type == "metal") {
+          material.type = MaterialType::METAL;
+          material.albedo = next_vec3();
+          material.fuzz = next_float();
+        } else if (type == "dielectric") {
+          material.type = MaterialType::DIELECTRIC;
+          material.refraction_index = next_float();
+        } else if (type == "light") {
+          material.type = MaterialType::DIFFUSE_LIGHT;
+          material.albedo = next_vec3();
+        } else {
+          fail("Unknown material type " + type);
+        }
+
+        if (!material_indices.emplace(name, scene.AddMaterial(material))
+                 .second) {
+          fail("Material " + name + " defined twice");
+        }
+      } else if (keyword == "camera") {
+        scene.has_camera = true;
+        scene.camera.origin = next_vec3();
+        scene.camera.look_at = next_vec3();
+        scene.camera.fov = next_float();
+        scene.camera.aperture = next_float();
+        scene.camera.focus_dist = next_float();
+      } else {
+        fail("Unknown statement " + keyword);
+      }
+
+      if (!at_line_end()) {
+        fail("Unexpected trailing value");
+      }
+    }
+
+    // comments run to the end of the line
+    while (*cursor && *cursor != '\n') {
+      ++cursor;
+    }
+    if (*cursor) {
+      ++cursor;
+    }
+  }
+
+  return scene;
+}
+
+}  // namespace rt
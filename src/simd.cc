@@ -0,0 +1,230 @@
+/**
+ * @file simd.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "simd.h"
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(RAY_TRACING_SIMD_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+namespace {
+
+uint32_t IntersectBoxScalar(const RayPacket& packet, const glm::vec3& box_min,
+                            const glm::vec3& box_max, const float* t,
+                            uint32_t mask) {
+  uint32_t hit_mask = 0;
+
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (!(mask & (1u << lane))) {
+      continue;
+    }
+
+    float t_near = packet.t_min;
+    float t_far = t[lane];
+    for (int axis = 0; axis < 3; ++axis) {
+      float t0 = (box_min[axis] - packet.origin[axis][lane]) *
+                 packet.inv_direction[axis][lane];
+      float t1 = (box_max[axis] - packet.origin[axis][lane]) *
+                 packet.inv_direction[axis][lane];
+      t_near = std::fmax(t_near, std::fmin(t0, t1));
+      t_far = std::fmin(t_far, std::fmax(t0, t1));
+    }
+
+    if (t_near <= t_far) {
+      hit_mask |= 1u << lane;
+    }
+  }
+
+  return hit_mask;
+}
+
+uint32_t IntersectSphereScalar(const RayPacket& packet,
+                               const glm::vec3& center, float radius,
+                               float* t, uint32_t mask) {
+  uint32_t hit_mask = 0;
+
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (!(mask & (1u << lane))) {
+      continue;
+    }
+
+    float oc[3];
+    float a = 0.f;
+    float half_b = 0.f;
+    float c = 0.f;
+    for (int axis = 0; axis < 3; ++axis) {
+      oc[axis] = packet.origin[axis][lane] - center[axis];
+      a += packet.direction[axis][lane] * packet.direction[axis][lane];
+      half_b += oc[axis] * packet.direction[axis][lane];
+      c += oc[axis] * oc[axis];
+    }
+    // same operation order as Sphere::Hit keeps both paths in agreement
+    c -= radius * radius;
+
+    float discriminant = half_b * half_b - a * c;
+    if (discriminant < 0.f) {
+      continue;
+    }
+
+    float sqrtd = std::sqrt(discriminant);
+    float root = (-half_b - sqrtd) / a;
+    if (root < packet.t_min || root > t[lane]) {
+      root = (-half_b + sqrtd) / a;
+
+      if (root < packet.t_min || root > t[lane]) {
+        continue;
+      }
+    }
+
+    t[lane] = root;
+    hit_mask |= 1u << lane;
+  }
+
+  return hit_mask;
+}
+
+int ClosestSphereScalar(const Ray& ray, float t_min,
+                        const SphereArrays& spheres, uint32_t begin,
+                        uint32_t end, float& t) {
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+  const float a = glm::dot(direction, direction);
+
+  int closest = -1;
+  for (uint32_t i = begin; i < end; ++i) {
+    glm::vec3 oc(origin.x - spheres.center[0][i],
+                 origin.y - spheres.center[1][i],
+                 origin.z - spheres.center[2][i]);
+    float half_b = glm::dot(oc, direction);
+    float c = glm::dot(oc, oc) - spheres.radius_squared[i];
+
+    float discriminant = half_b * half_b - a * c;
+    if (discriminant < 0.f) {
+      continue;
+    }
+
+    float sqrtd = std::sqrt(discriminant);
+    float root = (-half_b - sqrtd) / a;
+    if (root < t_min || root > t) {
+      root = (-half_b + sqrtd) / a;
+
+      if (root < t_min || root > t) {
+        continue;
+      }
+    }
+
+    t = root;
+    closest = static_cast<int>(i);
+  }
+
+  return closest;
+}
+
+}  // namespace
+
+SimdIsa Simd::DetectIsa() {
+#if defined(RAY_TRACING_SIMD_X86)
+#if defined(_MSC_VER)
+  int info[4]{};
+  __cpuid(info, 1);
+  const bool has_fma = info[2] & (1 << 12);
+  const bool has_osxsave = info[2] & (1 << 27);
+  const bool has_avx = info[2] & (1 << 28);
+
+  __cpuidex(info, 7, 0);
+  const bool has_avx2 = info[1] & (1 << 5);
+
+  // operating system must save ymm registers on context switch
+  const bool os_saves_ymm =
+      has_osxsave && ((_xgetbv(_XCR_XFEATURE_ENABLED_MASK) & 0x6) == 0x6);
+
+  if (has_avx && has_avx2 && has_fma && os_saves_ymm) {
+    return SimdIsa::AVX2;
+  }
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SimdIsa::AVX2;
+  }
+#endif
+  // part of the x86-64 baseline
+  return SimdIsa::SSE2;
+#elif defined(RAY_TRACING_SIMD_NEON)
+  // part of the aarch64 baseline
+  return SimdIsa::NEON;
+#else
+  return SimdIsa::SCALAR;
+#endif
+}
+
+const char* Simd::GetIsaName(SimdIsa isa) {
+  switch (isa) {
+    case SimdIsa::SSE2:
+      return "SSE2";
+    case SimdIsa::AVX2:
+      return "AVX2";
+    case SimdIsa::NEON:
+      return "NEON";
+    default:
+      return "Scalar";
+  }
+}
+
+SimdIsa Simd::GetIsa() {
+  static const SimdIsa isa = DetectIsa();
+
+  return isa;
+}
+
+const PacketKernels& Simd::GetKernels() {
+  static const PacketKernels kernels = []() {
+    switch (GetIsa()) {
+#ifdef RAY_TRACING_SIMD_X86
+      case SimdIsa::AVX2:
+        return GetAvx2Kernels();
+      case SimdIsa::SSE2:
+        return GetSse2Kernels();
+#endif
+#ifdef RAY_TRACING_SIMD_NEON
+      case SimdIsa::NEON:
+        return GetNeonKernels();
+#endif
+      default:
+        return GetScalarKernels();
+    }
+  }();
+
+  return kernels;
+}
+
+PacketKernels Simd::GetScalarKernels() {
+  PacketKernels kernels{};
+  kernels.intersect_box = IntersectBoxScalar;
+  kernels.intersect_sphere = IntersectSphereScalar;
+  kernels.closest_sphere = ClosestSphereScalar;
+  kernels.resolve_colors = ResolveColors;
+
+  return kernels;
+}
+
+}  // namespace rt
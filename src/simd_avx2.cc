@@ -0,0 +1,300 @@
+/**
+ * @file simd_avx2.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "simd.h"
+
+#ifdef RAY_TRACING_SIMD_X86
+
+// only the kernels below target AVX2, the rest of the translation unit and
+// the inline functions it shares with others stay at the baseline isa, as
+// the linker may keep any copy of those, kernels are only called after the
+// runtime check in Simd::DetectIsa, no fused multiply-add so results match
+// the scalar Sphere::Hit bit for bit
+#include <immintrin.h>
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RAY_TRACING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+// msvc takes the intrinsics without /arch:AVX2
+#define RAY_TRACING_TARGET_AVX2
+#endif
+
+namespace {
+
+RAY_TRACING_TARGET_AVX2
+inline __m256 LaneMask(uint32_t mask) {
+  const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  __m256i lanes = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)),
+                                   bits);
+
+  return _mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, bits));
+}
+
+RAY_TRACING_TARGET_AVX2
+uint32_t IntersectBoxAvx2(const RayPacket& packet, const glm::vec3& box_min,
+                          const glm::vec3& box_max, const float* t,
+                          uint32_t mask) {
+  __m256 t_near = _mm256_set1_ps(packet.t_min);
+  __m256 t_far = _mm256_loadu_ps(t);
+
+  for (int axis = 0; axis < 3; ++axis) {
+    __m256 origin = _mm256_load_ps(packet.origin[axis]);
+    __m256 inv_direction = _mm256_load_ps(packet.inv_direction[axis]);
+
+    __m256 t0 = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_set1_ps(box_min[axis]), origin), inv_direction);
+    __m256 t1 = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_set1_ps(box_max[axis]), origin), inv_direction);
+
+    t_near = _mm256_max_ps(t_near, _mm256_min_ps(t0, t1));
+    t_far = _mm256_min_ps(t_far, _mm256_max_ps(t0, t1));
+  }
+
+  __m256 hit = _mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ);
+
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit)) & mask;
+}
+
+RAY_TRACING_TARGET_AVX2
+uint32_t IntersectSphereAvx2(const RayPacket& packet, const glm::vec3& center,
+                             float radius, float* t, uint32_t mask) {
+  __m256 a = _mm256_setzero_ps();
+  __m256 half_b = _mm256_setzero_ps();
+  __m256 c = _mm256_setzero_ps();
+
+  for (int axis = 0; axis < 3; ++axis) {
+    __m256 direction = _mm256_load_ps(packet.direction[axis]);
+    __m256 oc = _mm256_sub_ps(_mm256_load_ps(packet.origin[axis]),
+                              _mm256_set1_ps(center[axis]));
+
+    a = _mm256_add_ps(a, _mm256_mul_ps(direction, direction));
+    half_b = _mm256_add_ps(half_b, _mm256_mul_ps(oc, direction));
+    c = _mm256_add_ps(c, _mm256_mul_ps(oc, oc));
+  }
+  c = _mm256_sub_ps(c, _mm256_set1_ps(radius * radius));
+
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 discriminant =
+      _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+  __m256 valid = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+
+  __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+  __m256 neg_half_b = _mm256_sub_ps(zero, half_b);
+  __m256 near_root = _mm256_div_ps(_mm256_sub_ps(neg_half_b, sqrtd), a);
+  __m256 far_root = _mm256_div_ps(_mm256_add_ps(neg_half_b, sqrtd), a);
+
+  const __m256 t_min = _mm256_set1_ps(packet.t_min);
+  const __m256 t_max = _mm256_loadu_ps(t);
+  __m256 near_ok =
+      _mm256_and_ps(_mm256_cmp_ps(near_root, t_min, _CMP_GE_OQ),
+                    _mm256_cmp_ps(near_root, t_max, _CMP_LE_OQ));
+  __m256 far_ok = _mm256_and_ps(_mm256_cmp_ps(far_root, t_min, _CMP_GE_OQ),
+                                _mm256_cmp_ps(far_root, t_max, _CMP_LE_OQ));
+
+  __m256 root = _mm256_blendv_ps(far_root, near_root, near_ok);
+  __m256 hit = _mm256_and_ps(_mm256_and_ps(valid, LaneMask(mask)),
+                             _mm256_or_ps(near_ok, far_ok));
+
+  _mm256_storeu_ps(t, _mm256_blendv_ps(t_max, root, hit));
+
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+
+RAY_TRACING_TARGET_AVX2
+int ClosestSphereAvx2(const Ray& ray, float t_min, const SphereArrays& spheres,
+                      uint32_t begin, uint32_t end, float& t) {
+  const glm::vec3 ray_origin = ray.GetOrigin();
+  const glm::vec3 ray_direction = ray.GetDirection();
+
+  __m256 origin[3];
+  __m256 direction[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    origin[axis] = _mm256_set1_ps(ray_origin[axis]);
+    direction[axis] = _mm256_set1_ps(ray_direction[axis]);
+  }
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 a = _mm256_set1_ps(glm::dot(ray_direction, ray_direction));
+  const __m256 t_min_lanes = _mm256_set1_ps(t_min);
+  const __m256i end_lanes = _mm256_set1_epi32(static_cast<int>(end));
+  const __m256i step = _mm256_set1_epi32(PACKET_SIZE);
+
+  // every lane keeps its own closest hit, reduced once at the end
+  __m256 best_t = _mm256_set1_ps(t);
+  __m256i best_index = _mm256_set1_epi32(-1);
+  __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(begin)),
+                                   _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+  for (uint32_t i = begin; i < end; i += PACKET_SIZE) {
+    __m256 oc[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      oc[axis] = _mm256_sub_ps(origin[axis],
+                               _mm256_loadu_ps(spheres.center[axis] + i));
+    }
+
+    __m256 half_b = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(oc[0], direction[0]),
+                      _mm256_mul_ps(oc[1], direction[1])),
+        _mm256_mul_ps(oc[2], direction[2]));
+    __m256 c = _mm256_sub_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(oc[0], oc[0]),
+                                    _mm256_mul_ps(oc[1], oc[1])),
+                      _mm256_mul_ps(oc[2], oc[2])),
+        _mm256_loadu_ps(spheres.radius_squared + i));
+
+    __m256 discriminant =
+        _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+    __m256 valid = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+
+    __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+    __m256 neg_half_b = _mm256_sub_ps(zero, half_b);
+    __m256 near_root = _mm256_div_ps(_mm256_sub_ps(neg_half_b, sqrtd), a);
+    __m256 far_root = _mm256_div_ps(_mm256_add_ps(neg_half_b, sqrtd), a);
+
+    __m256 near_ok =
+        _mm256_and_ps(_mm256_cmp_ps(near_root, t_min_lanes, _CMP_GE_OQ),
+                      _mm256_cmp_ps(near_root, best_t, _CMP_LE_OQ));
+    __m256 far_ok =
+        _mm256_and_ps(_mm256_cmp_ps(far_root, t_min_lanes, _CMP_GE_OQ),
+                      _mm256_cmp_ps(far_root, best_t, _CMP_LE_OQ));
+
+    // lanes past the last sphere read padding and are dropped here
+    __m256 in_range =
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(end_lanes, index));
+    __m256 hit = _mm256_and_ps(_mm256_and_ps(valid, in_range),
+                               _mm256_or_ps(near_ok, far_ok));
+
+    __m256 root = _mm256_blendv_ps(far_root, near_root, near_ok);
+    best_t = _mm256_blendv_ps(best_t, root, hit);
+    best_index = _mm256_castps_si256(_mm256_blendv_ps(
+        _mm256_castsi256_ps(best_index), _mm256_castsi256_ps(index), hit));
+
+    index = _mm256_add_epi32(index, step);
+  }
+
+  alignas(32) float lane_t[PACKET_SIZE];
+  alignas(32) int lane_index[PACKET_SIZE];
+  _mm256_store_ps(lane_t, best_t);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), best_index);
+
+  return ReduceClosestSphere(lane_t, lane_index, PACKET_SIZE, t);
+}
+
+// lut indices of interleaved RGB back to RGBA8, in the order they were loaded
+inline void PackPixels(const uint32_t* indices, const uint8_t* lut,
+                       int pixel_count, uint32_t* pixels) {
+  for (int i = 0; i < pixel_count; ++i) {
+    pixels[i] = (255u << 24) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 2]]) << 16) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 1]]) << 8) |
+                static_cast<uint32_t>(lut[indices[3 * i]]);
+  }
+}
+
+RAY_TRACING_TARGET_AVX2
+inline __m256 TonemapAvx2(__m256 x, Tonemap tonemap) {
+  switch (tonemap) {
+    case Tonemap::REINHARD:
+      return _mm256_div_ps(x, _mm256_add_ps(_mm256_set1_ps(1.f), x));
+    case Tonemap::ACES:
+      return _mm256_div_ps(
+          _mm256_mul_ps(x,
+                        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ACES_A), x),
+                                      _mm256_set1_ps(ACES_B))),
+          _mm256_add_ps(
+              _mm256_mul_ps(
+                  x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ACES_C), x),
+                                   _mm256_set1_ps(ACES_D))),
+              _mm256_set1_ps(ACES_E)));
+    default:
+      return x;
+  }
+}
+
+RAY_TRACING_TARGET_AVX2
+inline __m256i LutIndicesAvx2(__m256 x) {
+  const __m256i min_bits =
+      _mm256_set1_epi32(static_cast<int>(COLOR_LUT_MIN_BITS));
+  const __m256i max_bits =
+      _mm256_set1_epi32(static_cast<int>(COLOR_LUT_MAX_BITS));
+
+  // maxps returns its second operand for nan, so nan ends up black
+  x = _mm256_max_ps(x, _mm256_castsi256_ps(min_bits));
+  x = _mm256_min_ps(x, _mm256_castsi256_ps(max_bits));
+
+  return _mm256_srli_epi32(_mm256_sub_epi32(_mm256_castps_si256(x), min_bits),
+                           COLOR_LUT_SHIFT);
+}
+
+// eight pixels are three vectors of interleaved RGB, the per pixel scale is
+// permuted to match
+RAY_TRACING_TARGET_AVX2
+void ResolveColorsAvx2(const glm::vec3* sums, const int* sample_counts,
+                       uint32_t count, const ResolveParams& params,
+                       uint32_t* pixels) {
+  const float* values = reinterpret_cast<const float*>(sums);
+  const __m256 exposure = _mm256_set1_ps(params.exposure_scale);
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256i permutes[3] = {_mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2),
+                               _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5),
+                               _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7)};
+
+  uint32_t i = 0;
+  for (; i + PACKET_SIZE <= count; i += PACKET_SIZE) {
+    __m256 counts = _mm256_max_ps(
+        _mm256_cvtepi32_ps(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(sample_counts + i))),
+        one);
+    __m256 scale = _mm256_div_ps(exposure, counts);
+
+    alignas(32) uint32_t indices[3 * PACKET_SIZE];
+    for (int j = 0; j < 3; ++j) {
+      __m256 x =
+          _mm256_mul_ps(_mm256_loadu_ps(values + 3 * i + PACKET_SIZE * j),
+                        _mm256_permutevar8x32_ps(scale, permutes[j]));
+      _mm256_store_si256(
+          reinterpret_cast<__m256i*>(indices + PACKET_SIZE * j),
+          LutIndicesAvx2(TonemapAvx2(x, params.tonemap)));
+    }
+
+    PackPixels(indices, params.lut, PACKET_SIZE, pixels + i);
+  }
+
+  ResolveColors(sums + i, sample_counts + i, count - i, params, pixels + i);
+}
+
+}  // namespace
+
+PacketKernels Simd::GetAvx2Kernels() {
+  PacketKernels kernels{};
+  kernels.intersect_box = IntersectBoxAvx2;
+  kernels.intersect_sphere = IntersectSphereAvx2;
+  kernels.closest_sphere = ClosestSphereAvx2;
+  kernels.resolve_colors = ResolveColorsAvx2;
+
+  return kernels;
+}
+
+}  // namespace rt
+
+#undef RAY_TRACING_TARGET_AVX2
+
+#endif  // RAY_TRACING_SIMD_X86
@@ -0,0 +1,285 @@
+/**
+ * @file simd_neon.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "simd.h"
+
+#ifdef RAY_TRACING_SIMD_NEON
+
+#include <arm_neon.h>
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+namespace {
+
+// a packet is processed as two halves of four lanes
+const int HALF_SIZE = PACKET_SIZE / 2;
+
+inline uint32x4_t LaneMask(uint32_t mask) {
+  const uint32_t bit_values[4] = {1u, 2u, 4u, 8u};
+  const uint32x4_t bits = vld1q_u32(bit_values);
+
+  return vceqq_u32(vandq_u32(vdupq_n_u32(mask), bits), bits);
+}
+
+inline uint32_t MoveMask(uint32x4_t lanes) {
+  const uint32_t bit_values[4] = {1u, 2u, 4u, 8u};
+
+  return vaddvq_u32(vandq_u32(lanes, vld1q_u32(bit_values)));
+}
+
+uint32_t IntersectBoxNeon(const RayPacket& packet, const glm::vec3& box_min,
+                          const glm::vec3& box_max, const float* t,
+                          uint32_t mask) {
+  uint32_t hit_mask = 0;
+
+  for (int half = 0; half < 2; ++half) {
+    const int offset = half * HALF_SIZE;
+
+    float32x4_t t_near = vdupq_n_f32(packet.t_min);
+    float32x4_t t_far = vld1q_f32(t + offset);
+
+    for (int axis = 0; axis < 3; ++axis) {
+      float32x4_t origin = vld1q_f32(packet.origin[axis] + offset);
+      float32x4_t inv_direction =
+          vld1q_f32(packet.inv_direction[axis] + offset);
+
+      float32x4_t t0 = vmulq_f32(
+          vsubq_f32(vdupq_n_f32(box_min[axis]), origin), inv_direction);
+      float32x4_t t1 = vmulq_f32(
+          vsubq_f32(vdupq_n_f32(box_max[axis]), origin), inv_direction);
+
+      t_near = vmaxq_f32(t_near, vminq_f32(t0, t1));
+      t_far = vminq_f32(t_far, vmaxq_f32(t0, t1));
+    }
+
+    hit_mask |= MoveMask(vcleq_f32(t_near, t_far)) << offset;
+  }
+
+  return hit_mask & mask;
+}
+
+uint32_t IntersectSphereNeon(const RayPacket& packet, const glm::vec3& center,
+                             float radius, float* t, uint32_t mask) {
+  uint32_t hit_mask = 0;
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const float32x4_t t_min = vdupq_n_f32(packet.t_min);
+
+  for (int half = 0; half < 2; ++half) {
+    const int offset = half * HALF_SIZE;
+
+    float32x4_t a = zero;
+    float32x4_t half_b = zero;
+    float32x4_t c = zero;
+
+    for (int axis = 0; axis < 3; ++axis) {
+      float32x4_t direction = vld1q_f32(packet.direction[axis] + offset);
+      float32x4_t oc = vsubq_f32(vld1q_f32(packet.origin[axis] + offset),
+                                 vdupq_n_f32(center[axis]));
+
+      a = vaddq_f32(a, vmulq_f32(direction, direction));
+      half_b = vaddq_f32(half_b, vmulq_f32(oc, direction));
+      c = vaddq_f32(c, vmulq_f32(oc, oc));
+    }
+    c = vsubq_f32(c, vdupq_n_f32(radius * radius));
+
+    float32x4_t discriminant =
+        vsubq_f32(vmulq_f32(half_b, half_b), vmulq_f32(a, c));
+    uint32x4_t valid = vcgeq_f32(discriminant, zero);
+
+    float32x4_t sqrtd = vsqrtq_f32(vmaxq_f32(discriminant, zero));
+    float32x4_t neg_half_b = vnegq_f32(half_b);
+    float32x4_t near_root = vdivq_f32(vsubq_f32(neg_half_b, sqrtd), a);
+    float32x4_t far_root = vdivq_f32(vaddq_f32(neg_half_b, sqrtd), a);
+
+    const float32x4_t t_max = vld1q_f32(t + offset);
+    uint32x4_t near_ok =
+        vandq_u32(vcgeq_f32(near_root, t_min), vcleq_f32(near_root, t_max));
+    uint32x4_t far_ok =
+        vandq_u32(vcgeq_f32(far_root, t_min), vcleq_f32(far_root, t_max));
+
+    float32x4_t root = vbslq_f32(near_ok, near_root, far_root);
+    uint32x4_t hit = vandq_u32(vandq_u32(valid, LaneMask(mask >> offset)),
+                               vorrq_u32(near_ok, far_ok));
+
+    vst1q_f32(t + offset, vbslq_f32(hit, root, t_max));
+
+    hit_mask |= MoveMask(hit) << offset;
+  }
+
+  return hit_mask;
+}
+
+int ClosestSphereNeon(const Ray& ray, float t_min, const SphereArrays& spheres,
+                      uint32_t begin, uint32_t end, float& t) {
+  const glm::vec3 ray_origin = ray.GetOrigin();
+  const glm::vec3 ray_direction = ray.GetDirection();
+
+  float32x4_t origin[3];
+  float32x4_t direction[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    origin[axis] = vdupq_n_f32(ray_origin[axis]);
+    direction[axis] = vdupq_n_f32(ray_direction[axis]);
+  }
+
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const float32x4_t a = vdupq_n_f32(glm::dot(ray_direction, ray_direction));
+  const float32x4_t t_min_lanes = vdupq_n_f32(t_min);
+  const uint32x4_t end_lanes = vdupq_n_u32(end);
+  const uint32x4_t step = vdupq_n_u32(HALF_SIZE);
+  const uint32_t lane_offsets[4] = {0u, 1u, 2u, 3u};
+
+  // every lane keeps its own closest hit, reduced once at the end
+  float32x4_t best_t = vdupq_n_f32(t);
+  int32x4_t best_index = vdupq_n_s32(-1);
+  uint32x4_t index = vaddq_u32(vdupq_n_u32(begin), vld1q_u32(lane_offsets));
+
+  for (uint32_t i = begin; i < end; i += HALF_SIZE) {
+    float32x4_t oc[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      oc[axis] = vsubq_f32(origin[axis], vld1q_f32(spheres.center[axis] + i));
+    }
+
+    float32x4_t half_b =
+        vaddq_f32(vaddq_f32(vmulq_f32(oc[0], direction[0]),
+                            vmulq_f32(oc[1], direction[1])),
+                  vmulq_f32(oc[2], direction[2]));
+    float32x4_t c = vsubq_f32(
+        vaddq_f32(vaddq_f32(vmulq_f32(oc[0], oc[0]), vmulq_f32(oc[1], oc[1])),
+                  vmulq_f32(oc[2], oc[2])),
+        vld1q_f32(spheres.radius_squared + i));
+
+    float32x4_t discriminant =
+        vsubq_f32(vmulq_f32(half_b, half_b), vmulq_f32(a, c));
+    uint32x4_t valid = vcgeq_f32(discriminant, zero);
+
+    float32x4_t sqrtd = vsqrtq_f32(vmaxq_f32(discriminant, zero));
+    float32x4_t neg_half_b = vnegq_f32(half_b);
+    float32x4_t near_root = vdivq_f32(vsubq_f32(neg_half_b, sqrtd), a);
+    float32x4_t far_root = vdivq_f32(vaddq_f32(neg_half_b, sqrtd), a);
+
+    uint32x4_t near_ok = vandq_u32(vcgeq_f32(near_root, t_min_lanes),
+                                   vcleq_f32(near_root, best_t));
+    uint32x4_t far_ok = vandq_u32(vcgeq_f32(far_root, t_min_lanes),
+                                  vcleq_f32(far_root, best_t));
+
+    // lanes past the last sphere read padding and are dropped here
+    uint32x4_t in_range = vcltq_u32(index, end_lanes);
+    uint32x4_t hit =
+        vandq_u32(vandq_u32(valid, in_range), vorrq_u32(near_ok, far_ok));
+
+    float32x4_t root = vbslq_f32(near_ok, near_root, far_root);
+    best_t = vbslq_f32(hit, root, best_t);
+    best_index = vbslq_s32(hit, vreinterpretq_s32_u32(index), best_index);
+
+    index = vaddq_u32(index, step);
+  }
+
+  float lane_t[HALF_SIZE];
+  int lane_index[HALF_SIZE];
+  vst1q_f32(lane_t, best_t);
+  vst1q_s32(lane_index, best_index);
+
+  return ReduceClosestSphere(lane_t, lane_index, HALF_SIZE, t);
+}
+
+// lut indices of interleaved RGB back to RGBA8, in the order they were loaded
+inline void PackPixels(const uint32_t* indices, const uint8_t* lut,
+                       int pixel_count, uint32_t* pixels) {
+  for (int i = 0; i < pixel_count; ++i) {
+    pixels[i] = (255u << 24) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 2]]) << 16) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 1]]) << 8) |
+                static_cast<uint32_t>(lut[indices[3 * i]]);
+  }
+}
+
+inline float32x4_t TonemapNeon(float32x4_t x, Tonemap tonemap) {
+  switch (tonemap) {
+    case Tonemap::REINHARD:
+      return vdivq_f32(x, vaddq_f32(vdupq_n_f32(1.f), x));
+    case Tonemap::ACES:
+      return vdivq_f32(
+          vmulq_f32(x, vaddq_f32(vmulq_f32(vdupq_n_f32(ACES_A), x),
+                                 vdupq_n_f32(ACES_B))),
+          vaddq_f32(vmulq_f32(x, vaddq_f32(vmulq_f32(vdupq_n_f32(ACES_C), x),
+                                           vdupq_n_f32(ACES_D))),
+                    vdupq_n_f32(ACES_E)));
+    default:
+      return x;
+  }
+}
+
+inline uint32x4_t LutIndicesNeon(float32x4_t x) {
+  const uint32x4_t min_bits = vdupq_n_u32(COLOR_LUT_MIN_BITS);
+  const uint32x4_t max_bits = vdupq_n_u32(COLOR_LUT_MAX_BITS);
+
+  // maxnm returns the number for nan, so nan ends up black
+  x = vmaxnmq_f32(x, vreinterpretq_f32_u32(min_bits));
+  x = vminq_f32(x, vreinterpretq_f32_u32(max_bits));
+
+  return vshrq_n_u32(vsubq_u32(vreinterpretq_u32_f32(x), min_bits),
+                     COLOR_LUT_SHIFT);
+}
+
+// four pixels at a time, vld3 splits the interleaved RGB into channels and
+// vst3 interleaves the lut indices again
+void ResolveColorsNeon(const glm::vec3* sums, const int* sample_counts,
+                       uint32_t count, const ResolveParams& params,
+                       uint32_t* pixels) {
+  const float* values = reinterpret_cast<const float*>(sums);
+  const float32x4_t exposure = vdupq_n_f32(params.exposure_scale);
+  const float32x4_t one = vdupq_n_f32(1.f);
+
+  uint32_t i = 0;
+  for (; i + HALF_SIZE <= count; i += HALF_SIZE) {
+    float32x4_t counts =
+        vmaxq_f32(vcvtq_f32_s32(vld1q_s32(sample_counts + i)), one);
+    float32x4_t scale = vdivq_f32(exposure, counts);
+    float32x4x3_t rgb = vld3q_f32(values + 3 * i);
+
+    uint32x4x3_t channels;
+    for (int j = 0; j < 3; ++j) {
+      channels.val[j] = LutIndicesNeon(
+          TonemapNeon(vmulq_f32(rgb.val[j], scale), params.tonemap));
+    }
+
+    uint32_t indices[3 * HALF_SIZE];
+    vst3q_u32(indices, channels);
+
+    PackPixels(indices, params.lut, HALF_SIZE, pixels + i);
+  }
+
+  ResolveColors(sums + i, sample_counts + i, count - i, params, pixels + i);
+}
+
+}  // namespace
+
+PacketKernels Simd::GetNeonKernels() {
+  PacketKernels kernels{};
+  kernels.intersect_box = IntersectBoxNeon;
+  kernels.intersect_sphere = IntersectSphereNeon;
+  kernels.closest_sphere = ClosestSphereNeon;
+  kernels.resolve_colors = ResolveColorsNeon;
+
+  return kernels;
+}
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_SIMD_NEON
@@ -0,0 +1,295 @@
+/**
+ * @file simd_sse.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "simd.h"
+
+#ifdef RAY_TRACING_SIMD_X86
+
+#include <emmintrin.h>
+
+#include <cstdint>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "color_resolve.h"
+#include "ray.h"
+#include "ray_packet.h"
+
+namespace rt {
+
+namespace {
+
+// a packet is processed as two halves of four lanes
+const int HALF_SIZE = PACKET_SIZE / 2;
+
+inline __m128 LaneMask(uint32_t mask) {
+  const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+  __m128i lanes =
+      _mm_and_si128(_mm_set1_epi32(static_cast<int>(mask)), bits);
+
+  return _mm_castsi128_ps(_mm_cmpeq_epi32(lanes, bits));
+}
+
+inline __m128 Select(__m128 if_false, __m128 if_true, __m128 condition) {
+  return _mm_or_ps(_mm_and_ps(condition, if_true),
+                   _mm_andnot_ps(condition, if_false));
+}
+
+uint32_t IntersectBoxSse2(const RayPacket& packet, const glm::vec3& box_min,
+                          const glm::vec3& box_max, const float* t,
+                          uint32_t mask) {
+  uint32_t hit_mask = 0;
+
+  for (int half = 0; half < 2; ++half) {
+    const int offset = half * HALF_SIZE;
+
+    __m128 t_near = _mm_set1_ps(packet.t_min);
+    __m128 t_far = _mm_loadu_ps(t + offset);
+
+    for (int axis = 0; axis < 3; ++axis) {
+      __m128 origin = _mm_load_ps(packet.origin[axis] + offset);
+      __m128 inv_direction = _mm_load_ps(packet.inv_direction[axis] + offset);
+
+      __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_min[axis]), origin),
+                             inv_direction);
+      __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_max[axis]), origin),
+                             inv_direction);
+
+      t_near = _mm_max_ps(t_near, _mm_min_ps(t0, t1));
+      t_far = _mm_min_ps(t_far, _mm_max_ps(t0, t1));
+    }
+
+    hit_mask |= static_cast<uint32_t>(
+                    _mm_movemask_ps(_mm_cmple_ps(t_near, t_far)))
+                << offset;
+  }
+
+  return hit_mask & mask;
+}
+
+uint32_t IntersectSphereSse2(const RayPacket& packet, const glm::vec3& center,
+                             float radius, float* t, uint32_t mask) {
+  uint32_t hit_mask = 0;
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 t_min = _mm_set1_ps(packet.t_min);
+
+  for (int half = 0; half < 2; ++half) {
+    const int offset = half * HALF_SIZE;
+
+    __m128 a = zero;
+    __m128 half_b = zero;
+    __m128 c = zero;
+
+    for (int axis = 0; axis < 3; ++axis) {
+      __m128 direction = _mm_load_ps(packet.direction[axis] + offset);
+      __m128 oc = _mm_sub_ps(_mm_load_ps(packet.origin[axis] + offset),
+                             _mm_set1_ps(center[axis]));
+
+      a = _mm_add_ps(a, _mm_mul_ps(direction, direction));
+      half_b = _mm_add_ps(half_b, _mm_mul_ps(oc, direction));
+      c = _mm_add_ps(c, _mm_mul_ps(oc, oc));
+    }
+    c = _mm_sub_ps(c, _mm_set1_ps(radius * radius));
+
+    __m128 discriminant =
+        _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+    __m128 valid = _mm_cmpge_ps(discriminant, zero);
+
+    __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+    __m128 neg_half_b = _mm_sub_ps(zero, half_b);
+    __m128 near_root = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), a);
+    __m128 far_root = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), a);
+
+    const __m128 t_max = _mm_loadu_ps(t + offset);
+    __m128 near_ok = _mm_and_ps(_mm_cmpge_ps(near_root, t_min),
+                                _mm_cmple_ps(near_root, t_max));
+    __m128 far_ok = _mm_and_ps(_mm_cmpge_ps(far_root, t_min),
+                               _mm_cmple_ps(far_root, t_max));
+
+    __m128 root = Select(far_root, near_root, near_ok);
+    __m128 hit = _mm_and_ps(_mm_and_ps(valid, LaneMask(mask >> offset)),
+                            _mm_or_ps(near_ok, far_ok));
+
+    _mm_storeu_ps(t + offset, Select(t_max, root, hit));
+
+    hit_mask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << offset;
+  }
+
+  return hit_mask;
+}
+
+int ClosestSphereSse2(const Ray& ray, float t_min, const SphereArrays& spheres,
+                      uint32_t begin, uint32_t end, float& t) {
+  const glm::vec3 ray_origin = ray.GetOrigin();
+  const glm::vec3 ray_direction = ray.GetDirection();
+
+  __m128 origin[3];
+  __m128 direction[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    origin[axis] = _mm_set1_ps(ray_origin[axis]);
+    direction[axis] = _mm_set1_ps(ray_direction[axis]);
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 a = _mm_set1_ps(glm::dot(ray_direction, ray_direction));
+  const __m128 t_min_lanes = _mm_set1_ps(t_min);
+  const __m128i end_lanes = _mm_set1_epi32(static_cast<int>(end));
+  const __m128i step = _mm_set1_epi32(HALF_SIZE);
+
+  // every lane keeps its own closest hit, reduced once at the end
+  __m128 best_t = _mm_set1_ps(t);
+  __m128i best_index = _mm_set1_epi32(-1);
+  __m128i index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(begin)),
+                                _mm_setr_epi32(0, 1, 2, 3));
+
+  for (uint32_t i = begin; i < end; i += HALF_SIZE) {
+    __m128 oc[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      oc[axis] =
+          _mm_sub_ps(origin[axis], _mm_loadu_ps(spheres.center[axis] + i));
+    }
+
+    __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(oc[0], direction[0]),
+                                          _mm_mul_ps(oc[1], direction[1])),
+                               _mm_mul_ps(oc[2], direction[2]));
+    __m128 c = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(oc[0], oc[0]),
+                              _mm_mul_ps(oc[1], oc[1])),
+                   _mm_mul_ps(oc[2], oc[2])),
+        _mm_loadu_ps(spheres.radius_squared + i));
+
+    __m128 discriminant =
+        _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+    __m128 valid = _mm_cmpge_ps(discriminant, zero);
+
+    __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+    __m128 neg_half_b = _mm_sub_ps(zero, half_b);
+    __m128 near_root = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), a);
+    __m128 far_root = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), a);
+
+    __m128 near_ok = _mm_and_ps(_mm_cmpge_ps(near_root, t_min_lanes),
+                                _mm_cmple_ps(near_root, best_t));
+    __m128 far_ok = _mm_and_ps(_mm_cmpge_ps(far_root, t_min_lanes),
+                               _mm_cmple_ps(far_root, best_t));
+
+    // lanes past the last sphere read padding and are dropped here
+    __m128 in_range = _mm_castsi128_ps(_mm_cmpgt_epi32(end_lanes, index));
+    __m128 hit =
+        _mm_and_ps(_mm_and_ps(valid, in_range), _mm_or_ps(near_ok, far_ok));
+
+    __m128 root = Select(far_root, near_root, near_ok);
+    best_t = Select(best_t, root, hit);
+    best_index = _mm_castps_si128(Select(_mm_castsi128_ps(best_index),
+                                         _mm_castsi128_ps(index), hit));
+
+    index = _mm_add_epi32(index, step);
+  }
+
+  alignas(16) float lane_t[HALF_SIZE];
+  alignas(16) int lane_index[HALF_SIZE];
+  _mm_store_ps(lane_t, best_t);
+  _mm_store_si128(reinterpret_cast<__m128i*>(lane_index), best_index);
+
+  return ReduceClosestSphere(lane_t, lane_index, HALF_SIZE, t);
+}
+
+// lut indices of interleaved RGB back to RGBA8, in the order they were loaded
+inline void PackPixels(const uint32_t* indices, const uint8_t* lut,
+                       int pixel_count, uint32_t* pixels) {
+  for (int i = 0; i < pixel_count; ++i) {
+    pixels[i] = (255u << 24) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 2]]) << 16) |
+                (static_cast<uint32_t>(lut[indices[3 * i + 1]]) << 8) |
+                static_cast<uint32_t>(lut[indices[3 * i]]);
+  }
+}
+
+inline __m128 TonemapSse2(__m128 x, Tonemap tonemap) {
+  switch (tonemap) {
+    case Tonemap::REINHARD:
+      return _mm_div_ps(x, _mm_add_ps(_mm_set1_ps(1.f), x));
+    case Tonemap::ACES:
+      return _mm_div_ps(
+          _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_A), x),
+                                   _mm_set1_ps(ACES_B))),
+          _mm_add_ps(
+              _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_C), x),
+                                       _mm_set1_ps(ACES_D))),
+              _mm_set1_ps(ACES_E)));
+    default:
+      return x;
+  }
+}
+
+inline __m128i LutIndicesSse2(__m128 x) {
+  const __m128i min_bits =
+      _mm_set1_epi32(static_cast<int>(COLOR_LUT_MIN_BITS));
+  const __m128i max_bits =
+      _mm_set1_epi32(static_cast<int>(COLOR_LUT_MAX_BITS));
+
+  // maxps returns its second operand for nan, so nan ends up black
+  x = _mm_max_ps(x, _mm_castsi128_ps(min_bits));
+  x = _mm_min_ps(x, _mm_castsi128_ps(max_bits));
+
+  return _mm_srli_epi32(_mm_sub_epi32(_mm_castps_si128(x), min_bits),
+                        COLOR_LUT_SHIFT);
+}
+
+// four pixels are three vectors of interleaved RGB, the per pixel scale is
+// shuffled to match
+void ResolveColorsSse2(const glm::vec3* sums, const int* sample_counts,
+                       uint32_t count, const ResolveParams& params,
+                       uint32_t* pixels) {
+  const float* values = reinterpret_cast<const float*>(sums);
+  const __m128 exposure = _mm_set1_ps(params.exposure_scale);
+  const __m128 one = _mm_set1_ps(1.f);
+
+  uint32_t i = 0;
+  for (; i + HALF_SIZE <= count; i += HALF_SIZE) {
+    __m128 counts = _mm_max_ps(
+        _mm_cvtepi32_ps(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(sample_counts + i))),
+        one);
+    __m128 scale = _mm_div_ps(exposure, counts);
+    const __m128 scales[3] = {
+        _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1, 0, 0, 0)),
+        _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2, 2, 1, 1)),
+        _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(3, 3, 3, 2))};
+
+    alignas(16) uint32_t indices[3 * HALF_SIZE];
+    for (int j = 0; j < 3; ++j) {
+      __m128 x = _mm_mul_ps(_mm_loadu_ps(values + 3 * i + HALF_SIZE * j),
+                            scales[j]);
+      _mm_store_si128(reinterpret_cast<__m128i*>(indices + HALF_SIZE * j),
+                      LutIndicesSse2(TonemapSse2(x, params.tonemap)));
+    }
+
+    PackPixels(indices, params.lut, HALF_SIZE, pixels + i);
+  }
+
+  ResolveColors(sums + i, sample_counts + i, count - i, params, pixels + i);
+}
+
+}  // namespace
+
+PacketKernels Simd::GetSse2Kernels() {
+  PacketKernels kernels{};
+  kernels.intersect_box = IntersectBoxSse2;
+  kernels.intersect_sphere = IntersectSphereSse2;
+  kernels.closest_sphere = ClosestSphereSse2;
+  kernels.resolve_colors = ResolveColorsSse2;
+
+  return kernels;
+}
+
+}  // namespace rt
+
+#endif  // RAY_TRACING_SIMD_X86
@@ -0,0 +1,261 @@
+/**
+ * @file socket.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "socket.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace rt {
+
+namespace {
+
+#if defined(_WIN32)
+
+using Handle = SOCKET;
+using Length = int;
+using AddressLength = int;
+const int SEND_FLAGS = 0;
+
+// winsock is started once and stays up for the whole process
+void Startup() {
+  static const bool started = []() {
+    WSADATA data{};
+    return 0 == WSAStartup(MAKEWORD(2, 2), &data);
+  }();
+
+  if (!started) {
+    throw std::runtime_error("Error::Socket: Failed to start winsock!");
+  }
+}
+
+void CloseSocket(Handle handle) { closesocket(handle); }
+
+#else
+
+using Handle = int;
+using Length = size_t;
+using AddressLength = socklen_t;
+// a peer that hung up is an error instead of a SIGPIPE
+#if defined(MSG_NOSIGNAL)
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+void Startup() {}
+
+void CloseSocket(Handle handle) { close(handle); }
+
+#endif
+
+// largest piece handed to a single send or recv
+const size_t MAX_CHUNK_SIZE = size_t(1) << 30;
+
+Handle ToHandle(intptr_t handle) { return static_cast<Handle>(handle); }
+
+// messages are small and answered right away, so never hold them back
+void Configure(Handle handle) {
+  int enabled = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY,
+             reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+#if defined(SO_NOSIGPIPE)
+  setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE,
+             reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+#endif
+}
+
+}  // namespace
+
+Socket::Socket(intptr_t handle) : handle_{handle} {}
+
+Socket::~Socket() { Close(); }
+
+Socket::Socket(Socket&& other) noexcept
+    : handle_{std::exchange(other.handle_, -1)} {}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+  if (this != &other) {
+    Close();
+    handle_ = std::exchange(other.handle_, -1);
+  }
+
+  return *this;
+}
+
+Socket Socket::Connect(const std::string& address) {
+  Startup();
+
+  const size_t colon = address.rfind(':');
+  if (std::string::npos == colon || 0 == colon ||
+      colon + 1 == address.size()) {
+    throw std::runtime_error("Error::Socket: Expected host:port instead of " +
+                             address + "!");
+  }
+  const std::string host = address.substr(0, colon);
+  const std::string port = address.substr(colon + 1);
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) ||
+      !addresses) {
+    throw std::runtime_error("Error::Socket: Failed to resolve " + address +
+                             "!");
+  }
+
+  // first address that takes the connection
+  Socket socket{};
+  for (addrinfo* info = addresses; info; info = info->ai_next) {
+    Socket candidate(static_cast<intptr_t>(
+        ::socket(info->ai_family, info->ai_socktype, info->ai_protocol)));
+    if (!candidate.IsOpen()) {
+      continue;
+    }
+
+    if (0 == connect(ToHandle(candidate.handle_), info->ai_addr,
+                     static_cast<AddressLength>(info->ai_addrlen))) {
+      socket = std::move(candidate);
+      break;
+    }
+  }
+  freeaddrinfo(addresses);
+
+  if (!socket.IsOpen()) {
+    throw std::runtime_error("Error::Socket: Failed to connect to " +
+                             address + "!");
+  }
+  Configure(ToHandle(socket.handle_));
+
+  return socket;
+}
+
+Socket Socket::Listen(uint16_t port) {
+  Startup();
+
+  Socket socket(static_cast<intptr_t>(::socket(AF_INET, SOCK_STREAM, 0)));
+  if (!socket.IsOpen()) {
+    throw std::runtime_error("Error::Socket: Failed to create a socket!");
+  }
+
+  // restarted workers get their port back at once
+  int enabled = 1;
+  setsockopt(ToHandle(socket.handle_), SOL_SOCKET, SO_REUSEADDR,
+             reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  if (bind(ToHandle(socket.handle_), reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) ||
+      listen(ToHandle(socket.handle_), SOMAXCONN)) {
+    throw std::runtime_error("Error::Socket: Failed to listen on port " +
+                             std::to_string(port) + "!");
+  }
+
+  return socket;
+}
+
+Socket Socket::Accept() const {
+  Socket socket(static_cast<intptr_t>(
+      accept(ToHandle(handle_), nullptr, nullptr)));
+  if (!socket.IsOpen()) {
+    throw std::runtime_error("Error::Socket: Failed to accept a connection!");
+  }
+  Configure(ToHandle(socket.handle_));
+
+  return socket;
+}
+
+void Socket::Send(const void* data, size_t size) const {
+  const char* bytes = static_cast<const char*>(data);
+
+  while (size) {
+    const size_t chunk = std::min(size, MAX_CHUNK_SIZE);
+    const auto sent = send(ToHandle(handle_), bytes,
+                           static_cast<Length>(chunk), SEND_FLAGS);
+    if (sent <= 0) {
+      throw std::runtime_error("Error::Socket: Failed to send!");
+    }
+
+    bytes += sent;
+    size -= static_cast<size_t>(sent);
+  }
+}
+
+void Socket::Receive(void* data, size_t size) const {
+  char* bytes = static_cast<char*>(data);
+
+  while (size) {
+    const size_t chunk = std::min(size, MAX_CHUNK_SIZE);
+    const auto received =
+        recv(ToHandle(handle_), bytes, static_cast<Length>(chunk), 0);
+    if (0 == received) {
+      throw std::runtime_error("Error::Socket: Connection closed!");
+    }
+    if (received < 0) {
+      throw std::runtime_error("Error::Socket: Failed to receive!");
+    }
+
+    bytes += received;
+    size -= static_cast<size_t>(received);
+  }
+}
+
+void Socket::SetTimeout(float seconds) const {
+#if defined(_WIN32)
+  const DWORD timeout = static_cast<DWORD>(seconds * 1000.f);
+#else
+  timeval timeout{};
+  timeout.tv_sec = static_cast<time_t>(seconds);
+  timeout.tv_usec = static_cast<suseconds_t>(
+      (seconds - static_cast<float>(timeout.tv_sec)) * 1e6f);
+#endif
+
+  if (setsockopt(ToHandle(handle_), SOL_SOCKET, SO_RCVTIMEO,
+                 reinterpret_cast<const char*>(&timeout), sizeof(timeout))) {
+    throw std::runtime_error("Error::Socket: Failed to set the timeout!");
+  }
+}
+
+bool Socket::IsOpen() const { return handle_ >= 0; }
+
+void Socket::Close() {
+  if (IsOpen()) {
+    CloseSocket(ToHandle(handle_));
+    handle_ = -1;
+  }
+}
+
+}  // namespace rt
@@ -11,21 +11,27 @@
 #include "sphere.h"
 
 #include <cmath>
+#include <cstdint>
 
 #define RAY_TRACING_INCLUDE_GLM
 #include <glm/glm.hpp>
 
+#include "aabb.h"
 #include "hittable.h"
 #include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "simd.h"
 
 namespace rt {
 
-Sphere::Sphere(glm::vec3 center, float radius,
-               std::shared_ptr<Material> material)
-    : radius_{radius}, center_{center}, material_{material} {}
+Sphere::Sphere(glm::vec3 center, float radius, uint32_t material_index)
+    : radius_{radius}, center_{center}, material_index_{material_index} {}
 
 bool Sphere::Hit(const Ray& ray, float t_min, float t_max,
                  HitRecord& record) const {
+  RAY_TRACING_STATS_ADD(intersection_tests, 1);
+
   glm::vec3 oc = ray.GetOrigin() - center_;
   float a = glm::dot(ray.GetDirection(), ray.GetDirection());
   float half_b = glm::dot(oc, ray.GetDirection());
@@ -58,9 +64,57 @@ bool Sphere::Hit(const Ray& ray, float t_min, float t_max,
   glm::vec3 outward_normal = (record.point - center_) / radius_;
   record.SetFaceNormal(ray, outward_normal);
 
-  record.material = material_;
+  record.material_index = material_index_;
 
   return true;
 }
 
+bool Sphere::Occluded(const Ray& ray, float t_min, float t_max) const {
+  RAY_TRACING_STATS_ADD(intersection_tests, 1);
+
+  glm::vec3 oc = ray.GetOrigin() - center_;
+  float a = glm::dot(ray.GetDirection(), ray.GetDirection());
+  float half_b = glm::dot(oc, ray.GetDirection());
+  float c = glm::dot(oc, oc) - radius_ * radius_;
+  float discriminant = half_b * half_b - a * c;
+
+  if (discriminant < 0) {
+    return false;
+  }
+
+  // either root will do
+  float sqrtd = std::sqrt(discriminant);
+  float near_root = (-half_b - sqrtd) / a;
+  float far_root = (-half_b + sqrtd) / a;
+
+  return (near_root >= t_min && near_root <= t_max) ||
+         (far_root >= t_min && far_root <= t_max);
+}
+
+void Sphere::HitPacket(const RayPacket& packet, uint32_t mask,
+                       PacketHit& hit) const {
+  RAY_TRACING_STATS_ADD(intersection_tests, Stats::CountLanes(mask));
+
+  uint32_t hit_mask = Simd::GetKernels().intersect_sphere(packet, center_,
+                                                          radius_, hit.t, mask);
+
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (hit_mask & (1u << lane)) {
+      hit.object[lane] = this;
+    }
+  }
+}
+
+Aabb Sphere::BoundingBox() const {
+  glm::vec3 extent(std::fabs(radius_));
+
+  return Aabb(center_ - extent, center_ + extent);
+}
+
+glm::vec3 Sphere::GetCenter() const { return center_; }
+
+float Sphere::GetRadius() const { return radius_; }
+
+uint32_t Sphere::GetMaterialIndex() const { return material_index_; }
+
 }  // namespace rt
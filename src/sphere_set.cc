@@ -0,0 +1,237 @@
+/**
+ * @file sphere_set.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "sphere_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "config.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "simd.h"
+#include "sphere.h"
+
+namespace rt {
+
+void SphereSet::Add(const Sphere& sphere) {
+  Add(sphere.GetCenter(), sphere.GetRadius(), sphere.GetMaterialIndex());
+}
+
+void SphereSet::Add(const glm::vec3& center, float radius,
+                    uint32_t material_index) {
+  Push(center, radius, radius * radius, material_index);
+
+  glm::vec3 extent(std::fabs(radius));
+  box_.Expand(Aabb(center - extent, center + extent));
+}
+
+void SphereSet::AddEmpty() { Push(glm::vec3(0.f), 0.f, -INFINITY_F, 0); }
+
+void SphereSet::Append(const SphereSet& other, uint32_t index) {
+  if (other.IsEmpty(index)) {
+    AddEmpty();
+    return;
+  }
+
+  glm::vec3 center(other.center_x_[index], other.center_y_[index],
+                   other.center_z_[index]);
+  Add(center, other.radii_[index], other.material_indices_[index]);
+}
+
+void SphereSet::Set(uint32_t index, const glm::vec3& center, float radius,
+                    uint32_t material_index) {
+  center_x_[index] = center.x;
+  center_y_[index] = center.y;
+  center_z_[index] = center.z;
+  radius_squared_[index] = radius * radius;
+
+  radii_[index] = radius;
+  material_indices_[index] = material_index;
+
+  glm::vec3 extent(std::fabs(radius));
+  box_.Expand(Aabb(center - extent, center + extent));
+}
+
+void SphereSet::SetEmpty(uint32_t index) {
+  center_x_[index] = 0.f;
+  center_y_[index] = 0.f;
+  center_z_[index] = 0.f;
+  radius_squared_[index] = -INFINITY_F;
+
+  radii_[index] = 0.f;
+  material_indices_[index] = 0;
+}
+
+void SphereSet::Reserve(uint32_t count) {
+  const size_t padded_size = static_cast<size_t>(count) + PACKET_SIZE;
+  center_x_.reserve(padded_size);
+  center_y_.reserve(padded_size);
+  center_z_.reserve(padded_size);
+  radius_squared_.reserve(padded_size);
+
+  radii_.reserve(count);
+  material_indices_.reserve(count);
+}
+
+void SphereSet::Clear() {
+  count_ = 0;
+
+  center_x_.clear();
+  center_y_.clear();
+  center_z_.clear();
+  radius_squared_.clear();
+
+  radii_.clear();
+  material_indices_.clear();
+
+  box_ = Aabb();
+}
+
+uint32_t SphereSet::GetCount() const { return count_; }
+
+bool SphereSet::IsEmpty(uint32_t index) const {
+  return radius_squared_[index] < 0.f;
+}
+
+Aabb SphereSet::GetBoundingBox(uint32_t index) const {
+  if (IsEmpty(index)) {
+    return Aabb();
+  }
+
+  glm::vec3 center(center_x_[index], center_y_[index], center_z_[index]);
+  glm::vec3 extent(std::fabs(radii_[index]));
+
+  return Aabb(center - extent, center + extent);
+}
+
+bool SphereSet::HitRange(const Ray& ray, float t_min, float t_max,
+                         uint32_t begin, uint32_t end,
+                         HitRecord& record) const {
+  RAY_TRACING_STATS_ADD(intersection_tests, end - begin);
+
+  float closest_so_far = t_max;
+  int index = Simd::GetKernels().closest_sphere(ray, t_min, GetArrays(), begin,
+                                                end, closest_so_far);
+  if (index < 0) {
+    return false;
+  }
+
+  // same record Sphere::Hit would have written
+  record.t = closest_so_far;
+  record.point = ray.At(record.t);
+
+  glm::vec3 center(center_x_[index], center_y_[index], center_z_[index]);
+  glm::vec3 outward_normal = (record.point - center) / radii_[index];
+  record.SetFaceNormal(ray, outward_normal);
+
+  record.material_index = material_indices_[index];
+
+  return true;
+}
+
+bool SphereSet::OccludedRange(const Ray& ray, float t_min, float t_max,
+                              uint32_t begin, uint32_t end) const {
+  RAY_TRACING_STATS_ADD(intersection_tests, end - begin);
+
+  // one sweep of the kernel tests the whole range, the closest sphere comes
+  // for free and the record is skipped
+  float closest_so_far = t_max;
+  return Simd::GetKernels().closest_sphere(ray, t_min, GetArrays(), begin,
+                                           end, closest_so_far) >= 0;
+}
+
+bool SphereSet::Hit(const Ray& ray, float t_min, float t_max,
+                    HitRecord& record) const {
+  return HitRange(ray, t_min, t_max, 0, count_, record);
+}
+
+bool SphereSet::Occluded(const Ray& ray, float t_min, float t_max) const {
+  return OccludedRange(ray, t_min, t_max, 0, count_);
+}
+
+uint32_t SphereSet::HitPacketRange(const RayPacket& packet, uint32_t mask,
+                                   PacketHit& hit, uint32_t begin,
+                                   uint32_t end) const {
+  RAY_TRACING_STATS_ADD(intersection_tests,
+                        (end - begin) * Stats::CountLanes(mask));
+
+  const PacketKernels& kernels = Simd::GetKernels();
+  uint32_t hit_mask = 0;
+
+  for (uint32_t i = begin; i < end; ++i) {
+    if (IsEmpty(i)) {
+      continue;
+    }
+
+    glm::vec3 center(center_x_[i], center_y_[i], center_z_[i]);
+    hit_mask |=
+        kernels.intersect_sphere(packet, center, radii_[i], hit.t, mask);
+  }
+
+  return hit_mask;
+}
+
+void SphereSet::HitPacket(const RayPacket& packet, uint32_t mask,
+                          PacketHit& hit) const {
+  uint32_t hit_mask = HitPacketRange(packet, mask, hit, 0, count_);
+
+  // Hit of the whole set rebuilds the record of the closest sphere
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (hit_mask & (1u << lane)) {
+      hit.object[lane] = this;
+    }
+  }
+}
+
+Aabb SphereSet::BoundingBox() const { return box_; }
+
+void SphereSet::Push(const glm::vec3& center, float radius,
+                     float radius_squared, uint32_t material_index) {
+  // keep PACKET_SIZE - 1 empty slots readable past the last sphere
+  const size_t padded_size = count_ + PACKET_SIZE;
+  // vector growth is geometric already, Reserve skips it entirely
+  if (center_x_.size() < padded_size) {
+    center_x_.resize(padded_size, 0.f);
+    center_y_.resize(padded_size, 0.f);
+    center_z_.resize(padded_size, 0.f);
+    radius_squared_.resize(padded_size, -INFINITY_F);
+  }
+
+  center_x_[count_] = center.x;
+  center_y_[count_] = center.y;
+  center_z_[count_] = center.z;
+  radius_squared_[count_] = radius_squared;
+
+  radii_.push_back(radius);
+  material_indices_.push_back(material_index);
+
+  ++count_;
+}
+
+SphereArrays SphereSet::GetArrays() const {
+  SphereArrays arrays{};
+  arrays.center[0] = center_x_.data();
+  arrays.center[1] = center_y_.data();
+  arrays.center[2] = center_z_.data();
+  arrays.radius_squared = radius_squared_.data();
+
+  return arrays;
+}
+
+}  // namespace rt
@@ -0,0 +1,162 @@
+/**
+ * @file thread_pool.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rt {
+
+ThreadPool::ThreadPool(uint32_t thread_count) { Start(thread_count); }
+
+ThreadPool::~ThreadPool() { Stop(); }
+
+bool ThreadPool::ParallelFor(uint32_t task_count, const ThreadPoolTask& task) {
+  std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+  cancelled_.store(false);
+
+  // hand out contiguous ranges so neighbouring tiles stay on one worker
+  // unless they get stolen
+  const uint32_t worker_count = static_cast<uint32_t>(queues_.size());
+  for (uint32_t worker = 0; worker < worker_count; ++worker) {
+    uint32_t begin = static_cast<uint32_t>(
+        static_cast<uint64_t>(task_count) * worker / worker_count);
+    uint32_t end = static_cast<uint32_t>(
+        static_cast<uint64_t>(task_count) * (worker + 1) / worker_count);
+
+    std::lock_guard<std::mutex> queue_lock(queues_[worker]->mutex);
+    queues_[worker]->begin = begin;
+    queues_[worker]->end = end;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  active_workers_ = worker_count;
+  ++generation_;
+  work_condition_.notify_all();
+
+  done_condition_.wait(lock, [this]() { return !active_workers_; });
+  task_ = nullptr;
+
+  return !cancelled_.load();
+}
+
+void ThreadPool::Cancel() { cancelled_.store(true); }
+
+bool ThreadPool::IsCancelled() const {
+  return cancelled_.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::Resize(uint32_t thread_count) {
+  std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+  Stop();
+  Start(thread_count);
+}
+
+uint32_t ThreadPool::GetThreadCount() const {
+  return static_cast<uint32_t>(workers_.size());
+}
+
+void ThreadPool::Start(uint32_t thread_count) {
+  if (!thread_count) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  stop_ = false;
+
+  queues_.clear();
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, i, generation_);
+  }
+}
+
+void ThreadPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_condition_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+
+  workers_.clear();
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker, uint64_t generation) {
+  while (true) {
+    const ThreadPoolTask* task = nullptr;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(
+          lock, [&]() { return stop_ || generation != generation_; });
+
+      if (stop_) {
+        return;
+      }
+
+      generation = generation_;
+      task = task_;
+    }
+
+    // drain queues even when cancelled so the next batch starts empty
+    uint32_t index = 0;
+    while (PopTask(worker, index)) {
+      if (!cancelled_.load(std::memory_order_relaxed)) {
+        (*task)(index, worker);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!--active_workers_) {
+      done_condition_.notify_all();
+    }
+  }
+}
+
+bool ThreadPool::PopTask(uint32_t worker, uint32_t& task) {
+  // own queue first, front to back
+  {
+    WorkQueue& queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.begin != queue.end) {
+      task = queue.begin++;
+      return true;
+    }
+  }
+
+  // steal from the back of other queues
+  const uint32_t worker_count = static_cast<uint32_t>(queues_.size());
+  for (uint32_t i = 1; i < worker_count; ++i) {
+    WorkQueue& queue = *queues_[(worker + i) % worker_count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.begin != queue.end) {
+      task = --queue.end;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace rt
@@ -0,0 +1,431 @@
+/**
+ * @file triangle_mesh.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "triangle_mesh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "simd.h"
+
+namespace rt {
+
+namespace {
+
+// ray set up once for the watertight test of Woop et al., the dominant axis
+// of the direction becomes z and the other two are sheared onto it
+struct WatertightRay {
+  glm::vec3 origin;
+  int kx;
+  int ky;
+  int kz;
+  float sx;
+  float sy;
+  float sz;
+};
+
+WatertightRay MakeWatertightRay(const glm::vec3& origin,
+                                const glm::vec3& direction) {
+  WatertightRay ray{};
+  ray.origin = origin;
+
+  const float x = std::fabs(direction.x);
+  const float y = std::fabs(direction.y);
+  const float z = std::fabs(direction.z);
+  ray.kz = x > y ? (x > z ? 0 : 2) : (y > z ? 1 : 2);
+  ray.kx = (ray.kz + 1) % 3;
+  ray.ky = (ray.kx + 1) % 3;
+  // keep the winding order of the triangles
+  if (direction[ray.kz] < 0.f) {
+    std::swap(ray.kx, ray.ky);
+  }
+
+  ray.sz = 1.f / direction[ray.kz];
+  ray.sx = direction[ray.kx] * ray.sz;
+  ray.sy = direction[ray.ky] * ray.sz;
+
+  return ray;
+}
+
+// t is updated and the barycentrics written on a hit within [t_min, t]
+bool IntersectTriangle(const WatertightRay& ray, const glm::vec3& p0,
+                       const glm::vec3& p1, const glm::vec3& p2, float t_min,
+                       float& t, glm::vec3& barycentric) {
+  const glm::vec3 a = p0 - ray.origin;
+  const glm::vec3 b = p1 - ray.origin;
+  const glm::vec3 c = p2 - ray.origin;
+
+  const float ax = a[ray.kx] - ray.sx * a[ray.kz];
+  const float ay = a[ray.ky] - ray.sy * a[ray.kz];
+  const float bx = b[ray.kx] - ray.sx * b[ray.kz];
+  const float by = b[ray.ky] - ray.sy * b[ray.kz];
+  const float cx = c[ray.kx] - ray.sx * c[ray.kz];
+  const float cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+  float u = cx * by - cy * bx;
+  float v = ax * cy - ay * cx;
+  float w = bx * ay - by * ax;
+
+  // rays through an edge are decided in double precision, neighbouring
+  // triangles then never leave a crack between them
+  if (u == 0.f || v == 0.f || w == 0.f) {
+    u = static_cast<float>(static_cast<double>(cx) * by -
+                           static_cast<double>(cy) * bx);
+    v = static_cast<float>(static_cast<double>(ax) * cy -
+                           static_cast<double>(ay) * cx);
+    w = static_cast<float>(static_cast<double>(bx) * ay -
+                           static_cast<double>(by) * ax);
+  }
+
+  if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f)) {
+    return false;
+  }
+
+  const float det = u + v + w;
+  if (det == 0.f) {
+    return false;
+  }
+
+  const float az = ray.sz * a[ray.kz];
+  const float bz = ray.sz * b[ray.kz];
+  const float cz = ray.sz * c[ray.kz];
+
+  const float inv_det = 1.f / det;
+  const float t_hit = (u * az + v * bz + w * cz) * inv_det;
+  if (t_hit < t_min || t_hit > t) {
+    return false;
+  }
+
+  t = t_hit;
+  barycentric = glm::vec3(u, v, w) * inv_det;
+
+  return true;
+}
+
+}  // namespace
+
+uint32_t MeshData::GetTriangleCount() const {
+  return static_cast<uint32_t>(indices.size() / 3);
+}
+
+TriangleMesh::TriangleMesh(MeshData data, uint32_t material_index)
+    : positions_{std::move(data.positions)},
+      normals_{std::move(data.normals)},
+      material_index_{material_index} {
+  if (data.indices.size() % 3) {
+    throw std::runtime_error(
+        "Error::TriangleMesh: Index count is not a multiple of 3!");
+  }
+  if (!normals_.empty() && normals_.size() != positions_.size()) {
+    throw std::runtime_error(
+        "Error::TriangleMesh: Normal count does not match positions!");
+  }
+  for (uint32_t index : data.indices) {
+    if (index >= positions_.size()) {
+      throw std::runtime_error("Error::TriangleMesh: Index out of range!");
+    }
+  }
+
+  const uint32_t triangle_count = data.GetTriangleCount();
+
+  std::vector<Aabb> boxes(triangle_count);
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    for (int corner = 0; corner < 3; ++corner) {
+      boxes[i].Expand(positions_[data.indices[3 * i + corner]]);
+    }
+  }
+
+  std::vector<uint32_t> order{};
+  nodes_ = BvhBuilder::Build(boxes, order);
+
+  // store triangles in leaf order so that leaves reference contiguous ranges
+  indices_.resize(data.indices.size());
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    for (int corner = 0; corner < 3; ++corner) {
+      indices_[3 * i + corner] = data.indices[3 * order[i] + corner];
+    }
+  }
+}
+
+bool TriangleMesh::Hit(const Ray& ray, float t_min, float t_max,
+                       HitRecord& record) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+  const glm::vec3 inv_direction = 1.f / direction;
+  const bool direction_is_negative[3] = {direction.x < 0.f, direction.y < 0.f,
+                                         direction.z < 0.f};
+  const WatertightRay watertight = MakeWatertightRay(origin, direction);
+
+  float closest_so_far = t_max;
+  uint32_t closest_triangle = 0;
+  bool hit_anything = false;
+  glm::vec3 barycentric{};
+
+  // iterative traversal with explicit stack, visit nearer child first
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+
+    RAY_TRACING_STATS_ADD(bvh_nodes, 1);
+
+    if (node.box.Hit(origin, inv_direction, t_min, closest_so_far)) {
+      if (node.IsLeaf()) {
+        RAY_TRACING_STATS_ADD(intersection_tests, node.count);
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          const uint32_t* triangle = &indices_[3 * i];
+          if (IntersectTriangle(watertight, positions_[triangle[0]],
+                                positions_[triangle[1]],
+                                positions_[triangle[2]], t_min, closest_so_far,
+                                barycentric)) {
+            hit_anything = true;
+            closest_triangle = i;
+          }
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size++] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          node_index = node_index + 1;
+        }
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+
+  if (!hit_anything) {
+    return false;
+  }
+
+  // barycentrics of the closest triangle, later misses never overwrite them
+  const uint32_t* triangle = &indices_[3 * closest_triangle];
+  const glm::vec3& p0 = positions_[triangle[0]];
+  const glm::vec3& p1 = positions_[triangle[1]];
+  const glm::vec3& p2 = positions_[triangle[2]];
+
+  record.t = closest_so_far;
+  record.point = ray.At(record.t);
+
+  // front face follows the geometry, shading normals only bend the normal
+  glm::vec3 geometric_normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+  record.SetFaceNormal(ray, geometric_normal);
+
+  if (!normals_.empty()) {
+    glm::vec3 shading_normal = glm::normalize(
+        barycentric.x * normals_[triangle[0]] +
+        barycentric.y * normals_[triangle[1]] +
+        barycentric.z * normals_[triangle[2]]);
+    if (glm::dot(shading_normal, record.normal) < 0.f) {
+      shading_normal = -shading_normal;
+    }
+    record.normal = shading_normal;
+  }
+
+  record.material_index = material_index_;
+
+  return true;
+}
+
+bool TriangleMesh::Occluded(const Ray& ray, float t_min,
+                            float t_max) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+
+  const glm::vec3 origin = ray.GetOrigin();
+  const glm::vec3 direction = ray.GetDirection();
+  const glm::vec3 inv_direction = 1.f / direction;
+  const bool direction_is_negative[3] = {direction.x < 0.f, direction.y < 0.f,
+                                         direction.z < 0.f};
+  const WatertightRay watertight = MakeWatertightRay(origin, direction);
+
+  // IntersectTriangle narrows the interval it is given, a copy keeps t_max
+  float t = t_max;
+  glm::vec3 barycentric{};
+
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+
+    RAY_TRACING_STATS_ADD(bvh_nodes, 1);
+
+    if (node.box.Hit(origin, inv_direction, t_min, t_max)) {
+      if (node.IsLeaf()) {
+        RAY_TRACING_STATS_ADD(intersection_tests, node.count);
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          const uint32_t* triangle = &indices_[3 * i];
+          if (IntersectTriangle(watertight, positions_[triangle[0]],
+                                positions_[triangle[1]],
+                                positions_[triangle[2]], t_min, t,
+                                barycentric)) {
+            return true;
+          }
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size++] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          node_index = node_index + 1;
+        }
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+
+  return false;
+}
+
+void TriangleMesh::HitPacket(const RayPacket& packet, uint32_t mask,
+                             PacketHit& hit) const {
+  mask &= packet.mask;
+  if (nodes_.empty() || !mask) {
+    return;
+  }
+
+  const PacketKernels& kernels = Simd::GetKernels();
+
+  WatertightRay rays[PACKET_SIZE];
+  int first_lane = -1;
+  for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+    if (!(mask & (1u << lane))) {
+      continue;
+    }
+
+    glm::vec3 origin(packet.origin[0][lane], packet.origin[1][lane],
+                     packet.origin[2][lane]);
+    glm::vec3 direction(packet.direction[0][lane], packet.direction[1][lane],
+                        packet.direction[2][lane]);
+    rays[lane] = MakeWatertightRay(origin, direction);
+
+    if (first_lane < 0) {
+      first_lane = lane;
+    }
+  }
+
+  // coherent packets share the traversal order of their first active lane
+  const bool direction_is_negative[3] = {
+      packet.direction[0][first_lane] < 0.f,
+      packet.direction[1][first_lane] < 0.f,
+      packet.direction[2][first_lane] < 0.f};
+
+  // every stack entry carries the lanes that entered its parent
+  uint32_t stack[BvhBuilder::MAX_DEPTH];
+  uint32_t stack_masks[BvhBuilder::MAX_DEPTH];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+  glm::vec3 barycentric{};
+
+  while (true) {
+    const BvhNode& node = nodes_[node_index];
+    RAY_TRACING_STATS_ADD(bvh_nodes, Stats::CountLanes(mask));
+
+    uint32_t node_mask = kernels.intersect_box(packet, node.box.GetMin(),
+                                               node.box.GetMax(), hit.t, mask);
+
+    if (node_mask) {
+      if (node.IsLeaf()) {
+        RAY_TRACING_STATS_ADD(intersection_tests,
+                              node.count * Stats::CountLanes(node_mask));
+
+        // triangles are tested lane by lane, same test as the scalar Hit
+        for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+          if (!(node_mask & (1u << lane))) {
+            continue;
+          }
+
+          for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            const uint32_t* triangle = &indices_[3 * i];
+            if (IntersectTriangle(rays[lane], positions_[triangle[0]],
+                                  positions_[triangle[1]],
+                                  positions_[triangle[2]], packet.t_min,
+                                  hit.t[lane], barycentric)) {
+              hit.object[lane] = this;
+            }
+          }
+        }
+      } else {
+        if (direction_is_negative[node.axis]) {
+          stack[stack_size] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size] = node.offset;
+          node_index = node_index + 1;
+        }
+        stack_masks[stack_size++] = node_mask;
+        mask = node_mask;
+        continue;
+      }
+    }
+
+    if (!stack_size) {
+      break;
+    }
+    --stack_size;
+    node_index = stack[stack_size];
+    mask = stack_masks[stack_size];
+  }
+}
+
+Aabb TriangleMesh::BoundingBox() const {
+  return nodes_.empty() ? Aabb() : nodes_[0].box;
+}
+
+uint32_t TriangleMesh::GetTriangleCount() const {
+  return static_cast<uint32_t>(indices_.size() / 3);
+}
+
+const std::vector<glm::vec3>& TriangleMesh::GetPositions() const {
+  return positions_;
+}
+
+const std::vector<glm::vec3>& TriangleMesh::GetNormals() const {
+  return normals_;
+}
+
+const std::vector<uint32_t>& TriangleMesh::GetIndices() const {
+  return indices_;
+}
+
+}  // namespace rt
@@ -14,10 +14,10 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <limits>
-#include <random>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -35,6 +35,17 @@
 
 namespace rt {
 
+namespace {
+
+// hardware ray tracing, deferred host operations are required by the
+// acceleration structure extension even though builds happen on the device
+const std::vector<const char*> RAY_TRACING_EXTS = {
+    VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+    VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+    VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME};
+
+}  // namespace
+
 inline bool QueueFamilies::IsCompleted() {
   return graphics_family.has_value() && present_family.has_value();
 }
@@ -55,6 +66,20 @@ void Utils::CheckVulkanResult(const int result, const char* error_msg) {
   }
 }
 
+uint32_t Utils::QueryVulkanApiVersion() {
+  uint32_t api_version = VK_API_VERSION_1_0;
+
+  // 1.0 loaders do not have the query
+  auto enumerate_instance_version =
+      reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+          vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+  if (enumerate_instance_version) {
+    enumerate_instance_version(&api_version);
+  }
+
+  return std::min(api_version, static_cast<uint32_t>(VK_API_VERSION_1_2));
+}
+
 std::vector<const char*> Utils::QueryVulkanInstanceExts() {
   std::vector<const char*> required_exts{};
 
@@ -222,6 +247,11 @@ int Utils::EvaluatePhysicalDevice(const VkPhysicalDevice& physical_device,
     score -= 1000;
   }
 
+  // hardware ray tracing
+  if (QueryRayTracingSupport(physical_device)) {
+    score += 500;
+  }
+
   std::clog << "Physical Device: " << device_properties.deviceName << "\n";
 
   return score;
@@ -292,9 +322,70 @@ std::vector<const char*> Utils::QueryVulkanDeviceExts(
         "extension(s)!");
   }
 
+  // ray tracing extensions are optional
+  if (QueryRayTracingSupport(physical_device)) {
+    required_exts.insert(required_exts.end(), RAY_TRACING_EXTS.begin(),
+                         RAY_TRACING_EXTS.end());
+  }
+
   return required_exts;
 }
 
+bool Utils::QueryRayTracingSupport(const VkPhysicalDevice& physical_device) {
+  // buffer device addresses and spir-v 1.4 are core since 1.2
+  VkPhysicalDeviceProperties device_properties{};
+  vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+  if (QueryVulkanApiVersion() < VK_API_VERSION_1_2 ||
+      device_properties.apiVersion < VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  // available device extensions
+  uint32_t available_ext_cnt = 0;
+  vkEnumerateDeviceExtensionProperties(physical_device, nullptr,
+                                       &available_ext_cnt, nullptr);
+  std::vector<VkExtensionProperties> available_exts(available_ext_cnt);
+  vkEnumerateDeviceExtensionProperties(
+      physical_device, nullptr, &available_ext_cnt, available_exts.data());
+
+  // compare
+  std::set<std::string> extensions(RAY_TRACING_EXTS.begin(),
+                                   RAY_TRACING_EXTS.end());
+  for (const auto& extension : available_exts) {
+    extensions.erase(extension.extensionName);
+  }
+
+  if (!extensions.empty()) {
+    return false;
+  }
+
+  // the extensions may still lack the features
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR
+      acceleration_structure_features{};
+  acceleration_structure_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR ray_tracing_pipeline_features{};
+  ray_tracing_pipeline_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+  ray_tracing_pipeline_features.pNext = &acceleration_structure_features;
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features{};
+  vulkan12_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12_features.pNext = &ray_tracing_pipeline_features;
+
+  VkPhysicalDeviceFeatures2 device_features{};
+  device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  device_features.pNext = &vulkan12_features;
+  vkGetPhysicalDeviceFeatures2(physical_device, &device_features);
+
+  return device_features.features.shaderInt64 &&
+         vulkan12_features.bufferDeviceAddress &&
+         acceleration_structure_features.accelerationStructure &&
+         ray_tracing_pipeline_features.rayTracingPipeline;
+}
+
 SwapChainSupportDetails Utils::QuerySwapChainSupport(
     const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface) {
   SwapChainSupportDetails details{};
@@ -499,7 +590,8 @@ void Utils::CreateBuffer(const VkPhysicalDevice& physical_device,
                          const VkDevice& device, const VkDeviceSize size,
                          const VkBufferUsageFlags usage,
                          const VkMemoryPropertyFlags properties,
-                         VkBuffer& buffer, VkDeviceMemory& buffer_memory) {
+                         VkBuffer& buffer, VkDeviceMemory& buffer_memory,
+                         const VkMemoryAllocateFlags allocate_flags) {
   VkBufferCreateInfo buffer_info{};
   buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_info.size = size;
@@ -518,6 +610,14 @@ void Utils::CreateBuffer(const VkPhysicalDevice& physical_device,
   alloc_info.memoryTypeIndex = FindMemoryType(
       physical_device, mem_requirements.memoryTypeBits, properties);
 
+  // device addresses need the memory allocated for them
+  VkMemoryAllocateFlagsInfo alloc_flags_info{};
+  alloc_flags_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+  alloc_flags_info.flags = allocate_flags;
+  if (allocate_flags) {
+    alloc_info.pNext = &alloc_flags_info;
+  }
+
   result = vkAllocateMemory(device, &alloc_info, nullptr, &buffer_memory);
   CheckVulkanResult(result, "Error::Vulkan: Failed to allocate buffer memory!");
 
@@ -539,6 +639,40 @@ void Utils::CopyBuffer(const VkDevice& device,
   EndSingleTimeCommand(device, graphics_queue, command_pool, command_buffer);
 }
 
+void Utils::CreateDeviceLocalBuffer(
+    const VkPhysicalDevice& physical_device, const VkDevice& device,
+    const VkCommandPool& command_pool, const VkQueue& graphics_queue,
+    const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+    VkBuffer& buffer, VkDeviceMemory& buffer_memory) {
+  VkBuffer staging_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory staging_buffer_memory = VK_NULL_HANDLE;
+  CreateBuffer(physical_device, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               staging_buffer, staging_buffer_memory);
+
+  void* map = nullptr;
+  VkResult result =
+      vkMapMemory(device, staging_buffer_memory, 0, size, 0, &map);
+  CheckVulkanResult(result, "Error::Vulkan: Failed to map staging buffer!");
+  memcpy(map, data, static_cast<size_t>(size));
+  vkUnmapMemory(device, staging_buffer_memory);
+
+  const VkMemoryAllocateFlags allocate_flags =
+      (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+          ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+          : 0;
+  CreateBuffer(physical_device, device, size,
+               usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory,
+               allocate_flags);
+  CopyBuffer(device, command_pool, graphics_queue, staging_buffer, buffer,
+             size);
+
+  vkDestroyBuffer(device, staging_buffer, nullptr);
+  vkFreeMemory(device, staging_buffer_memory, nullptr);
+}
+
 void Utils::CreateImage(uint32_t width, uint32_t height, VkFormat format,
                         VkImageTiling tiling, VkImageUsageFlags usage,
                         const VkPhysicalDevice& physical_device,
@@ -587,6 +721,16 @@ void Utils::TransitionImageLayout(const VkDevice& device,
                                   VkImageLayout new_layout) {
   VkCommandBuffer command_buffer = BeginSingleTimeCommand(device, command_pool);
 
+  RecordImageLayoutTransition(command_buffer, image, old_layout, new_layout);
+
+  EndSingleTimeCommand(device, graphics_queue, command_pool, command_buffer);
+}
+
+void Utils::RecordImageLayoutTransition(VkCommandBuffer command_buffer,
+                                        VkImage image,
+                                        VkImageLayout old_layout,
+                                        VkImageLayout new_layout,
+                                        VkPipelineStageFlags shader_stage) {
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.oldLayout = old_layout;
@@ -610,6 +754,14 @@ void Utils::TransitionImageLayout(const VkDevice& device,
 
     source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  } else if (old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+             new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    // previous frames may still sample the image
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    source_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
   } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
              new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -617,6 +769,28 @@ void Utils::TransitionImageLayout(const VkDevice& device,
 
     source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
+             new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    destination_stage = shader_stage;
+  } else if (old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+             new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+    // previous frames may still sample the image
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    source_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    destination_stage = shader_stage;
+  } else if (old_layout == VK_IMAGE_LAYOUT_GENERAL &&
+             new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    source_stage = shader_stage;
+    destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
   } else {
     throw std::invalid_argument(
         "Error::Vulkan: Unsupported layout transition!");
@@ -624,8 +798,6 @@ void Utils::TransitionImageLayout(const VkDevice& device,
 
   vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0,
                        nullptr, 0, nullptr, 1, &barrier);
-
-  EndSingleTimeCommand(device, graphics_queue, command_pool, command_buffer);
 }
 
 void Utils::CopyBufferToImage(const VkDevice& device,
@@ -652,87 +824,4 @@ void Utils::CopyBufferToImage(const VkDevice& device,
   EndSingleTimeCommand(device, graphics_queue, command_pool, command_buffer);
 }
 
-uint32_t Utils::GetColor(const glm::vec3& color, int samples_per_pixel,
-                         float gamma) {
-  float scale = static_cast<float>(1.f / samples_per_pixel);
-
-  glm::vec3 RGB = glm::clamp(color * scale, glm::vec3(0.f), glm::vec3(1.f));
-
-  uint32_t R = static_cast<uint32_t>(std::pow(RGB.r * 255.f, 1.f / gamma));
-  uint32_t G = static_cast<uint32_t>(std::pow(RGB.g * 255.f, 1.f / gamma));
-  uint32_t B = static_cast<uint32_t>(std::pow(RGB.b * 255.f, 1.f / gamma));
-
-  return (255 << 24) | (B << 16) | (G << 8) | R;
-}
-
-uint32_t Utils::GetColor(const glm::vec4& color, int samples_per_pixel,
-                         float gamma) {
-  float scale = static_cast<float>(1.f / samples_per_pixel);
-
-  glm::vec4 RGBA = glm::clamp(color * scale, glm::vec4(0.f), glm::vec4(1.f));
-
-  uint32_t R = static_cast<uint32_t>(std::pow(RGBA.r * 255.f, 1.f / gamma));
-  uint32_t G = static_cast<uint32_t>(std::pow(RGBA.g * 255.f, 1.f / gamma));
-  uint32_t B = static_cast<uint32_t>(std::pow(RGBA.b * 255.f, 1.f / gamma));
-  uint32_t A = static_cast<uint32_t>(std::pow(RGBA.a * 255.f, 1.f / gamma));
-
-  return (A << 24) | (B << 16) | (G << 8) | R;
-}
-
-float Utils::RandomFloat(float min, float max) {
-  static std::uniform_real_distribution<float> distribution(min, max);
-  static std::mt19937 generator{};
-
-  return distribution(generator);
-}
-
-glm::vec3 Utils::RandomVec3(float min, float max) {
-  return glm::vec3(RandomFloat(min, max), RandomFloat(min, max),
-                   RandomFloat(min, max));
-}
-
-bool Utils::NearZero(const glm::vec3& vec) {
-  const float delta = static_cast<float>(1e-8);
-
-  return (std::fabs(vec.x) < delta) && (std::fabs(vec.y) < delta) &&
-         (std::fabs(vec.z) < delta);
-}
-
-glm::vec3 Utils::RandomInUnitSphere() {
-  while (true) {
-    glm::vec3 point = Utils::RandomVec3(-1.f, 1.f);
-
-    if (glm::dot(point, point) >= 1) {
-      continue;
-    }
-
-    return point;
-  }
-}
-
-glm::vec3 Utils::RandomInHemiSphere(const glm::vec3& normal) {
-  glm::vec3 in_unit_sphere = RandomInUnitSphere();
-
-  // whether in current normal semi-sphere or not
-  if (glm::dot(in_unit_sphere, normal) > 0.f) {
-    return in_unit_sphere;
-  } else {
-    return -in_unit_sphere;
-  }
-}
-
-glm::vec3 Utils::RandomInUnitDisk() {
-  while (true) {
-    glm::vec3 point(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), 0.f);
-
-    if (glm::dot(point, point) >= 1.f) {
-      continue;
-    }
-
-    return point;
-  }
-}
-
-float Utils::DegreesToRadians(float degree) { return PI / 180.f * degree; }
-
 }  // namespace rt
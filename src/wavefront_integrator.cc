@@ -0,0 +1,401 @@
+/**
+ * @file wavefront_integrator.cc
+ * @author Mao Zhang (mao.zhang233@gmail.com)
+ * @brief
+ * @version 1.0
+ * @date 2023-04-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "wavefront_integrator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define RAY_TRACING_INCLUDE_GLM
+#include <glm/glm.hpp>
+
+#include "config.h"
+#include "hittable.h"
+#include "light_list.h"
+#include "material.h"
+#include "material_data.h"
+#include "material_table.h"
+#include "math_utils.h"
+#include "path_integrator.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "render_stats.h"
+#include "sampler.h"
+
+namespace rt {
+
+namespace {
+
+// materials of one kind, specialized so every bin calls the MaterialShading
+// code of its kind without looking at the kind again
+template <MaterialKind KIND>
+struct KindShading {
+  static glm::vec3 Emitted(const MaterialTable& materials, uint32_t index,
+                           const HitRecord& record) {
+    (void)materials;
+    (void)index;
+    (void)record;
+    return glm::vec3(0.f);
+  }
+
+  static glm::vec3 Evaluate(const MaterialTable& materials, uint32_t index,
+                            const Ray& ray, const HitRecord& record,
+                            const glm::vec3& direction, float& pdf) {
+    (void)materials;
+    (void)index;
+    (void)ray;
+    (void)record;
+    (void)direction;
+    pdf = 0.f;
+    return glm::vec3(0.f);
+  }
+};
+
+template <>
+struct KindShading<MaterialKind::LAMBERTIAN>
+    : KindShading<MaterialKind::COUNT> {
+  static bool Scatter(const MaterialTable& materials, uint32_t index,
+                      const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) {
+    (void)ray;
+    return MaterialShading::ScatterLambertian(
+        materials.GetData(index), record, attenuation, scattered, sampler);
+  }
+
+  static glm::vec3 Evaluate(const MaterialTable& materials, uint32_t index,
+                            const Ray& ray, const HitRecord& record,
+                            const glm::vec3& direction, float& pdf) {
+    (void)ray;
+    return MaterialShading::EvaluateLambertian(materials.GetData(index),
+                                               record, direction, pdf);
+  }
+};
+
+template <>
+struct KindShading<MaterialKind::METAL> : KindShading<MaterialKind::COUNT> {
+  static bool Scatter(const MaterialTable& materials, uint32_t index,
+                      const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) {
+    return MaterialShading::ScatterMetal(materials.GetData(index), ray,
+                                         record, attenuation, scattered,
+                                         sampler);
+  }
+};
+
+template <>
+struct KindShading<MaterialKind::DIELECTRIC>
+    : KindShading<MaterialKind::COUNT> {
+  static bool Scatter(const MaterialTable& materials, uint32_t index,
+                      const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) {
+    return MaterialShading::ScatterDielectric(materials.GetData(index), ray,
+                                              record, attenuation, scattered,
+                                              sampler);
+  }
+};
+
+template <>
+struct KindShading<MaterialKind::DIFFUSE_LIGHT>
+    : KindShading<MaterialKind::COUNT> {
+  static bool Scatter(const MaterialTable& materials, uint32_t index,
+                      const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) {
+    (void)ray;
+    (void)record;
+    (void)scattered;
+    (void)sampler;
+    return MaterialShading::ScatterDiffuseLight(materials.GetData(index),
+                                                attenuation);
+  }
+
+  static glm::vec3 Emitted(const MaterialTable& materials, uint32_t index,
+                           const HitRecord& record) {
+    return MaterialShading::EmittedDiffuseLight(materials.GetData(index),
+                                                record);
+  }
+};
+
+// the open end, straight through the vtable
+template <>
+struct KindShading<MaterialKind::OTHER> {
+  static bool Scatter(const MaterialTable& materials, uint32_t index,
+                      const Ray& ray, const HitRecord& record,
+                      glm::vec3& attenuation, Ray& scattered,
+                      Sampler& sampler) {
+    return materials.Get(index).Scatter(ray, record, attenuation, scattered,
+                                        sampler);
+  }
+
+  static glm::vec3 Emitted(const MaterialTable& materials, uint32_t index,
+                           const HitRecord& record) {
+    return materials.Get(index).Emitted(record);
+  }
+
+  static glm::vec3 Evaluate(const MaterialTable& materials, uint32_t index,
+                            const Ray& ray, const HitRecord& record,
+                            const glm::vec3& direction, float& pdf) {
+    return materials.Get(index).Evaluate(ray, record, direction, pdf);
+  }
+};
+
+}  // namespace
+
+WavefrontIntegrator::WavefrontIntegrator(const Hittable& world,
+                                         const MaterialTable& materials,
+                                         int max_depth,
+                                         const LightList* lights,
+                                         int roulette_depth)
+    : world_{world},
+      materials_{materials},
+      lights_{lights && !lights->IsEmpty() ? lights : nullptr},
+      max_depth_{max_depth},
+      roulette_depth_{roulette_depth} {}
+
+void WavefrontIntegrator::Trace(WavefrontQueue& queue,
+                                bool use_packets) const {
+  const size_t count = queue.paths.size();
+
+  queue.throughputs.assign(count, glm::vec3(1.f));
+  queue.records.resize(count);
+  queue.scatter_pdfs.assign(count, 0.f);
+  queue.scatter_origins.assign(count, glm::vec3(0.f));
+
+  queue.active.clear();
+  for (size_t i = 0; i < count; ++i) {
+    queue.paths[i].radiance = glm::vec3(0.f);
+    queue.paths[i].aov = SurfaceAov{};
+    queue.active.push_back(static_cast<uint32_t>(i));
+  }
+
+  uint32_t offsets[WAVEFRONT_BIN_COUNT + 1];
+
+  for (int depth = 0; depth < max_depth_ && !queue.active.empty(); ++depth) {
+    Intersect(queue, depth, use_packets && 0 == depth);
+    Bin(queue, offsets);
+
+    queue.active.clear();
+    queue.shadow_rays.clear();
+
+    Shade<MaterialKind::LAMBERTIAN>(queue, offsets[0], offsets[1], depth);
+    Shade<MaterialKind::METAL>(queue, offsets[1], offsets[2], depth);
+    Shade<MaterialKind::DIELECTRIC>(queue, offsets[2], offsets[3], depth);
+    Shade<MaterialKind::DIFFUSE_LIGHT>(queue, offsets[3], offsets[4], depth);
+    Shade<MaterialKind::OTHER>(queue, offsets[4], offsets[5], depth);
+
+    TraceShadowRays(queue);
+  }
+}
+
+void WavefrontIntegrator::Intersect(WavefrontQueue& queue, int depth,
+                                    bool use_packets) const {
+  std::vector<uint32_t>& active = queue.active;
+  size_t kept = 0;
+
+  // paths that hit something stay in the queue, the rest see the background
+  auto finish = [&](uint32_t index, bool is_hit) {
+    if (is_hit) {
+      active[kept++] = index;
+      return;
+    }
+
+    WavefrontPath& path = queue.paths[index];
+    const glm::vec3 background = PathIntegrator::Background(path.ray);
+    path.radiance += queue.throughputs[index] * background;
+    if (0 == depth) {
+      path.aov = SurfaceAov{background, glm::vec3(0.f), glm::vec3(0.f)};
+    }
+  };
+
+  if (!use_packets) {
+    for (size_t i = 0; i < active.size(); ++i) {
+      const uint32_t index = active[i];
+
+      RAY_TRACING_STATS_RAY(depth);
+      finish(index, world_.Hit(queue.paths[index].ray, PathIntegrator::T_MIN,
+                               INFINITY_F, queue.records[index]));
+    }
+
+    active.resize(kept);
+    return;
+  }
+
+  // neighbouring camera rays of the queue share a packet, the full record
+  // is rebuilt from the closest object as in the packet path of Renderer
+  for (size_t first = 0; first < active.size(); first += PACKET_SIZE) {
+    const int lane_count =
+        static_cast<int>(std::min<size_t>(PACKET_SIZE, active.size() - first));
+
+    RayPacket packet{};
+    for (int lane = 0; lane < lane_count; ++lane) {
+      packet.SetRay(lane, queue.paths[active[first + lane]].ray);
+    }
+    packet.mask = (1u << lane_count) - 1u;
+    packet.t_min = PathIntegrator::T_MIN;
+
+    PacketHit hit{};
+    hit.Reset(INFINITY_F);
+    RAY_TRACING_STATS_ADD(rays[0], lane_count);
+    world_.HitPacket(packet, packet.mask, hit);
+
+    for (int lane = 0; lane < lane_count; ++lane) {
+      const uint32_t index = active[first + lane];
+      const Ray& ray = queue.paths[index].ray;
+      const Hittable* object = hit.object[lane];
+      HitRecord& record = queue.records[index];
+
+      bool is_hit = false;
+      if (object) {
+        is_hit = object->Hit(ray, PathIntegrator::T_MIN, hit.t[lane], record);
+        if (!is_hit) {
+          RAY_TRACING_STATS_RAY(0);
+          is_hit = world_.Hit(ray, PathIntegrator::T_MIN, INFINITY_F, record);
+        }
+      }
+
+      finish(index, is_hit);
+    }
+  }
+
+  active.resize(kept);
+}
+
+void WavefrontIntegrator::Bin(WavefrontQueue& queue,
+                              uint32_t* offsets) const {
+  uint32_t counts[WAVEFRONT_BIN_COUNT]{};
+  for (uint32_t index : queue.active) {
+    const MaterialKind kind =
+        materials_.GetKind(queue.records[index].material_index);
+    ++counts[static_cast<int>(kind)];
+  }
+
+  // counting sort, paths keep their queue order within a bin
+  uint32_t cursors[WAVEFRONT_BIN_COUNT];
+  offsets[0] = 0;
+  for (int bin = 0; bin < WAVEFRONT_BIN_COUNT; ++bin) {
+    cursors[bin] = offsets[bin];
+    offsets[bin + 1] = offsets[bin] + counts[bin];
+  }
+
+  queue.binned.resize(queue.active.size());
+  for (uint32_t index : queue.active) {
+    const MaterialKind kind =
+        materials_.GetKind(queue.records[index].material_index);
+    queue.binned[cursors[static_cast<int>(kind)]++] = index;
+  }
+}
+
+template <MaterialKind KIND>
+void WavefrontIntegrator::Shade(WavefrontQueue& queue, uint32_t begin,
+                                uint32_t end, int depth) const {
+  // same steps as one bounce of PathIntegrator::Li, the shadow ray of the
+  // light sample is only queued here
+  for (uint32_t b = begin; b < end; ++b) {
+    const uint32_t index = queue.binned[b];
+    WavefrontPath& path = queue.paths[index];
+    const HitRecord& record = queue.records[index];
+    glm::vec3& throughput = queue.throughputs[index];
+    float& scatter_pdf = queue.scatter_pdfs[index];
+
+    const uint32_t material = record.material_index;
+    using Shading = KindShading<KIND>;
+
+    const glm::vec3 emitted = Shading::Emitted(materials_, material, record);
+    if (!MathUtils::NearZero(emitted)) {
+      float weight = 1.f;
+      if (scatter_pdf > 0.f) {
+        weight = MathUtils::PowerHeuristic(
+            scatter_pdf,
+            lights_->GetPdf(queue.scatter_origins[index], record.point,
+                            record.normal, emitted));
+      }
+
+      path.radiance += throughput * emitted * weight;
+    }
+
+    Ray scattered{};
+    glm::vec3 attenuation{};
+    const bool is_scattered =
+        Shading::Scatter(materials_, material, path.ray, record, attenuation,
+                         scattered, path.sampler);
+
+    if (0 == depth) {
+      path.aov = SurfaceAov{attenuation, record.normal, record.point};
+    }
+
+    if (!is_scattered) {
+      continue;
+    }
+
+    scatter_pdf = 0.f;
+    if (lights_ && depth + 1 < max_depth_) {
+      Shading::Evaluate(materials_, material, path.ray, record,
+                        scattered.GetDirection(), scatter_pdf);
+    }
+
+    LightSample light{};
+    if (scatter_pdf > 0.f) {
+      queue.scatter_origins[index] = record.point;
+
+      float pdf = 0.f;
+      glm::vec3 value{};
+      if (lights_->Sample(record.point, path.sampler, light)) {
+        value = Shading::Evaluate(materials_, material, path.ray, record,
+                                  light.point - record.point, pdf);
+      }
+
+      if (pdf > 0.f) {
+        const float weight = MathUtils::PowerHeuristic(
+            lights_->GetPdf(record.point, light.point, light.normal,
+                            light.radiance),
+            pdf);
+
+        const glm::vec3 offset = light.point - record.point;
+        const float distance = glm::length(offset);
+        queue.shadow_rays.push_back(
+            {Ray(record.point, offset / distance),
+             distance * (1.f - PathIntegrator::SHADOW_EPSILON), index,
+             throughput * (value * light.radiance * (weight / light.pdf))});
+      }
+    }
+
+    throughput *= attenuation;
+
+    if (depth + 1 >= roulette_depth_) {
+      float survival = std::min(
+          std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.95f);
+
+      if (survival <= 0.f || MathUtils::RandomFloat(path.sampler) >= survival) {
+        continue;
+      }
+
+      throughput /= survival;
+    }
+
+    path.ray = scattered;
+    queue.active.push_back(index);
+  }
+}
+
+void WavefrontIntegrator::TraceShadowRays(WavefrontQueue& queue) const {
+  for (const WavefrontShadowRay& shadow_ray : queue.shadow_rays) {
+    RAY_TRACING_STATS_ADD(shadow_rays, 1);
+    if (!world_.Occluded(shadow_ray.ray, PathIntegrator::T_MIN,
+                         shadow_ray.t_max)) {
+      queue.paths[shadow_ray.path].radiance += shadow_ray.radiance;
+    }
+  }
+}
+
+}  // namespace rt